@@ -9,49 +9,73 @@
 #include "pug/pug_parser.h"
 #include "pug/pug_tokenizer.h"
 #include "pug/pug_renderer.h"
+#include "pug/pug_buffer_pool.h"
+#include "pug/pug_parallel.h"
+#include "pug/pug_value.h"
+#include "pug/pug_expr.h"
+#include "pug/pug_template.h"
+#include "pug/pug_loader.h"
+#include "pug/pug_registry.h"
+#include "pug/pug_engine.h"
+#include "pug/pug_image.h"
+#include "pug/pug_preload.h"
+#include "pug/pug_batch.h"
+#include "pug/pug_build.h"
+#include "pug/pug_watch.h"
+#include "pug/pug_document.h"
+#include "pug/pug_serve.h"
 #include "pug/pug_bug.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Punto de entrada principal para procesar un archivo Pug
+// Punto de entrada principal para procesar un archivo Pug. Sin locales
+// enlazadas, las interpolaciones #{...} se renderizan vacías. El motor por
+// defecto guarda la plantilla compilada: repetir el mismo contenido sólo
+// renderiza, con el frame del hilo y un buffer del pool compartido.
 static inline char* process_pug_file(
     const char* content, unsigned int use_tabs, unsigned int tab_size , unsigned int minify) {
-    // Tokenizar
-    TokenList* tokens = tokenize_file(content);
-    if (!tokens) {
-        g_print("Error: Fallo en tokenización\n");
-        return NULL;
-    }
-
-    // Crear contexto de parsing
-    ParserContext* ctx = parser_context_create();
-    if (!ctx) {
-        token_list_free(tokens);
-        g_print("Error: Fallo en creación de ParserContext\n");
-        return NULL;
-    }
-    ctx->tokens = tokens;
-    ctx->use_tabs = use_tabs;
-    ctx->tab_size = tab_size;
-
-    // Parsear
-    ASTNode* root = parse_pug(ctx);
-    if (!root) {
-        parser_context_free(ctx);
-        g_print("Error: Fallo en parsing\n");
-        return NULL;
-    }
+    // Tokenizar, parsear y resolver las locales a slots (sólo la primera vez)
+    PugTemplate* tpl = pug_engine_get_source(pug_engine_default(), content);
+    if (!tpl) return NULL;
 
     // Opcional: Imprimir AST para depuración
     #ifdef DEBUG
-    ast_node_print(root, 0);
+    ast_node_print(tpl->root, 0);
     #endif
 
-    // Renderizar
-    char* result = render_ast(root, ctx->use_tabs, ctx->tab_size,minify);
-    parser_context_free(ctx); // Libera tokens y root
+    // Renderizar en un buffer prestado por el pool compartido
+    PugBufferPool* pool = pug_buffer_pool_default();
+    GString* output = pug_buffer_pool_acquire(pool, 0);
+    template_render_context_cached(tpl, NULL, pug_render_context_get(), output, NULL,
+                                   use_tabs, tab_size, minify);
+    pug_template_free(tpl);
+
+    char* result = pug_buffer_pool_lend(pool, output);
+    if (!result) {
+        g_print("Error: Fallo en renderizado\n");
+    }
+
+    return result;
+}
+
+// Como process_pug_file() pero desde una ruta en disco, resolviendo sus
+// include/extends relativos al directorio del archivo. Las plantillas quedan
+// compiladas en el loader del motor por defecto: las llamadas siguientes sólo
+// comprueban que los archivos no han cambiado.
+static inline char* process_pug_path(
+    const char* path, unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    PugTemplate* tpl = pug_loader_get_file(pug_engine_default()->loader, path);
+    if (!tpl) return NULL;
+
+    PugBufferPool* pool = pug_buffer_pool_default();
+    GString* output = pug_buffer_pool_acquire(pool, 0);
+    template_render_context_cached(tpl, NULL, pug_render_context_get(), output, NULL,
+                                   use_tabs, tab_size, minify);
+    pug_template_free(tpl);
+
+    char* result = pug_buffer_pool_lend(pool, output);
     if (!result) {
         g_print("Error: Fallo en renderizado\n");
     }
@@ -59,9 +83,13 @@ static inline char* process_pug_file(
     return result;
 }
 
-// Libera la memoria del resultado renderizado
+// Libera la memoria del resultado renderizado (si viene del pool, el buffer
+// vuelve al pool para el siguiente render)
 static inline void render_free(char* rendered) {
-    if (rendered) g_free(rendered);
+    if (!rendered) return;
+    if (!pug_buffer_pool_release_str(pug_buffer_pool_default(), rendered)) {
+        g_free(rendered);
+    }
 }
 
 #ifdef __cplusplus
@@ -12,6 +12,58 @@ extern "C" {
 
 
 
+// ============================================================================
+// IMPLEMENTACIÓN INLINE - PugText
+// ============================================================================
+static inline void pug_text_free(PugText* text) {
+    if (!text) return;
+    g_free(text->segments);
+    g_free(text->literals);
+    g_free(text->escaped);
+    g_free(text);
+}
+
+static inline void pug_static_tag_free(PugStaticTag* tag) {
+    if (!tag) return;
+    for (int i = 0; i < 3; i++) g_free(tag->html[i]);
+    g_free(tag);
+}
+
+static inline void pug_branch_free(PugBranch* branch) {
+    if (!branch) return;
+    if (branch->table) g_hash_table_destroy(branch->table);
+    g_free(branch->targets);
+    g_free(branch);
+}
+
+static inline void pug_call_free(PugCall* call) {
+    if (!call) return;
+    g_free(call->name);
+    g_free(call->args);
+    g_strfreev(call->attr_names);
+    g_free(call->attr_values);
+    PugCallVariant* variant = call->variants;
+    while (variant) {
+        PugCallVariant* next = variant->next;
+        g_free(variant->html);
+        g_free(variant);
+        variant = next;
+    }
+    g_free(call);
+}
+
+static inline void pug_include_free(PugInclude* include) {
+    if (!include) return;
+    g_free(include->name);
+    g_free(include);
+}
+
+static inline void pug_block_free(PugBlock* block) {
+    if (!block) return;
+    g_free(block->name);
+    g_free(block);
+}
+
 // ============================================================================
 // IMPLEMENTACIÓN INLINE - ASTNode
 // ============================================================================
@@ -21,6 +73,16 @@ static inline ASTNode* ast_node_create(TokenType type, int depth) {
     
     node->tag = NULL;
     node->text_content = NULL;
+    node->text = NULL;
+    node->expr = NULL;
+    node->loop = NULL;
+    node->open_tag = NULL;
+    node->branch = NULL;
+    node->call = NULL;
+    node->mixin = NULL;
+    node->include = NULL;
+    node->block = NULL;
+    node->tag_info = NULL;
     node->node_type = type;
     node->attributes = NULL;
     node->classes = NULL;
@@ -36,6 +98,7 @@ static inline ASTNode* ast_node_create(TokenType type, int depth) {
     node->is_void = 0;
     node->is_inline = 0;
     node->is_block = 0;
+    node->cache_deps = PUG_CACHE_DEPS_DECLARED;
     
     node->children = (ASTNode**)malloc(sizeof(ASTNode*) * node->children_capacity);
     if (!node->children) {
@@ -67,6 +130,13 @@ static inline void ast_node_free(ASTNode* node) {
     
     if (node->tag) free(node->tag);
     if (node->text_content) free(node->text_content);
+    if (node->text) pug_text_free(node->text);
+    if (node->loop) g_free(node->loop);
+    if (node->open_tag) pug_static_tag_free(node->open_tag);
+    if (node->branch) pug_branch_free(node->branch);
+    if (node->call) pug_call_free(node->call);
+    if (node->include) pug_include_free(node->include);
+    if (node->block) pug_block_free(node->block);
     if (node->id) free(node->id);
     
     if (node->classes) {
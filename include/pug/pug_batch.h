@@ -0,0 +1,142 @@
+#ifndef PUG_BATCH_H
+#define PUG_BATCH_H
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "pug/pug_template.h"
+#include "pug/pug_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// RENDER POR LOTES
+// ============================================================================
+// Renderiza una misma plantilla contra n registros (correos, facturas...).
+// Cada hilo del lote tiene un único PugLocals donde bind enlaza el registro
+// de turno, y reutiliza el frame, la arena y el buffer de salida de su
+// PugRenderContext: por registro sólo se escriben los bytes de la salida.
+// Para no buscar nombres en cada registro, bind puede usar slots obtenidos
+// una vez con pug_template_slot() y pug_locals_set().
+
+#define PUG_BATCH_CHUNK 64      // Registros que toma un hilo de una vez
+
+// Enlaza el registro index en locals (vaciadas antes de cada registro).
+// Devuelve 0 para saltar el registro.
+typedef int (*PugBatchBindFunc)(PugLocals* locals, gsize index, gpointer data);
+
+// Recibe la salida del registro index. Los bytes se reutilizan con el
+// siguiente registro del mismo hilo: hay que copiarlos o escribirlos ya.
+// Con varios hilos se llama desde todos ellos.
+typedef void (*PugBatchEmitFunc)(gsize index, const char* output, gsize len, gpointer data);
+
+typedef struct {
+    guint64 records;            // Registros renderizados
+    guint64 skipped;            // Registros que bind rechazó
+    guint64 bytes;              // Bytes de salida
+    double seconds;
+} PugBatchStats;
+
+typedef struct {
+    PugEngine* engine;
+    const PugTemplate* tpl;
+    gsize n;
+    PugBatchBindFunc bind;
+    PugBatchEmitFunc emit;
+    gpointer data;
+    gsize next;                 // Siguiente registro sin repartir (atómico)
+    GMutex lock;
+    PugBatchStats stats;
+} PugBatch;
+
+// Renderiza registros hasta que no quedan; devuelve al terminar
+static inline gpointer batch_worker(gpointer data) {
+    PugBatch* batch = (PugBatch*)data;
+    PugLocals* locals = pug_locals_new(batch->tpl);
+    const PugEngineConfig* config = &batch->engine->config;
+    PugRenderContext* ctx = pug_render_context_get();
+    guint64 records = 0, skipped = 0, bytes = 0;
+
+    for (;;) {
+        gsize from = (gsize)g_atomic_pointer_add(&batch->next, PUG_BATCH_CHUNK);
+        if (from >= batch->n) break;
+        gsize to = MIN(from + PUG_BATCH_CHUNK, batch->n);
+        for (gsize i = from; i < to; i++) {
+            pug_locals_reset(locals);
+            if (batch->bind && !batch->bind(locals, i, batch->data)) {
+                skipped++;
+                continue;
+            }
+            pug_template_render_context(batch->tpl, locals, ctx, NULL,
+                                        config->use_tabs, config->tab_size, config->minify);
+            if (batch->emit) batch->emit(i, ctx->output->str, ctx->output->len, batch->data);
+            records++;
+            bytes += ctx->output->len;
+        }
+    }
+
+    pug_locals_free(locals);
+    g_mutex_lock(&batch->lock);
+    batch->stats.records += records;
+    batch->stats.skipped += skipped;
+    batch->stats.bytes += bytes;
+    g_mutex_unlock(&batch->lock);
+    return NULL;
+}
+
+// Renderiza tpl una vez por registro 0..n-1 con la configuración del motor.
+// Con n_threads > 1 los registros se reparten por tramos entre el hilo que
+// llama y n_threads - 1 hilos más. stats puede ser NULL.
+static inline void pug_engine_render_batch(PugEngine* engine, const PugTemplate* tpl, gsize n,
+                                           PugBatchBindFunc bind, PugBatchEmitFunc emit, gpointer data,
+                                           unsigned int n_threads, PugBatchStats* stats) {
+    if (!engine || !tpl) return;
+    PugBatch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.engine = engine;
+    batch.tpl = tpl;
+    batch.n = n;
+    batch.bind = bind;
+    batch.emit = emit;
+    batch.data = data;
+    g_mutex_init(&batch.lock);
+
+    gint64 start = g_get_monotonic_time();
+    if (n_threads <= 1 || n <= PUG_BATCH_CHUNK) {
+        batch_worker(&batch);
+    } else {
+        // El hilo que llama es uno más de los n_threads
+        GPtrArray* threads = g_ptr_array_new();
+        for (unsigned int i = 1; i < n_threads; i++) {
+            g_ptr_array_add(threads, g_thread_new("pug-batch", batch_worker, &batch));
+        }
+        batch_worker(&batch);
+        for (guint i = 0; i < threads->len; i++) {
+            g_thread_join((GThread*)g_ptr_array_index(threads, i));
+        }
+        g_ptr_array_free(threads, TRUE);
+    }
+    batch.stats.seconds = (double)(g_get_monotonic_time() - start) / G_USEC_PER_SEC;
+
+    g_mutex_clear(&batch.lock);
+    if (stats) *stats = batch.stats;
+}
+
+static inline void pug_batch_print_stats(const PugBatchStats* stats) {
+    if (!stats) return;
+    double seconds = stats->seconds > 0 ? stats->seconds : 1e-9;
+    printf("=== Batch render ===\n");
+    printf("Registros: %llu | Saltados: %llu | Bytes: %llu\n",
+           (unsigned long long)stats->records, (unsigned long long)stats->skipped,
+           (unsigned long long)stats->bytes);
+    printf("Tiempo: %.3f s | %.0f registros/s | %.1f MB/s\n", stats->seconds,
+           (double)stats->records / seconds, (double)stats->bytes / seconds / (1024.0 * 1024.0));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_BATCH_H
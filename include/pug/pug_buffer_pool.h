@@ -0,0 +1,251 @@
+#ifndef PUG_BUFFER_POOL_H
+#define PUG_BUFFER_POOL_H
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// POOL DE BUFFERS DE SALIDA
+// ============================================================================
+// Reutiliza los GString de salida entre renders en lugar de crear y liberar
+// uno por llamada. Los buffers se agrupan por clases de tamaño (4 KiB * 4^n);
+// un buffer devuelto vuelve a la clase que corresponde a su capacidad real.
+//
+// - max_retained limita los bytes que el pool guarda libres; lo que excede el
+//   límite se libera en el momento.
+// - pug_buffer_pool_trim() libera los buffers que no se han usado desde el
+//   trim anterior (el mínimo de buffers libres observado en cada clase), de
+//   modo que el pool se ajusta a la carga real sin dejar memoria ociosa.
+//
+// Todas las operaciones son seguras entre hilos.
+
+#define PUG_POOL_CLASS_COUNT 6
+#define PUG_POOL_MIN_CLASS_SIZE ((gsize)4096)
+#define PUG_POOL_DEFAULT_MAX_RETAINED ((gsize)64 * 1024 * 1024)
+
+// Variables globales definidas en los headers. Con un símbolo débil el
+// enlazador se queda con una sola definición aunque el header se incluya en
+// varias unidades de traducción, así que todas comparten el mismo objeto.
+#ifndef PUG_SHARED
+#if defined(__GNUC__) || defined(__TINYC__)
+#define PUG_SHARED __attribute__((weak))
+#else
+#define PUG_SHARED
+#endif
+#endif
+
+typedef struct {
+    GPtrArray* free_buffers[PUG_POOL_CLASS_COUNT];  // GString* libres por clase
+    guint min_free[PUG_POOL_CLASS_COUNT];           // mínimo libre desde el último trim (G_MAXUINT = sin préstamos)
+    GHashTable* outstanding;                        // str -> GString prestado
+    gsize retained_bytes;
+    gsize max_retained;
+    gsize typical_len;                              // tamaño de la última salida
+    GMutex lock;
+
+    // Estadísticas
+    guint64 hits;
+    guint64 misses;
+    guint64 discarded;
+} PugBufferPool;
+
+// Capacidad de una clase de tamaño
+static inline gsize pug_buffer_pool_class_size(unsigned int cls) {
+    return PUG_POOL_MIN_CLASS_SIZE << (2 * cls);
+}
+
+// Clase más pequeña cuya capacidad cubre len
+static inline unsigned int pug_buffer_pool_class_for(gsize len) {
+    unsigned int cls = 0;
+    while (cls < PUG_POOL_CLASS_COUNT - 1 && pug_buffer_pool_class_size(cls) < len) cls++;
+    return cls;
+}
+
+static inline PugBufferPool* pug_buffer_pool_new(gsize max_retained) {
+    PugBufferPool* pool = g_new0(PugBufferPool, 1);
+    if (!pool) return NULL;
+    for (unsigned int i = 0; i < PUG_POOL_CLASS_COUNT; i++) {
+        pool->free_buffers[i] = g_ptr_array_new();
+        pool->min_free[i] = G_MAXUINT;
+    }
+    pool->outstanding = g_hash_table_new(g_direct_hash, g_direct_equal);
+    pool->max_retained = max_retained ? max_retained : PUG_POOL_DEFAULT_MAX_RETAINED;
+    g_mutex_init(&pool->lock);
+    return pool;
+}
+
+// Obtiene un buffer vacío con capacidad para al menos hint bytes.
+// Con hint == 0 se usa el tamaño de la última salida devuelta al pool.
+static inline GString* pug_buffer_pool_acquire(PugBufferPool* pool, gsize hint) {
+    if (!pool) return g_string_sized_new(hint ? hint : PUG_POOL_MIN_CLASS_SIZE);
+
+    g_mutex_lock(&pool->lock);
+    if (hint == 0) hint = pool->typical_len;
+    unsigned int wanted = pug_buffer_pool_class_for(hint + 1);
+
+    GString* buf = NULL;
+    for (unsigned int cls = wanted; cls < PUG_POOL_CLASS_COUNT && !buf; cls++) {
+        GPtrArray* list = pool->free_buffers[cls];
+        if (list->len == 0) continue;
+        buf = (GString*)g_ptr_array_remove_index_fast(list, list->len - 1);
+        if (list->len < pool->min_free[cls]) pool->min_free[cls] = list->len;
+        pool->retained_bytes -= buf->allocated_len;
+    }
+
+    if (buf) {
+        pool->hits++;
+    } else {
+        pool->misses++;
+        buf = g_string_sized_new(pug_buffer_pool_class_size(wanted));
+    }
+    g_mutex_unlock(&pool->lock);
+    g_string_truncate(buf, 0);
+    return buf;
+}
+
+// Entrega el contenido de un buffer prestado como char*, que luego se devuelve
+// con pug_buffer_pool_release_str(). Debe llamarse cuando el buffer ya no va a
+// crecer, porque el puntero puede cambiar con cada realloc.
+static inline char* pug_buffer_pool_lend(PugBufferPool* pool, GString* buf) {
+    if (!buf) return NULL;
+    if (!pool) return g_string_free(buf, FALSE);
+    g_mutex_lock(&pool->lock);
+    g_hash_table_insert(pool->outstanding, buf->str, buf);
+    g_mutex_unlock(&pool->lock);
+    return buf->str;
+}
+
+// Devuelve un buffer al pool (o lo libera si el pool ya retiene demasiado)
+static inline void pug_buffer_pool_release(PugBufferPool* pool, GString* buf) {
+    if (!buf) return;
+    if (!pool) {
+        g_string_free(buf, TRUE);
+        return;
+    }
+
+    g_mutex_lock(&pool->lock);
+    pool->typical_len = buf->len;
+
+    // Buffers fuera de las clases o por encima del límite no se retienen
+    if (buf->allocated_len < PUG_POOL_MIN_CLASS_SIZE ||
+        buf->allocated_len > pug_buffer_pool_class_size(PUG_POOL_CLASS_COUNT - 1) * 2 ||
+        pool->retained_bytes + buf->allocated_len > pool->max_retained) {
+        pool->discarded++;
+        g_mutex_unlock(&pool->lock);
+        g_string_free(buf, TRUE);
+        return;
+    }
+
+    // Clase más grande cuya capacidad está garantizada por el buffer
+    unsigned int cls = pug_buffer_pool_class_for(buf->allocated_len);
+    if (cls > 0 && pug_buffer_pool_class_size(cls) > buf->allocated_len) cls--;
+    g_ptr_array_add(pool->free_buffers[cls], buf);
+    pool->retained_bytes += buf->allocated_len;
+    g_mutex_unlock(&pool->lock);
+}
+
+// Devuelve al pool un resultado entregado con pug_buffer_pool_lend().
+// Devuelve 1 si el puntero pertenecía al pool, 0 si no.
+static inline int pug_buffer_pool_release_str(PugBufferPool* pool, char* str) {
+    if (!pool || !str) return 0;
+    g_mutex_lock(&pool->lock);
+    GString* buf = (GString*)g_hash_table_lookup(pool->outstanding, str);
+    if (buf) g_hash_table_remove(pool->outstanding, str);
+    g_mutex_unlock(&pool->lock);
+    if (!buf) return 0;
+    pug_buffer_pool_release(pool, buf);
+    return 1;
+}
+
+// Libera los buffers que no se han necesitado desde el trim anterior.
+// Pensado para llamarse periódicamente (p. ej. cada pocos segundos).
+// Devuelve los bytes liberados.
+static inline gsize pug_buffer_pool_trim(PugBufferPool* pool) {
+    if (!pool) return 0;
+    GPtrArray* victims = g_ptr_array_new();
+
+    g_mutex_lock(&pool->lock);
+    for (unsigned int cls = 0; cls < PUG_POOL_CLASS_COUNT; cls++) {
+        // Sin préstamos desde el trim anterior el mínimo es el número actual
+        // de libres: todos estuvieron ociosos
+        GPtrArray* list = pool->free_buffers[cls];
+        guint idle = MIN(pool->min_free[cls], list->len);
+        for (guint i = 0; i < idle; i++) {
+            GString* buf = (GString*)g_ptr_array_remove_index_fast(list, 0);
+            pool->retained_bytes -= buf->allocated_len;
+            g_ptr_array_add(victims, buf);
+        }
+        pool->min_free[cls] = G_MAXUINT;
+    }
+    g_mutex_unlock(&pool->lock);
+
+    gsize freed = 0;
+    for (guint i = 0; i < victims->len; i++) {
+        GString* buf = (GString*)g_ptr_array_index(victims, i);
+        freed += buf->allocated_len;
+        g_string_free(buf, TRUE);
+    }
+    g_ptr_array_free(victims, TRUE);
+
+#ifdef __GLIBC__
+    // Devolver al sistema las páginas libres que glibc retiene en sus arenas
+    if (freed > 0) malloc_trim(0);
+#endif
+    return freed;
+}
+
+static inline void pug_buffer_pool_print_stats(PugBufferPool* pool) {
+    if (!pool) return;
+    g_mutex_lock(&pool->lock);
+    printf("=== Buffer pool ===\n");
+    printf("Retenido: %zu / %zu bytes\n", (size_t)pool->retained_bytes, (size_t)pool->max_retained);
+    printf("Hits: %llu | Misses: %llu | Descartados: %llu\n",
+           (unsigned long long)pool->hits, (unsigned long long)pool->misses,
+           (unsigned long long)pool->discarded);
+    for (unsigned int cls = 0; cls < PUG_POOL_CLASS_COUNT; cls++) {
+        printf("  clase %u (%zu bytes): %u libres\n", cls,
+               (size_t)pug_buffer_pool_class_size(cls), pool->free_buffers[cls]->len);
+    }
+    g_mutex_unlock(&pool->lock);
+}
+
+// Libera el pool y todos los buffers libres. Los buffers todavía prestados
+// pasan a ser propiedad de quien los tenga.
+static inline void pug_buffer_pool_free(PugBufferPool* pool) {
+    if (!pool) return;
+    for (unsigned int cls = 0; cls < PUG_POOL_CLASS_COUNT; cls++) {
+        GPtrArray* list = pool->free_buffers[cls];
+        for (guint i = 0; i < list->len; i++) {
+            g_string_free((GString*)g_ptr_array_index(list, i), TRUE);
+        }
+        g_ptr_array_free(list, TRUE);
+    }
+    g_hash_table_destroy(pool->outstanding);
+    g_mutex_clear(&pool->lock);
+    g_free(pool);
+}
+
+// Pool compartido que usan process_pug_file(), render_free() y el render
+// paralelo. Es uno solo para todo el programa (ver PUG_SHARED).
+PUG_SHARED PugBufferPool* pug_buffer_pool_shared = NULL;
+
+static inline PugBufferPool* pug_buffer_pool_default(void) {
+    if (g_once_init_enter(&pug_buffer_pool_shared)) {
+        g_once_init_leave(&pug_buffer_pool_shared, pug_buffer_pool_new(0));
+    }
+    return pug_buffer_pool_shared;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_BUFFER_POOL_H
@@ -34,6 +34,15 @@ static inline const char* token_type_to_string(TokenType type) {
         case TOKEN_BLOCK_COMMENT: return "BLOCK_COMMENT";
         case TOKEN_MIXIN: return "MIXIN";
         case TOKEN_CALL: return "CALL";
+        case TOKEN_CACHE: return "CACHE";
+        case TOKEN_EACH: return "EACH";
+        case TOKEN_IF: return "IF";
+        case TOKEN_UNLESS: return "UNLESS";
+        case TOKEN_ELSE: return "ELSE";
+        case TOKEN_CASE: return "CASE";
+        case TOKEN_WHEN: return "WHEN";
+        case TOKEN_DEFAULT: return "DEFAULT";
+        case TOKEN_BLOCK: return "BLOCK";
         case TOKEN_EOF: return "EOF";
         default: return "UNKNOWN";
     }
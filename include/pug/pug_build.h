@@ -0,0 +1,590 @@
+#ifndef PUG_BUILD_H
+#define PUG_BUILD_H
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "pug/pug_template.h"
+#include "pug/pug_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// COMPILACIÓN DE DIRECTORIOS
+// ============================================================================
+// Recorre un directorio de origen, renderiza cada *.pug y escribe el .html
+// en la misma ruta relativa del directorio de salida. Todo ocurre en un solo
+// proceso: las plantillas comunes (layouts, includes) se compilan una vez en
+// el motor y las comparten todos los hilos.
+//
+// El reparto es por robo de trabajo: cada hilo tiene su propia cola; mete
+// al final lo que descubre (los archivos de un directorio que recorre) y
+// saca del final, así trabaja sobre lo que acaba de ver. Cuando se queda sin
+// nada roba del principio de la cola de otro hilo, donde están las tareas más
+// antiguas y normalmente más grandes (directorios enteros sin recorrer).
+
+// Qué se hizo con un archivo en un build incremental
+typedef enum {
+    PUG_BUILD_WRITTEN = 0,      // Renderizado y escrito
+    PUG_BUILD_UNCHANGED,        // Renderizado, pero el HTML era el mismo: no se escribe
+    PUG_BUILD_SKIPPED           // Sus entradas no cambiaron: ni se compila
+} PugBuildState;
+
+typedef struct {
+    char* path;                 // Relativa al directorio de origen
+    gboolean is_dir;
+    gboolean ok;
+    PugBuildState state;
+    gsize bytes;                // Bytes de HTML escritos
+    double ms;                  // Compilar + renderizar + escribir
+} PugBuildFile;
+
+typedef struct {
+    GPtrArray* files;           // PugBuildFile* de cada .pug, por ruta
+    guint failed;
+    guint skipped;
+    guint unchanged;
+    guint64 steals;             // Tareas que un hilo tomó de otra cola
+    unsigned int n_threads;
+    double seconds;
+} PugBuildReport;
+
+// ============================================================================
+// MANIFIESTO (build incremental)
+// ============================================================================
+// Guarda para cada página las plantillas de las que sale (ella misma y sus
+// include/extends, recursivamente) con la marca y el hash de su contenido,
+// más el hash del HTML escrito. En el siguiente build una página cuyas
+// entradas siguen igual no se compila; una que cambió se renderiza, pero si
+// el HTML sale igual no se reescribe y rsync o la invalidación del CDN no la
+// ven. Un cambio en un parcial sólo reconstruye las páginas que lo usan.
+//
+// Es un archivo de texto con una línea por registro:
+//   pug-manifest 1
+//   O <hash del html> <página relativa al origen>
+//   I <marca> <hash> <ruta de una entrada de la página anterior>
+
+#define PUG_MANIFEST_HEADER "pug-manifest 1"
+
+typedef struct {
+    char* path;
+    gint64 stamp;
+    guint64 hash;
+} PugManifestInput;
+
+typedef struct {
+    char* source;
+    guint64 output_hash;
+    GArray* inputs;             // PugManifestInput
+} PugManifestEntry;
+
+typedef struct {
+    GHashTable* entries;        // source -> PugManifestEntry*
+} PugManifest;
+
+static inline PugManifestEntry* manifest_entry_new(const char* source, guint64 output_hash) {
+    PugManifestEntry* entry = g_new0(PugManifestEntry, 1);
+    entry->source = g_strdup(source);
+    entry->output_hash = output_hash;
+    entry->inputs = g_array_new(FALSE, FALSE, sizeof(PugManifestInput));
+    return entry;
+}
+
+static inline void manifest_entry_add_input(PugManifestEntry* entry, const char* path, gint64 stamp, guint64 hash) {
+    PugManifestInput input = { g_strdup(path), stamp, hash };
+    g_array_append_val(entry->inputs, input);
+}
+
+static inline void manifest_entry_free(PugManifestEntry* entry) {
+    if (!entry) return;
+    for (guint i = 0; i < entry->inputs->len; i++) g_free(g_array_index(entry->inputs, PugManifestInput, i).path);
+    g_array_free(entry->inputs, TRUE);
+    g_free(entry->source);
+    g_free(entry);
+}
+
+static inline PugManifest* pug_manifest_new(void) {
+    PugManifest* manifest = g_new0(PugManifest, 1);
+    manifest->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)manifest_entry_free);
+    return manifest;
+}
+
+static inline void pug_manifest_free(PugManifest* manifest) {
+    if (!manifest) return;
+    g_hash_table_destroy(manifest->entries);
+    g_free(manifest);
+}
+
+static inline void pug_manifest_put(PugManifest* manifest, PugManifestEntry* entry) {
+    g_hash_table_replace(manifest->entries, entry->source, entry);
+}
+
+// Lee un manifiesto. Si no existe o no se entiende devuelve uno vacío (el
+// build será completo).
+static inline PugManifest* pug_manifest_load(const char* path) {
+    PugManifest* manifest = pug_manifest_new();
+    char* content = NULL;
+    if (!path || !g_file_get_contents(path, &content, NULL, NULL)) return manifest;
+
+    char** lines = g_strsplit(content, "\n", -1);
+    g_free(content);
+    if (!lines[0] || strcmp(lines[0], PUG_MANIFEST_HEADER) != 0) {
+        g_strfreev(lines);
+        return manifest;
+    }
+
+    PugManifestEntry* entry = NULL;
+    for (int i = 1; lines[i]; i++) {
+        char* line = lines[i];
+        char* end = NULL;
+        if (line[0] == 'O' && line[1] == ' ') {
+            guint64 hash = g_ascii_strtoull(line + 2, &end, 16);
+            if (end && *end == ' ') {
+                entry = manifest_entry_new(end + 1, hash);
+                pug_manifest_put(manifest, entry);
+            }
+        } else if (line[0] == 'I' && line[1] == ' ' && entry) {
+            gint64 stamp = g_ascii_strtoll(line + 2, &end, 10);
+            if (!end || *end != ' ') continue;
+            guint64 hash = g_ascii_strtoull(end + 1, &end, 16);
+            if (end && *end == ' ') manifest_entry_add_input(entry, end + 1, stamp, hash);
+        }
+    }
+    g_strfreev(lines);
+    return manifest;
+}
+
+static inline gint manifest_entry_compare(gconstpointer a, gconstpointer b) {
+    return strcmp((*(const PugManifestEntry* const*)a)->source, (*(const PugManifestEntry* const*)b)->source);
+}
+
+// Escribe el manifiesto (ordenado por página, así se puede comparar)
+static inline gboolean pug_manifest_save(PugManifest* manifest, const char* path) {
+    GPtrArray* sorted = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer entry;
+    g_hash_table_iter_init(&iter, manifest->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &entry)) g_ptr_array_add(sorted, entry);
+    g_ptr_array_sort(sorted, manifest_entry_compare);
+
+    GString* out = g_string_new(PUG_MANIFEST_HEADER "\n");
+    for (guint i = 0; i < sorted->len; i++) {
+        const PugManifestEntry* e = (const PugManifestEntry*)g_ptr_array_index(sorted, i);
+        g_string_append_printf(out, "O %016llx %s\n", (unsigned long long)e->output_hash, e->source);
+        for (guint j = 0; j < e->inputs->len; j++) {
+            const PugManifestInput* in = &g_array_index(e->inputs, PugManifestInput, j);
+            g_string_append_printf(out, "I %lld %016llx %s\n", (long long)in->stamp,
+                                   (unsigned long long)in->hash, in->path);
+        }
+    }
+    g_ptr_array_free(sorted, TRUE);
+
+    GError* error = NULL;
+    gboolean ok = g_file_set_contents(path, out->str, (gssize)out->len, &error);
+    if (!ok) {
+        g_print("Error: No se pudo escribir el manifiesto %s: %s\n", path, error->message);
+        g_error_free(error);
+    }
+    g_string_free(out, TRUE);
+    return ok;
+}
+
+// ============================================================================
+// REPARTO
+// ============================================================================
+
+typedef struct {
+    GQueue tasks;               // PugBuildFile*; el dueño trabaja por el final
+    GMutex lock;
+} PugBuildQueue;
+
+typedef struct {
+    PugEngine* engine;
+    const char* src;
+    const char* out;
+    PugBuildQueue* queues;
+    unsigned int n_threads;
+    gint pending;               // Tareas encoladas o en curso
+    GMutex lock;                // Protege report, manifest y hashes
+    PugBuildReport* report;
+    PugManifest* previous;      // Manifiesto del build anterior (NULL = build completo)
+    PugManifest* manifest;      // El de este build (NULL = sin manifiesto)
+    GHashTable* hashes;         // Entrada -> hash actual (guint64*), leída una vez
+} PugBuild;
+
+typedef struct {
+    PugBuild* build;
+    unsigned int index;
+} PugBuildWorker;
+
+static inline void pug_build_file_free(PugBuildFile* file) {
+    if (!file) return;
+    g_free(file->path);
+    g_free(file);
+}
+
+static inline void build_push(PugBuild* build, unsigned int worker, char* path, gboolean is_dir) {
+    PugBuildFile* task = g_new0(PugBuildFile, 1);
+    task->path = path;
+    task->is_dir = is_dir;
+    g_atomic_int_inc(&build->pending);
+    PugBuildQueue* queue = &build->queues[worker];
+    g_mutex_lock(&queue->lock);
+    g_queue_push_tail(&queue->tasks, task);
+    g_mutex_unlock(&queue->lock);
+}
+
+// Siguiente tarea para worker: la última de su cola o la primera de otra
+static inline PugBuildFile* build_take(PugBuild* build, unsigned int worker, guint64* steals) {
+    PugBuildQueue* own = &build->queues[worker];
+    g_mutex_lock(&own->lock);
+    PugBuildFile* task = (PugBuildFile*)g_queue_pop_tail(&own->tasks);
+    g_mutex_unlock(&own->lock);
+    if (task) return task;
+
+    for (unsigned int i = 1; i < build->n_threads; i++) {
+        PugBuildQueue* victim = &build->queues[(worker + i) % build->n_threads];
+        g_mutex_lock(&victim->lock);
+        task = (PugBuildFile*)g_queue_pop_head(&victim->tasks);
+        g_mutex_unlock(&victim->lock);
+        if (task) {
+            (*steals)++;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+// Encola el contenido de un directorio: subdirectorios y archivos .pug.
+// Se saltan las entradas ocultas y los enlaces simbólicos a directorios.
+static inline void build_scan_dir(PugBuild* build, unsigned int worker, const char* rel) {
+    char* dir_path = rel[0] ? g_build_filename(build->src, rel, NULL) : g_strdup(build->src);
+    GError* error = NULL;
+    GDir* dir = g_dir_open(dir_path, 0, &error);
+    if (!dir) {
+        g_print("Error: No se pudo abrir %s: %s\n", dir_path, error->message);
+        g_error_free(error);
+        g_free(dir_path);
+        return;
+    }
+
+    const char* name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (name[0] == '.') continue;
+        char* full = g_build_filename(dir_path, name, NULL);
+        char* child = rel[0] ? g_build_filename(rel, name, NULL) : g_strdup(name);
+        if (g_file_test(full, G_FILE_TEST_IS_DIR)) {
+            if (g_file_test(full, G_FILE_TEST_IS_SYMLINK)) {
+                g_free(child);
+            } else {
+                build_push(build, worker, child, TRUE);
+            }
+        } else if (g_str_has_suffix(name, ".pug")) {
+            build_push(build, worker, child, FALSE);
+        } else {
+            g_free(child);
+        }
+        g_free(full);
+    }
+    g_dir_close(dir);
+    g_free(dir_path);
+}
+
+// Hash actual de una entrada; cada archivo se lee una vez por build
+static inline gboolean build_input_hash(PugBuild* build, const char* path, guint64* hash) {
+    g_mutex_lock(&build->lock);
+    guint64* known = (guint64*)g_hash_table_lookup(build->hashes, path);
+    if (known) *hash = *known;
+    g_mutex_unlock(&build->lock);
+    if (known) return TRUE;
+
+    const PugFileProvider* provider = &build->engine->loader->provider;
+    char* content = provider->read(path, provider->data);
+    if (!content) return FALSE;
+    *hash = pug_loader_hash(content);
+    g_free(content);
+
+    g_mutex_lock(&build->lock);
+    if (!g_hash_table_contains(build->hashes, path)) {
+        g_hash_table_insert(build->hashes, g_strdup(path), g_memdup2(hash, sizeof(guint64)));
+    }
+    g_mutex_unlock(&build->lock);
+    return TRUE;
+}
+
+// Si ninguna entrada de old cambió devuelve la entrada para el manifiesto
+// nuevo (con las marcas actuales); si no, NULL. Una marca distinta con el
+// mismo contenido (un touch, un checkout) no cuenta como cambio.
+static inline PugManifestEntry* build_entry_fresh(PugBuild* build, const PugManifestEntry* old) {
+    const PugFileProvider* provider = &build->engine->loader->provider;
+    if (old->inputs->len == 0) return NULL;
+    PugManifestEntry* fresh = manifest_entry_new(old->source, old->output_hash);
+    for (guint i = 0; i < old->inputs->len; i++) {
+        const PugManifestInput* input = &g_array_index(old->inputs, PugManifestInput, i);
+        gint64 stamp = provider->stat ? provider->stat(input->path, provider->data) : -1;
+        guint64 hash = input->hash;
+        if (stamp < 0 || stamp != input->stamp) {
+            if (!build_input_hash(build, input->path, &hash) || hash != input->hash) {
+                manifest_entry_free(fresh);
+                return NULL;
+            }
+        }
+        manifest_entry_add_input(fresh, input->path, stamp, hash);
+    }
+    return fresh;
+}
+
+// Entradas de tpl para el manifiesto: ella y lo que usa, sin repetir
+static inline void build_collect_inputs(const PugTemplate* tpl, GHashTable* seen, PugManifestEntry* entry) {
+    if (g_hash_table_contains(seen, tpl->name)) return;
+    g_hash_table_add(seen, tpl->name);
+    manifest_entry_add_input(entry, tpl->name, tpl->source_stamp, tpl->source_hash);
+    for (guint i = 0; i < tpl->uses->len; i++) {
+        build_collect_inputs((const PugTemplate*)g_ptr_array_index(tpl->uses, i), seen, entry);
+    }
+}
+
+static inline void build_record(PugBuild* build, PugManifestEntry* entry) {
+    if (!build->manifest) {
+        manifest_entry_free(entry);
+        return;
+    }
+    g_mutex_lock(&build->lock);
+    pug_manifest_put(build->manifest, entry);
+    g_mutex_unlock(&build->lock);
+}
+
+// Renderiza un archivo y escribe su .html en el directorio de salida. Un
+// include o extends que no se pudo cargar cuenta como fallo. Con manifiesto
+// anterior se salta lo que no cambió.
+static inline gboolean build_render_file(PugBuild* build, PugBuildFile* file) {
+    gsize base_len = strlen(file->path) - strlen(".pug");
+    char* rel = g_strdup_printf("%.*s.html", (int)base_len, file->path);
+    char* target = g_build_filename(build->out, rel, NULL);
+    g_free(rel);
+
+    const PugManifestEntry* old = build->previous
+        ? (const PugManifestEntry*)g_hash_table_lookup(build->previous->entries, file->path) : NULL;
+    gboolean exists = old && g_file_test(target, G_FILE_TEST_IS_REGULAR);
+    if (exists) {
+        PugManifestEntry* fresh = build_entry_fresh(build, old);
+        if (fresh) {
+            file->state = PUG_BUILD_SKIPPED;
+            build_record(build, fresh);
+            g_free(target);
+            return TRUE;
+        }
+    }
+
+    PugTemplate* tpl = pug_engine_get(build->engine, file->path);
+    if (!tpl) {
+        g_free(target);
+        return FALSE;
+    }
+    if (tpl->unresolved > 0) {
+        g_print("Error: %s tiene %u include/extends sin resolver\n", file->path, tpl->unresolved);
+        pug_template_free(tpl);
+        g_free(target);
+        return FALSE;
+    }
+    gsize len = 0;
+    const char* html = pug_engine_render(build->engine, tpl, NULL, &len);
+    guint64 output_hash = pug_loader_hash(html);
+
+    gboolean ok = TRUE;
+    if (exists && old->output_hash == output_hash) {
+        file->state = PUG_BUILD_UNCHANGED;
+    } else {
+        char* parent = g_path_get_dirname(target);
+        GError* error = NULL;
+        ok = g_mkdir_with_parents(parent, 0755) == 0 &&
+             g_file_set_contents(target, html, (gssize)len, &error);
+        if (!ok) {
+            g_print("Error: No se pudo escribir %s: %s\n", target, error ? error->message : g_strerror(errno));
+            if (error) g_error_free(error);
+        }
+        file->state = PUG_BUILD_WRITTEN;
+        file->bytes = ok ? len : 0;
+        g_free(parent);
+    }
+
+    if (ok) {
+        PugManifestEntry* entry = manifest_entry_new(file->path, output_hash);
+        GHashTable* seen = g_hash_table_new(g_str_hash, g_str_equal);
+        build_collect_inputs(tpl, seen, entry);
+        g_hash_table_destroy(seen);
+        build_record(build, entry);
+    }
+
+    g_free(target);
+    pug_template_free(tpl);
+    return ok;
+}
+
+static inline gpointer build_worker(gpointer data) {
+    PugBuildWorker* self = (PugBuildWorker*)data;
+    PugBuild* build = self->build;
+    guint64 steals = 0;
+
+    while (g_atomic_int_get(&build->pending) > 0) {
+        PugBuildFile* task = build_take(build, self->index, &steals);
+        if (!task) {
+            // Otro hilo aún puede descubrir trabajo recorriendo un directorio
+            g_usleep(50);
+            continue;
+        }
+
+        if (task->is_dir) {
+            build_scan_dir(build, self->index, task->path);
+            pug_build_file_free(task);
+        } else {
+            gint64 start = g_get_monotonic_time();
+            task->ok = build_render_file(build, task);
+            task->ms = (double)(g_get_monotonic_time() - start) / 1000.0;
+            g_mutex_lock(&build->lock);
+            g_ptr_array_add(build->report->files, task);
+            if (!task->ok) build->report->failed++;
+            else if (task->state == PUG_BUILD_SKIPPED) build->report->skipped++;
+            else if (task->state == PUG_BUILD_UNCHANGED) build->report->unchanged++;
+            g_mutex_unlock(&build->lock);
+        }
+        g_atomic_int_add(&build->pending, -1);
+    }
+
+    g_mutex_lock(&build->lock);
+    build->report->steals += steals;
+    g_mutex_unlock(&build->lock);
+    return NULL;
+}
+
+static inline gint build_file_compare(gconstpointer a, gconstpointer b) {
+    const PugBuildFile* fa = *(const PugBuildFile* const*)a;
+    const PugBuildFile* fb = *(const PugBuildFile* const*)b;
+    return strcmp(fa->path, fb->path);
+}
+
+// Reparte el trabajo entre los hilos y espera. pages == NULL recorre src
+// entero; si no, sólo se construyen esas páginas (relativas a src) y el
+// resto del manifiesto anterior se conserva.
+static inline guint build_run(PugEngine* engine, const char* src, const char* out, unsigned int n_threads,
+                              const char* manifest, const GPtrArray* pages, PugBuildReport* report) {
+    memset(report, 0, sizeof(PugBuildReport));
+    report->files = g_ptr_array_new_with_free_func((GDestroyNotify)pug_build_file_free);
+    if (!engine || !src || !out) return 0;
+    if (!g_file_test(src, G_FILE_TEST_IS_DIR)) {
+        g_print("Error: %s no es un directorio\n", src);
+        report->failed = 1;
+        return report->failed;
+    }
+
+    PugBuild build;
+    memset(&build, 0, sizeof(build));
+    build.engine = engine;
+    build.src = src;
+    build.out = out;
+    build.n_threads = n_threads ? n_threads : g_get_num_processors();
+    build.queues = g_new0(PugBuildQueue, build.n_threads);
+    for (unsigned int i = 0; i < build.n_threads; i++) {
+        g_queue_init(&build.queues[i].tasks);
+        g_mutex_init(&build.queues[i].lock);
+    }
+    g_mutex_init(&build.lock);
+    build.report = report;
+    report->n_threads = build.n_threads;
+    if (manifest) {
+        build.previous = pug_manifest_load(manifest);
+        build.manifest = pages ? pug_manifest_load(manifest) : pug_manifest_new();
+    }
+    build.hashes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    gint64 start = g_get_monotonic_time();
+    if (pages) {
+        for (guint i = 0; i < pages->len; i++) {
+            build_push(&build, i % build.n_threads, g_strdup((const char*)g_ptr_array_index(pages, i)), FALSE);
+        }
+    } else {
+        build_push(&build, 0, g_strdup(""), TRUE);
+    }
+
+    // El hilo que llama es el trabajador 0
+    PugBuildWorker* workers = g_new0(PugBuildWorker, build.n_threads);
+    GThread** threads = g_new0(GThread*, build.n_threads);
+    for (unsigned int i = 0; i < build.n_threads; i++) {
+        workers[i].build = &build;
+        workers[i].index = i;
+        if (i > 0) threads[i] = g_thread_new("pug-build", build_worker, &workers[i]);
+    }
+    build_worker(&workers[0]);
+    for (unsigned int i = 1; i < build.n_threads; i++) g_thread_join(threads[i]);
+    report->seconds = (double)(g_get_monotonic_time() - start) / G_USEC_PER_SEC;
+    g_ptr_array_sort(report->files, build_file_compare);
+    if (manifest) {
+        g_mkdir_with_parents(out, 0755);
+        pug_manifest_save(build.manifest, manifest);
+    }
+    pug_manifest_free(build.previous);
+    pug_manifest_free(build.manifest);
+    g_hash_table_destroy(build.hashes);
+
+    for (unsigned int i = 0; i < build.n_threads; i++) g_mutex_clear(&build.queues[i].lock);
+    g_mutex_clear(&build.lock);
+    g_free(threads);
+    g_free(workers);
+    g_free(build.queues);
+    return report->failed;
+}
+
+// Compila src en out con engine (su raíz debe ser src). n_threads == 0 usa
+// un hilo por CPU. Con manifest != NULL el build es incremental: se lee el
+// manifiesto del build anterior y al terminar se escribe el nuevo (sólo con
+// las páginas que siguen existiendo). Devuelve el número de archivos que
+// fallaron; report queda relleno y se libera con pug_build_report_clear().
+static inline guint pug_build_directory(PugEngine* engine, const char* src, const char* out,
+                                        unsigned int n_threads, const char* manifest, PugBuildReport* report) {
+    return build_run(engine, src, out, n_threads, manifest, NULL, report);
+}
+
+// Como pug_build_directory() pero sólo para las páginas de pages (rutas
+// *.pug relativas a src), p. ej. las afectadas por un cambio
+static inline guint pug_build_pages(PugEngine* engine, const char* src, const char* out, unsigned int n_threads,
+                                    const char* manifest, const GPtrArray* pages, PugBuildReport* report) {
+    return build_run(engine, src, out, n_threads, manifest, pages, report);
+}
+
+static inline void pug_build_report_print(const PugBuildReport* report, gboolean per_file) {
+    if (!report || !report->files) return;
+    gsize bytes = 0;
+    double busy = 0;
+    for (guint i = 0; i < report->files->len; i++) {
+        const PugBuildFile* file = (const PugBuildFile*)g_ptr_array_index(report->files, i);
+        bytes += file->bytes;
+        busy += file->ms;
+        if (per_file) {
+            const char* mark = !file->ok ? "!!" : file->state == PUG_BUILD_SKIPPED ? "==" :
+                               file->state == PUG_BUILD_UNCHANGED ? "=~" : "  ";
+            printf("%s %8.2f ms %8zu B  %s\n", mark, file->ms, (size_t)file->bytes, file->path);
+        }
+    }
+    printf("=== Build ===\n");
+    printf("Archivos: %u | Fallos: %u | Bytes: %zu\n", report->files->len, report->failed, (size_t)bytes);
+    printf("Al día: %u | Sin cambios en la salida: %u | Escritos: %u\n", report->skipped, report->unchanged,
+           report->files->len - report->failed - report->skipped - report->unchanged);
+    printf("Hilos: %u | Robos: %llu | Tiempo: %.3f s (%.3f s sumando archivos)\n", report->n_threads,
+           (unsigned long long)report->steals, report->seconds, busy / 1000.0);
+}
+
+static inline void pug_build_report_clear(PugBuildReport* report) {
+    if (!report) return;
+    if (report->files) g_ptr_array_free(report->files, TRUE);
+    report->files = NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_BUILD_H
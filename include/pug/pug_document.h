@@ -0,0 +1,532 @@
+#ifndef PUG_DOCUMENT_H
+#define PUG_DOCUMENT_H
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pug/pug_tokens.h"
+#include "pug/pug_token_list.h"
+#include "pug/pug_ast.h"
+#include "pug/pug_parser.h"
+#include "pug/pug_tokenizer.h"
+#include "pug/pug_renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// DOCUMENTO EDITABLE (re-tokenizado y re-parseo incremental)
+// ============================================================================
+// Guarda el texto de una plantilla junto con sus tokens y su AST para que un
+// editor pueda aplicar ediciones sin volver a procesarla entera. El
+// tokenizador trabaja línea a línea, así que una edición sólo re-tokeniza
+// las líneas que toca. El parser agrupa por indentación: se busca el nodo
+// más profundo cuyo bloque contiene la edición, se parsea de nuevo desde el
+// hijo afectado y se para en cuanto el parseo vuelve a coincidir con un hijo
+// viejo posterior a la edición; ese hijo y los siguientes se conservan.
+//
+// El árbol resultante es el mismo que daría parse_pug() sobre el texto
+// nuevo. En los casos raros en que no se puede garantizar (tokens sueltos que
+// el parser salta justo en el límite del bloque) se parsea todo.
+//
+// El AST no está compilado: sirve para la vista previa (render_ast) o para
+// inspeccionarlo. Una PugTemplate se sigue compilando desde el texto.
+
+typedef struct {
+    GString* text;
+    GArray* line_offsets;       // gsize: inicio de cada línea en text
+    GArray* line_tokens;        // guint: primer token de cada línea (+1 entrada: EOF)
+    TokenList* tokens;          // Todos los tokens en orden, terminados en EOF
+    ASTNode* root;
+
+    // Estadísticas
+    guint64 edits;
+    guint64 full_parses;        // Ediciones que acabaron en parseo completo
+    guint lines_tokenized;      // Líneas tokenizadas en la última edición
+    guint nodes_parsed;         // Nodos creados en la última edición
+} PugDocument;
+
+// Línea (desde 0) que contiene el byte offset
+static inline guint document_line_of(const PugDocument* doc, gsize offset) {
+    guint low = 0, high = doc->line_offsets->len;
+    while (high - low > 1) {
+        guint mid = (low + high) / 2;
+        if (g_array_index(doc->line_offsets, gsize, mid) <= offset) low = mid;
+        else high = mid;
+    }
+    return low;
+}
+
+// Tokeniza count líneas desde first y anota en starts dónde empieza cada una
+// (relativo a la primera)
+static inline void document_tokenize_lines(PugDocument* doc, guint first, guint count,
+                                           TokenList* out, GArray* starts) {
+    GString* line = g_string_new("");
+    guint n_lines = doc->line_offsets->len;
+    for (guint i = first; i < first + count; i++) {
+        gsize from = g_array_index(doc->line_offsets, gsize, i);
+        gsize to = (i + 1 < n_lines) ? g_array_index(doc->line_offsets, gsize, i + 1) - 1 : doc->text->len;
+        g_string_truncate(line, 0);
+        g_string_append_len(line, doc->text->str + from, (gssize)(to - from));
+        guint start = out->count;
+        g_array_append_val(starts, start);
+        tokenize_line(out, line->str, i + 1);
+    }
+    g_string_free(line, TRUE);
+}
+
+// Parsea todos los tokens del documento
+static inline void document_parse_full(PugDocument* doc) {
+    if (doc->root) ast_node_free(doc->root);
+    ParserContext* ctx = parser_context_create();
+    ctx->tokens = doc->tokens;
+    doc->root = parse_pug(ctx);
+    ctx->tokens = NULL;
+    ctx->root_node = NULL;
+    parser_context_free(ctx);
+}
+
+static inline guint document_count_nodes(const ASTNode* node) {
+    guint count = 1;
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        count += document_count_nodes(node->children[i]);
+    }
+    return count;
+}
+
+// Crea un documento a partir del texto completo
+static inline PugDocument* pug_document_new(const char* content) {
+    if (!content) content = "";
+    PugDocument* doc = g_new0(PugDocument, 1);
+    doc->text = g_string_new(content);
+    doc->line_offsets = g_array_new(FALSE, FALSE, sizeof(gsize));
+    doc->line_tokens = g_array_new(FALSE, FALSE, sizeof(guint));
+    doc->tokens = token_list_create();
+    if (!doc->tokens) {
+        g_print("Error: No se pudo crear TokenList\n");
+        g_string_free(doc->text, TRUE);
+        g_array_free(doc->line_offsets, TRUE);
+        g_array_free(doc->line_tokens, TRUE);
+        g_free(doc);
+        return NULL;
+    }
+
+    gsize zero = 0;
+    g_array_append_val(doc->line_offsets, zero);
+    for (gsize i = 0; i < doc->text->len; i++) {
+        if (doc->text->str[i] == '\n') {
+            gsize next = i + 1;
+            g_array_append_val(doc->line_offsets, next);
+        }
+    }
+
+    guint n_lines = doc->line_offsets->len;
+    document_tokenize_lines(doc, 0, n_lines, doc->tokens, doc->line_tokens);
+    guint eof_index = doc->tokens->count;
+    g_array_append_val(doc->line_tokens, eof_index);
+    token_list_add(doc->tokens, create_token(TOKEN_EOF, NULL, 0, n_lines + 1, 0));
+
+    document_parse_full(doc);
+    doc->lines_tokenized = n_lines;
+    doc->nodes_parsed = doc->root ? document_count_nodes(doc->root) - 1 : 0;
+    return doc;
+}
+
+static inline void pug_document_free(PugDocument* doc) {
+    if (!doc) return;
+    if (doc->root) ast_node_free(doc->root);
+    token_list_free(doc->tokens);
+    g_array_free(doc->line_offsets, TRUE);
+    g_array_free(doc->line_tokens, TRUE);
+    g_string_free(doc->text, TRUE);
+    g_free(doc);
+}
+
+// Tokens que parse_node() convierte en nodo (el resto devuelve NULL)
+static inline int document_token_starts_node(TokenType type) {
+    switch (type) {
+        case TOKEN_CLASS:
+        case TOKEN_ID:
+        case TOKEN_ATTRIBUTE:
+        case TOKEN_INDENTATION:
+        case TOKEN_EOF:
+        case TOKEN_COUNT:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// Tokens que un TAG de la misma profundidad absorbe (ver parse_node())
+static inline int document_token_absorbed(TokenType type) {
+    return type == TOKEN_ID || type == TOKEN_CLASS || type == TOKEN_ATTRIBUTE ||
+           type == TOKEN_TEXT || type == TOKEN_INTERPOLATION;
+}
+
+#define PUG_DOCUMENT_NO_TOKEN G_MAXUINT
+
+// Índice del token con el que empieza node (numeración de líneas actual).
+// Los trozos de texto de una línea pueden repetir columna: si hay más de un
+// candidato devuelve PUG_DOCUMENT_NO_TOKEN.
+static inline guint document_node_token(const PugDocument* doc, const ASTNode* node) {
+    guint line = node->line - 1;
+    guint first = g_array_index(doc->line_tokens, guint, line);
+    guint last = g_array_index(doc->line_tokens, guint, line + 1);
+    guint found = PUG_DOCUMENT_NO_TOKEN;
+    for (guint i = first; i < last; i++) {
+        const Token* token = doc->tokens->tokens[i];
+        if (token->column != node->column) continue;
+        if (token->type == node->node_type ||
+            (node->node_type == TOKEN_TEXT && (token->type == TOKEN_PIPE || token->type == TOKEN_DOT))) {
+            if (found != PUG_DOCUMENT_NO_TOKEN) return PUG_DOCUMENT_NO_TOKEN;
+            found = i;
+        }
+    }
+    return found;
+}
+
+// Último hijo de node que empieza antes de line, o -1
+static inline int document_child_before(const ASTNode* node, unsigned int line) {
+    int low = -1, high = (int)node->children_count;
+    while (high - low > 1) {
+        int mid = (low + high) / 2;
+        if (node->children[mid]->line < line) low = mid;
+        else high = mid;
+    }
+    return low;
+}
+
+static inline int document_child_index(const ASTNode* parent, const ASTNode* child) {
+    for (int i = (int)parent->children_count - 1; i >= 0; i--) {
+        if (parent->children[i] == child) return i;
+    }
+    return -1;
+}
+
+// Suma delta a la línea de los nodos que empiezan después de after_line
+static inline void document_shift_lines(ASTNode* node, unsigned int after_line, int delta) {
+    if (node->parent && node->line > after_line) node->line += delta;
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        // Un hijo seguido de otro que empieza antes de la edición queda entero antes
+        if (i + 1 < node->children_count && node->children[i + 1]->line <= after_line) continue;
+        document_shift_lines(node->children[i], after_line, delta);
+    }
+}
+
+// Primer nodo después del subárbol de node en orden de documento
+static inline ASTNode* document_node_after(ASTNode* node) {
+    while (node->parent) {
+        int index = document_child_index(node->parent, node);
+        if (index + 1 < (int)node->parent->children_count) return node->parent->children[index + 1];
+        node = node->parent;
+    }
+    return NULL;
+}
+
+// Un token en first empieza un nodo que sube hasta el padre de sibling (no lo
+// absorbe sibling ni ninguno de sus descendientes)
+static inline int document_token_closes(const Token* token, const ASTNode* sibling) {
+    if (token->type == TOKEN_EOF) return 1;
+    return document_token_starts_node(token->type) && !document_token_absorbed(token->type) &&
+           token->depth <= sibling->depth;
+}
+
+// Parsea desde el token first como hijos de parent, igual que parse_pug(),
+// hasta llegar al inicio de un hijo viejo de tail que vuelve a colgar de
+// parent (se reutiliza con los siguientes) o al final del bloque. after es
+// el nodo viejo que sigue al bloque. Devuelve FALSE si el final no coincide
+// con el árbol viejo.
+static inline gboolean document_reparse_block(PugDocument* doc, ASTNode* parent, guint first,
+                                              GPtrArray* tail, ASTNode* after) {
+    guint* tail_tokens = g_new(guint, tail->len + 1);
+    for (guint i = 0; i < tail->len; i++) {
+        tail_tokens[i] = document_node_token(doc, (ASTNode*)g_ptr_array_index(tail, i));
+    }
+    guint after_token = after ? document_node_token(doc, after) : PUG_DOCUMENT_NO_TOKEN;
+    guint first_new = parent->children_count;
+    guint end_new = 0;
+    guint next_tail = 0;
+    gboolean ok = TRUE;
+
+    ParserContext* ctx = parser_context_create();
+    ctx->tokens = doc->tokens;
+    ctx->current_token = first;
+    ctx->current_parent = parent;
+
+    for (;;) {
+        // Hijos viejos que el parseo nuevo ya ha pasado de largo
+        while (next_tail < tail->len && (tail_tokens[next_tail] < ctx->current_token ||
+                                         tail_tokens[next_tail] == PUG_DOCUMENT_NO_TOKEN)) {
+            ast_node_free((ASTNode*)g_ptr_array_index(tail, next_tail));
+            g_ptr_array_index(tail, next_tail++) = NULL;
+        }
+        if (next_tail < tail->len && tail_tokens[next_tail] == ctx->current_token) {
+            ASTNode* old = (ASTNode*)g_ptr_array_index(tail, next_tail);
+            ASTNode* p = ctx->current_parent;
+            while (p != parent && old->depth <= p->depth) p = p->parent;
+            if (p == parent) {
+                // Desde aquí el parseo es el mismo que el viejo
+                end_new = parent->children_count;
+                for (guint i = next_tail; i < tail->len; i++) {
+                    ast_node_add_child(parent, (ASTNode*)g_ptr_array_index(tail, i));
+                    g_ptr_array_index(tail, i) = NULL;
+                }
+                break;
+            }
+            ast_node_free(old);
+            g_ptr_array_index(tail, next_tail++) = NULL;
+        }
+
+        Token* token = parser_get_current_token(ctx);
+        if (!token || token->type == TOKEN_EOF) {
+            ok = (after == NULL);
+            break;
+        }
+        if (parent->parent && token->depth <= parent->depth) {
+            // Fin del bloque: tiene que empezar el nodo viejo que lo seguía
+            ok = (ctx->current_token == after_token);
+            break;
+        }
+
+        ASTNode* node = parse_node(ctx);
+        if (!node) {
+            if (parser_get_current_token(ctx) && parser_get_current_token(ctx)->type == TOKEN_EOF) {
+                ok = (after == NULL);
+                break;
+            }
+            parser_advance_token(ctx);
+            continue;
+        }
+        while (ctx->current_parent != parent && node->depth <= ctx->current_parent->depth) {
+            ctx->current_parent = ctx->current_parent->parent;
+        }
+        ast_node_add_child(ctx->current_parent, node);
+        doc->nodes_parsed++;
+
+        Token* next_token = parser_get_current_token(ctx);
+        if (next_token && next_token->depth > node->depth) {
+            ctx->current_parent = node;
+        }
+    }
+    if (!end_new) end_new = parent->children_count;
+
+    for (guint i = 0; i < tail->len; i++) {
+        if (g_ptr_array_index(tail, i)) ast_node_free((ASTNode*)g_ptr_array_index(tail, i));
+    }
+    for (guint i = first_new; i < end_new; i++) {
+        parser_resolve_cache_deps(parent->children[i]);
+    }
+
+    ctx->tokens = NULL;
+    parser_context_free(ctx);
+    g_free(tail_tokens);
+    return ok;
+}
+
+// ¿El cache de node declaraba sus dependencias?
+static inline int document_cache_declared(const PugDocument* doc, const ASTNode* node) {
+    guint index = document_node_token(doc, node);
+    if (index == PUG_DOCUMENT_NO_TOKEN) return 1;
+    const Token* token = doc->tokens->tokens[index];
+    for (const char* p = token->value; p && *p; p++) {
+        if (!g_ascii_isspace(*p)) return 1;
+    }
+    return 0;
+}
+
+static inline int document_tokens_equal(Token** a, Token** b, guint n) {
+    for (guint i = 0; i < n; i++) {
+        if (a[i]->type != b[i]->type || a[i]->depth != b[i]->depth || a[i]->line != b[i]->line ||
+            a[i]->column != b[i]->column || g_strcmp0(a[i]->value, b[i]->value) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Sustituye los bytes [start, end) por replacement (NULL = borrar) y
+// actualiza tokens y AST. Devuelve FALSE si el rango no es válido.
+static inline gboolean pug_document_edit(PugDocument* doc, gsize start, gsize end, const char* replacement) {
+    if (!doc) return FALSE;
+    if (start > end || end > doc->text->len) {
+        g_print("Error: Edición fuera del documento (%" G_GSIZE_FORMAT "-%" G_GSIZE_FORMAT ")\n", start, end);
+        return FALSE;
+    }
+    if (!replacement) replacement = "";
+    gsize replacement_len = strlen(replacement);
+    doc->edits++;
+    doc->nodes_parsed = 0;
+
+    // Líneas viejas afectadas [l0, l1] y sus tokens
+    guint l0 = document_line_of(doc, start);
+    guint l1 = document_line_of(doc, end);
+    unsigned int first_line = l0 + 1, last_line = l1 + 1;    // Numeración de los nodos
+    guint tok_first = g_array_index(doc->line_tokens, guint, l0);
+    guint tok_end = g_array_index(doc->line_tokens, guint, l1 + 1);
+    guint old_n = tok_end - tok_first;
+
+    // Texto y comienzos de línea
+    g_string_erase(doc->text, (gssize)start, (gssize)(end - start));
+    g_string_insert_len(doc->text, (gssize)start, replacement, (gssize)replacement_len);
+    gssize delta_bytes = (gssize)replacement_len - (gssize)(end - start);
+    g_array_remove_range(doc->line_offsets, l0 + 1, l1 - l0);
+    for (guint i = l0 + 1; i < doc->line_offsets->len; i++) {
+        g_array_index(doc->line_offsets, gsize, i) += delta_bytes;
+    }
+    guint new_lines = 1;
+    for (gsize i = 0; i < replacement_len; i++) {
+        if (replacement[i] == '\n') {
+            gsize offset = start + i + 1;
+            g_array_insert_val(doc->line_offsets, l0 + new_lines, offset);
+            new_lines++;
+        }
+    }
+    int delta_lines = (int)new_lines - (int)(l1 - l0 + 1);
+
+    // Re-tokenizar sólo las líneas nuevas
+    TokenList* fresh = token_list_create();
+    GArray* starts = g_array_new(FALSE, FALSE, sizeof(guint));
+    document_tokenize_lines(doc, l0, new_lines, fresh, starts);
+    doc->lines_tokenized = new_lines;
+    guint new_n = fresh->count;
+    Token** old_tokens = doc->tokens->tokens + tok_first;
+    gboolean same = (old_n == new_n) && document_tokens_equal(old_tokens, fresh->tokens, new_n);
+
+    // Nodo más profundo cuyo bloque contiene la edición (numeración vieja)
+    ASTNode* parent = doc->root;
+    int keep = 0;
+    guint first = 0;
+    gboolean full = FALSE;
+    if (!same && doc->root) {
+        unsigned int depth = G_MAXUINT;
+        for (guint i = 0; i < old_n; i++) depth = MIN(depth, old_tokens[i]->depth);
+        for (guint i = 0; i < new_n; i++) depth = MIN(depth, fresh->tokens[i]->depth);
+
+        for (;;) {
+            int k = document_child_before(parent, first_line);
+            if (k < 0) break;
+            ASTNode* child = parent->children[k];
+            ASTNode* next = (k + 1 < (int)parent->children_count) ? parent->children[k + 1] : NULL;
+            if (child->depth >= depth || (next && next->line <= last_line)) break;
+            parent = child;
+        }
+
+        // Primer token de la región antes y después de la edición
+        const Token* old_first = doc->tokens->tokens[tok_first];
+        const Token* new_first = new_n ? fresh->tokens[0] : doc->tokens->tokens[tok_end];
+        for (;;) {
+            int k = document_child_before(parent, first_line);
+            if (k >= 0) {
+                // El hermano anterior se conserva si la edición no cae en su bloque
+                ASTNode* sibling = parent->children[k];
+                const Token* prior = doc->tokens->tokens[tok_first - 1];
+                if (document_token_starts_node(prior->type) &&
+                    document_token_closes(old_first, sibling) && document_token_closes(new_first, sibling)) {
+                    keep = k + 1;
+                    first = tok_first;
+                } else {
+                    keep = k;
+                    first = document_node_token(doc, sibling);
+                    full = (first == PUG_DOCUMENT_NO_TOKEN);
+                }
+                break;
+            }
+            if (!parent->parent) {
+                keep = 0;
+                first = 0;
+                break;
+            }
+            // Sin hermano anterior: desde el primer token tras los de parent,
+            // si parse_pug() deja ahí a parent como padre actual
+            guint child_start = document_node_token(doc, parent);
+            if (child_start == PUG_DOCUMENT_NO_TOKEN) {
+                full = TRUE;
+                break;
+            }
+            child_start++;
+            if (parent->node_type == TOKEN_TAG) {
+                while (child_start < tok_first && doc->tokens->tokens[child_start]->depth == parent->depth &&
+                       document_token_absorbed(doc->tokens->tokens[child_start]->type)) {
+                    child_start++;
+                }
+            }
+            const Token* next = (child_start < tok_first) ? doc->tokens->tokens[child_start] : new_first;
+            if (next->type != TOKEN_EOF && next->depth > parent->depth) {
+                keep = 0;
+                first = child_start;
+                break;
+            }
+            parent = parent->parent;
+        }
+    }
+
+    // Hijos viejos de parent: [0, keep) se quedan, los que empiezan en la
+    // región se descartan y los posteriores pueden reutilizarse
+    int from = keep;
+    while (!same && doc->root && from < (int)parent->children_count &&
+           parent->children[from]->line <= last_line) {
+        from++;
+    }
+
+    // Sustituir los tokens de la región y renumerar los siguientes
+    token_list_splice(doc->tokens, tok_first, old_n, fresh->tokens, new_n);
+    fresh->count = 0;
+    token_list_free(fresh);
+    int delta_tokens = (int)new_n - (int)old_n;
+    g_array_remove_range(doc->line_tokens, l0, l1 - l0 + 1);
+    for (guint i = l0; i < doc->line_tokens->len; i++) {
+        g_array_index(doc->line_tokens, guint, i) += delta_tokens;
+    }
+    for (guint i = 0; i < new_lines; i++) {
+        guint index = tok_first + g_array_index(starts, guint, i);
+        g_array_insert_val(doc->line_tokens, l0 + i, index);
+    }
+    g_array_free(starts, TRUE);
+    if (delta_lines != 0) {
+        for (guint i = tok_first + new_n; i < doc->tokens->count; i++) {
+            doc->tokens->tokens[i]->line += delta_lines;
+        }
+        if (doc->root) document_shift_lines(doc->root, last_line, delta_lines);
+    }
+    if (same || !doc->root) return TRUE;
+
+    gboolean ok = !full;
+    if (ok) {
+        GPtrArray* tail = g_ptr_array_new();
+        ASTNode* after = document_node_after(parent);
+        for (int i = keep; i < (int)parent->children_count; i++) {
+            if (i < from) ast_node_free(parent->children[i]);
+            else g_ptr_array_add(tail, parent->children[i]);
+        }
+        parent->children_count = (unsigned int)keep;
+        ok = document_reparse_block(doc, parent, first, tail, after);
+        g_ptr_array_free(tail, TRUE);
+    }
+    if (!ok) {
+        document_parse_full(doc);
+        doc->full_parses++;
+        doc->nodes_parsed = document_count_nodes(doc->root) - 1;
+        return TRUE;
+    }
+
+    // Los cache sin dependencias declaradas que contienen la edición
+    for (ASTNode* node = parent; node && node->parent; node = node->parent) {
+        if (node->node_type == TOKEN_CACHE && !document_cache_declared(doc, node)) {
+            parser_cache_node_deps(node);
+        }
+    }
+    return TRUE;
+}
+
+// Vista previa del documento (se libera con g_free)
+static inline char* pug_document_render(const PugDocument* doc, unsigned int use_tabs, unsigned int tab_size,
+                                        unsigned int minify) {
+    return doc ? render_ast(doc->root, use_tabs, tab_size, minify) : NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_DOCUMENT_H
@@ -0,0 +1,173 @@
+#ifndef PUG_ENGINE_H
+#define PUG_ENGINE_H
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pug/pug_template.h"
+#include "pug/pug_loader.h"
+#include "pug/pug_registry.h"
+#include "pug/pug_buffer_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// MOTOR DE PLANTILLAS
+// ============================================================================
+// Un PugEngine reúne lo que antes se montaba en cada llamada: la
+// configuración de salida, la tabla de símbolos compartida (el loader la
+// usa como tabla de átomos de todas sus plantillas) y la caché de plantillas
+// compiladas. La tabla de etiquetas HTML es estática y de sólo lectura
+// (pug_tag_table); cada nodo guarda su entrada al compilar.
+//
+// Las plantillas que devuelve el motor no se modifican después de
+// compilarse: cualquier número de hilos las renderiza a la vez sin locks.
+// El estado de un render vive en el PugRenderContext del hilo, que se
+// reutiliza de un render al siguiente. Los caminos calientes que no deben
+// tocar el lock del loader leen del registro (pug_registry_get()), que
+// publica las recargas sin bloquear a nadie.
+
+typedef struct {
+    unsigned int use_tabs;
+    unsigned int tab_size;
+    unsigned int minify;
+    PugCheckMode check;         // Comprobación de cambios en las plantillas
+    gsize cache_bytes;          // Presupuesto de la caché (0 = por defecto)
+    const PugFileProvider* provider; // NULL lee del disco
+    gsize fragment_bytes;       // Caché de los bloques `cache` (0 = sin caché)
+} PugEngineConfig;
+
+typedef struct {
+    PugEngineConfig config;
+    PugLoader* loader;
+    PugRegistry* registry;      // Lecturas sin locks sobre el loader
+    PugFragmentCache* fragments; // Compartida por todos los hilos; NULL sin caché
+    GHashTable* sources;        // contenido -> PugTemplate* (pug_engine_get_source)
+    GMutex sources_lock;
+} PugEngine;
+
+// Plantillas compiladas desde texto que guarda cada motor; al llenarse se
+// vacía la tabla entera
+#define PUG_ENGINE_MAX_SOURCES 256
+
+static inline PugEngineConfig pug_engine_config_default(void) {
+    PugEngineConfig config = { 0, 2, 0, PUG_CHECK_STAMP, 0, NULL, 0 };
+    return config;
+}
+
+// Crea un motor con raíz root ("." si es NULL). config == NULL usa la
+// configuración por defecto.
+static inline PugEngine* pug_engine_new(const char* root, const PugEngineConfig* config) {
+    PugEngine* engine = g_new0(PugEngine, 1);
+    if (!engine) return NULL;
+    engine->config = config ? *config : pug_engine_config_default();
+    engine->loader = pug_loader_new(root, engine->config.provider);
+    if (!engine->loader) {
+        g_print("Error: Fallo en creación del loader\n");
+        g_free(engine);
+        return NULL;
+    }
+    engine->config.provider = NULL; // El loader ya copió sus funciones
+    pug_loader_set_check(engine->loader, engine->config.check);
+    pug_loader_set_max_bytes(engine->loader, engine->config.cache_bytes);
+    engine->registry = pug_registry_new(engine->loader);
+    if (engine->config.fragment_bytes > 0) {
+        engine->fragments = pug_fragment_cache_new(engine->config.fragment_bytes);
+    }
+    engine->sources = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify)pug_template_free);
+    g_mutex_init(&engine->sources_lock);
+    return engine;
+}
+
+static inline void pug_engine_free(PugEngine* engine) {
+    if (!engine) return;
+    pug_registry_free(engine->registry);
+    pug_loader_free(engine->loader);
+    pug_fragment_cache_free(engine->fragments);
+    g_hash_table_destroy(engine->sources);
+    g_mutex_clear(&engine->sources_lock);
+    g_free(engine);
+}
+
+// Plantilla de path (relativa a la raíz del motor). Es una referencia nueva
+// que se suelta con pug_template_free().
+static inline PugTemplate* pug_engine_get(PugEngine* engine, const char* path) {
+    return engine ? pug_loader_get(engine->loader, path) : NULL;
+}
+
+// Plantilla compilada a partir del texto content. El mismo texto sólo se
+// tokeniza, parsea y compila la primera vez; las siguientes llamadas
+// devuelven la plantilla guardada. Es una referencia nueva que se suelta con
+// pug_template_free().
+static inline PugTemplate* pug_engine_get_source(PugEngine* engine, const char* content) {
+    if (!engine || !content) return NULL;
+
+    g_mutex_lock(&engine->sources_lock);
+    PugTemplate* tpl = pug_template_ref((PugTemplate*)g_hash_table_lookup(engine->sources, content));
+    g_mutex_unlock(&engine->sources_lock);
+    if (tpl) return tpl;
+
+    tpl = pug_template_compile(content, NULL);
+    if (!tpl) return NULL;
+
+    g_mutex_lock(&engine->sources_lock);
+    if (g_hash_table_size(engine->sources) >= PUG_ENGINE_MAX_SOURCES) {
+        g_hash_table_remove_all(engine->sources);
+    }
+    g_hash_table_replace(engine->sources, g_strdup(content), pug_template_ref(tpl));
+    g_mutex_unlock(&engine->sources_lock);
+    return tpl;
+}
+
+// Añade el render de tpl a output con el contexto del hilo actual
+static inline void pug_engine_render_to(PugEngine* engine, const PugTemplate* tpl, const PugLocals* locals,
+                                        GString* output) {
+    if (!engine || !tpl || !output) return;
+    const PugEngineConfig* config = &engine->config;
+    template_render_context_cached(tpl, locals, pug_render_context_get(), output, engine->fragments,
+                                   config->use_tabs, config->tab_size, config->minify);
+}
+
+// Renderiza tpl en el buffer del hilo actual. El resultado es del motor:
+// sigue siendo válido hasta el siguiente render en el mismo hilo. len puede
+// ser NULL.
+static inline const char* pug_engine_render(PugEngine* engine, const PugTemplate* tpl, const PugLocals* locals,
+                                            gsize* len) {
+    if (!engine || !tpl) return NULL;
+    const PugEngineConfig* config = &engine->config;
+    PugRenderContext* ctx = pug_render_context_get();
+    template_render_context_cached(tpl, locals, ctx, NULL, engine->fragments,
+                                   config->use_tabs, config->tab_size, config->minify);
+    if (len) *len = ctx->output->len;
+    return ctx->output->str;
+}
+
+// Carga y renderiza path sin locales; devuelve una copia (se libera con g_free)
+static inline char* pug_engine_render_path(PugEngine* engine, const char* path) {
+    PugTemplate* tpl = pug_engine_get(engine, path);
+    if (!tpl) return NULL;
+    char* result = g_strdup(pug_engine_render(engine, tpl, NULL, NULL));
+    pug_template_free(tpl);
+    return result;
+}
+
+// Motor compartido que usan process_pug_file() y process_pug_path(), con
+// raíz en el directorio actual. Es uno solo para todo el programa (ver
+// PUG_SHARED en pug_buffer_pool.h).
+PUG_SHARED PugEngine* pug_engine_shared = NULL;
+
+static inline PugEngine* pug_engine_default(void) {
+    if (g_once_init_enter(&pug_engine_shared)) {
+        g_once_init_leave(&pug_engine_shared, pug_engine_new(NULL, NULL));
+    }
+    return pug_engine_shared;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_ENGINE_H
@@ -0,0 +1,1005 @@
+#ifndef PUG_EXPR_H
+#define PUG_EXPR_H
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pug/pug_value.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// EXPRESIONES COMPILADAS
+// ============================================================================
+// Lenguaje de expresiones de las líneas `- código`, de las interpolaciones
+// #{...} / !{...} y de los valores de atributo sin comillas:
+//
+//   - var total = precio * cantidad
+//   p= usuario.nombre + ' (' + usuario.pais + ')'
+//   a(href=base + '/perfil', class=activo ? 'on' : 'off')
+//
+// Soporta variables, acceso a miembros (a.b, a[i], .length), literales
+// (números, 'cadenas', "cadenas", true, false, null, undefined), aritmética,
+// comparación, lógicos con cortocircuito, ternario y concatenación.
+//
+// Cada expresión se parsea una sola vez al compilar la plantilla, se pliegan
+// las constantes y se genera bytecode de registros. En el render los
+// registros viven en la pila de C: los temporales numéricos y booleanos no
+// reservan memoria y las concatenaciones van a la arena del render.
+
+#define PUG_EXPR_MAX_REGS 64    // Registros por expresión
+#define PUG_EXPR_RK 128         // Operando >= PUG_EXPR_RK: constante k[op - 128]
+
+// ============================================================================
+// TABLA DE SÍMBOLOS
+// ============================================================================
+// Cada nombre de local distinto que aparece en una plantilla recibe al
+// compilar un slot denso (0, 1, 2...). En el render las expresiones sólo
+// indexan el frame de valores; los nombres no se vuelven a buscar.
+// Una tabla compartida (la de un loader) crece mientras se compilan otras
+// plantillas, así que las búsquedas por nombre toman el lock de lectura.
+typedef struct {
+    GHashTable* slots;      // nombre -> GUINT_TO_POINTER(slot + 1)
+    GPtrArray* names;       // slot -> nombre
+    GRWLock lock;
+} PugSymbols;
+
+static inline void pug_symbols_init(PugSymbols* symbols) {
+    symbols->slots = g_hash_table_new(g_str_hash, g_str_equal);
+    symbols->names = g_ptr_array_new_with_free_func(g_free);
+    g_rw_lock_init(&symbols->lock);
+}
+
+static inline void pug_symbols_clear(PugSymbols* symbols) {
+    if (symbols->slots) g_hash_table_destroy(symbols->slots);
+    if (symbols->names) g_ptr_array_free(symbols->names, TRUE);
+    symbols->slots = NULL;
+    symbols->names = NULL;
+    g_rw_lock_clear(&symbols->lock);
+}
+
+// Devuelve el slot de un nombre, creándolo si no existe
+static inline unsigned int pug_symbols_intern(PugSymbols* symbols, const char* name, gsize len) {
+    char* key = g_strndup(name, len);
+    g_rw_lock_writer_lock(&symbols->lock);
+    gpointer found = g_hash_table_lookup(symbols->slots, key);
+    if (found) {
+        g_rw_lock_writer_unlock(&symbols->lock);
+        g_free(key);
+        return GPOINTER_TO_UINT(found) - 1;
+    }
+    unsigned int slot = symbols->names->len;
+    g_ptr_array_add(symbols->names, key);
+    g_hash_table_insert(symbols->slots, key, GUINT_TO_POINTER(slot + 1));
+    g_rw_lock_writer_unlock(&symbols->lock);
+    return slot;
+}
+
+// Slot de un nombre o -1 si la plantilla no lo usa
+static inline int pug_symbols_lookup(const PugSymbols* symbols, const char* name) {
+    if (!name) return -1;
+    g_rw_lock_reader_lock((GRWLock*)&symbols->lock);
+    gpointer found = g_hash_table_lookup(symbols->slots, name);
+    g_rw_lock_reader_unlock((GRWLock*)&symbols->lock);
+    return found ? (int)GPOINTER_TO_UINT(found) - 1 : -1;
+}
+
+// ============================================================================
+// BYTECODE
+// ============================================================================
+typedef enum {
+    PUG_OP_LOADK = 0,   // R[a] = K[bx]
+    PUG_OP_LOADL,       // R[a] = frame[bx]
+    PUG_OP_STOREL,      // frame[bx] = R[a]
+    PUG_OP_MOVE,        // R[a] = R[b]
+    PUG_OP_GET,         // R[a] = RK[b][RK[c]]
+    PUG_OP_NEG,         // R[a] = -RK[b]
+    PUG_OP_NOT,         // R[a] = !RK[b]
+    PUG_OP_TONUM,       // R[a] = +RK[b]
+    PUG_OP_ADD,         // R[a] = RK[b] + RK[c] (suma o concatenación)
+    PUG_OP_SUB,
+    PUG_OP_MUL,
+    PUG_OP_DIV,
+    PUG_OP_MOD,
+    PUG_OP_EQ,          // ==
+    PUG_OP_NE,          // !=
+    PUG_OP_SEQ,         // ===
+    PUG_OP_SNE,         // !==
+    PUG_OP_LT,
+    PUG_OP_LE,
+    PUG_OP_GT,
+    PUG_OP_GE,
+    PUG_OP_JMP,         // pc = bx
+    PUG_OP_JMPF,        // if (!R[a]) pc = bx
+    PUG_OP_JMPT,        // if (R[a]) pc = bx
+    PUG_OP_RET          // devuelve R[a]
+} PugOpcode;
+
+// Instrucción de 32 bits; bx = b | c << 8
+typedef struct {
+    guint8 op;
+    guint8 a;
+    guint8 b;
+    guint8 c;
+} PugInstr;
+
+#define PUG_INSTR_BX(i) ((unsigned int)(i).b | ((unsigned int)(i).c << 8))
+
+typedef struct PugExpr {
+    PugInstr* code;
+    unsigned int code_len;
+    PugValue* constants;
+    unsigned int n_constants;
+    unsigned int n_regs;
+    int slot;               // >= 0 si la expresión es sólo una local
+    PugArena strings;       // Cadenas de las constantes
+} PugExpr;
+
+static inline void pug_expr_free(PugExpr* expr) {
+    if (!expr) return;
+    g_free(expr->code);
+    g_free(expr->constants);
+    pug_arena_clear(&expr->strings);
+    g_free(expr);
+}
+
+// ============================================================================
+// OPERACIONES (compartidas por el plegado de constantes y la VM)
+// ============================================================================
+
+// Concatena las representaciones textuales de a y b en la arena
+static inline PugValue pug_expr_concat(const PugValue* a, const PugValue* b, PugArena* arena) {
+    // Los arrays se unen con comas; sólo ellos necesitan un buffer intermedio
+    if (a->type == PUG_VALUE_ARRAY || b->type == PUG_VALUE_ARRAY) {
+        GString* tmp = g_string_new("");
+        pug_value_append(tmp, a);
+        pug_value_append(tmp, b);
+        char* str = pug_arena_alloc(arena, tmp->len + 1);
+        memcpy(str, tmp->str, tmp->len + 1);
+        PugValue result = pug_value_string_len(str, tmp->len);
+        g_string_free(tmp, TRUE);
+        return result;
+    }
+
+    char buf_a[PUG_NUMBER_BUF_SIZE], buf_b[PUG_NUMBER_BUF_SIZE];
+    gsize len_a = 0, len_b = 0;
+    const char* text_a = pug_value_to_text(a, buf_a, &len_a);
+    const char* text_b = pug_value_to_text(b, buf_b, &len_b);
+
+    // Con un lado vacío no hace falta copiar la otra cadena
+    if (len_a == 0 && b->type == PUG_VALUE_STRING) return *b;
+    if (len_b == 0 && a->type == PUG_VALUE_STRING) return *a;
+
+    char* str = pug_arena_alloc(arena, len_a + len_b + 1);
+    memcpy(str, text_a, len_a);
+    memcpy(str + len_a, text_b, len_b);
+    str[len_a + len_b] = '\0';
+    return pug_value_string_len(str, len_a + len_b);
+}
+
+// Resto con el signo del dividendo, como % de JavaScript (sin libm)
+static inline double pug_expr_mod(double a, double b) {
+    if (b == 0 || a != a || b != b || a > G_MAXDOUBLE || a < -G_MAXDOUBLE) return 0.0 / 0.0;
+    if (b > G_MAXDOUBLE || b < -G_MAXDOUBLE) return a;
+    double q = a / b;
+    if (q > 9.2e18 || q < -9.2e18) return 0;
+    return a - b * (double)(gint64)q;
+}
+
+// Igualdad estricta (===)
+static inline gboolean pug_expr_strict_equals(const PugValue* a, const PugValue* b) {
+    if (a->type != b->type) return FALSE;
+    switch (a->type) {
+        case PUG_VALUE_NULL:
+            return TRUE;
+        case PUG_VALUE_BOOL:
+            return a->as.boolean == b->as.boolean;
+        case PUG_VALUE_NUMBER:
+            return a->as.number == b->as.number;
+        case PUG_VALUE_STRING:
+            return a->as.string.len == b->as.string.len &&
+                   memcmp(a->as.string.str, b->as.string.str, a->as.string.len) == 0;
+        case PUG_VALUE_ARRAY:
+            return a->as.array.items == b->as.array.items;
+        case PUG_VALUE_OBJECT:
+            return a->as.object.values == b->as.object.values;
+    }
+    return FALSE;
+}
+
+// Hash compatible con pug_expr_strict_equals() para tablas de saltos de `case`
+static inline guint pug_expr_value_hash(gconstpointer key) {
+    const PugValue* value = (const PugValue*)key;
+    guint hash = 2166136261u ^ (guint)value->type;
+    switch (value->type) {
+        case PUG_VALUE_BOOL:
+            return hash * 16777619u ^ (guint)value->as.boolean;
+        case PUG_VALUE_NUMBER: {
+            // 0 y -0 son iguales: se hashean como entero cuando lo son
+            double n = value->as.number;
+            guint64 bits;
+            if (n >= -9007199254740992.0 && n <= 9007199254740992.0 && n == (double)(gint64)n) {
+                bits = (guint64)(gint64)n;
+            } else {
+                memcpy(&bits, &n, sizeof(bits));
+            }
+            return (hash * 16777619u ^ (guint)bits) * 16777619u ^ (guint)(bits >> 32);
+        }
+        case PUG_VALUE_STRING:
+            for (gsize i = 0; i < value->as.string.len; i++) {
+                hash = (hash ^ (guchar)value->as.string.str[i]) * 16777619u;
+            }
+            return hash;
+        default:
+            return hash;
+    }
+}
+
+static inline gboolean pug_expr_value_equal(gconstpointer a, gconstpointer b) {
+    return pug_expr_strict_equals((const PugValue*)a, (const PugValue*)b);
+}
+
+// Igualdad con conversión (==): null sólo es igual a null; si no, tipos
+// distintos se comparan como números
+static inline gboolean pug_expr_loose_equals(const PugValue* a, const PugValue* b) {
+    if (a->type == b->type) return pug_expr_strict_equals(a, b);
+    if (a->type == PUG_VALUE_NULL || b->type == PUG_VALUE_NULL) return FALSE;
+    if (a->type >= PUG_VALUE_ARRAY || b->type >= PUG_VALUE_ARRAY) return FALSE;
+    return pug_value_to_number(a) == pug_value_to_number(b);
+}
+
+// Comparación < <= > >=: cadenas por bytes, el resto como números
+static inline gboolean pug_expr_compare(PugOpcode op, const PugValue* a, const PugValue* b) {
+    if (a->type == PUG_VALUE_STRING && b->type == PUG_VALUE_STRING) {
+        gsize n = a->as.string.len < b->as.string.len ? a->as.string.len : b->as.string.len;
+        int cmp = memcmp(a->as.string.str, b->as.string.str, n);
+        if (cmp == 0) cmp = (a->as.string.len > b->as.string.len) - (a->as.string.len < b->as.string.len);
+        switch (op) {
+            case PUG_OP_LT: return cmp < 0;
+            case PUG_OP_LE: return cmp <= 0;
+            case PUG_OP_GT: return cmp > 0;
+            default: return cmp >= 0;
+        }
+    }
+    double x = pug_value_to_number(a), y = pug_value_to_number(b);
+    switch (op) {
+        case PUG_OP_LT: return x < y;
+        case PUG_OP_LE: return x <= y;
+        case PUG_OP_GT: return x > y;
+        default: return x >= y;
+    }
+}
+
+static inline PugValue pug_expr_unary(PugOpcode op, const PugValue* a) {
+    switch (op) {
+        case PUG_OP_NEG: return pug_value_number(-pug_value_to_number(a));
+        case PUG_OP_NOT: return pug_value_bool(!pug_value_truthy(a));
+        default: return pug_value_number(pug_value_to_number(a));
+    }
+}
+
+static inline PugValue pug_expr_binary(PugOpcode op, const PugValue* a, const PugValue* b, PugArena* arena) {
+    switch (op) {
+        case PUG_OP_ADD:
+            if (a->type >= PUG_VALUE_STRING || b->type >= PUG_VALUE_STRING) {
+                return pug_expr_concat(a, b, arena);
+            }
+            return pug_value_number(pug_value_to_number(a) + pug_value_to_number(b));
+        case PUG_OP_SUB: return pug_value_number(pug_value_to_number(a) - pug_value_to_number(b));
+        case PUG_OP_MUL: return pug_value_number(pug_value_to_number(a) * pug_value_to_number(b));
+        case PUG_OP_DIV: return pug_value_number(pug_value_to_number(a) / pug_value_to_number(b));
+        case PUG_OP_MOD: return pug_value_number(pug_expr_mod(pug_value_to_number(a), pug_value_to_number(b)));
+        case PUG_OP_EQ: return pug_value_bool(pug_expr_loose_equals(a, b));
+        case PUG_OP_NE: return pug_value_bool(!pug_expr_loose_equals(a, b));
+        case PUG_OP_SEQ: return pug_value_bool(pug_expr_strict_equals(a, b));
+        case PUG_OP_SNE: return pug_value_bool(!pug_expr_strict_equals(a, b));
+        default: return pug_value_bool(pug_expr_compare(op, a, b));
+    }
+}
+
+// a[key] / a.key: propiedades de objetos, índices de arrays y cadenas, length
+static inline PugValue pug_expr_get(const PugValue* a, const PugValue* key) {
+    if (key->type == PUG_VALUE_STRING) {
+        const char* name = key->as.string.str;
+        gsize len = key->as.string.len;
+        if (a->type == PUG_VALUE_OBJECT) {
+            const PugValue* found = pug_value_lookup_len(a, name, len);
+            return found ? *found : pug_value_null();
+        }
+        if (len == 6 && memcmp(name, "length", 6) == 0) {
+            if (a->type == PUG_VALUE_ARRAY) return pug_value_number((double)a->as.array.count);
+            if (a->type == PUG_VALUE_STRING) {
+                return pug_value_number((double)g_utf8_strlen(a->as.string.str, (gssize)a->as.string.len));
+            }
+        }
+        return pug_value_null();
+    }
+    if (key->type == PUG_VALUE_NUMBER) {
+        double n = key->as.number;
+        if (n < 0 || n != (double)(gsize)n) return pug_value_null();
+        gsize i = (gsize)n;
+        if (a->type == PUG_VALUE_ARRAY && i < a->as.array.count) return a->as.array.items[i];
+        // Índice de byte: los caracteres multibyte no se separan
+        if (a->type == PUG_VALUE_STRING && i < a->as.string.len) {
+            return pug_value_string_len(a->as.string.str + i, 1);
+        }
+    }
+    return pug_value_null();
+}
+
+// ============================================================================
+// VM
+// ============================================================================
+
+// Ejecuta una expresión. frame son las locales de la plantilla (las líneas
+// `- var x = ...` escriben en él) y arena recibe las cadenas nuevas.
+static inline PugValue pug_expr_eval(const PugExpr* expr, PugValue* frame, unsigned int frame_size, PugArena* arena) {
+    PugValue regs[PUG_EXPR_MAX_REGS];
+    const PugInstr* code;
+    const PugValue* k;
+    unsigned int pc = 0;
+
+    if (!expr) return pug_value_null();
+    // Una local sola no necesita pasar por la VM
+    if (expr->slot >= 0) {
+        return (frame && (unsigned int)expr->slot < frame_size) ? frame[expr->slot] : pug_value_null();
+    }
+
+    code = expr->code;
+    k = expr->constants;
+#define RK(x) ((x) >= PUG_EXPR_RK ? &k[(x) - PUG_EXPR_RK] : &regs[(x)])
+    for (;;) {
+        PugInstr i = code[pc++];
+        switch ((PugOpcode)i.op) {
+            case PUG_OP_LOADK:
+                regs[i.a] = k[PUG_INSTR_BX(i)];
+                break;
+            case PUG_OP_LOADL: {
+                unsigned int slot = PUG_INSTR_BX(i);
+                regs[i.a] = (frame && slot < frame_size) ? frame[slot] : pug_value_null();
+                break;
+            }
+            case PUG_OP_STOREL: {
+                unsigned int slot = PUG_INSTR_BX(i);
+                if (frame && slot < frame_size) frame[slot] = regs[i.a];
+                break;
+            }
+            case PUG_OP_MOVE:
+                regs[i.a] = regs[i.b];
+                break;
+            case PUG_OP_GET:
+                regs[i.a] = pug_expr_get(RK(i.b), RK(i.c));
+                break;
+            case PUG_OP_NEG:
+            case PUG_OP_NOT:
+            case PUG_OP_TONUM:
+                regs[i.a] = pug_expr_unary((PugOpcode)i.op, RK(i.b));
+                break;
+            case PUG_OP_ADD: {
+                const PugValue* a = RK(i.b);
+                const PugValue* b = RK(i.c);
+                if (a->type == PUG_VALUE_NUMBER && b->type == PUG_VALUE_NUMBER) {
+                    regs[i.a] = pug_value_number(a->as.number + b->as.number);
+                } else {
+                    regs[i.a] = pug_expr_binary(PUG_OP_ADD, a, b, arena);
+                }
+                break;
+            }
+            case PUG_OP_SUB: case PUG_OP_MUL: case PUG_OP_DIV: case PUG_OP_MOD:
+            case PUG_OP_EQ: case PUG_OP_NE: case PUG_OP_SEQ: case PUG_OP_SNE:
+            case PUG_OP_LT: case PUG_OP_LE: case PUG_OP_GT: case PUG_OP_GE:
+                regs[i.a] = pug_expr_binary((PugOpcode)i.op, RK(i.b), RK(i.c), arena);
+                break;
+            case PUG_OP_JMP:
+                pc = PUG_INSTR_BX(i);
+                break;
+            case PUG_OP_JMPF:
+                if (!pug_value_truthy(&regs[i.a])) pc = PUG_INSTR_BX(i);
+                break;
+            case PUG_OP_JMPT:
+                if (pug_value_truthy(&regs[i.a])) pc = PUG_INSTR_BX(i);
+                break;
+            case PUG_OP_RET:
+                return regs[i.a];
+        }
+    }
+#undef RK
+}
+
+// ============================================================================
+// COMPILADOR
+// ============================================================================
+
+typedef enum {
+    EXPR_CONST,
+    EXPR_LOCAL,
+    EXPR_GET,
+    EXPR_UNARY,
+    EXPR_BINARY,
+    EXPR_AND,
+    EXPR_OR,
+    EXPR_COND,
+    EXPR_ASSIGN,
+    EXPR_SEQ                // a; b (líneas de código con varias sentencias)
+} ExprKind;
+
+typedef struct ExprNode {
+    ExprKind kind;
+    PugOpcode op;
+    PugValue value;
+    unsigned int slot;
+    struct ExprNode* a;
+    struct ExprNode* b;
+    struct ExprNode* c;
+} ExprNode;
+
+typedef enum {
+    ETOK_END = 0,
+    ETOK_NUMBER,
+    ETOK_STRING,
+    ETOK_IDENT,
+    ETOK_PUNCT
+} ExprTokenType;
+
+typedef struct {
+    const char* src;
+    const char* end;
+    const char* p;
+
+    // Token actual
+    ExprTokenType type;
+    const char* start;
+    gsize len;
+    double number;
+
+    PugSymbols* symbols;
+    PugExpr* expr;          // Recibe las constantes de cadena
+    GPtrArray* nodes;       // Nodos del árbol (se liberan al terminar)
+    int error;
+
+    // Generación de código
+    GArray* code;
+    GArray* constants;
+    unsigned int max_reg;
+} ExprCompiler;
+
+static inline int expr_is_ident_start(char c) {
+    return g_ascii_isalpha(c) || c == '_' || c == '$';
+}
+
+static inline int expr_is_ident_char(char c) {
+    return g_ascii_isalnum(c) || c == '_' || c == '$';
+}
+
+// Avanza al siguiente token
+static inline void expr_next(ExprCompiler* ec) {
+    const char* p = ec->p;
+    while (p < ec->end && g_ascii_isspace(*p)) p++;
+    ec->start = p;
+    if (p >= ec->end) {
+        ec->type = ETOK_END;
+        ec->len = 0;
+        ec->p = p;
+        return;
+    }
+
+    if (g_ascii_isdigit(*p) || (*p == '.' && p + 1 < ec->end && g_ascii_isdigit(p[1]))) {
+        char buf[64];
+        gsize n = 0;
+        while (p + n < ec->end && n < sizeof(buf) - 1 &&
+               (g_ascii_isalnum(p[n]) || p[n] == '.' ||
+                ((p[n] == '+' || p[n] == '-') && n > 0 && (p[n - 1] == 'e' || p[n - 1] == 'E')))) {
+            buf[n] = p[n];
+            n++;
+        }
+        buf[n] = '\0';
+        char* stop = NULL;
+        ec->number = g_ascii_strtod(buf, &stop);
+        if (stop != buf + n) ec->error = 1;
+        ec->type = ETOK_NUMBER;
+        ec->len = n;
+        ec->p = p + n;
+        return;
+    }
+
+    if (*p == '\'' || *p == '"') {
+        char quote = *p++;
+        while (p < ec->end && *p != quote) {
+            if (*p == '\\' && p + 1 < ec->end) p++;
+            p++;
+        }
+        if (p >= ec->end) ec->error = 1;
+        ec->type = ETOK_STRING;
+        ec->len = (gsize)(p - ec->start) + (p < ec->end ? 1 : 0);
+        ec->p = p < ec->end ? p + 1 : p;
+        return;
+    }
+
+    if (expr_is_ident_start(*p)) {
+        while (p < ec->end && expr_is_ident_char(*p)) p++;
+        ec->type = ETOK_IDENT;
+        ec->len = (gsize)(p - ec->start);
+        ec->p = p;
+        return;
+    }
+
+    // Operadores de uno a tres caracteres
+    static const char* const puncts[] = {
+        "===", "!==", "==", "!=", "<=", ">=", "&&", "||", "+=", "-=",
+        "(", ")", "[", "]", ".", "?", ":", ";", "+", "-", "*", "/", "%", "!", "<", ">", "=", ",", NULL
+    };
+    for (int i = 0; puncts[i]; i++) {
+        gsize n = strlen(puncts[i]);
+        if ((gsize)(ec->end - p) >= n && memcmp(p, puncts[i], n) == 0) {
+            ec->type = ETOK_PUNCT;
+            ec->len = n;
+            ec->p = p + n;
+            return;
+        }
+    }
+    ec->error = 1;
+    ec->type = ETOK_END;
+    ec->len = 0;
+    ec->p = ec->end;
+}
+
+static inline int expr_is(ExprCompiler* ec, const char* text) {
+    gsize n = strlen(text);
+    return (ec->type == ETOK_PUNCT || ec->type == ETOK_IDENT) && ec->len == n && memcmp(ec->start, text, n) == 0;
+}
+
+static inline int expr_accept(ExprCompiler* ec, const char* text) {
+    if (!expr_is(ec, text)) return 0;
+    expr_next(ec);
+    return 1;
+}
+
+static inline void expr_expect(ExprCompiler* ec, const char* text) {
+    if (!expr_accept(ec, text)) ec->error = 1;
+}
+
+static inline ExprNode* expr_node(ExprCompiler* ec, ExprKind kind) {
+    ExprNode* node = g_new0(ExprNode, 1);
+    node->kind = kind;
+    g_ptr_array_add(ec->nodes, node);
+    return node;
+}
+
+static inline ExprNode* expr_const(ExprCompiler* ec, PugValue value) {
+    ExprNode* node = expr_node(ec, EXPR_CONST);
+    node->value = value;
+    return node;
+}
+
+// Literal de cadena con sus escapes, guardado en la arena de la expresión
+static inline ExprNode* expr_string_literal(ExprCompiler* ec) {
+    const char* p = ec->start + 1;
+    const char* end = ec->start + ec->len - 1;
+    char* str = pug_arena_alloc(&ec->expr->strings, (gsize)(end - p) + 1);
+    gsize n = 0;
+    while (p < end) {
+        if (*p == '\\' && p + 1 < end) {
+            p++;
+            switch (*p) {
+                case 'n': str[n++] = '\n'; break;
+                case 't': str[n++] = '\t'; break;
+                case 'r': str[n++] = '\r'; break;
+                default: str[n++] = *p; break;
+            }
+            p++;
+            continue;
+        }
+        str[n++] = *p++;
+    }
+    str[n] = '\0';
+    return expr_const(ec, pug_value_string_len(str, n));
+}
+
+static inline ExprNode* expr_parse_expression(ExprCompiler* ec);
+
+static inline ExprNode* expr_parse_primary(ExprCompiler* ec) {
+    ExprNode* node = NULL;
+    if (ec->error) return NULL;
+
+    switch (ec->type) {
+        case ETOK_NUMBER:
+            node = expr_const(ec, pug_value_number(ec->number));
+            expr_next(ec);
+            return node;
+        case ETOK_STRING:
+            node = expr_string_literal(ec);
+            expr_next(ec);
+            return node;
+        case ETOK_IDENT:
+            if (expr_is(ec, "true")) node = expr_const(ec, pug_value_bool(TRUE));
+            else if (expr_is(ec, "false")) node = expr_const(ec, pug_value_bool(FALSE));
+            else if (expr_is(ec, "null") || expr_is(ec, "undefined")) node = expr_const(ec, pug_value_null());
+            else {
+                node = expr_node(ec, EXPR_LOCAL);
+                node->slot = pug_symbols_intern(ec->symbols, ec->start, ec->len);
+            }
+            expr_next(ec);
+            return node;
+        case ETOK_PUNCT:
+            if (expr_accept(ec, "(")) {
+                node = expr_parse_expression(ec);
+                expr_expect(ec, ")");
+                return node;
+            }
+            break;
+        default:
+            break;
+    }
+    ec->error = 1;
+    return NULL;
+}
+
+static inline ExprNode* expr_parse_postfix(ExprCompiler* ec) {
+    ExprNode* node = expr_parse_primary(ec);
+    while (!ec->error) {
+        if (expr_accept(ec, ".")) {
+            if (ec->type != ETOK_IDENT) {
+                ec->error = 1;
+                return NULL;
+            }
+            char* name = pug_arena_alloc(&ec->expr->strings, ec->len + 1);
+            memcpy(name, ec->start, ec->len);
+            name[ec->len] = '\0';
+            ExprNode* get = expr_node(ec, EXPR_GET);
+            get->a = node;
+            get->b = expr_const(ec, pug_value_string_len(name, ec->len));
+            node = get;
+            expr_next(ec);
+        } else if (expr_accept(ec, "[")) {
+            ExprNode* get = expr_node(ec, EXPR_GET);
+            get->a = node;
+            get->b = expr_parse_expression(ec);
+            expr_expect(ec, "]");
+            node = get;
+        } else {
+            break;
+        }
+    }
+    return node;
+}
+
+static inline ExprNode* expr_parse_unary(ExprCompiler* ec) {
+    PugOpcode op;
+    if (expr_is(ec, "!")) op = PUG_OP_NOT;
+    else if (expr_is(ec, "-")) op = PUG_OP_NEG;
+    else if (expr_is(ec, "+")) op = PUG_OP_TONUM;
+    else return expr_parse_postfix(ec);
+    expr_next(ec);
+    ExprNode* node = expr_node(ec, EXPR_UNARY);
+    node->op = op;
+    node->a = expr_parse_unary(ec);
+    return node;
+}
+
+// Operadores binarios por nivel de precedencia (de menor a mayor)
+typedef struct {
+    const char* text;
+    PugOpcode op;
+    int level;
+} ExprBinaryOp;
+
+static const ExprBinaryOp expr_binary_ops[] = {
+    { "||", PUG_OP_JMPT, 1 },
+    { "&&", PUG_OP_JMPF, 2 },
+    { "===", PUG_OP_SEQ, 3 }, { "!==", PUG_OP_SNE, 3 }, { "==", PUG_OP_EQ, 3 }, { "!=", PUG_OP_NE, 3 },
+    { "<=", PUG_OP_LE, 4 }, { ">=", PUG_OP_GE, 4 }, { "<", PUG_OP_LT, 4 }, { ">", PUG_OP_GT, 4 },
+    { "+", PUG_OP_ADD, 5 }, { "-", PUG_OP_SUB, 5 },
+    { "*", PUG_OP_MUL, 6 }, { "/", PUG_OP_DIV, 6 }, { "%", PUG_OP_MOD, 6 },
+    { NULL, PUG_OP_RET, 0 }
+};
+
+static inline const ExprBinaryOp* expr_binary_op(ExprCompiler* ec) {
+    if (ec->type != ETOK_PUNCT) return NULL;
+    for (int i = 0; expr_binary_ops[i].text; i++) {
+        if (expr_is(ec, expr_binary_ops[i].text)) return &expr_binary_ops[i];
+    }
+    return NULL;
+}
+
+// Precedence climbing sobre la tabla anterior
+static inline ExprNode* expr_parse_binary(ExprCompiler* ec, int min_level) {
+    ExprNode* left = expr_parse_unary(ec);
+    const ExprBinaryOp* op;
+    while (!ec->error && (op = expr_binary_op(ec)) != NULL && op->level >= min_level) {
+        expr_next(ec);
+        ExprNode* right = expr_parse_binary(ec, op->level + 1);
+        ExprNode* node;
+        if (op->level == 1) node = expr_node(ec, EXPR_OR);
+        else if (op->level == 2) node = expr_node(ec, EXPR_AND);
+        else {
+            node = expr_node(ec, EXPR_BINARY);
+            node->op = op->op;
+        }
+        node->a = left;
+        node->b = right;
+        left = node;
+    }
+    return left;
+}
+
+static inline ExprNode* expr_parse_expression(ExprCompiler* ec) {
+    ExprNode* cond = expr_parse_binary(ec, 1);
+    if (!ec->error && expr_accept(ec, "?")) {
+        ExprNode* node = expr_node(ec, EXPR_COND);
+        node->c = cond;
+        node->a = expr_parse_expression(ec);
+        expr_expect(ec, ":");
+        node->b = expr_parse_expression(ec);
+        return node;
+    }
+    return cond;
+}
+
+// sentencia := [var|let|const] nombre (= | += | -=) expresión | expresión
+static inline ExprNode* expr_parse_statement(ExprCompiler* ec) {
+    int declared = expr_accept(ec, "var") || expr_accept(ec, "let") || expr_accept(ec, "const");
+    if (ec->type == ETOK_IDENT) {
+        // Mirar un token más allá del nombre sin consumirlo
+        ExprCompiler peek = *ec;
+        expr_next(&peek);
+        if (expr_is(&peek, "=") || expr_is(&peek, "+=") || expr_is(&peek, "-=")) {
+            unsigned int slot = pug_symbols_intern(ec->symbols, ec->start, ec->len);
+            int compound = expr_is(&peek, "+=") ? PUG_OP_ADD : expr_is(&peek, "-=") ? PUG_OP_SUB : -1;
+            *ec = peek;
+            expr_next(ec);
+            ExprNode* value = expr_parse_expression(ec);
+            if (compound >= 0) {
+                ExprNode* local = expr_node(ec, EXPR_LOCAL);
+                local->slot = slot;
+                ExprNode* op = expr_node(ec, EXPR_BINARY);
+                op->op = (PugOpcode)compound;
+                op->a = local;
+                op->b = value;
+                value = op;
+            }
+            ExprNode* node = expr_node(ec, EXPR_ASSIGN);
+            node->slot = slot;
+            node->a = value;
+            return node;
+        }
+    }
+    if (declared) {
+        // `var x` sin valor: x = undefined
+        if (ec->type != ETOK_IDENT) {
+            ec->error = 1;
+            return NULL;
+        }
+        ExprNode* node = expr_node(ec, EXPR_ASSIGN);
+        node->slot = pug_symbols_intern(ec->symbols, ec->start, ec->len);
+        node->a = expr_const(ec, pug_value_null());
+        expr_next(ec);
+        return node;
+    }
+    return expr_parse_expression(ec);
+}
+
+// ============================================================================
+// PLEGADO DE CONSTANTES
+// ============================================================================
+static inline ExprNode* expr_fold(ExprCompiler* ec, ExprNode* node) {
+    if (!node) return NULL;
+    node->a = expr_fold(ec, node->a);
+    node->b = expr_fold(ec, node->b);
+    node->c = expr_fold(ec, node->c);
+
+    switch (node->kind) {
+        case EXPR_UNARY:
+            if (node->a->kind == EXPR_CONST) {
+                return expr_const(ec, pug_expr_unary(node->op, &node->a->value));
+            }
+            break;
+        case EXPR_BINARY:
+            if (node->a->kind == EXPR_CONST && node->b->kind == EXPR_CONST) {
+                return expr_const(ec, pug_expr_binary(node->op, &node->a->value, &node->b->value, &ec->expr->strings));
+            }
+            break;
+        case EXPR_GET:
+            if (node->a->kind == EXPR_CONST && node->b->kind == EXPR_CONST) {
+                return expr_const(ec, pug_expr_get(&node->a->value, &node->b->value));
+            }
+            break;
+        case EXPR_AND:
+            if (node->a->kind == EXPR_CONST) {
+                return pug_value_truthy(&node->a->value) ? node->b : node->a;
+            }
+            break;
+        case EXPR_OR:
+            if (node->a->kind == EXPR_CONST) {
+                return pug_value_truthy(&node->a->value) ? node->a : node->b;
+            }
+            break;
+        case EXPR_COND:
+            if (node->c->kind == EXPR_CONST) {
+                return pug_value_truthy(&node->c->value) ? node->a : node->b;
+            }
+            break;
+        default:
+            break;
+    }
+    return node;
+}
+
+// ============================================================================
+// GENERACIÓN DE CÓDIGO
+// ============================================================================
+static inline unsigned int expr_emit(ExprCompiler* ec, PugOpcode op, unsigned int a, unsigned int b, unsigned int c) {
+    PugInstr instr;
+    instr.op = (guint8)op;
+    instr.a = (guint8)a;
+    instr.b = (guint8)b;
+    instr.c = (guint8)c;
+    g_array_append_val(ec->code, instr);
+    if (ec->code->len >= 0xFFFF) ec->error = 1;
+    return ec->code->len - 1;
+}
+
+static inline unsigned int expr_emit_bx(ExprCompiler* ec, PugOpcode op, unsigned int a, unsigned int bx) {
+    if (bx > 0xFFFF) ec->error = 1;
+    return expr_emit(ec, op, a, bx & 0xFF, (bx >> 8) & 0xFF);
+}
+
+// Apunta el salto de la instrucción at a la posición actual
+static inline void expr_patch(ExprCompiler* ec, unsigned int at) {
+    PugInstr* instr = &g_array_index(ec->code, PugInstr, at);
+    instr->b = (guint8)(ec->code->len & 0xFF);
+    instr->c = (guint8)((ec->code->len >> 8) & 0xFF);
+}
+
+static inline unsigned int expr_add_constant(ExprCompiler* ec, PugValue value) {
+    g_array_append_val(ec->constants, value);
+    return ec->constants->len - 1;
+}
+
+static inline void expr_use_reg(ExprCompiler* ec, unsigned int reg) {
+    if (reg >= PUG_EXPR_MAX_REGS) ec->error = 1;
+    else if (reg + 1 > ec->max_reg) ec->max_reg = reg + 1;
+}
+
+static inline void expr_gen(ExprCompiler* ec, ExprNode* node, unsigned int target);
+
+// Operando RK: una constante se referencia directamente sin cargarla
+static inline unsigned int expr_gen_rk(ExprCompiler* ec, ExprNode* node, unsigned int target) {
+    if (node->kind == EXPR_CONST && ec->constants->len < PUG_EXPR_RK) {
+        return PUG_EXPR_RK + expr_add_constant(ec, node->value);
+    }
+    expr_gen(ec, node, target);
+    return target;
+}
+
+// Genera el código que deja el valor de node en el registro target, usando
+// los registros siguientes como temporales
+static inline void expr_gen(ExprCompiler* ec, ExprNode* node, unsigned int target) {
+    unsigned int b, c, jump, end;
+    if (ec->error || !node) {
+        ec->error = 1;
+        return;
+    }
+    expr_use_reg(ec, target);
+    if (ec->error) return;
+
+    switch (node->kind) {
+        case EXPR_CONST:
+            expr_emit_bx(ec, PUG_OP_LOADK, target, expr_add_constant(ec, node->value));
+            break;
+        case EXPR_LOCAL:
+            expr_emit_bx(ec, PUG_OP_LOADL, target, node->slot);
+            break;
+        case EXPR_GET:
+            b = expr_gen_rk(ec, node->a, target);
+            c = expr_gen_rk(ec, node->b, target + 1);
+            expr_emit(ec, PUG_OP_GET, target, b, c);
+            break;
+        case EXPR_UNARY:
+            b = expr_gen_rk(ec, node->a, target);
+            expr_emit(ec, node->op, target, b, 0);
+            break;
+        case EXPR_BINARY:
+            b = expr_gen_rk(ec, node->a, target);
+            c = expr_gen_rk(ec, node->b, target + 1);
+            expr_emit(ec, node->op, target, b, c);
+            break;
+        case EXPR_AND:
+        case EXPR_OR:
+            expr_gen(ec, node->a, target);
+            jump = expr_emit_bx(ec, node->kind == EXPR_AND ? PUG_OP_JMPF : PUG_OP_JMPT, target, 0);
+            expr_gen(ec, node->b, target);
+            expr_patch(ec, jump);
+            break;
+        case EXPR_COND:
+            expr_gen(ec, node->c, target);
+            jump = expr_emit_bx(ec, PUG_OP_JMPF, target, 0);
+            expr_gen(ec, node->a, target);
+            end = expr_emit_bx(ec, PUG_OP_JMP, 0, 0);
+            expr_patch(ec, jump);
+            expr_gen(ec, node->b, target);
+            expr_patch(ec, end);
+            break;
+        case EXPR_ASSIGN:
+            expr_gen(ec, node->a, target);
+            expr_emit_bx(ec, PUG_OP_STOREL, target, node->slot);
+            break;
+        case EXPR_SEQ:
+            expr_gen(ec, node->a, target);
+            expr_gen(ec, node->b, target);
+            break;
+    }
+}
+
+// Compila src (len bytes). Con statements != 0 acepta sentencias separadas
+// por ';' (`var x = 1; y = x + 1`); si no, una única expresión. Los nombres
+// se resuelven a slots en symbols. Devuelve NULL si hay un error de sintaxis.
+static inline PugExpr* pug_expr_compile(const char* src, gsize len, PugSymbols* symbols, int statements) {
+    if (!src || !symbols) return NULL;
+
+    PugExpr* expr = g_new0(PugExpr, 1);
+    expr->slot = -1;
+
+    ExprCompiler ec;
+    memset(&ec, 0, sizeof(ec));
+    ec.src = src;
+    ec.end = src + len;
+    ec.p = src;
+    ec.symbols = symbols;
+    ec.expr = expr;
+    ec.nodes = g_ptr_array_new_with_free_func(g_free);
+    expr_next(&ec);
+
+    ExprNode* root = NULL;
+    if (ec.type == ETOK_END) ec.error = 1;
+    while (!ec.error && ec.type != ETOK_END) {
+        ExprNode* node = statements ? expr_parse_statement(&ec) : expr_parse_expression(&ec);
+        if (root) {
+            ExprNode* seq = expr_node(&ec, EXPR_SEQ);
+            seq->a = root;
+            seq->b = node;
+            node = seq;
+        }
+        root = node;
+        if (!statements || !expr_accept(&ec, ";")) break;
+    }
+    if (ec.type != ETOK_END) ec.error = 1;
+
+    if (!ec.error) root = expr_fold(&ec, root);
+
+    if (!ec.error && root->kind == EXPR_LOCAL) {
+        // Atajo: la VM devuelve la local sin ejecutar bytecode
+        expr->slot = (int)root->slot;
+    } else if (!ec.error) {
+        ec.code = g_array_new(FALSE, FALSE, sizeof(PugInstr));
+        ec.constants = g_array_new(FALSE, FALSE, sizeof(PugValue));
+        expr_gen(&ec, root, 0);
+        expr_emit(&ec, PUG_OP_RET, 0, 0, 0);
+        expr->code_len = ec.code->len;
+        expr->n_constants = ec.constants->len;
+        expr->n_regs = ec.max_reg;
+        expr->code = (PugInstr*)g_array_free(ec.code, FALSE);
+        expr->constants = (PugValue*)g_array_free(ec.constants, FALSE);
+    }
+
+    g_ptr_array_free(ec.nodes, TRUE);
+    if (ec.error) {
+        pug_expr_free(expr);
+        return NULL;
+    }
+    return expr;
+}
+
+// Devuelve 1 si la expresión es una constante y deja su valor en out
+static inline int pug_expr_is_constant(const PugExpr* expr, PugValue* out) {
+    if (!expr || expr->slot >= 0 || expr->code_len != 2 || expr->code[0].op != PUG_OP_LOADK) return 0;
+    if (out) *out = expr->constants[PUG_INSTR_BX(expr->code[0])];
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_EXPR_H
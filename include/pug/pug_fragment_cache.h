@@ -0,0 +1,322 @@
+#ifndef PUG_FRAGMENT_CACHE_H
+#define PUG_FRAGMENT_CACHE_H
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "pug/pug_tokens.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// CACHÉ DE FRAGMENTOS
+// ============================================================================
+// Guarda el HTML ya renderizado de los bloques `cache` para que los renders
+// siguientes copien los bytes en lugar de recorrer el subárbol:
+//
+//   cache
+//     nav
+//       a(href='/') #{usuario}
+//
+// La clave combina el ámbito (nombre de la plantilla y, en las del loader, el
+// número de compilación: una versión recargada no reutiliza fragmentos de la
+// anterior), la posición del bloque (línea:columna), el contexto de salida y
+// el valor de cada local del que depende el bloque. Las dependencias se pueden escribir tras la palabra clave
+// (`cache usuario idioma`); si no, el parser las deduce de las
+// interpolaciones del subárbol (ver fragment_collect_deps).
+//
+// Las entradas se expulsan por LRU cuando los bytes retenidos superan
+// max_bytes. Es segura entre hilos.
+
+#define PUG_FRAGMENT_CACHE_DEFAULT_MAX_BYTES ((gsize)16 * 1024 * 1024)
+
+typedef struct {
+    char* key;
+    char* data;
+    gsize len;
+    GList link;             // Nodo en la lista LRU (sin reserva propia)
+} PugFragment;
+
+typedef struct PugFragmentCache {
+    GHashTable* entries;    // clave -> PugFragment*
+    GQueue lru;             // Más reciente en la cabeza
+    gsize bytes;
+    gsize max_bytes;
+    GMutex lock;
+
+    // Estadísticas
+    guint64 hits;
+    guint64 misses;
+    guint64 evictions;
+} PugFragmentCache;
+
+// Valor actual de una local usada como dependencia (NULL = sin valor)
+typedef const char* (*PugVaryFunc)(const char* name, gpointer user_data);
+
+// Destino de los bytes de un fragmento encontrado
+typedef void (*PugFragmentEmitFunc)(gpointer target, const char* data, gsize len);
+
+static inline gsize fragment_size(PugFragment* fragment) {
+    return fragment->len + strlen(fragment->key) + sizeof(PugFragment);
+}
+
+static inline void fragment_free(PugFragment* fragment) {
+    if (!fragment) return;
+    g_free(fragment->key);
+    g_free(fragment->data);
+    g_free(fragment);
+}
+
+static inline PugFragmentCache* pug_fragment_cache_new(gsize max_bytes) {
+    PugFragmentCache* cache = g_new0(PugFragmentCache, 1);
+    if (!cache) return NULL;
+    cache->entries = g_hash_table_new(g_str_hash, g_str_equal);
+    g_queue_init(&cache->lru);
+    cache->max_bytes = max_bytes ? max_bytes : PUG_FRAGMENT_CACHE_DEFAULT_MAX_BYTES;
+    g_mutex_init(&cache->lock);
+    return cache;
+}
+
+// Quita una entrada (con el lock tomado)
+static inline void fragment_cache_remove_locked(PugFragmentCache* cache, PugFragment* fragment) {
+    g_hash_table_remove(cache->entries, fragment->key);
+    g_queue_unlink(&cache->lru, &fragment->link);
+    cache->bytes -= fragment_size(fragment);
+    fragment_free(fragment);
+}
+
+// Busca un fragmento y, si existe, entrega sus bytes a emit. Devuelve 1 en
+// caso de acierto. La copia se hace con el lock tomado, así una expulsión
+// concurrente nunca libera los datos a medio copiar.
+static inline int pug_fragment_cache_fetch(PugFragmentCache* cache, const char* key,
+                                           PugFragmentEmitFunc emit, gpointer target) {
+    if (!cache || !key) return 0;
+    g_mutex_lock(&cache->lock);
+    PugFragment* fragment = (PugFragment*)g_hash_table_lookup(cache->entries, key);
+    if (!fragment) {
+        cache->misses++;
+        g_mutex_unlock(&cache->lock);
+        return 0;
+    }
+    cache->hits++;
+    g_queue_unlink(&cache->lru, &fragment->link);
+    g_queue_push_head_link(&cache->lru, &fragment->link);
+    emit(target, fragment->data, fragment->len);
+    g_mutex_unlock(&cache->lock);
+    return 1;
+}
+
+// Guarda (o reemplaza) un fragmento y expulsa los menos usados si hace falta
+static inline void pug_fragment_cache_store(PugFragmentCache* cache, const char* key, const char* data, gsize len) {
+    if (!cache || !key) return;
+
+    PugFragment* fragment = g_new0(PugFragment, 1);
+    fragment->key = g_strdup(key);
+    fragment->data = (char*)g_malloc(len ? len : 1);
+    memcpy(fragment->data, data, len);
+    fragment->len = len;
+    fragment->link.data = fragment;
+
+    // Un fragmento mayor que toda la caché no se guarda
+    if (fragment_size(fragment) > cache->max_bytes) {
+        fragment_free(fragment);
+        return;
+    }
+
+    g_mutex_lock(&cache->lock);
+    PugFragment* old = (PugFragment*)g_hash_table_lookup(cache->entries, key);
+    if (old) fragment_cache_remove_locked(cache, old);
+
+    g_hash_table_insert(cache->entries, fragment->key, fragment);
+    g_queue_push_head_link(&cache->lru, &fragment->link);
+    cache->bytes += fragment_size(fragment);
+
+    while (cache->bytes > cache->max_bytes && cache->lru.tail) {
+        fragment_cache_remove_locked(cache, (PugFragment*)cache->lru.tail->data);
+        cache->evictions++;
+    }
+    g_mutex_unlock(&cache->lock);
+}
+
+// Vacía la caché (p. ej. tras recargar plantillas)
+static inline void pug_fragment_cache_clear(PugFragmentCache* cache) {
+    if (!cache) return;
+    g_mutex_lock(&cache->lock);
+    while (cache->lru.head) {
+        fragment_cache_remove_locked(cache, (PugFragment*)cache->lru.head->data);
+    }
+    g_mutex_unlock(&cache->lock);
+}
+
+static inline void pug_fragment_cache_free(PugFragmentCache* cache) {
+    if (!cache) return;
+    pug_fragment_cache_clear(cache);
+    g_hash_table_destroy(cache->entries);
+    g_mutex_clear(&cache->lock);
+    g_free(cache);
+}
+
+// Copia los contadores de la caché (cualquier puntero puede ser NULL)
+static inline void pug_fragment_cache_stats(PugFragmentCache* cache, guint64* hits, guint64* misses,
+                                            guint64* evictions, gsize* bytes) {
+    if (!cache) return;
+    g_mutex_lock(&cache->lock);
+    if (hits) *hits = cache->hits;
+    if (misses) *misses = cache->misses;
+    if (evictions) *evictions = cache->evictions;
+    if (bytes) *bytes = cache->bytes;
+    g_mutex_unlock(&cache->lock);
+}
+
+static inline void pug_fragment_cache_print_stats(PugFragmentCache* cache) {
+    if (!cache) return;
+    guint64 hits = 0, misses = 0, evictions = 0;
+    gsize bytes = 0;
+    pug_fragment_cache_stats(cache, &hits, &misses, &evictions, &bytes);
+    printf("=== Fragment cache ===\n");
+    printf("Entradas: %u | Bytes: %zu / %zu\n", g_hash_table_size(cache->entries),
+           (size_t)bytes, (size_t)cache->max_bytes);
+    printf("Hits: %llu | Misses: %llu | Expulsiones: %llu\n",
+           (unsigned long long)hits, (unsigned long long)misses, (unsigned long long)evictions);
+}
+
+// ============================================================================
+// DEPENDENCIAS DE UN BLOQUE `cache`
+// ============================================================================
+
+// Añade a names (sin repetir) las locales usadas en la expresión [begin, end).
+// Sólo cuenta identificadores raíz: usuario.nombre depende de "usuario".
+static inline void fragment_scan_expression(const char* begin, const char* end, GPtrArray* names) {
+    static const char* const keywords[] = { "true", "false", "null", "undefined", "var", "let", "const", NULL };
+    const char* p = begin;
+    while (p < end) {
+        if (*p == '\'' || *p == '"') {
+            char quote = *p++;
+            while (p < end && *p != quote) p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+            p++;
+            continue;
+        }
+        if (g_ascii_isdigit(*p)) {
+            // Los números (1e3, 0x1f) no empiezan identificadores
+            while (p < end && (g_ascii_isalnum(*p) || *p == '.')) p++;
+            continue;
+        }
+        if (!(g_ascii_isalpha(*p) || *p == '_' || *p == '$')) {
+            p++;
+            continue;
+        }
+        const char* start = p;
+        while (p < end && (g_ascii_isalnum(*p) || *p == '_' || *p == '$')) p++;
+
+        // Propiedades (a.b): sólo cuenta la raíz
+        const char* before = start;
+        while (before > begin && before[-1] == ' ') before--;
+        if (before > begin && before[-1] == '.') continue;
+
+        char* name = g_strndup(start, p - start);
+        int seen = 0;
+        for (int k = 0; keywords[k] && !seen; k++) seen = (strcmp(keywords[k], name) == 0);
+        for (guint i = 0; i < names->len && !seen; i++) {
+            seen = (strcmp((char*)g_ptr_array_index(names, i), name) == 0);
+        }
+        if (seen) g_free(name);
+        else g_ptr_array_add(names, name);
+    }
+}
+
+// Añade a names las locales de las interpolaciones #{...} / !{...} de text.
+// Con whole != 0 el texto entero es una expresión.
+static inline void fragment_scan_text(const char* text, GPtrArray* names, int whole) {
+    if (!text) return;
+    if (whole) {
+        fragment_scan_expression(text, text + strlen(text), names);
+        return;
+    }
+    const char* p = text;
+    while ((p = strchr(p, '{')) != NULL) {
+        if (p == text || (p[-1] != '#' && p[-1] != '!') || (p - 1 > text && p[-2] == '\\')) {
+            p++;
+            continue;
+        }
+        const char* close = strchr(p + 1, '}');
+        if (!close) return;
+        fragment_scan_expression(p + 1, close, names);
+        p = close + 1;
+    }
+}
+
+// Añade a names las locales que usa el propio nodo (sin sus hijos)
+static inline void fragment_collect_node_deps(ASTNode* node, GPtrArray* names) {
+    if (node->node_type == TOKEN_EACH) {
+        // Sólo la colección: las variables del bucle las fija el propio bucle
+        const char* in = node->text_content ? strstr(node->text_content, " in ") : NULL;
+        if (in) fragment_scan_text(in + 4, names, 1);
+    } else if (node->node_type == TOKEN_CALL) {
+        // Argumentos y atributos de la llamada (el nombre del mixin no es una local)
+        const char* args = node->text_content ? strchr(node->text_content, '(') : NULL;
+        if (args) fragment_scan_text(args, names, 1);
+    } else {
+        // Código, condiciones, sujeto de case y valores de when son expresiones enteras
+        int whole = node->node_type == TOKEN_INTERPOLATION || node->node_type == TOKEN_CODE ||
+                    (node->node_type >= TOKEN_IF && node->node_type <= TOKEN_WHEN);
+        fragment_scan_text(node->text_content, names, whole);
+    }
+    if (node->attributes) {
+        for (unsigned int i = 0; i < node->attributes->count; i++) {
+            Attribute* attr = node->attributes->attributes[i];
+            if (attr) fragment_scan_text(attr->value, names, attr->type == ATTR_EXPRESSION);
+        }
+    }
+}
+
+// Recorre un subárbol recogiendo las locales que usan sus interpolaciones.
+// Sólo ve el árbol literal: los cuerpos de mixins, includes y bloques
+// sobrescritos los añade la plantilla al enlazar (template_link_cache_deps).
+static inline void fragment_collect_deps(ASTNode* node, GPtrArray* names) {
+    if (!node) return;
+    fragment_collect_node_deps(node, names);
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        fragment_collect_deps(node->children[i], names);
+    }
+}
+
+// Clave de un bloque `cache`: ámbito, posición, contexto de salida y valores
+// de las dependencias (node->text_content, separadas por espacios o comas).
+// El contexto incluye lo que cambia los bytes del bloque según dónde se
+// renderice: elementos que conservan espacios por encima y el hermano que
+// sigue (en PUG_MINIFY_FULL decide qué cierres se omiten; NULL en el resto).
+// Cada valor lleva su longitud delante: ninguna combinación de valores
+// produce la misma clave que otra.
+static inline char* fragment_build_key(ASTNode* node, const char* scope, int depth_offset,
+                                       unsigned int use_tabs, unsigned int tab_size, int minify,
+                                       unsigned int preserve_ws, const void* next_sibling,
+                                       PugVaryFunc vary, gpointer vary_data) {
+    GString* key = g_string_sized_new(64);
+    g_string_append_printf(key, "%s\x1f%u:%u\x1f%u:%u:%d:%d:%u:%p", scope ? scope : "",
+                           node->line, node->column, use_tabs, tab_size, minify, depth_offset,
+                           preserve_ws, next_sibling);
+    if (node->text_content && *node->text_content) {
+        gchar** names = g_strsplit_set(node->text_content, " ,", -1);
+        for (gchar** name = names; *name; name++) {
+            if (!**name) continue;
+            const char* value = vary ? vary(*name, vary_data) : NULL;
+            g_string_append_c(key, '\x1f');
+            g_string_append(key, *name);
+            if (value) {
+                g_string_append_printf(key, "=%" G_GSIZE_FORMAT ":", strlen(value));
+                g_string_append(key, value);
+            }
+        }
+        g_strfreev(names);
+    }
+    return g_string_free(key, FALSE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_FRAGMENT_CACHE_H
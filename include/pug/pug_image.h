@@ -0,0 +1,1154 @@
+#ifndef PUG_IMAGE_H
+#define PUG_IMAGE_H
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "pug/pug_value.h"
+#include "pug/pug_expr.h"
+#include "pug/pug_template.h"
+#include "pug/pug_loader.h"
+#include "pug/pug_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// IMAGEN DE PLANTILLAS COMPILADAS
+// ============================================================================
+// Serializa las plantillas ya compiladas de un loader (árbol, expresiones en
+// bytecode, mixins, textos troceados y la tabla de símbolos compartida) para
+// volver a montarlas sin tokenizar, parsear ni compilar expresiones. Al
+// cargar sólo se recalcula lo que no necesita parsear: la apertura estática
+// de las etiquetas, el escapado de los literales y los enlaces (ramas,
+// llamadas a mixins, bloques de extends, include con el loader).
+//
+// `c-pug embed <origen> <salida.c>` compila un directorio y escribe la
+// imagen como un array de C para enlazarla en el binario:
+//
+//   extern const unsigned char pug_templates[];
+//   extern const size_t pug_templates_size;
+//
+//   PugImage* image = pug_image_open(pug_templates, pug_templates_size);
+//   PugEngine* engine = pug_engine_new_from_image(image, NULL);
+//   PugTemplate* tpl = pug_engine_get(engine, "pages/index");
+//
+// El motor no toca el sistema de archivos: su proveedor busca la ruta en el
+// índice de la imagen y monta la plantilla la primera vez que se pide.
+//
+// `c-pug bundle <origen> <salida.pugi>` escribe la misma imagen como archivo
+// (paquete) para proyectarlo con mmap en sólo lectura desde varios procesos:
+// la caché de páginas guarda una sola copia y cada proceso sólo monta las
+// plantillas que pide, sin compilar nada al arrancar.
+//
+//   PugImage* image = pug_image_map("site.pugi");
+//   PugEngine* engine = pug_engine_new_from_image(image, NULL);
+//
+// Formato (enteros little-endian, desplazamientos desde el principio):
+//
+//   cabecera: "PUGI" | u32 versión | u32 tamaño | u32 cadenas | u32 bytes de
+//             cadenas | u32 símbolos | u32 índice | u32 tabla hash (0 = sin)
+//   cadenas:  u32 n + bytes + '\0', una detrás de otra (sin repetir)
+//   símbolos: u32 n | n × cadena (slot -> nombre)
+//   índice:   u32 n | n × (cadena nombre | u32 desplazamiento | u32 tamaño),
+//             ordenado por nombre
+//   tabla hash: u32 n (potencia de 2) | n × (posición en el índice + 1, 0 =
+//             libre), por pug_loader_hash(nombre) con sondeo lineal
+//   plantilla: u64 hash | u32 slots | u32 n + expresiones | u32 n + mixins |
+//             nodo raíz (cada nodo seguido de sus hijos)
+//
+// Una cadena se referencia con su posición en la sección de cadenas + 1
+// (0 = NULL); una expresión o un mixin, con su índice en la plantilla + 1.
+
+#define PUG_IMAGE_MAGIC "PUGI"
+#define PUG_IMAGE_VERSION 2
+#define PUG_IMAGE_HEADER_SIZE 32
+#define PUG_IMAGE_MAX_DEPTH 1024        // Anidamiento máximo de nodos al cargar
+
+typedef struct {
+    const guint8* data;         // Del llamador, salvo con pug_image_map()
+    gsize size;
+    const guint8* strings;
+    guint32 strings_size;
+    guint32 n_symbols;
+    const guint8* symbols;      // n_symbols referencias de cadena
+    guint32 n_templates;
+    const guint8* index;        // n_templates entradas de 12 bytes
+    guint32 n_buckets;          // 0 si la imagen no trae tabla hash
+    const guint8* buckets;
+    GMappedFile* mapped;        // Paquete proyectado por pug_image_map()
+} PugImage;
+
+static inline guint32 image_u32_at(const guint8* p) {
+    guint32 v;
+    memcpy(&v, p, 4);
+    return GUINT32_FROM_LE(v);
+}
+
+// Cadena de la referencia ref (NULL si es 0 o no es válida; *ok = FALSE si
+// no es válida)
+static inline const char* image_string(const PugImage* image, guint32 ref, gsize* len, gboolean* ok) {
+    if (len) *len = 0;
+    if (ref == 0) return NULL;
+    guint32 at = ref - 1;
+    if ((guint64)at + 5 > image->strings_size) {
+        *ok = FALSE;
+        return NULL;
+    }
+    guint32 n = image_u32_at(image->strings + at);
+    if ((guint64)at + 4 + n + 1 > image->strings_size || image->strings[at + 4 + n] != '\0') {
+        *ok = FALSE;
+        return NULL;
+    }
+    if (len) *len = n;
+    return (const char*)image->strings + at + 4;
+}
+
+// ============================================================================
+// ESCRITURA
+// ============================================================================
+
+typedef struct {
+    GByteArray* out;            // Cuerpo de la plantilla que se escribe
+    GByteArray* strings;
+    GHashTable* string_refs;    // Cadena -> referencia (sin repetir)
+    GHashTable* exprs;          // PugExpr* -> índice + 1 en la plantilla actual
+    GHashTable* mixins;         // PugMixin* -> índice + 1
+    gboolean error;
+} PugImageWriter;
+
+static inline void image_put_u8(GByteArray* out, guint8 v) {
+    g_byte_array_append(out, &v, 1);
+}
+
+static inline void image_put_u32(GByteArray* out, guint32 v) {
+    guint32 le = GUINT32_TO_LE(v);
+    g_byte_array_append(out, (const guint8*)&le, 4);
+}
+
+static inline void image_put_u64(GByteArray* out, guint64 v) {
+    guint64 le = GUINT64_TO_LE(v);
+    g_byte_array_append(out, (const guint8*)&le, 8);
+}
+
+static inline void image_put_f64(GByteArray* out, double v) {
+    guint64 bits;
+    memcpy(&bits, &v, 8);
+    image_put_u64(out, bits);
+}
+
+static inline guint32 image_string_ref(PugImageWriter* writer, const char* str, gsize len) {
+    if (!str) return 0;
+    // Las cadenas con '\0' dentro (constantes) no se comparten
+    gboolean plain = strlen(str) == len;
+    if (plain) {
+        gpointer known = g_hash_table_lookup(writer->string_refs, str);
+        if (known) return GPOINTER_TO_UINT(known);
+    }
+    guint32 ref = writer->strings->len + 1;
+    image_put_u32(writer->strings, (guint32)len);
+    g_byte_array_append(writer->strings, (const guint8*)str, (guint)len);
+    image_put_u8(writer->strings, 0);
+    if (plain) g_hash_table_insert(writer->string_refs, g_strdup(str), GUINT_TO_POINTER(ref));
+    return ref;
+}
+
+static inline void image_put_str(PugImageWriter* writer, const char* str) {
+    image_put_u32(writer->out, image_string_ref(writer, str, str ? strlen(str) : 0));
+}
+
+static inline void image_put_ref(PugImageWriter* writer, GHashTable* table, gconstpointer item) {
+    guint32 ref = item ? GPOINTER_TO_UINT(g_hash_table_lookup(table, item)) : 0;
+    if (item && !ref) writer->error = TRUE;
+    image_put_u32(writer->out, ref);
+}
+
+static inline void image_write_expr(PugImageWriter* writer, const PugExpr* expr) {
+    GByteArray* out = writer->out;
+    image_put_u32(out, (guint32)expr->slot);
+    image_put_u32(out, expr->n_regs);
+    image_put_u32(out, expr->code_len);
+    for (unsigned int i = 0; i < expr->code_len; i++) {
+        g_byte_array_append(out, (const guint8*)&expr->code[i], 4);
+    }
+    image_put_u32(out, expr->n_constants);
+    for (unsigned int i = 0; i < expr->n_constants; i++) {
+        const PugValue* k = &expr->constants[i];
+        image_put_u8(out, (guint8)k->type);
+        switch (k->type) {
+            case PUG_VALUE_BOOL:
+                image_put_u8(out, k->as.boolean ? 1 : 0);
+                break;
+            case PUG_VALUE_NUMBER:
+                image_put_f64(out, k->as.number);
+                break;
+            case PUG_VALUE_STRING:
+                image_put_u32(out, image_string_ref(writer, k->as.string.str, k->as.string.len));
+                break;
+            case PUG_VALUE_NULL:
+                break;
+            default:
+                // El compilador sólo pliega escalares
+                writer->error = TRUE;
+                break;
+        }
+    }
+}
+
+static inline void image_write_mixin(PugImageWriter* writer, const PugMixin* mixin) {
+    image_put_str(writer, mixin->name);
+    image_put_u32(writer->out, mixin->n_params);
+    for (unsigned int i = 0; i < mixin->n_params; i++) {
+        image_put_u32(writer->out, mixin->param_slots[i]);
+        image_put_ref(writer, writer->exprs, mixin->defaults[i]);
+    }
+    image_put_u32(writer->out, (guint32)mixin->rest_slot);
+    image_put_u32(writer->out, mixin->attributes_slot);
+}
+
+static inline void image_write_text(PugImageWriter* writer, const PugText* text) {
+    GByteArray* out = writer->out;
+    if (!text) {
+        image_put_u8(out, 0);
+        return;
+    }
+    // Con literales (texto compilado) o sin ellos (dependencias de `cache`)
+    image_put_u8(out, text->literals ? 1 : 2);
+    if (text->literals) image_put_str(writer, text->literals);
+    image_put_u32(out, text->count);
+    for (unsigned int i = 0; i < text->count; i++) {
+        const PugSegment* seg = &text->segments[i];
+        image_put_u8(out, (guint8)seg->type);
+        image_put_u32(out, seg->slot);
+        image_put_ref(writer, writer->exprs, seg->expr);
+        image_put_u32(out, seg->text ? (guint32)(seg->text - text->literals) : 0);
+        image_put_u32(out, seg->len);
+    }
+}
+
+static inline void image_write_node(PugImageWriter* writer, const ASTNode* node) {
+    GByteArray* out = writer->out;
+    image_put_u8(out, (guint8)node->node_type);
+    image_put_str(writer, node->tag);
+    image_put_str(writer, node->text_content);
+    image_put_str(writer, node->id);
+    image_put_u32(out, node->depth);
+    image_put_u32(out, node->line);
+    image_put_u32(out, node->column);
+    image_put_u8(out, (guint8)((node->is_void ? 1 : 0) | (node->is_inline ? 2 : 0) | (node->is_block ? 4 : 0) |
+                               ((unsigned int)node->cache_deps << 3)));
+
+    image_put_u32(out, (guint32)node->class_count);
+    for (unsigned int i = 0; i < node->class_count; i++) image_put_str(writer, node->classes[i]);
+
+    image_put_u32(out, node->attributes ? node->attributes->count + 1 : 0);
+    for (unsigned int i = 0; node->attributes && i < node->attributes->count; i++) {
+        const Attribute* attr = node->attributes->attributes[i];
+        image_put_str(writer, attr->name);
+        image_put_str(writer, attr->value);
+        image_put_u8(out, (guint8)attr->type);
+        image_put_ref(writer, writer->exprs, attr->expr);
+    }
+
+    image_put_ref(writer, writer->exprs, node->expr);
+    image_write_text(writer, node->text);
+
+    image_put_u8(out, node->loop ? 1 : 0);
+    if (node->loop) {
+        image_put_u32(out, node->loop->value_slot);
+        image_put_u32(out, node->loop->key_slot);
+        image_put_u8(out, node->loop->has_key ? 1 : 0);
+    }
+
+    image_put_ref(writer, writer->mixins, node->mixin);
+
+    const PugCall* call = node->call;
+    image_put_u8(out, call ? 1 : 0);
+    if (call) {
+        image_put_str(writer, call->name);
+        image_put_u32(out, call->args ? call->n_args + 1 : 0);
+        for (unsigned int i = 0; call->args && i < call->n_args; i++) {
+            image_put_ref(writer, writer->exprs, call->args[i]);
+        }
+        image_put_u32(out, call->attr_names ? call->n_attrs + 1 : 0);
+        for (unsigned int i = 0; call->attr_names && i < call->n_attrs; i++) {
+            image_put_str(writer, call->attr_names[i]);
+            image_put_ref(writer, writer->exprs, call->attr_values[i]);
+        }
+    }
+
+    image_put_u8(out, node->block ? 1 : 0);
+    if (node->block) {
+        image_put_str(writer, node->block->name);
+        image_put_u8(out, (guint8)node->block->mode);
+    }
+
+    image_put_u32(out, node->children_count);
+    for (unsigned int i = 0; i < node->children_count; i++) image_write_node(writer, node->children[i]);
+}
+
+static inline void image_write_template(PugImageWriter* writer, const PugTemplate* tpl) {
+    g_hash_table_remove_all(writer->exprs);
+    g_hash_table_remove_all(writer->mixins);
+    for (guint i = 0; i < tpl->exprs->len; i++) {
+        g_hash_table_insert(writer->exprs, g_ptr_array_index(tpl->exprs, i), GUINT_TO_POINTER(i + 1));
+    }
+    for (guint i = 0; i < tpl->mixins->len; i++) {
+        g_hash_table_insert(writer->mixins, g_ptr_array_index(tpl->mixins, i), GUINT_TO_POINTER(i + 1));
+    }
+
+    image_put_u64(writer->out, tpl->source_hash);
+    image_put_u32(writer->out, tpl->slot_count);
+    image_put_u32(writer->out, tpl->exprs->len);
+    for (guint i = 0; i < tpl->exprs->len; i++) {
+        image_write_expr(writer, (const PugExpr*)g_ptr_array_index(tpl->exprs, i));
+    }
+    image_put_u32(writer->out, tpl->mixins->len);
+    for (guint i = 0; i < tpl->mixins->len; i++) {
+        image_write_mixin(writer, (const PugMixin*)g_ptr_array_index(tpl->mixins, i));
+    }
+    image_write_node(writer, tpl->root);
+}
+
+static inline void image_align(GByteArray* out) {
+    while (out->len % 8) image_put_u8(out, 0);
+}
+
+static inline gint image_name_compare(gconstpointer a, gconstpointer b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+// Imagen de las plantillas names (rutas relativas a la raíz del loader, que
+// son también sus nombres en el índice). Las compila con el loader si hace
+// falta. Devuelve NULL si alguna no compila.
+static inline GByteArray* pug_image_build(PugLoader* loader, const GPtrArray* names) {
+    if (!loader || !names) return NULL;
+    GPtrArray* sorted = g_ptr_array_new();
+    for (guint i = 0; i < names->len; i++) g_ptr_array_add(sorted, g_ptr_array_index(names, i));
+    g_ptr_array_sort(sorted, image_name_compare);
+
+    // Se compilan todas antes de copiar los símbolos: cada una puede añadir
+    GPtrArray* templates = g_ptr_array_new_with_free_func((GDestroyNotify)pug_template_free);
+    gboolean ok = TRUE;
+    for (guint i = 0; i < sorted->len && ok; i++) {
+        const char* name = (const char*)g_ptr_array_index(sorted, i);
+        PugTemplate* tpl = pug_loader_get(loader, name);
+        if (!tpl) {
+            g_print("Error: No se pudo compilar %s\n", name);
+            ok = FALSE;
+        } else if (i > 0 && strcmp(name, (const char*)g_ptr_array_index(sorted, i - 1)) == 0) {
+            pug_template_free(tpl);
+        } else {
+            g_ptr_array_add(templates, tpl);
+        }
+    }
+    if (!ok) {
+        g_ptr_array_unref(templates);
+        g_ptr_array_free(sorted, TRUE);
+        return NULL;
+    }
+
+    PugImageWriter writer;
+    writer.strings = g_byte_array_new();
+    writer.string_refs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    writer.exprs = g_hash_table_new(g_direct_hash, g_direct_equal);
+    writer.mixins = g_hash_table_new(g_direct_hash, g_direct_equal);
+    writer.error = FALSE;
+
+    // Símbolos e índice van antes que los cuerpos; sus cadenas se escriben ya
+    GByteArray* symbols = g_byte_array_new();
+    writer.out = symbols;
+    g_rw_lock_reader_lock(&loader->symbols.lock);
+    image_put_u32(symbols, loader->symbols.names->len);
+    for (guint i = 0; i < loader->symbols.names->len; i++) {
+        image_put_str(&writer, (const char*)g_ptr_array_index(loader->symbols.names, i));
+    }
+    g_rw_lock_reader_unlock(&loader->symbols.lock);
+
+    GByteArray* bodies = g_byte_array_new();
+    GArray* spans = g_array_new(FALSE, FALSE, sizeof(guint32));
+    writer.out = bodies;
+    for (guint i = 0; i < templates->len; i++) {
+        guint32 start = bodies->len;
+        image_write_template(&writer, (const PugTemplate*)g_ptr_array_index(templates, i));
+        image_align(bodies);
+        guint32 size = bodies->len - start;
+        g_array_append_val(spans, start);
+        g_array_append_val(spans, size);
+    }
+
+    GByteArray* index = g_byte_array_new();
+    GArray* name_refs = g_array_new(FALSE, FALSE, sizeof(guint32));
+    writer.out = index;
+    // Tabla hash al menos al doble del número de plantillas
+    guint32 n_buckets = 1;
+    while (n_buckets < templates->len * 2) n_buckets <<= 1;
+    guint32* buckets = g_new0(guint32, n_buckets);
+    for (guint i = 0; i < sorted->len; i++) {
+        const char* name = (const char*)g_ptr_array_index(sorted, i);
+        if (i > 0 && strcmp(name, (const char*)g_ptr_array_index(sorted, i - 1)) == 0) continue;
+        guint32 ref = image_string_ref(&writer, name, strlen(name));
+        guint32 bucket = (guint32)pug_loader_hash(name) & (n_buckets - 1);
+        while (buckets[bucket]) bucket = (bucket + 1) & (n_buckets - 1);
+        buckets[bucket] = name_refs->len + 1;
+        g_array_append_val(name_refs, ref);
+    }
+    image_align(writer.strings);
+
+    guint32 strings_offset = PUG_IMAGE_HEADER_SIZE;
+    guint32 symbols_offset = strings_offset + writer.strings->len;
+    image_align(symbols);
+    guint32 index_offset = symbols_offset + symbols->len;
+    guint32 hash_offset = index_offset + 4 + templates->len * 12;
+    guint32 bodies_offset = hash_offset + 4 + n_buckets * 4;
+    bodies_offset += (8 - bodies_offset % 8) % 8;
+
+    image_put_u32(index, templates->len);
+    for (guint i = 0; i < templates->len; i++) {
+        image_put_u32(index, g_array_index(name_refs, guint32, i));
+        image_put_u32(index, bodies_offset + g_array_index(spans, guint32, i * 2));
+        image_put_u32(index, g_array_index(spans, guint32, i * 2 + 1));
+    }
+    image_put_u32(index, n_buckets);
+    for (guint32 i = 0; i < n_buckets; i++) image_put_u32(index, buckets[i]);
+    image_align(index);
+
+    GByteArray* image = g_byte_array_sized_new(bodies_offset + bodies->len);
+    g_byte_array_append(image, (const guint8*)PUG_IMAGE_MAGIC, 4);
+    image_put_u32(image, PUG_IMAGE_VERSION);
+    image_put_u32(image, bodies_offset + bodies->len);
+    image_put_u32(image, strings_offset);
+    image_put_u32(image, writer.strings->len);
+    image_put_u32(image, symbols_offset);
+    image_put_u32(image, index_offset);
+    image_put_u32(image, hash_offset);
+    g_byte_array_append(image, writer.strings->data, writer.strings->len);
+    g_byte_array_append(image, symbols->data, symbols->len);
+    g_byte_array_append(image, index->data, index->len);
+    g_byte_array_append(image, bodies->data, bodies->len);
+
+    gboolean error = writer.error;
+    g_free(buckets);
+    g_array_free(name_refs, TRUE);
+    g_array_free(spans, TRUE);
+    g_byte_array_free(index, TRUE);
+    g_byte_array_free(bodies, TRUE);
+    g_byte_array_free(symbols, TRUE);
+    g_byte_array_free(writer.strings, TRUE);
+    g_hash_table_destroy(writer.string_refs);
+    g_hash_table_destroy(writer.exprs);
+    g_hash_table_destroy(writer.mixins);
+    g_ptr_array_unref(templates);
+    g_ptr_array_free(sorted, TRUE);
+    if (error) {
+        g_print("Error: Plantilla con datos que la imagen no admite\n");
+        g_byte_array_free(image, TRUE);
+        return NULL;
+    }
+    return image;
+}
+
+// ============================================================================
+// LECTURA
+// ============================================================================
+
+// Abre una imagen en memoria (no la copia: data tiene que seguir viva). NULL
+// si no es una imagen válida.
+static inline PugImage* pug_image_open(const guint8* data, gsize size) {
+    if (!data || size < PUG_IMAGE_HEADER_SIZE || memcmp(data, PUG_IMAGE_MAGIC, 4) != 0) {
+        g_print("Error: No es una imagen de plantillas\n");
+        return NULL;
+    }
+    guint32 version = image_u32_at(data + 4);
+    guint32 total = image_u32_at(data + 8);
+    guint32 strings_offset = image_u32_at(data + 12);
+    guint32 strings_size = image_u32_at(data + 16);
+    guint32 symbols_offset = image_u32_at(data + 20);
+    guint32 index_offset = image_u32_at(data + 24);
+    guint32 hash_offset = image_u32_at(data + 28);
+    if (version != PUG_IMAGE_VERSION) {
+        g_print("Error: Versión de imagen %u no soportada\n", version);
+        return NULL;
+    }
+    if (total != size || (guint64)strings_offset + strings_size > size || (guint64)symbols_offset + 4 > size ||
+        (guint64)index_offset + 4 > size || (guint64)hash_offset + 4 > size) {
+        g_print("Error: Imagen de plantillas corrupta\n");
+        return NULL;
+    }
+
+    PugImage* image = g_new0(PugImage, 1);
+    image->data = data;
+    image->size = size;
+    image->strings = data + strings_offset;
+    image->strings_size = strings_size;
+    image->n_symbols = image_u32_at(data + symbols_offset);
+    image->symbols = data + symbols_offset + 4;
+    image->n_templates = image_u32_at(data + index_offset);
+    image->index = data + index_offset + 4;
+    if (hash_offset) {
+        image->n_buckets = image_u32_at(data + hash_offset);
+        image->buckets = data + hash_offset + 4;
+    }
+
+    gboolean ok = (guint64)symbols_offset + 4 + (guint64)image->n_symbols * 4 <= size &&
+                  (guint64)index_offset + 4 + (guint64)image->n_templates * 12 <= size &&
+                  (guint64)hash_offset + 4 + (guint64)image->n_buckets * 4 <= size;
+    // Potencia de 2 con algún hueco libre (el sondeo siempre termina)
+    if (hash_offset) ok = ok && image->n_buckets > 0 && (image->n_buckets & (image->n_buckets - 1)) == 0;
+    guint32 used = 0;
+    for (guint32 i = 0; ok && i < image->n_buckets; i++) {
+        guint32 entry = image_u32_at(image->buckets + i * 4);
+        ok = entry <= image->n_templates;
+        if (entry) used++;
+    }
+    ok = ok && (!hash_offset || used < image->n_buckets);
+    const char* previous = NULL;
+    for (guint32 i = 0; ok && i < image->n_symbols; i++) {
+        ok = image_string(image, image_u32_at(image->symbols + i * 4), NULL, &ok) != NULL;
+    }
+    for (guint32 i = 0; ok && i < image->n_templates; i++) {
+        const guint8* entry = image->index + i * 12;
+        const char* name = image_string(image, image_u32_at(entry), NULL, &ok);
+        guint32 offset = image_u32_at(entry + 4);
+        guint32 length = image_u32_at(entry + 8);
+        // Los nombres van ordenados y sin repetir (búsqueda binaria)
+        ok = ok && name && (guint64)offset + length <= size && (!previous || strcmp(previous, name) < 0);
+        previous = name;
+    }
+    if (!ok) {
+        g_print("Error: Imagen de plantillas corrupta\n");
+        g_free(image);
+        return NULL;
+    }
+    return image;
+}
+
+static inline void pug_image_free(PugImage* image) {
+    if (!image) return;
+    if (image->mapped) g_mapped_file_unref(image->mapped);
+    g_free(image);
+}
+
+static inline guint pug_image_count(const PugImage* image) {
+    return image ? image->n_templates : 0;
+}
+
+// Nombre de la plantilla index del índice
+static inline const char* pug_image_name(const PugImage* image, guint index) {
+    gboolean ok = TRUE;
+    if (!image || index >= image->n_templates) return NULL;
+    return image_string(image, image_u32_at(image->index + index * 12), NULL, &ok);
+}
+
+// Posición de name en el índice o -1
+static inline int pug_image_find(const PugImage* image, const char* name) {
+    if (!image || !name) return -1;
+    if (image->n_buckets) {
+        guint32 mask = image->n_buckets - 1;
+        for (guint32 bucket = (guint32)pug_loader_hash(name) & mask;; bucket = (bucket + 1) & mask) {
+            guint32 entry = image_u32_at(image->buckets + bucket * 4);
+            if (entry == 0) return -1;
+            if (strcmp(name, pug_image_name(image, entry - 1)) == 0) return (int)(entry - 1);
+        }
+    }
+    guint lo = 0, hi = image->n_templates;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(name, pug_image_name(image, mid));
+        if (cmp == 0) return (int)mid;
+        if (cmp < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return -1;
+}
+
+typedef struct {
+    const PugImage* image;
+    const guint8* p;
+    const guint8* end;
+    PugTemplate* tpl;
+    unsigned int slot_count;
+    gboolean ok;
+} PugImageReader;
+
+static inline gboolean image_need(PugImageReader* reader, gsize n) {
+    if (reader->ok && (gsize)(reader->end - reader->p) >= n) return TRUE;
+    reader->ok = FALSE;
+    return FALSE;
+}
+
+static inline guint8 image_get_u8(PugImageReader* reader) {
+    if (!image_need(reader, 1)) return 0;
+    return *reader->p++;
+}
+
+static inline guint32 image_get_u32(PugImageReader* reader) {
+    if (!image_need(reader, 4)) return 0;
+    guint32 v = image_u32_at(reader->p);
+    reader->p += 4;
+    return v;
+}
+
+static inline guint64 image_get_u64(PugImageReader* reader) {
+    if (!image_need(reader, 8)) return 0;
+    guint64 v;
+    memcpy(&v, reader->p, 8);
+    reader->p += 8;
+    return GUINT64_FROM_LE(v);
+}
+
+static inline double image_get_f64(PugImageReader* reader) {
+    guint64 bits = image_get_u64(reader);
+    double v;
+    memcpy(&v, &bits, 8);
+    return v;
+}
+
+// Un contador de elementos de al menos min_size bytes cada uno: no puede
+// pedir más de lo que queda
+static inline guint32 image_get_count(PugImageReader* reader, gsize min_size) {
+    guint32 n = image_get_u32(reader);
+    if (reader->ok && (guint64)n * min_size > (guint64)(reader->end - reader->p)) reader->ok = FALSE;
+    return reader->ok ? n : 0;
+}
+
+static inline const char* image_get_str(PugImageReader* reader, gsize* len) {
+    guint32 ref = image_get_u32(reader);
+    if (!reader->ok) return NULL;
+    return image_string(reader->image, ref, len, &reader->ok);
+}
+
+// Copia de una cadena (NULL se queda en NULL)
+static inline char* image_get_strdup(PugImageReader* reader) {
+    const char* str = image_get_str(reader, NULL);
+    return str ? g_strdup(str) : NULL;
+}
+
+static inline unsigned int image_get_slot(PugImageReader* reader) {
+    guint32 slot = image_get_u32(reader);
+    if (slot >= reader->slot_count) reader->ok = FALSE;
+    return reader->ok ? slot : 0;
+}
+
+static inline PugExpr* image_get_expr_ref(PugImageReader* reader) {
+    guint32 ref = image_get_u32(reader);
+    if (ref == 0 || !reader->ok) return NULL;
+    if (ref > reader->tpl->exprs->len) {
+        reader->ok = FALSE;
+        return NULL;
+    }
+    return (PugExpr*)g_ptr_array_index(reader->tpl->exprs, ref - 1);
+}
+
+// El bytecode de una imagen no se ejecuta sin comprobar: registros y
+// constantes dentro de rango, locales dentro del frame y saltos sólo hacia
+// delante (la VM no los mira)
+static inline gboolean image_expr_valid(const PugExpr* expr, unsigned int slot_count) {
+    if (expr->slot >= 0) return expr->code_len == 0;
+    if (expr->code_len == 0 || expr->n_regs > PUG_EXPR_MAX_REGS) return FALSE;
+    if (expr->code[expr->code_len - 1].op != PUG_OP_RET) return FALSE;
+    for (unsigned int pc = 0; pc < expr->code_len; pc++) {
+        PugInstr i = expr->code[pc];
+        unsigned int bx = PUG_INSTR_BX(i);
+        if (i.op > PUG_OP_RET || i.a >= expr->n_regs) return FALSE;
+        switch ((PugOpcode)i.op) {
+            case PUG_OP_LOADK:
+                if (bx >= expr->n_constants) return FALSE;
+                break;
+            case PUG_OP_LOADL:
+            case PUG_OP_STOREL:
+                if (bx >= slot_count) return FALSE;
+                break;
+            case PUG_OP_RET:
+                break;
+            case PUG_OP_MOVE:
+                if (i.b >= expr->n_regs) return FALSE;
+                break;
+            case PUG_OP_JMP:
+            case PUG_OP_JMPF:
+            case PUG_OP_JMPT:
+                if (bx <= pc || bx >= expr->code_len) return FALSE;
+                break;
+            default:
+                // Operandos RK: registro o constante
+                if (i.b >= PUG_EXPR_RK ? (unsigned int)(i.b - PUG_EXPR_RK) >= expr->n_constants : i.b >= expr->n_regs) return FALSE;
+                if (i.op == PUG_OP_NEG || i.op == PUG_OP_NOT || i.op == PUG_OP_TONUM) break;
+                if (i.c >= PUG_EXPR_RK ? (unsigned int)(i.c - PUG_EXPR_RK) >= expr->n_constants : i.c >= expr->n_regs) return FALSE;
+                break;
+        }
+    }
+    return TRUE;
+}
+
+static inline PugExpr* image_read_expr(PugImageReader* reader) {
+    PugExpr* expr = g_new0(PugExpr, 1);
+    expr->slot = (int)image_get_u32(reader);
+    expr->n_regs = image_get_u32(reader);
+    expr->code_len = image_get_count(reader, 4);
+    if (expr->slot >= (int)reader->slot_count) reader->ok = FALSE;
+    if (reader->ok && expr->code_len > 0) {
+        expr->code = g_new(PugInstr, expr->code_len);
+        memcpy(expr->code, reader->p, (gsize)expr->code_len * 4);
+        reader->p += (gsize)expr->code_len * 4;
+    }
+    expr->n_constants = image_get_count(reader, 1);
+    if (reader->ok && expr->n_constants > 0) expr->constants = g_new0(PugValue, expr->n_constants);
+    for (unsigned int i = 0; reader->ok && i < expr->n_constants; i++) {
+        PugValue* k = &expr->constants[i];
+        guint8 type = image_get_u8(reader);
+        if (type == PUG_VALUE_BOOL) {
+            *k = pug_value_bool(image_get_u8(reader) != 0);
+        } else if (type == PUG_VALUE_NUMBER) {
+            *k = pug_value_number(image_get_f64(reader));
+        } else if (type == PUG_VALUE_STRING) {
+            gsize len = 0;
+            const char* str = image_get_str(reader, &len);
+            if (!str) {
+                reader->ok = FALSE;
+                break;
+            }
+            char* copy = pug_arena_alloc(&expr->strings, len + 1);
+            memcpy(copy, str, len + 1);
+            *k = pug_value_string_len(copy, len);
+        } else if (type != PUG_VALUE_NULL) {
+            reader->ok = FALSE;
+        }
+    }
+    if (!reader->ok || !image_expr_valid(expr, reader->slot_count)) {
+        reader->ok = FALSE;
+        pug_expr_free(expr);
+        return NULL;
+    }
+    return expr;
+}
+
+static inline PugMixin* image_read_mixin(PugImageReader* reader) {
+    PugMixin* mixin = g_new0(PugMixin, 1);
+    mixin->name = image_get_strdup(reader);
+    unsigned int n = image_get_count(reader, 8);
+    mixin->param_slots = g_new0(unsigned int, n ? n : 1);
+    mixin->defaults = g_new0(PugExpr*, n ? n : 1);
+    for (unsigned int i = 0; reader->ok && i < n; i++) {
+        mixin->param_slots[i] = image_get_slot(reader);
+        mixin->defaults[i] = image_get_expr_ref(reader);
+        mixin->n_params++;
+    }
+    mixin->rest_slot = (int)image_get_u32(reader);
+    if (mixin->rest_slot >= (int)reader->slot_count) reader->ok = FALSE;
+    mixin->attributes_slot = image_get_slot(reader);
+    if (!mixin->name) reader->ok = FALSE;
+    if (!reader->ok) {
+        pug_mixin_free(mixin);
+        return NULL;
+    }
+    return mixin;
+}
+
+static inline PugText* image_read_text(PugImageReader* reader) {
+    guint8 kind = image_get_u8(reader);
+    if (kind == 0 || !reader->ok) return NULL;
+    if (kind > 2) {
+        reader->ok = FALSE;
+        return NULL;
+    }
+    PugText* text = g_new0(PugText, 1);
+    gsize literals_len = 0;
+    if (kind == 1) {
+        const char* literals = image_get_str(reader, &literals_len);
+        if (!literals) reader->ok = FALSE;
+        else text->literals = (char*)g_memdup2(literals, literals_len + 1);
+    }
+    unsigned int n = image_get_count(reader, 17);
+    text->segments = g_new0(PugSegment, n ? n : 1);
+    for (unsigned int i = 0; reader->ok && i < n; i++) {
+        PugSegment* seg = &text->segments[i];
+        seg->type = (SegmentType)image_get_u8(reader);
+        guint32 slot = image_get_u32(reader);
+        seg->expr = image_get_expr_ref(reader);
+        guint32 offset = image_get_u32(reader);
+        seg->len = image_get_u32(reader);
+        if (seg->type > SEGMENT_RAW) reader->ok = FALSE;
+        if (seg->type == SEGMENT_LITERAL) {
+            // Un literal es un trozo del texto
+            if (!text->literals || (guint64)offset + seg->len > literals_len) reader->ok = FALSE;
+            else seg->text = text->literals + offset;
+        } else if (!seg->expr) {
+            if (slot >= reader->slot_count) reader->ok = FALSE;
+            seg->slot = slot;
+        }
+        text->count++;
+    }
+    if (reader->ok && text->literals) template_escape_literals(text);
+    return text;
+}
+
+static inline PugCall* image_read_call(PugImageReader* reader) {
+    if (!image_get_u8(reader) || !reader->ok) return NULL;
+    PugCall* call = g_new0(PugCall, 1);
+    call->name = image_get_strdup(reader);
+    if (!call->name) reader->ok = FALSE;
+    guint32 args = image_get_count(reader, 4);
+    if (args > 0) {
+        call->args = g_new0(PugExpr*, args);
+        for (unsigned int i = 0; reader->ok && i + 1 < args; i++) {
+            call->args[call->n_args++] = image_get_expr_ref(reader);
+            if (!call->args[i]) reader->ok = FALSE;
+        }
+    }
+    guint32 attrs = image_get_count(reader, 8);
+    if (attrs > 0) {
+        call->attr_names = g_new0(char*, attrs);
+        call->attr_values = g_new0(PugExpr*, attrs);
+        for (unsigned int i = 0; reader->ok && i + 1 < attrs; i++) {
+            call->attr_names[i] = image_get_strdup(reader);
+            call->attr_values[call->n_attrs++] = image_get_expr_ref(reader);
+            if (!call->attr_names[i] || !call->attr_values[i]) reader->ok = FALSE;
+        }
+    }
+    return call;
+}
+
+// Monta un nodo y sus hijos repitiendo los pasos de template_compile_node()
+// que no parsean. parent != NULL lo cuelga antes de leer los hijos, así un
+// error a medias se libera con el árbol.
+static inline ASTNode* image_read_node(PugImageReader* reader, ASTNode* parent, unsigned int level) {
+    guint8 type = image_get_u8(reader);
+    if (!reader->ok || type >= TOKEN_COUNT || level > PUG_IMAGE_MAX_DEPTH) {
+        reader->ok = FALSE;
+        return NULL;
+    }
+    ASTNode* node = ast_node_create((TokenType)type, 0);
+    if (!node) {
+        reader->ok = FALSE;
+        return NULL;
+    }
+    if (parent) ast_node_add_child(parent, node);
+    PugTemplate* tpl = reader->tpl;
+
+    node->tag = image_get_strdup(reader);
+    node->text_content = image_get_strdup(reader);
+    node->id = image_get_strdup(reader);
+    node->depth = image_get_u32(reader);
+    node->line = image_get_u32(reader);
+    node->column = image_get_u32(reader);
+    // La raíz tiene profundidad -1; el resto sangra a lo sumo lo que anida
+    if (node->depth > PUG_IMAGE_MAX_DEPTH && node->depth != G_MAXUINT) reader->ok = FALSE;
+    guint8 flags = image_get_u8(reader);
+    node->is_void = flags & 1;
+    node->is_inline = (flags >> 1) & 1;
+    node->is_block = (flags >> 2) & 1;
+    node->cache_deps = (PugCacheDeps)((flags >> 3) & 3);
+    if (node->cache_deps > PUG_CACHE_DEPS_UNKNOWN) reader->ok = FALSE;
+
+    unsigned int n_classes = image_get_count(reader, 4);
+    if (n_classes > 0) {
+        // Capacidad en múltiplos de 5, como parse_classes()
+        node->classes = (char**)malloc(sizeof(char*) * ((n_classes + 4) / 5 * 5));
+        for (unsigned int i = 0; reader->ok && i < n_classes; i++) {
+            node->classes[node->class_count] = image_get_strdup(reader);
+            if (!node->classes[node->class_count++]) reader->ok = FALSE;
+        }
+    }
+
+    guint32 n_attrs = image_get_count(reader, 13);
+    if (n_attrs > 0) {
+        node->attributes = attribute_list_create();
+        for (unsigned int i = 0; reader->ok && i + 1 < n_attrs; i++) {
+            Attribute* attr = (Attribute*)malloc(sizeof(Attribute));
+            attr->name = image_get_strdup(reader);
+            attr->value = image_get_strdup(reader);
+            attr->type = (AttributeType)image_get_u8(reader);
+            attr->expr = image_get_expr_ref(reader);
+            attribute_list_add(node->attributes, attr);
+            if (!attr->name || attr->type > ATTR_ID) reader->ok = FALSE;
+        }
+    }
+
+    node->expr = image_get_expr_ref(reader);
+    node->text = image_read_text(reader);
+
+    if (image_get_u8(reader) && reader->ok) {
+        node->loop = g_new0(PugLoop, 1);
+        node->loop->value_slot = image_get_slot(reader);
+        node->loop->key_slot = image_get_slot(reader);
+        node->loop->has_key = image_get_u8(reader) ? 1 : 0;
+    }
+
+    guint32 mixin_ref = image_get_u32(reader);
+    if (reader->ok && mixin_ref > 0) {
+        PugMixin* mixin = mixin_ref <= tpl->mixins->len ? (PugMixin*)g_ptr_array_index(tpl->mixins, mixin_ref - 1) : NULL;
+        if (!mixin || mixin->node || type != TOKEN_MIXIN) {
+            reader->ok = FALSE;
+        } else {
+            mixin->node = node;
+            node->mixin = mixin;
+            g_hash_table_replace(tpl->mixin_names, mixin->name, mixin);
+        }
+    }
+
+    node->call = image_read_call(reader);
+
+    if (image_get_u8(reader) && reader->ok) {
+        node->block = g_new0(PugBlock, 1);
+        node->block->name = image_get_strdup(reader);
+        node->block->mode = (PugBlockMode)image_get_u8(reader);
+        if (!node->block->name || node->block->mode > PUG_BLOCK_PREPEND) reader->ok = FALSE;
+    }
+    if (!reader->ok) return node;
+
+    // Lo que template_compile_node() calcula sin parsear
+    if (type == TOKEN_TAG) {
+        node->tag_info = pug_tag_lookup(node->tag);
+        render_prepare_static_tag(node);
+    } else if (type == TOKEN_INCLUDE || type == TOKEN_EXTENDS) {
+        template_compile_include(tpl, node);
+    }
+
+    unsigned int n_children = image_get_count(reader, 1);
+    for (unsigned int i = 0; reader->ok && i < n_children; i++) {
+        image_read_node(reader, node, level + 1);
+    }
+    if (!reader->ok) return node;
+    if (type == TOKEN_CASE) template_link_case(node);
+    template_link_branches(node);
+    return node;
+}
+
+// Monta la plantilla index de la imagen con el nombre name, sus slots en
+// symbols (que ya tiene los de la imagen, ver pug_engine_new_from_image()) y
+// sus include/extends cargados con resolve. NULL si los datos no son válidos.
+static inline PugTemplate* pug_image_instantiate(const PugImage* image, guint index, const char* name,
+                                                 PugSymbols* symbols, PugResolveFunc resolve, gpointer resolve_data) {
+    if (!image || index >= image->n_templates || !symbols) return NULL;
+    if (symbols->names->len < image->n_symbols) {
+        g_print("Error: La tabla de símbolos no es la de la imagen\n");
+        return NULL;
+    }
+    const guint8* entry = image->index + index * 12;
+    guint32 offset = image_u32_at(entry + 4);
+
+    PugImageReader reader;
+    reader.image = image;
+    reader.p = image->data + offset;
+    reader.end = reader.p + image_u32_at(entry + 8);
+    reader.ok = TRUE;
+    reader.tpl = template_new(name, symbols, resolve, resolve_data);
+    PugTemplate* tpl = reader.tpl;
+
+    tpl->source_hash = image_get_u64(&reader);
+    reader.slot_count = image_get_u32(&reader);
+    if (reader.slot_count > image->n_symbols) reader.ok = FALSE;
+    unsigned int n_exprs = image_get_count(&reader, 17);
+    for (unsigned int i = 0; reader.ok && i < n_exprs; i++) {
+        PugExpr* expr = image_read_expr(&reader);
+        if (expr) g_ptr_array_add(tpl->exprs, expr);
+    }
+    unsigned int n_mixins = image_get_count(&reader, 16);
+    for (unsigned int i = 0; reader.ok && i < n_mixins; i++) {
+        PugMixin* mixin = image_read_mixin(&reader);
+        if (mixin) g_ptr_array_add(tpl->mixins, mixin);
+    }
+    tpl->root = image_read_node(&reader, NULL, 0);
+    for (guint i = 0; reader.ok && i < tpl->mixins->len; i++) {
+        if (!((PugMixin*)g_ptr_array_index(tpl->mixins, i))->node) reader.ok = FALSE;
+    }
+    if (reader.ok) {
+        template_finish(tpl);
+        tpl->slot_count = reader.slot_count;
+        // Lo incluido se renderiza con el frame de quien lo incluye
+        for (guint i = 0; i < tpl->uses->len; i++) {
+            if (((PugTemplate*)g_ptr_array_index(tpl->uses, i))->slot_count > tpl->slot_count) reader.ok = FALSE;
+        }
+    }
+    if (!reader.ok) {
+        g_print("Error: Plantilla '%s' corrupta en la imagen\n", name);
+        pug_template_free(tpl);
+        return NULL;
+    }
+    return tpl;
+}
+
+// ============================================================================
+// PROVEEDOR Y MOTOR
+// ============================================================================
+// Proveedor de archivos para un loader con raíz "/": las rutas resueltas
+// ("/pages/index.pug") son los nombres del índice con una '/' delante. No
+// hay fuentes que leer; la marca de una plantilla de la imagen es 0.
+
+static inline const char* image_path_name(const char* path) {
+    return path[0] == '/' ? path + 1 : path;
+}
+
+static inline char* image_provider_read(const char* path, gpointer data) {
+    (void)path;
+    (void)data;
+    return NULL;
+}
+
+static inline gint64 image_provider_stat(const char* path, gpointer data) {
+    return pug_image_find((const PugImage*)data, image_path_name(path)) >= 0 ? 0 : -1;
+}
+
+static inline PugTemplate* image_provider_compiled(const char* path, PugSymbols* symbols, PugResolveFunc resolve,
+                                                   gpointer resolve_data, gpointer data) {
+    const PugImage* image = (const PugImage*)data;
+    int index = pug_image_find(image, image_path_name(path));
+    if (index < 0) return NULL;
+    return pug_image_instantiate(image, (guint)index, path, symbols, resolve, resolve_data);
+}
+
+static inline PugFileProvider pug_image_provider(const PugImage* image) {
+    PugFileProvider provider = { image_provider_read, (gpointer)image, image_provider_stat,
+                                 image_provider_compiled };
+    return provider;
+}
+
+// Motor que sirve las plantillas de image (que tiene que vivir más que él)
+// sin tocar el sistema de archivos. Las plantillas se montan al pedirlas por
+// primera vez y nunca se comprueban: la imagen no cambia.
+static inline PugEngine* pug_engine_new_from_image(const PugImage* image, const PugEngineConfig* config) {
+    if (!image) return NULL;
+    PugEngineConfig engine_config = config ? *config : pug_engine_config_default();
+    PugFileProvider provider = pug_image_provider(image);
+    engine_config.check = PUG_CHECK_NONE;
+    engine_config.provider = &provider;
+    PugEngine* engine = pug_engine_new("/", &engine_config);
+    if (!engine) return NULL;
+
+    // Los slots de la imagen son los del loader que la compiló
+    gboolean ok = TRUE;
+    for (guint32 i = 0; ok && i < image->n_symbols; i++) {
+        gsize len = 0;
+        const char* name = image_string(image, image_u32_at(image->symbols + i * 4), &len, &ok);
+        ok = ok && name && pug_symbols_intern(&engine->loader->symbols, name, len) == i;
+    }
+    if (!ok) {
+        g_print("Error: Tabla de símbolos de la imagen no válida\n");
+        pug_engine_free(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+// ============================================================================
+// EMBEBER EN EL BINARIO
+// ============================================================================
+
+// Rutas relativas de los .pug bajo dir (sin ocultos ni enlaces a directorios)
+static inline void image_scan_dir(const char* root, const char* rel, GPtrArray* names) {
+    char* dir_path = rel[0] ? g_build_filename(root, rel, NULL) : g_strdup(root);
+    GDir* dir = g_dir_open(dir_path, 0, NULL);
+    if (!dir) {
+        g_print("Error: No se pudo abrir %s\n", dir_path);
+        g_free(dir_path);
+        return;
+    }
+    const char* name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (name[0] == '.') continue;
+        char* full = g_build_filename(dir_path, name, NULL);
+        char* child = rel[0] ? g_strconcat(rel, "/", name, NULL) : g_strdup(name);
+        if (g_file_test(full, G_FILE_TEST_IS_DIR)) {
+            if (!g_file_test(full, G_FILE_TEST_IS_SYMLINK)) image_scan_dir(root, child, names);
+            g_free(child);
+        } else if (g_str_has_suffix(name, ".pug")) {
+            g_ptr_array_add(names, child);
+        } else {
+            g_free(child);
+        }
+        g_free(full);
+    }
+    g_dir_close(dir);
+    g_free(dir_path);
+}
+
+// Compila todos los .pug de src y devuelve su imagen (NULL si alguno falla).
+// count recibe el número de plantillas (puede ser NULL).
+static inline GByteArray* pug_image_build_directory(const char* src, guint* count) {
+    PugEngineConfig config = pug_engine_config_default();
+    config.check = PUG_CHECK_NONE;
+    PugEngine* engine = pug_engine_new(src, &config);
+    if (!engine) return NULL;
+    GPtrArray* names = g_ptr_array_new_with_free_func(g_free);
+    image_scan_dir(src, "", names);
+    GByteArray* image = pug_image_build(engine->loader, names);
+    if (count) *count = names->len;
+    g_ptr_array_free(names, TRUE);
+    pug_engine_free(engine);
+    return image;
+}
+
+// Escribe image como fuente C: `const unsigned char symbol[]` y
+// `const size_t symbol_size`
+static inline gboolean pug_image_write_c(const GByteArray* image, const char* symbol, const char* path) {
+    if (!image || !symbol || !path) return FALSE;
+    gboolean valid = g_ascii_isalpha(symbol[0]) || symbol[0] == '_';
+    for (const char* p = symbol; valid && *p; p++) valid = g_ascii_isalnum(*p) || *p == '_';
+    if (!valid) {
+        g_print("Error: '%s' no es un identificador de C\n", symbol);
+        return FALSE;
+    }
+    GString* code = g_string_sized_new(image->len * 6 + 256);
+    g_string_append(code, "/* Plantillas compiladas (generado por c-pug embed; no editar) */\n");
+    g_string_append(code, "#include <stddef.h>\n\n");
+    g_string_append_printf(code, "const unsigned char %s[] __attribute__((aligned(16))) = {", symbol);
+    for (guint i = 0; i < image->len; i++) {
+        if (i % 16 == 0) g_string_append(code, "\n   ");
+        g_string_append_printf(code, " 0x%02x,", image->data[i]);
+    }
+    g_string_append_printf(code, "\n};\n\nconst size_t %s_size = %u;\n", symbol, image->len);
+
+    GError* error = NULL;
+    gboolean ok = g_file_set_contents(path, code->str, (gssize)code->len, &error);
+    if (!ok) {
+        g_print("Error: No se pudo escribir %s: %s\n", path, error->message);
+        g_error_free(error);
+    }
+    g_string_free(code, TRUE);
+    return ok;
+}
+
+// ============================================================================
+// PAQUETES
+// ============================================================================
+
+// Escribe image en path. El archivo se sustituye con un rename: los procesos
+// que ya lo tienen proyectado siguen viendo el anterior.
+static inline gboolean pug_image_write_file(const GByteArray* image, const char* path) {
+    if (!image || !path) return FALSE;
+    GError* error = NULL;
+    if (!g_file_set_contents(path, (const char*)image->data, (gssize)image->len, &error)) {
+        g_print("Error: No se pudo escribir %s: %s\n", path, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Proyecta el paquete path en sólo lectura. Las páginas son las de la caché
+// del sistema, compartidas por todos los procesos que lo abren; se liberan
+// con pug_image_free().
+static inline PugImage* pug_image_map(const char* path) {
+    GError* error = NULL;
+    GMappedFile* mapped = g_mapped_file_new(path, FALSE, &error);
+    if (!mapped) {
+        g_print("Error: No se pudo abrir %s: %s\n", path, error->message);
+        g_error_free(error);
+        return NULL;
+    }
+    PugImage* image = pug_image_open((const guint8*)g_mapped_file_get_contents(mapped),
+                                     g_mapped_file_get_length(mapped));
+    if (!image) {
+        g_mapped_file_unref(mapped);
+        return NULL;
+    }
+    image->mapped = mapped;
+    return image;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_IMAGE_H
@@ -0,0 +1,585 @@
+#ifndef PUG_LOADER_H
+#define PUG_LOADER_H
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "pug/pug_template.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// CARGADOR DE PLANTILLAS (include / extends)
+// ============================================================================
+// Carga las plantillas por ruta a través de un proveedor de archivos y
+// compila cada una una sola vez. Un `include` o `extends` no copia el árbol
+// de la plantilla referida: el nodo apunta a la plantilla compartida, de la
+// que quien la incluye guarda una referencia. Todas las plantillas del loader
+// comparten la tabla de locales, así una parcial se renderiza con el frame de
+// quien la incluye y sus mixins se pueden llamar desde ella.
+//
+// Las rutas relativas se resuelven desde el directorio de la plantilla que
+// las usa; las que empiezan por '/' desde la raíz del loader. Sin extensión
+// se añade ".pug". Los ciclos se detectan al compilar y el loader guarda el
+// grafo de dependencias (qué plantillas incluye o extiende cada una).
+//
+// El loader es también la caché de plantillas compiladas:
+//   - Antes de devolver una plantilla comprueba que ni su archivo ni los que
+//     incluye han cambiado (por la marca del proveedor o por el hash del
+//     contenido, ver PugCheckMode); si cambiaron, la recompila.
+//   - Expulsa por LRU cuando la memoria estimada supera max_bytes. Una
+//     plantilla expulsada o recompilada sigue viva mientras alguien tenga
+//     una referencia (un render en curso, una plantilla que la incluye).
+//   - Es segura entre hilos. Las búsquedas sólo toman el lock de las tablas;
+//     si varios hilos piden a la vez una plantilla que no está, uno la
+//     compila y el resto espera a ese resultado. Las compilaciones van de
+//     una en una porque comparten la tabla de símbolos.
+
+#define PUG_LOADER_DEFAULT_MAX_BYTES ((gsize)64 * 1024 * 1024)
+
+// Cómo se comprueba que una plantilla guardada sigue al día
+typedef enum {
+    PUG_CHECK_NONE = 0,     // Nunca (despliegues inmutables)
+    PUG_CHECK_STAMP,        // Marca del proveedor (mtime); sin stat, como HASH
+    PUG_CHECK_HASH          // Se relee el archivo y se compara el hash
+} PugCheckMode;
+
+// Lee el archivo path; devuelve su contenido (se libera con g_free) o NULL
+typedef char* (*PugReadFunc)(const char* path, gpointer data);
+
+// Marca de versión de path (p. ej. mtime en microsegundos) o -1 si no existe
+typedef gint64 (*PugStatFunc)(const char* path, gpointer data);
+
+// Plantilla de path ya compilada (p. ej. desde una imagen, ver pug_image.h),
+// con sus slots en symbols y sus include/extends cargados con resolve.
+// Devuelve NULL si el proveedor no la tiene compilada.
+typedef PugTemplate* (*PugCompiledFunc)(const char* path, PugSymbols* symbols, PugResolveFunc resolve,
+                                        gpointer resolve_data, gpointer data);
+
+typedef struct {
+    PugReadFunc read;
+    gpointer data;
+    PugStatFunc stat;       // Opcional
+    PugCompiledFunc compiled; // Opcional: se prueba antes de leer y compilar
+} PugFileProvider;
+
+typedef struct {
+    char* path;
+    PugTemplate* tpl;       // NULL mientras se compila
+    gsize bytes;
+    GList link;             // Nodo en la lista LRU (sin reserva propia)
+} PugLoaderEntry;
+
+typedef struct PugLoader {
+    PugFileProvider provider;
+    char* root;                 // Base de las rutas que empiezan por '/'
+    PugCheckMode check;
+    PugSymbols symbols;         // Compartida por todas las plantillas del loader
+
+    GHashTable* entries;        // Ruta resuelta -> PugLoaderEntry*
+    GHashTable* deps;           // Ruta resuelta -> GPtrArray de las rutas que usa
+    GQueue lru;                 // Más reciente en la cabeza (sólo entradas compiladas)
+    gsize bytes;
+    gsize max_bytes;
+    GMutex lock;                // Tablas, LRU y contadores
+    GCond loaded;               // Avisa de que terminó una compilación
+
+    GRecMutex compile_lock;     // Una compilación puede cargar otras (recursivo)
+    GPtrArray* loading;         // Rutas compilándose (pila para detectar ciclos)
+
+    // Estadísticas
+    guint64 hits;
+    guint64 misses;             // Compilaciones (incluye recompilaciones)
+    guint64 reloads;            // Recompilaciones por cambios en los archivos
+    guint64 evictions;
+} PugLoader;
+
+// Proveedor por defecto: lee del disco
+static inline char* pug_disk_read(const char* path, gpointer data) {
+    char* content = NULL;
+    (void)data;
+    if (!g_file_get_contents(path, &content, NULL, NULL)) return NULL;
+    return content;
+}
+
+static inline gint64 pug_disk_stat(const char* path, gpointer data) {
+    GStatBuf st;
+    (void)data;
+    if (g_stat(path, &st) != 0) return -1;
+#if defined(__linux__)
+    return (gint64)st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000;
+#else
+    return (gint64)st.st_mtime * G_USEC_PER_SEC;
+#endif
+}
+
+// FNV-1a de 64 bits del contenido de una plantilla
+static inline guint64 pug_loader_hash(const char* content) {
+    guint64 hash = 14695981039346656037ULL;
+    for (const unsigned char* p = (const unsigned char*)content; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static inline void loader_entry_free(PugLoaderEntry* entry) {
+    if (!entry) return;
+    pug_template_free(entry->tpl);
+    g_free(entry->path);
+    g_free(entry);
+}
+
+// Crea un loader con raíz root ("." si es NULL). provider == NULL lee del disco.
+static inline PugLoader* pug_loader_new(const char* root, const PugFileProvider* provider) {
+    PugLoader* loader = g_new0(PugLoader, 1);
+    if (!loader) return NULL;
+    loader->provider.read = provider ? provider->read : pug_disk_read;
+    loader->provider.data = provider ? provider->data : NULL;
+    loader->provider.stat = provider ? provider->stat : pug_disk_stat;
+    loader->provider.compiled = provider ? provider->compiled : NULL;
+    loader->root = g_canonicalize_filename(root ? root : ".", NULL);
+    loader->check = PUG_CHECK_STAMP;
+    pug_symbols_init(&loader->symbols);
+    loader->entries = g_hash_table_new(g_str_hash, g_str_equal);
+    loader->deps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+    g_queue_init(&loader->lru);
+    loader->max_bytes = PUG_LOADER_DEFAULT_MAX_BYTES;
+    g_mutex_init(&loader->lock);
+    g_cond_init(&loader->loaded);
+    g_rec_mutex_init(&loader->compile_lock);
+    loader->loading = g_ptr_array_new();
+    return loader;
+}
+
+// Libera el loader. Las plantillas que alguien siga referenciando viven hasta
+// su último pug_template_free(), pero ya no se pueden renderizar con locales
+// creadas después: la tabla de símbolos era del loader.
+static inline void pug_loader_free(PugLoader* loader) {
+    if (!loader) return;
+    GHashTableIter iter;
+    gpointer entry;
+    g_hash_table_iter_init(&iter, loader->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &entry)) loader_entry_free((PugLoaderEntry*)entry);
+    g_hash_table_destroy(loader->entries);
+    g_hash_table_destroy(loader->deps);
+    g_ptr_array_free(loader->loading, TRUE);
+    pug_symbols_clear(&loader->symbols);
+    g_rec_mutex_clear(&loader->compile_lock);
+    g_cond_clear(&loader->loaded);
+    g_mutex_clear(&loader->lock);
+    g_free(loader->root);
+    g_free(loader);
+}
+
+// Presupuesto de memoria de las plantillas guardadas (0 = por defecto)
+static inline void pug_loader_set_max_bytes(PugLoader* loader, gsize max_bytes) {
+    if (!loader) return;
+    g_mutex_lock(&loader->lock);
+    loader->max_bytes = max_bytes ? max_bytes : PUG_LOADER_DEFAULT_MAX_BYTES;
+    g_mutex_unlock(&loader->lock);
+}
+
+static inline void pug_loader_set_check(PugLoader* loader, PugCheckMode check) {
+    if (loader) loader->check = check;
+}
+
+// Añade ".pug" si el último componente de la ruta no tiene extensión
+static inline char* loader_with_extension(char* resolved) {
+    char* base = g_path_get_basename(resolved);
+    if (!strchr(base, '.')) {
+        char* with_ext = g_strconcat(resolved, ".pug", NULL);
+        g_free(resolved);
+        resolved = with_ext;
+    }
+    g_free(base);
+    return resolved;
+}
+
+// ¿Está la ruta canónica resolved dentro de la raíz del loader?
+static inline int loader_inside_root(const PugLoader* loader, const char* resolved) {
+    gsize len = strlen(loader->root);
+    if (len == 1 && loader->root[0] == '/') return resolved[0] == '/';
+    return strncmp(resolved, loader->root, len) == 0 && resolved[len] == '/';
+}
+
+// Ruta canónica de path usada desde from (NULL = desde la raíz). Lo que se
+// pide desde la raíz, y lo que incluye una plantilla que está dentro de ella,
+// no puede salir de la raíz ("../../etc/passwd"): devuelve NULL.
+static inline char* pug_loader_resolve_path(const PugLoader* loader, const char* from, const char* path) {
+    gboolean from_root = !from || !*from || path[0] == '/';
+    char* dir = from_root ? g_strdup(loader->root) : g_path_get_dirname(from);
+    const char* relative = path[0] == '/' ? path + 1 : path;
+    char* joined = g_build_filename(dir, relative, NULL);
+    char* resolved = g_canonicalize_filename(joined, loader->root);
+    g_free(joined);
+    g_free(dir);
+    if ((from_root || loader_inside_root(loader, from)) && !loader_inside_root(loader, resolved)) {
+        g_print("Error: Ruta fuera de la raíz de las plantillas: %s\n", path);
+        g_free(resolved);
+        return NULL;
+    }
+    return loader_with_extension(resolved);
+}
+
+// ¿Siguen tpl y las plantillas que usa tal como se compilaron?
+static inline int loader_fresh(PugLoader* loader, const PugTemplate* tpl) {
+    if (loader->check == PUG_CHECK_NONE) return 1;
+    if (loader->check == PUG_CHECK_STAMP && loader->provider.stat) {
+        if (loader->provider.stat(tpl->name, loader->provider.data) != tpl->source_stamp) return 0;
+    } else {
+        char* content = loader->provider.read(tpl->name, loader->provider.data);
+        int same = content && pug_loader_hash(content) == tpl->source_hash;
+        g_free(content);
+        if (!same) return 0;
+    }
+    for (guint i = 0; i < tpl->uses->len; i++) {
+        if (!loader_fresh(loader, (const PugTemplate*)g_ptr_array_index(tpl->uses, i))) return 0;
+    }
+    return 1;
+}
+
+// Quita una entrada compilada (con el lock tomado)
+static inline void loader_remove_locked(PugLoader* loader, PugLoaderEntry* entry) {
+    g_hash_table_remove(loader->entries, entry->path);
+    g_queue_unlink(&loader->lru, &entry->link);
+    loader->bytes -= entry->bytes;
+    loader_entry_free(entry);
+}
+
+static inline PugTemplate* loader_compile(PugLoader* loader, const char* resolved, PugTemplate* stale);
+
+// Devuelve una referencia a la plantilla de resolved, compilándola si no está
+// guardada o si cambió alguno de sus archivos
+static inline PugTemplate* loader_load(PugLoader* loader, const char* resolved) {
+    PugTemplate* tpl = NULL;
+    g_mutex_lock(&loader->lock);
+    for (;;) {
+        PugLoaderEntry* entry = (PugLoaderEntry*)g_hash_table_lookup(loader->entries, resolved);
+        if (!entry) break;
+        if (entry->tpl) {
+            tpl = pug_template_ref(entry->tpl);
+            g_queue_unlink(&loader->lru, &entry->link);
+            g_queue_push_head_link(&loader->lru, &entry->link);
+            break;
+        }
+        // Se está compilando. Si el lock de compilación es de este hilo, es
+        // él quien la compila: un include circular (loader_compile lo avisa).
+        if (g_rec_mutex_trylock(&loader->compile_lock)) {
+            g_rec_mutex_unlock(&loader->compile_lock);
+            break;
+        }
+        g_cond_wait(&loader->loaded, &loader->lock);
+    }
+    g_mutex_unlock(&loader->lock);
+
+    if (tpl && loader_fresh(loader, tpl)) {
+        g_mutex_lock(&loader->lock);
+        loader->hits++;
+        g_mutex_unlock(&loader->lock);
+        return tpl;
+    }
+    PugTemplate* result = loader_compile(loader, resolved, tpl);
+    pug_template_free(tpl);
+    return result;
+}
+
+// PugResolveFunc de las plantillas del loader: anota la dependencia y carga
+static inline PugTemplate* loader_resolve(const char* from, const char* path, gpointer data) {
+    PugLoader* loader = (PugLoader*)data;
+    char* resolved = pug_loader_resolve_path(loader, from, path);
+    if (!resolved) return NULL;
+
+    g_mutex_lock(&loader->lock);
+    GPtrArray* deps = (GPtrArray*)g_hash_table_lookup(loader->deps, from);
+    if (!deps) {
+        deps = g_ptr_array_new_with_free_func(g_free);
+        g_hash_table_insert(loader->deps, g_strdup(from), deps);
+    }
+    gboolean known = FALSE;
+    for (guint i = 0; i < deps->len && !known; i++) {
+        known = strcmp((const char*)g_ptr_array_index(deps, i), resolved) == 0;
+    }
+    if (!known) g_ptr_array_add(deps, g_strdup(resolved));
+    g_mutex_unlock(&loader->lock);
+
+    PugTemplate* tpl = loader_load(loader, resolved);
+    g_free(resolved);
+    return tpl;
+}
+
+// Compila resolved (stale = la versión guardada que ya no vale, o NULL) y la
+// guarda. Devuelve una referencia o NULL.
+static inline PugTemplate* loader_compile(PugLoader* loader, const char* resolved, PugTemplate* stale) {
+    g_rec_mutex_lock(&loader->compile_lock);
+
+    // Con el lock de compilación tomado, una entrada a medio compilar sólo
+    // puede ser de este mismo hilo
+    for (guint i = 0; i < loader->loading->len; i++) {
+        if (strcmp((const char*)g_ptr_array_index(loader->loading, i), resolved) != 0) continue;
+        GString* cycle = g_string_new("");
+        for (guint j = i; j < loader->loading->len; j++) {
+            g_string_append(cycle, (const char*)g_ptr_array_index(loader->loading, j));
+            g_string_append(cycle, " -> ");
+        }
+        g_string_append(cycle, resolved);
+        g_print("Error: dependencia circular: %s\n", cycle->str);
+        g_string_free(cycle, TRUE);
+        g_rec_mutex_unlock(&loader->compile_lock);
+        return NULL;
+    }
+
+    g_mutex_lock(&loader->lock);
+    PugLoaderEntry* entry = (PugLoaderEntry*)g_hash_table_lookup(loader->entries, resolved);
+    if (entry && entry->tpl != stale) {
+        // Otro hilo la compiló mientras esperábamos el lock
+        PugTemplate* tpl = pug_template_ref(entry->tpl);
+        loader->hits++;
+        g_mutex_unlock(&loader->lock);
+        g_rec_mutex_unlock(&loader->compile_lock);
+        return tpl;
+    }
+    if (entry) {
+        loader_remove_locked(loader, entry);
+        loader->reloads++;
+    }
+    entry = g_new0(PugLoaderEntry, 1);
+    entry->path = g_strdup(resolved);
+    entry->link.data = entry;
+    g_hash_table_insert(loader->entries, entry->path, entry);
+    g_hash_table_remove(loader->deps, resolved);
+    loader->misses++;
+    g_mutex_unlock(&loader->lock);
+
+    // La marca se toma antes de leer: si el archivo cambia entre medias, la
+    // siguiente comprobación lo verá
+    gint64 stamp = loader->provider.stat ? loader->provider.stat(resolved, loader->provider.data) : 0;
+    PugTemplate* tpl = NULL;
+    g_ptr_array_add(loader->loading, (gpointer)resolved);
+    if (loader->provider.compiled) {
+        tpl = loader->provider.compiled(resolved, &loader->symbols, loader_resolve, loader, loader->provider.data);
+    }
+    if (tpl) {
+        tpl->source_stamp = stamp;
+    } else {
+        char* content = loader->provider.read(resolved, loader->provider.data);
+        if (!content) {
+            g_print("Error: no se pudo leer '%s'\n", resolved);
+        } else {
+            tpl = pug_template_compile_with(content, resolved, &loader->symbols, loader_resolve, loader);
+            if (tpl) {
+                tpl->source_stamp = stamp;
+                tpl->source_hash = pug_loader_hash(content);
+            }
+            g_free(content);
+        }
+    }
+    g_ptr_array_remove_index(loader->loading, loader->loading->len - 1);
+
+    g_mutex_lock(&loader->lock);
+    if (tpl) {
+        entry->tpl = pug_template_ref(tpl);
+        entry->bytes = tpl->bytes + sizeof(PugLoaderEntry) + strlen(resolved);
+        loader->bytes += entry->bytes;
+        g_queue_push_head_link(&loader->lru, &entry->link);
+        // Nunca se expulsa la recién compilada
+        while (loader->bytes > loader->max_bytes && loader->lru.tail && loader->lru.tail != &entry->link) {
+            loader_remove_locked(loader, (PugLoaderEntry*)loader->lru.tail->data);
+            loader->evictions++;
+        }
+    } else {
+        g_hash_table_remove(loader->entries, resolved);
+        loader_entry_free(entry);
+    }
+    g_cond_broadcast(&loader->loaded);
+    g_mutex_unlock(&loader->lock);
+
+    g_rec_mutex_unlock(&loader->compile_lock);
+    return tpl;
+}
+
+// Devuelve la plantilla de path (relativa a la raíz), compilándola con sus
+// include/extends si hace falta. Es una referencia nueva: se suelta con
+// pug_template_free().
+static inline PugTemplate* pug_loader_get(PugLoader* loader, const char* path) {
+    if (!loader || !path) return NULL;
+    char* resolved = pug_loader_resolve_path(loader, NULL, path);
+    if (!resolved) return NULL;
+    PugTemplate* tpl = loader_load(loader, resolved);
+    g_free(resolved);
+    return tpl;
+}
+
+// Como pug_loader_get() pero con una ruta del sistema de archivos (relativa
+// al directorio actual), no a la raíz del loader
+static inline PugTemplate* pug_loader_get_file(PugLoader* loader, const char* path) {
+    if (!loader || !path) return NULL;
+    char* resolved = loader_with_extension(g_canonicalize_filename(path, NULL));
+    PugTemplate* tpl = loader_load(loader, resolved);
+    g_free(resolved);
+    return tpl;
+}
+
+// Rutas que path incluye o extiende directamente (NULL si ninguna). El array
+// es del loader y vale hasta que path se recompile.
+static inline const GPtrArray* pug_loader_dependencies(PugLoader* loader, const char* path) {
+    if (!loader || !path) return NULL;
+    char* resolved = pug_loader_resolve_path(loader, NULL, path);
+    if (!resolved) return NULL;
+    g_mutex_lock(&loader->lock);
+    const GPtrArray* deps = (const GPtrArray*)g_hash_table_lookup(loader->deps, resolved);
+    g_mutex_unlock(&loader->lock);
+    g_free(resolved);
+    return deps;
+}
+
+// Rutas canónicas de las plantillas que dependen de resolved directa o
+// indirectamente
+static inline GPtrArray* loader_dependents(PugLoader* loader, const char* resolved) {
+    GPtrArray* result = g_ptr_array_new_with_free_func(g_free);
+    GHashTable* seen = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray* pending = g_ptr_array_new();
+
+    g_mutex_lock(&loader->lock);
+    g_ptr_array_add(pending, (gpointer)resolved);
+    while (pending->len > 0) {
+        const char* target = (const char*)g_ptr_array_remove_index(pending, pending->len - 1);
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, loader->deps);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            GPtrArray* deps = (GPtrArray*)value;
+            if (g_hash_table_contains(seen, key)) continue;
+            for (guint i = 0; i < deps->len; i++) {
+                if (strcmp((const char*)g_ptr_array_index(deps, i), target) != 0) continue;
+                g_hash_table_add(seen, key);
+                g_ptr_array_add(result, g_strdup((const char*)key));
+                g_ptr_array_add(pending, key);
+                break;
+            }
+        }
+    }
+    g_mutex_unlock(&loader->lock);
+
+    g_ptr_array_free(pending, TRUE);
+    g_hash_table_destroy(seen);
+    return result;
+}
+
+// Plantillas que dependen de path directa o indirectamente: las que habría
+// que recompilar si cambia. Devuelve un array nuevo de rutas (g_ptr_array_unref).
+static inline GPtrArray* pug_loader_dependents(PugLoader* loader, const char* path) {
+    if (!loader || !path) return g_ptr_array_new_with_free_func(g_free);
+    char* resolved = pug_loader_resolve_path(loader, NULL, path);
+    if (!resolved) return g_ptr_array_new_with_free_func(g_free);
+    GPtrArray* result = loader_dependents(loader, resolved);
+    g_free(resolved);
+    return result;
+}
+
+// Recompila resolved después de lo que usa y que también hay que recompilar
+// (affected), así nunca se queda enlazada a la versión vieja de un parcial.
+// done evita repetir y corta los ciclos.
+static inline void loader_reload_ordered(PugLoader* loader, const char* resolved, GHashTable* affected,
+                                         GHashTable* done, GPtrArray* reloaded) {
+    if (g_hash_table_contains(done, resolved)) return;
+    g_hash_table_add(done, (gpointer)resolved);
+
+    GPtrArray* uses = g_ptr_array_new_with_free_func(g_free);
+    g_mutex_lock(&loader->lock);
+    const GPtrArray* deps = (const GPtrArray*)g_hash_table_lookup(loader->deps, resolved);
+    for (guint i = 0; deps && i < deps->len; i++) {
+        const char* dep = (const char*)g_ptr_array_index(deps, i);
+        if (g_hash_table_contains(affected, dep)) g_ptr_array_add(uses, g_strdup(dep));
+    }
+    PugLoaderEntry* entry = (PugLoaderEntry*)g_hash_table_lookup(loader->entries, resolved);
+    PugTemplate* current = entry && entry->tpl ? pug_template_ref(entry->tpl) : NULL;
+    g_mutex_unlock(&loader->lock);
+
+    for (guint i = 0; i < uses->len; i++) {
+        const char* dep = (const char*)g_hash_table_lookup(affected, g_ptr_array_index(uses, i));
+        loader_reload_ordered(loader, dep, affected, done, reloaded);
+    }
+    g_ptr_array_free(uses, TRUE);
+
+    // Lo que no está guardado se compilará cuando se pida
+    if (!current) return;
+    PugTemplate* fresh = loader_compile(loader, resolved, current);
+    if (fresh) g_ptr_array_add(reloaded, g_strdup(resolved));
+    pug_template_free(fresh);
+    pug_template_free(current);
+}
+
+// Recompila ya las plantillas guardadas de changed (rutas canónicas de
+// archivos que cambiaron) y todas las que dependen de ellas, cada una
+// después de las que usa. Quien pida una de ellas mientras se compila espera
+// a la versión nueva; quien ya tenía una referencia sigue con la vieja.
+// Devuelve las rutas recompiladas (g_ptr_array_unref).
+static inline GPtrArray* pug_loader_reload(PugLoader* loader, const GPtrArray* changed) {
+    GPtrArray* reloaded = g_ptr_array_new_with_free_func(g_free);
+    if (!loader || !changed) return reloaded;
+
+    // Ruta -> la misma ruta (los valores viven lo que el set)
+    GHashTable* affected = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (guint i = 0; i < changed->len; i++) {
+        const char* path = (const char*)g_ptr_array_index(changed, i);
+        GPtrArray* dependents = loader_dependents(loader, path);
+        for (guint j = 0; j < dependents->len; j++) {
+            char* dependent = (char*)g_ptr_array_index(dependents, j);
+            if (!g_hash_table_contains(affected, dependent)) {
+                char* key = g_strdup(dependent);
+                g_hash_table_insert(affected, key, key);
+            }
+        }
+        g_ptr_array_unref(dependents);
+        if (!g_hash_table_contains(affected, path)) {
+            char* key = g_strdup(path);
+            g_hash_table_insert(affected, key, key);
+        }
+    }
+
+    GHashTable* done = g_hash_table_new(g_str_hash, g_str_equal);
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, affected);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        loader_reload_ordered(loader, (const char*)key, affected, done, reloaded);
+    }
+    g_hash_table_destroy(done);
+    g_hash_table_destroy(affected);
+    return reloaded;
+}
+
+// Copia los contadores del loader (cualquier puntero puede ser NULL)
+static inline void pug_loader_stats(PugLoader* loader, guint64* hits, guint64* misses,
+                                    guint64* evictions, gsize* bytes) {
+    if (!loader) return;
+    g_mutex_lock(&loader->lock);
+    if (hits) *hits = loader->hits;
+    if (misses) *misses = loader->misses;
+    if (evictions) *evictions = loader->evictions;
+    if (bytes) *bytes = loader->bytes;
+    g_mutex_unlock(&loader->lock);
+}
+
+static inline void pug_loader_print_stats(PugLoader* loader) {
+    if (!loader) return;
+    g_mutex_lock(&loader->lock);
+    printf("=== Template cache ===\n");
+    printf("Plantillas: %u | Bytes: %zu / %zu\n", g_hash_table_size(loader->entries),
+           (size_t)loader->bytes, (size_t)loader->max_bytes);
+    printf("Hits: %llu | Misses: %llu | Recompilaciones: %llu | Expulsiones: %llu\n",
+           (unsigned long long)loader->hits, (unsigned long long)loader->misses,
+           (unsigned long long)loader->reloads, (unsigned long long)loader->evictions);
+    g_mutex_unlock(&loader->lock);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_LOADER_H
@@ -0,0 +1,417 @@
+#ifndef PUG_PARALLEL_H
+#define PUG_PARALLEL_H
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pug/pug_tokens.h"
+#include "pug/pug_renderer.h"
+#include "pug/pug_buffer_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// RENDERIZADO PARALELO DE SUBÁRBOLES
+// ============================================================================
+// Modo opcional para páginas muy grandes. Antes de renderizar se recorre el
+// árbol sumando el número de nodos de cada subárbol; en cada nodo que supera
+// el umbral, las secuencias de hijos pequeños se agrupan en rangos de unos
+// `threshold` nodos. Cada rango es una tarea que un hilo del pool renderiza en
+// su propio buffer.
+//
+// El hilo principal renderiza el documento en orden normal y, al llegar al
+// inicio de un rango, lo empalma: si la tarea aún no la ha tomado nadie la
+// renderiza él mismo directamente en la salida; si no, espera a que termine y
+// copia su buffer. Así la salida queda en orden de documento y es idéntica a
+// la de render_ast() (la indentación depende de node->depth, que es absoluta).
+
+#define PUG_PARALLEL_DEFAULT_THRESHOLD 2048
+
+enum {
+    PUG_TASK_PENDING = 0,
+    PUG_TASK_RUNNING = 1,
+    PUG_TASK_DONE = 2
+};
+
+typedef struct PugParallelPlan PugParallelPlan;
+
+typedef struct {
+    PugParallelPlan* plan;
+    ASTNode* parent;
+    unsigned int from;
+    unsigned int to;
+    unsigned int preserve_ws;   // Elementos pre/textarea/... abiertos por encima
+    int depth_offset;           // Bloques `cache` y ramas por encima (ver render_fragment)
+    ASTNode* next_sibling;      // Lo que sigue al rango si parent es transparente
+    GString* out;
+    gint state;
+} PugRenderTask;
+
+struct PugParallelPlan {
+    GHashTable* tasks;          // Primer hijo del rango -> PugRenderTask*
+    GPtrArray* order;           // Tareas en el orden en que se encolan
+    GArray* weights;            // Pila de pesos usada al planificar
+    PugSink config;             // Copia de la configuración del sink principal al planificar
+    PugValue* frame;            // Copia de las locales para los hilos
+    unsigned int threshold;
+    unsigned int has_code;      // Hay líneas `- código` que escriben en el frame
+    unsigned int use_tabs;
+    unsigned int tab_size;
+    int minify;
+    gint pending_workers;       // Tareas encoladas que un hilo aún no ha soltado
+    GMutex lock;
+    GCond done;
+};
+
+typedef struct {
+    GThreadPool* threads;
+    unsigned int threshold;     // Nodos por tarea
+    unsigned int n_threads;
+} PugParallelRenderer;
+
+// Número de ancestros de node que conservan espacios (sólo PUG_MINIFY_FULL)
+static inline unsigned int parallel_preserve_depth(ASTNode* node, int minify) {
+    unsigned int count = 0;
+    if (minify != PUG_MINIFY_FULL) return 0;
+    for (ASTNode* p = node; p; p = p->parent) {
+        const PugTagInfo* info = p->node_type == TOKEN_TAG ? node_tag_info(p) : NULL;
+        if (info && (info->flags & PUG_TAG_PRESERVE)) count++;
+    }
+    return count;
+}
+
+// Ajuste de indentación de los hijos de node: cada bloque `cache` o rama
+// condicional por encima resta un nivel, igual que hacen render_fragment() y
+// render_branch_body() en el hilo principal
+static inline int parallel_depth_offset(ASTNode* node) {
+    int offset = 0;
+    for (ASTNode* p = node; p; p = p->parent) {
+        if (p->node_type == TOKEN_CACHE || (p->node_type >= TOKEN_IF && p->node_type <= TOKEN_BLOCK)) offset--;
+    }
+    return offset;
+}
+
+// Primer nodo con salida tras node cuando node no genera etiqueta propia
+// (cache, ramas): lo mismo que render_children() deja en next_sibling al
+// llegar a sus hijos en el hilo principal. Una cadena if/else se salta entera.
+static inline ASTNode* parallel_next_after(ASTNode* node) {
+    while (node && node->parent && node->node_type != TOKEN_TAG) {
+        ASTNode* parent = node->parent;
+        unsigned int end = 0;
+        while (end < parent->children_count && parent->children[end] != node) end++;
+        end++;
+        while (end < parent->children_count && parent->children[end]->node_type == TOKEN_ELSE) end++;
+        ASTNode* next = next_rendered_sibling(parent, end - 1);
+        if (next) return next;
+        if (parent->node_type == TOKEN_TAG && g_strcmp0(parent->tag, "root") != 0) return NULL;
+        node = parent;
+    }
+    return NULL;
+}
+
+// Número de nodos de un subárbol que se renderiza como una unidad (sin
+// trocear). También anota si dentro hay código que escribe en el frame.
+static inline unsigned int parallel_count_unit(PugParallelPlan* plan, ASTNode* node) {
+    unsigned int count = 1;
+    if (node->node_type == TOKEN_CODE && node->expr) plan->has_code = 1;
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        count += parallel_count_unit(plan, node->children[i]);
+    }
+    return count;
+}
+
+static inline void parallel_plan_add_task(PugParallelPlan* plan, ASTNode* parent, unsigned int from, unsigned int to) {
+    PugRenderTask* task = g_new0(PugRenderTask, 1);
+    task->plan = plan;
+    task->parent = parent;
+    task->from = from;
+    task->to = to;
+    task->preserve_ws = parallel_preserve_depth(parent, plan->minify);
+    task->depth_offset = parallel_depth_offset(parent);
+    if (plan->minify == PUG_MINIFY_FULL) task->next_sibling = parallel_next_after(parent);
+    task->state = PUG_TASK_PENDING;
+    g_hash_table_insert(plan->tasks, parent->children[from], task);
+    g_ptr_array_add(plan->order, task);
+}
+
+// Calcula el peso (nodos) del subárbol y crea las tareas de sus hijos
+static inline unsigned int parallel_plan_node(PugParallelPlan* plan, ASTNode* node) {
+    unsigned int weight = 1;
+    guint base = plan->weights->len;
+
+    if (node->node_type == TOKEN_CODE && node->expr) plan->has_code = 1;
+
+    // El cuerpo de un bucle se renderiza una vez por elemento con otras
+    // variables: no se trocea, el bucle entero va en una sola tarea
+    if (node->node_type == TOKEN_EACH && node->loop) return parallel_count_unit(plan, node);
+    // De un case o de una cadena if/else sólo se renderiza una rama: no se
+    // trocean, así una rama que no se toma nunca llega a renderizarse
+    if (node->node_type == TOKEN_CASE || node->node_type == TOKEN_IF ||
+        node->node_type == TOKEN_UNLESS || node->node_type == TOKEN_ELSE) {
+        return parallel_count_unit(plan, node);
+    }
+    // El cuerpo de un mixin sólo se renderiza desde sus llamadas, y cada
+    // llamada (con su `block`) va entera en una tarea
+    if (node->node_type == TOKEN_MIXIN && node->mixin) {
+        parallel_count_unit(plan, node);
+        return 1;
+    }
+    // Un bloque sobrescrito emite partes de otros árboles: va entero
+    if (node->node_type == TOKEN_BLOCK && node->block) {
+        const PugBlockPart* parts = NULL;
+        unsigned int n = render_block_parts(&plan->config, node, &parts);
+        if (n > 0) {
+            unsigned int weight = 1;
+            for (unsigned int i = 0; i < n; i++) weight += parallel_count_unit(plan, parts[i].node);
+            return weight;
+        }
+    }
+    // Una plantilla incluida puede aparecer en varios sitios: va entera
+    if (node->node_type == TOKEN_INCLUDE && node->include) {
+        return parallel_count_unit(plan, node->include->root);
+    }
+    if (node->node_type == TOKEN_CALL && node->call) {
+        unsigned int body = node->call->mixin ? parallel_count_unit(plan, node->call->mixin->node) : 0;
+        return parallel_count_unit(plan, node) + body;
+    }
+
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        unsigned int w = parallel_plan_node(plan, node->children[i]);
+        g_array_append_val(plan->weights, w);
+        weight += w;
+    }
+
+    if (weight >= plan->threshold) {
+        unsigned int* w = &g_array_index(plan->weights, unsigned int, base);
+        unsigned int i = 0;
+        while (i < node->children_count) {
+            // Los hijos grandes ya repartieron su contenido en sus propias
+            // tareas. Un else nunca abre rango: va con el if que lo precede.
+            if (w[i] >= plan->threshold || node->children[i]->node_type == TOKEN_ELSE) {
+                i++;
+                continue;
+            }
+            unsigned int start = i, sum = 0;
+            while (i < node->children_count && w[i] < plan->threshold && sum < plan->threshold) {
+                sum += w[i];
+                i++;
+            }
+            // Ni lo cierra: la cadena if/else entera queda en el mismo rango
+            while (i < node->children_count && node->children[i]->node_type == TOKEN_ELSE) {
+                sum += w[i];
+                i++;
+            }
+            // Rangos demasiado pequeños no compensan el cambio de hilo
+            if (sum >= plan->threshold / 4) {
+                parallel_plan_add_task(plan, node, start, i);
+            }
+        }
+    }
+
+    g_array_set_size(plan->weights, base);
+    return weight;
+}
+
+// Renderiza el rango de una tarea en el sink indicado
+static inline void parallel_render_range(PugSink* sink, PugRenderTask* task) {
+    PugParallelPlan* plan = task->plan;
+    render_children(sink, task->parent, task->from, task->to, plan->use_tabs, plan->tab_size, plan->minify);
+}
+
+// Función de los hilos del pool
+static inline void parallel_worker(gpointer data, gpointer user_data) {
+    PugRenderTask* task = (PugRenderTask*)data;
+    PugParallelPlan* plan = task->plan;
+    (void)user_data;
+
+    if (g_atomic_int_compare_and_exchange(&task->state, PUG_TASK_PENDING, PUG_TASK_RUNNING)) {
+        task->out = pug_buffer_pool_acquire(pug_buffer_pool_default(), 0);
+        // El sink del hilo principal sigue cambiando mientras tanto: sólo se
+        // parte de la copia hecha al planificar
+        PugSink sink = plan->config;
+        sink.gstr = task->out;
+        sink.next_sibling = task->next_sibling;
+        sink.preserve_ws = task->preserve_ws;
+        sink.depth_offset = task->depth_offset;
+        // Cada hilo tiene su arena y su frame: los bucles escriben en él
+        PugArena arena = { NULL, NULL, 0, 0 };
+        PugValue* frame = plan->frame ? (PugValue*)g_memdup2(plan->frame, sizeof(PugValue) * sink.frame_size) : NULL;
+        sink.arena = &arena;
+        sink.frame = frame;
+        parallel_render_range(&sink, task);
+        pug_arena_clear(&arena);
+        g_free(frame);
+        g_mutex_lock(&plan->lock);
+        g_atomic_int_set(&task->state, PUG_TASK_DONE);
+        g_cond_broadcast(&plan->done);
+        g_mutex_unlock(&plan->lock);
+    }
+
+    g_mutex_lock(&plan->lock);
+    plan->pending_workers--;
+    g_cond_broadcast(&plan->done);
+    g_mutex_unlock(&plan->lock);
+}
+
+// PugSpliceFunc del hilo principal
+static inline unsigned int parallel_splice(PugSink* output, ASTNode* parent, unsigned int index) {
+    PugParallelPlan* plan = (PugParallelPlan*)output->splice_data;
+    PugRenderTask* task = (PugRenderTask*)g_hash_table_lookup(plan->tasks, parent->children[index]);
+    if (!task || task->parent != parent || task->from != index) return index;
+
+    if (g_atomic_int_compare_and_exchange(&task->state, PUG_TASK_PENDING, PUG_TASK_RUNNING)) {
+        // Nadie la ha empezado: renderizarla aquí evita la copia
+        PugSpliceFunc splice = output->splice;
+        output->splice = NULL;
+        parallel_render_range(output, task);
+        output->splice = splice;
+        g_atomic_int_set(&task->state, PUG_TASK_DONE);
+    } else {
+        g_mutex_lock(&plan->lock);
+        while (g_atomic_int_get(&task->state) != PUG_TASK_DONE) {
+            g_cond_wait(&plan->done, &plan->lock);
+        }
+        g_mutex_unlock(&plan->lock);
+        sink_append_len(output, task->out->str, task->out->len);
+        pug_buffer_pool_release(pug_buffer_pool_default(), task->out);
+        task->out = NULL;
+    }
+    return task->to;
+}
+
+// Crea un renderizador paralelo. n_threads == 0 usa un hilo por CPU y
+// threshold == 0 usa PUG_PARALLEL_DEFAULT_THRESHOLD nodos por tarea.
+static inline PugParallelRenderer* pug_parallel_renderer_new(unsigned int n_threads, unsigned int threshold) {
+    PugParallelRenderer* renderer = g_new0(PugParallelRenderer, 1);
+    if (!renderer) return NULL;
+    renderer->n_threads = n_threads ? n_threads : g_get_num_processors();
+    renderer->threshold = threshold ? threshold : PUG_PARALLEL_DEFAULT_THRESHOLD;
+    renderer->threads = g_thread_pool_new(parallel_worker, renderer, (gint)renderer->n_threads, FALSE, NULL);
+    if (!renderer->threads) {
+        g_free(renderer);
+        return NULL;
+    }
+    return renderer;
+}
+
+static inline void pug_parallel_renderer_free(PugParallelRenderer* renderer) {
+    if (!renderer) return;
+    g_thread_pool_free(renderer->threads, FALSE, TRUE);
+    g_free(renderer);
+}
+
+// Renderiza root en sink repartiendo los subárboles grandes entre los hilos
+// del renderizador. Los hilos heredan del sink las locales y la caché de
+// fragmentos. Con renderer == NULL equivale a render_node().
+static inline void render_sink_parallel(PugParallelRenderer* renderer, PugSink* sink, ASTNode* root,
+                                        unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!root || !sink) return;
+    if (!renderer) {
+        render_node(sink, root, use_tabs, tab_size, (int)minify);
+        return;
+    }
+
+    PugParallelPlan plan;
+    plan.tasks = g_hash_table_new(g_direct_hash, g_direct_equal);
+    plan.order = g_ptr_array_new_with_free_func(g_free);
+    plan.weights = g_array_new(FALSE, FALSE, sizeof(unsigned int));
+    // Sólo lo que no cambia durante el render: sin buffer, posición ni
+    // estado del minificador del hilo principal
+    memset(&plan.config, 0, sizeof(plan.config));
+    plan.config.scope = sink->scope;
+    plan.config.fragments = sink->fragments;
+    plan.config.vary = sink->vary;
+    plan.config.vary_data = sink->vary_data;
+    plan.config.frame_size = sink->frame_size;
+    plan.config.memo = sink->memo;
+    plan.config.sealed = sink->sealed;
+    plan.config.blocks = sink->blocks;
+    plan.threshold = renderer->threshold;
+    plan.has_code = 0;
+    plan.frame = NULL;
+    plan.use_tabs = use_tabs;
+    plan.tab_size = tab_size;
+    plan.minify = (int)minify;
+    plan.pending_workers = 0;
+    g_mutex_init(&plan.lock);
+    g_cond_init(&plan.done);
+
+    parallel_plan_node(&plan, root);
+
+    // Las asignaciones dependen del orden del documento: con código el
+    // render es secuencial
+    if (plan.has_code) {
+        g_hash_table_remove_all(plan.tasks);
+        g_ptr_array_set_size(plan.order, 0);
+    }
+
+    // Los hilos parten de las locales tal como están antes de renderizar
+    if (plan.order->len > 0 && sink->frame && sink->frame_size > 0) {
+        plan.frame = (PugValue*)g_memdup2(sink->frame, sizeof(PugValue) * sink->frame_size);
+    }
+
+    g_mutex_lock(&plan.lock);
+    plan.pending_workers = (gint)plan.order->len;
+    g_mutex_unlock(&plan.lock);
+    for (guint i = 0; i < plan.order->len; i++) {
+        g_thread_pool_push(renderer->threads, g_ptr_array_index(plan.order, i), NULL);
+    }
+
+    if (plan.order->len > 0) {
+        sink->splice = parallel_splice;
+        sink->splice_data = &plan;
+    }
+    render_node(sink, root, use_tabs, tab_size, (int)minify);
+    sink->splice = NULL;
+    sink->splice_data = NULL;
+
+    // Esperar a que los hilos suelten todas las tareas antes de liberarlas
+    g_mutex_lock(&plan.lock);
+    while (plan.pending_workers > 0) {
+        g_cond_wait(&plan.done, &plan.lock);
+    }
+    g_mutex_unlock(&plan.lock);
+
+    // Tareas que quedaron dentro de un fragmento servido desde la caché
+    for (guint i = 0; i < plan.order->len; i++) {
+        PugRenderTask* task = (PugRenderTask*)g_ptr_array_index(plan.order, i);
+        if (task->out) pug_buffer_pool_release(pug_buffer_pool_default(), task->out);
+    }
+
+    g_free(plan.frame);
+    g_hash_table_destroy(plan.tasks);
+    g_ptr_array_free(plan.order, TRUE);
+    g_array_free(plan.weights, TRUE);
+    g_mutex_clear(&plan.lock);
+    g_cond_clear(&plan.done);
+}
+
+// Renderiza como render_ast_to(), repartiendo los subárboles grandes entre
+// los hilos del renderizador. Con renderer == NULL o árboles por debajo del
+// umbral equivale a render_ast_to().
+static inline void render_ast_parallel_to(PugParallelRenderer* renderer, GString* output, ASTNode* root,
+                                          unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!root || !output) return;
+    PugSink sink = { .gstr = output };
+    PugScratchFrame scratch;
+    render_scratch_begin(&sink, root, &scratch);
+    render_sink_parallel(renderer, &sink, root, use_tabs, tab_size, minify);
+    render_scratch_end(&sink, &scratch);
+}
+
+static inline char* render_ast_parallel(PugParallelRenderer* renderer, ASTNode* root,
+                                        unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!root) return NULL;
+    GString* output = g_string_new("");
+    if (!output) return NULL;
+    render_ast_parallel_to(renderer, output, root, use_tabs, tab_size, minify);
+    return g_string_free(output, FALSE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_PARALLEL_H
@@ -5,6 +5,7 @@
 #include "pug/pug_ast.h"
 #include "pug/pug_attribute_list.h"
 #include "pug/pug_token_list.h"
+#include "pug/pug_fragment_cache.h"
 #include <glib.h>
 #include <stdlib.h>
 #include <string.h>
@@ -77,6 +78,7 @@ static inline void parse_attributes(ParserContext* ctx, ASTNode* node) {
             attr->name = NULL;
             attr->value = NULL;
             attr->type = ATTR_STRING;
+            attr->expr = NULL;
             
             attr->name = g_strstrip(g_strdup(kv[0]));
             if (!attr->name || !*attr->name) {
@@ -93,7 +95,9 @@ static inline void parse_attributes(ParserContext* ctx, ASTNode* node) {
                     value[strlen(value) - 1] = '\0';
                     attr->value = g_strdup(value + 1);
                 } else {
+                    // Sin comillas: expresión (se compila con la plantilla)
                     attr->value = g_strdup(value);
+                    attr->type = ATTR_EXPRESSION;
                 }
             } else {
                 attr->value = g_strdup(""); // Valor vacío permitido
@@ -187,6 +191,37 @@ static inline ASTNode* parse_node(ParserContext* ctx) {
             node->text_content = g_strstrip(g_strdup(token->value ? token->value : ""));
             parser_advance_token(ctx);
             return node;
+        case TOKEN_CACHE:
+            node->tag = g_strdup("cache");
+            node->text_content = g_strstrip(g_strdup(token->value ? token->value : ""));
+            parser_advance_token(ctx);
+            return node;
+        case TOKEN_EACH:
+            node->tag = g_strdup("each");
+            node->text_content = g_strstrip(g_strdup(token->value ? token->value : ""));
+            parser_advance_token(ctx);
+            return node;
+        case TOKEN_IF:
+        case TOKEN_UNLESS:
+        case TOKEN_CASE:
+        case TOKEN_WHEN:
+        case TOKEN_DEFAULT:
+        case TOKEN_BLOCK: {
+            static const char* const names[] = { "if", "unless", "else", "case", "when", "default", "block" };
+            node->tag = g_strdup(names[token->type - TOKEN_IF]);
+            node->text_content = g_strstrip(g_strdup(token->value ? token->value : ""));
+            parser_advance_token(ctx);
+            return node;
+        }
+        case TOKEN_ELSE: {
+            // `else if cond` guarda sólo la condición
+            const char* rest = token->value ? token->value : "";
+            int is_else_if = strncmp(rest, "if", 2) == 0 && (rest[2] == '\0' || g_ascii_isspace(rest[2]));
+            node->tag = g_strdup(is_else_if ? "else if" : "else");
+            node->text_content = g_strstrip(g_strdup(is_else_if ? rest + 2 : ""));
+            parser_advance_token(ctx);
+            return node;
+        }
         default:
             ast_node_free(node);
             parser_advance_token(ctx);
@@ -206,14 +241,14 @@ static inline ASTNode* parse_node(ParserContext* ctx) {
         } else if (token->type == TOKEN_ATTRIBUTE) {
             parse_attributes(ctx, node);
         } else if (token->type == TOKEN_TEXT || token->type == TOKEN_INTERPOLATION) {
-            if (node->text_content) {
-                char* new_text = g_strconcat(node->text_content, " ", token->value, NULL);
-                g_free(node->text_content);
-                node->text_content = g_strstrip(g_strdup(new_text));
-                g_free(new_text);
-            } else {
-                node->text_content = g_strstrip(g_strdup(token->value ? token->value : ""));
-            }
+            // Los trozos de texto ya traen sus espacios; las interpolaciones
+            // conservan su sintaxis #{...} para compilarlas después
+            int interp = (token->type == TOKEN_INTERPOLATION);
+            char* new_text = g_strconcat(node->text_content ? node->text_content : "",
+                                         interp ? "#{" : "", token->value ? token->value : "",
+                                         interp ? "}" : "", NULL);
+            g_free(node->text_content);
+            node->text_content = new_text;
             node->is_inline = 1;
             parser_advance_token(ctx);
         } else {
@@ -221,9 +256,34 @@ static inline ASTNode* parse_node(ParserContext* ctx) {
         }
     }
     
+    if (node->text_content) g_strstrip(node->text_content);
     return node;
 }
 
+// Dependencias de un bloque `cache` sin declarar: las locales de sus hijos
+static inline void parser_cache_node_deps(ASTNode* node) {
+    GPtrArray* names = g_ptr_array_new_with_free_func(g_free);
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        fragment_collect_deps(node->children[i], names);
+    }
+    g_ptr_array_add(names, NULL);
+    g_free(node->text_content);
+    node->text_content = g_strjoinv(" ", (gchar**)names->pdata);
+    node->cache_deps = PUG_CACHE_DEPS_INFERRED;
+    g_ptr_array_free(names, TRUE);
+}
+
+// Completa las dependencias de los bloques `cache` que no las declaran
+static inline void parser_resolve_cache_deps(ASTNode* node) {
+    if (!node) return;
+    if (node->node_type == TOKEN_CACHE && (!node->text_content || !*node->text_content)) {
+        parser_cache_node_deps(node);
+    }
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        parser_resolve_cache_deps(node->children[i]);
+    }
+}
+
 // Parsea una lista de tokens y construye el AST
 static inline ASTNode* parse_pug(ParserContext* ctx) {
     if (!ctx || !ctx->tokens) return NULL;
@@ -282,6 +342,7 @@ static inline ASTNode* parse_pug(ParserContext* ctx) {
         }
     }
     
+    parser_resolve_cache_deps(ctx->root_node);
     return ctx->root_node;
 }
 
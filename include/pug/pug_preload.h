@@ -0,0 +1,251 @@
+#ifndef PUG_PRELOAD_H
+#define PUG_PRELOAD_H
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "pug/pug_template.h"
+#include "pug/pug_loader.h"
+#include "pug/pug_registry.h"
+#include "pug/pug_engine.h"
+#include "pug/pug_image.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// PRECARGA PARA PROCESOS CON FORK()
+// ============================================================================
+// Un proceso maestro compila todas las plantillas antes de fork() y los
+// hijos las usan sin copiarlas: las páginas del código compilado sólo se
+// copian si alguien escribe en ellas, así que después de sellar nada del
+// camino de render escribe en datos compartidos:
+//
+//   - Las plantillas se buscan en una tabla propia de sólo lectura y se usan
+//     sin referencias (ni el contador de la plantilla ni el LRU del loader).
+//   - Las variantes de las llamadas constantes se crean al calentar, en el
+//     maestro; sellada, una plantilla ya no publica variantes nuevas ni usa
+//     su memo de mixins (ver render_call_constant()).
+//   - Las estadísticas por plantilla viven en páginas propias (mmap anónimo)
+//     que cada hijo sustituye por unas suyas con pug_preload_after_fork().
+//
+//   PugPreload* preload = pug_preload_new(engine);     // check = NONE
+//   pug_preload_add_directory(preload);
+//   pug_preload_seal(preload);
+//   if (fork() == 0) {
+//       pug_preload_after_fork(preload);
+//       const char* html = pug_preload_render(preload, "index", locals, &len);
+//   }
+//
+// Las plantillas no se vuelven a comprobar ni a recargar: el motor tiene que
+// ser de PUG_CHECK_NONE y sin pug_watch.
+
+typedef struct {
+    gsize renders;              // Atómicas
+    gsize bytes;
+} PugPreloadStats;
+
+typedef struct {
+    PugEngine* engine;
+    GPtrArray* names;           // Rutas precargadas, en el orden en que se añaden
+    GPtrArray* templates;       // Versión publicada en el registro de cada ruta
+    GHashTable* index;          // Ruta -> posición + 1 (sólo lecturas tras sellar)
+    PugPreloadStats* stats;     // Páginas del proceso, una entrada por ruta
+    gsize stats_size;
+    gboolean sealed;
+} PugPreload;
+
+static inline PugPreload* pug_preload_new(PugEngine* engine) {
+    if (!engine) return NULL;
+    if (engine->loader->check != PUG_CHECK_NONE) {
+        g_print("Error: La precarga necesita un motor sin comprobación de cambios\n");
+        return NULL;
+    }
+    PugPreload* preload = g_new0(PugPreload, 1);
+    preload->engine = engine;
+    preload->names = g_ptr_array_new_with_free_func(g_free);
+    preload->templates = g_ptr_array_new();
+    preload->index = g_hash_table_new(g_str_hash, g_str_equal);
+    return preload;
+}
+
+static inline void preload_stats_unmap(PugPreload* preload) {
+    if (preload->stats) munmap(preload->stats, preload->stats_size);
+    preload->stats = NULL;
+    preload->stats_size = 0;
+}
+
+// Estadísticas a cero en páginas nuevas, que no comparten nada con las de
+// ninguna plantilla ni con las de otro proceso
+static inline gboolean preload_stats_map(PugPreload* preload) {
+    gsize page = (gsize)sysconf(_SC_PAGESIZE);
+    gsize size = sizeof(PugPreloadStats) * (preload->names->len ? preload->names->len : 1);
+    size = (size + page - 1) / page * page;
+    void* stats = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED) {
+        g_print("Error: No se pudieron reservar las estadísticas de la precarga\n");
+        return FALSE;
+    }
+    preload_stats_unmap(preload);
+    preload->stats = (PugPreloadStats*)stats;
+    preload->stats_size = size;
+    return TRUE;
+}
+
+// Compila path (relativa a la raíz) y la publica en el registro. Sólo antes
+// de sellar.
+static inline gboolean pug_preload_add(PugPreload* preload, const char* path) {
+    if (!preload || !path) return FALSE;
+    if (preload->sealed) {
+        g_print("Error: La precarga ya está sellada\n");
+        return FALSE;
+    }
+    if (g_hash_table_contains(preload->index, path)) return TRUE;
+    PugRegistry* registry = preload->engine->registry;
+    guint guard = pug_registry_enter(registry);
+    const PugTemplate* tpl = pug_registry_get(registry, path);
+    pug_registry_leave(registry, guard);
+    if (!tpl) return FALSE;
+
+    // Sin recargas, la versión publicada no se retira nunca
+    char* name = g_strdup(path);
+    g_ptr_array_add(preload->names, name);
+    g_ptr_array_add(preload->templates, (gpointer)tpl);
+    g_hash_table_insert(preload->index, name, GUINT_TO_POINTER(preload->names->len));
+    return TRUE;
+}
+
+// Precarga todos los .pug bajo la raíz del motor, con el nombre sin
+// extensión con el que se piden ("pages/index"). Devuelve cuántos compilan.
+static inline guint pug_preload_add_directory(PugPreload* preload) {
+    if (!preload) return 0;
+    GPtrArray* files = g_ptr_array_new_with_free_func(g_free);
+    image_scan_dir(preload->engine->loader->root, "", files);
+    g_ptr_array_sort(files, image_name_compare);
+    guint added = 0;
+    for (guint i = 0; i < files->len; i++) {
+        char* name = (char*)g_ptr_array_index(files, i);
+        name[strlen(name) - strlen(".pug")] = '\0';
+        if (pug_preload_add(preload, name)) added++;
+    }
+    g_ptr_array_free(files, TRUE);
+    return added;
+}
+
+// Precarga todas las plantillas de la imagen del motor
+// (pug_engine_new_from_image())
+static inline guint pug_preload_add_image(PugPreload* preload, const PugImage* image) {
+    if (!preload || !image) return 0;
+    guint added = 0;
+    for (guint i = 0; i < pug_image_count(image); i++) {
+        char* name = g_strdup(pug_image_name(image, i));
+        if (g_str_has_suffix(name, ".pug")) name[strlen(name) - strlen(".pug")] = '\0';
+        if (pug_preload_add(preload, name)) added++;
+        g_free(name);
+    }
+    return added;
+}
+
+// Calienta y sella: un render de cada plantilla (sin locales, con el formato
+// del motor) crea en el maestro las variantes de las llamadas constantes y
+// los buffers del hilo; después se sellan todas las plantillas del loader
+// (también las incluidas) y se reservan las estadísticas. Llamar antes de
+// fork().
+static inline gboolean pug_preload_seal(PugPreload* preload) {
+    if (!preload || preload->sealed) return FALSE;
+    for (guint i = 0; i < preload->templates->len; i++) {
+        pug_engine_render(preload->engine, (const PugTemplate*)g_ptr_array_index(preload->templates, i), NULL, NULL);
+    }
+
+    PugLoader* loader = preload->engine->loader;
+    g_mutex_lock(&loader->lock);
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, loader->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        PugLoaderEntry* entry = (PugLoaderEntry*)value;
+        if (entry->tpl) entry->tpl->sealed = 1;
+    }
+    g_mutex_unlock(&loader->lock);
+    for (guint i = 0; i < preload->templates->len; i++) {
+        ((PugTemplate*)g_ptr_array_index(preload->templates, i))->sealed = 1;
+    }
+
+    if (!preload_stats_map(preload)) return FALSE;
+    preload->sealed = TRUE;
+    return TRUE;
+}
+
+// En el hijo, justo después de fork(): estadísticas propias desde cero. Las
+// del maestro no se tocan (ni para ponerlas a cero), así que no se copian.
+static inline gboolean pug_preload_after_fork(PugPreload* preload) {
+    if (!preload || !preload->sealed) return FALSE;
+    return preload_stats_map(preload);
+}
+
+// Posición de path en la precarga o -1
+static inline int pug_preload_find(const PugPreload* preload, const char* path) {
+    if (!preload || !path) return -1;
+    return (int)GPOINTER_TO_UINT(g_hash_table_lookup(preload->index, path)) - 1;
+}
+
+static inline const PugTemplate* pug_preload_template(const PugPreload* preload, int index) {
+    if (!preload || index < 0 || (guint)index >= preload->templates->len) return NULL;
+    return (const PugTemplate*)g_ptr_array_index(preload->templates, index);
+}
+
+// Anota un render de bytes bytes de la plantilla index
+static inline void pug_preload_count(PugPreload* preload, int index, gsize bytes) {
+    if (!preload || !preload->stats || index < 0 || (guint)index >= preload->names->len) return;
+    g_atomic_pointer_add(&preload->stats[index].renders, 1);
+    g_atomic_pointer_add(&preload->stats[index].bytes, bytes);
+}
+
+// Renderiza la plantilla precargada path en el buffer del hilo actual (como
+// pug_engine_render()). NULL si path no está precargada.
+static inline const char* pug_preload_render(PugPreload* preload, const char* path, const PugLocals* locals,
+                                             gsize* len) {
+    int index = pug_preload_find(preload, path);
+    if (index < 0) return NULL;
+    gsize n = 0;
+    const char* html = pug_engine_render(preload->engine, pug_preload_template(preload, index), locals, &n);
+    pug_preload_count(preload, index, n);
+    if (len) *len = n;
+    return html;
+}
+
+static inline void pug_preload_print_stats(const PugPreload* preload) {
+    if (!preload) return;
+    gsize renders = 0, bytes = 0;
+    for (guint i = 0; preload->stats && i < preload->names->len; i++) {
+        renders += preload->stats[i].renders;
+        bytes += preload->stats[i].bytes;
+    }
+    printf("=== Preload ===\n");
+    printf("Plantillas: %u | Renders: %lu | Bytes: %lu\n", preload->names->len, (unsigned long)renders,
+           (unsigned long)bytes);
+    for (guint i = 0; preload->stats && i < preload->names->len; i++) {
+        if (preload->stats[i].renders == 0) continue;
+        printf("  %s: %lu renders, %lu bytes\n", (const char*)g_ptr_array_index(preload->names, i),
+               (unsigned long)preload->stats[i].renders, (unsigned long)preload->stats[i].bytes);
+    }
+}
+
+// No libera el motor
+static inline void pug_preload_free(PugPreload* preload) {
+    if (!preload) return;
+    preload_stats_unmap(preload);
+    g_hash_table_destroy(preload->index);
+    g_ptr_array_free(preload->templates, TRUE);
+    g_ptr_array_free(preload->names, TRUE);
+    g_free(preload);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_PRELOAD_H
@@ -0,0 +1,361 @@
+#ifndef PUG_REGISTRY_H
+#define PUG_REGISTRY_H
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "pug/pug_template.h"
+#include "pug/pug_loader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// REGISTRO DE PLANTILLAS PUBLICADAS (lecturas sin locks)
+// ============================================================================
+// Vista de sólo lectura sobre el loader para los caminos calientes (el
+// servidor de render). Cada ruta pedida tiene una entrada estable con un
+// puntero a la versión publicada de su plantilla; una recarga compila la
+// versión nueva aparte y la publica cambiando el puntero con una operación
+// atómica. Quien lee una ruta ya publicada no espera ni a un lock ni a una
+// compilación: si la plantilla se está recompilando recibe la versión
+// anterior, que sigue siendo válida, y si el lector ve que la suya caducó
+// (comprobación del loader) la recompila el hilo de recargas del registro,
+// no él. La primera petición de una ruta sí compila, o espera a que el loader
+// termine de compilarla: todavía no hay ninguna versión que servir.
+//
+// Las versiones sustituidas (y las tablas de rutas viejas) no se liberan al
+// momento: se retiran con la época en que dejaron de estar publicadas y se
+// liberan cuando ningún lector puede seguir usándolas (reclamación por
+// épocas). Un lector marca su sección con pug_registry_enter() /
+// pug_registry_leave(): incrementa el contador de su época en el hueco de su
+// hilo (una línea de caché por hueco, sin escrituras compartidas entre
+// hilos). La época global sólo avanza cuando ningún lector sigue en la
+// anterior, así que lo retirado en la época e se libera al llegar a e + 2.
+//
+// Los huecos se reparten entre hilos por turno: dos hilos en el mismo hueco
+// sólo comparten línea de caché, los contadores siguen siendo correctos.
+//
+//   guint guard = pug_registry_enter(registry);
+//   const PugTemplate* tpl = pug_registry_get(registry, "pages/index");
+//   ... renderizar tpl ...
+//   pug_registry_leave(registry, guard);
+//
+// Las escrituras (publicar, recargar, liberar lo retirado) van con un lock
+// propio del registro que los lectores no tocan.
+
+#define PUG_REGISTRY_SLOTS 64
+#define PUG_REGISTRY_EPOCHS 3
+
+// Contadores de lectores de un hueco, uno por época módulo 3
+typedef struct {
+    gint count[PUG_REGISTRY_EPOCHS];
+} __attribute__((aligned(64))) PugRegistryReaders;
+
+typedef struct {
+    char* path;                 // Ruta tal como se pide (clave de la tabla)
+    char* resolved;             // Ruta canónica en el loader
+    PugTemplate* tpl;           // Versión publicada (atómico; el registro tiene una referencia)
+    gint refreshing;            // Recarga encargada al hilo de recargas (atómico)
+} PugRegistryEntry;
+
+typedef enum {
+    PUG_REGISTRY_RETIRED_TEMPLATE,
+    PUG_REGISTRY_RETIRED_TABLE
+} PugRegistryRetiredType;
+
+typedef struct {
+    PugRegistryRetiredType type;
+    gpointer data;
+    gint epoch;                 // Época en que dejó de estar publicado
+} PugRegistryRetired;
+
+typedef struct {
+    PugRegistryReaders readers[PUG_REGISTRY_SLOTS];
+    gint epoch;                 // Época global (atómico)
+    GHashTable* table;          // Ruta -> PugRegistryEntry* (atómico; inmutable una vez publicada)
+
+    PugLoader* loader;
+    GThreadPool* refresher;     // Un hilo: recompila las versiones caducadas
+    GMutex lock;                // Escritores: publicar, retirar, liberar
+    GPtrArray* entries;         // Todas las entradas (viven lo que el registro)
+    GQueue retired;             // PugRegistryRetired* por orden de época
+
+    // Estadísticas (con el lock)
+    guint64 publishes;
+    guint64 reclaimed;
+} PugRegistry;
+
+// Hueco de lectores del hilo actual (el mismo para todos los registros)
+static inline guint registry_thread_slot(void) {
+    static GPrivate slot_key;
+    static gint next_slot = 0;
+    gpointer slot = g_private_get(&slot_key);
+    if (!slot) {
+        guint assigned = (guint)g_atomic_int_add(&next_slot, 1) % PUG_REGISTRY_SLOTS;
+        slot = GUINT_TO_POINTER(assigned + 1);
+        g_private_set(&slot_key, slot);
+    }
+    return GPOINTER_TO_UINT(slot) - 1;
+}
+
+static inline void registry_refresh_worker(gpointer data, gpointer user_data);
+
+static inline PugRegistry* pug_registry_new(PugLoader* loader) {
+    if (!loader) return NULL;
+    PugRegistry* registry = g_new0(PugRegistry, 1);
+    registry->loader = loader;
+    registry->table = g_hash_table_new(g_str_hash, g_str_equal);
+    registry->entries = g_ptr_array_new();
+    g_mutex_init(&registry->lock);
+    g_queue_init(&registry->retired);
+    // Sin hilos hasta la primera recarga (no exclusivo)
+    registry->refresher = g_thread_pool_new(registry_refresh_worker, registry, 1, FALSE, NULL);
+    return registry;
+}
+
+static inline void registry_retired_free(PugRegistryRetired* retired) {
+    if (retired->type == PUG_REGISTRY_RETIRED_TEMPLATE) {
+        pug_template_free((PugTemplate*)retired->data);
+    } else {
+        g_hash_table_destroy((GHashTable*)retired->data);
+    }
+    g_free(retired);
+}
+
+// Libera el registro. No puede quedar ningún lector dentro.
+static inline void pug_registry_free(PugRegistry* registry) {
+    if (!registry) return;
+    g_thread_pool_free(registry->refresher, FALSE, TRUE);
+    PugRegistryRetired* retired;
+    while ((retired = (PugRegistryRetired*)g_queue_pop_head(&registry->retired)) != NULL) {
+        registry_retired_free(retired);
+    }
+    for (guint i = 0; i < registry->entries->len; i++) {
+        PugRegistryEntry* entry = (PugRegistryEntry*)g_ptr_array_index(registry->entries, i);
+        pug_template_free(entry->tpl);
+        g_free(entry->path);
+        g_free(entry->resolved);
+        g_free(entry);
+    }
+    g_ptr_array_free(registry->entries, TRUE);
+    g_hash_table_destroy(registry->table);
+    g_mutex_clear(&registry->lock);
+    g_free(registry);
+}
+
+// ============================================================================
+// LECTORES
+// ============================================================================
+
+// Empieza una sección de lectura. Devuelve la marca que hay que pasar a
+// pug_registry_leave(). Se puede anidar.
+static inline guint pug_registry_enter(PugRegistry* registry) {
+    guint slot = registry_thread_slot();
+    PugRegistryReaders* readers = &registry->readers[slot];
+    for (;;) {
+        gint epoch = g_atomic_int_get(&registry->epoch);
+        gint index = epoch % PUG_REGISTRY_EPOCHS;
+        g_atomic_int_inc(&readers->count[index]);
+        // Si la época avanzó entre la lectura y el incremento, el escritor
+        // pudo no ver este contador: se vuelve a anunciar en la nueva
+        if (g_atomic_int_get(&registry->epoch) == epoch) {
+            return slot * PUG_REGISTRY_EPOCHS + (guint)index;
+        }
+        g_atomic_int_add(&readers->count[index], -1);
+    }
+}
+
+static inline void pug_registry_leave(PugRegistry* registry, guint guard) {
+    PugRegistryReaders* readers = &registry->readers[guard / PUG_REGISTRY_EPOCHS];
+    g_atomic_int_add(&readers->count[guard % PUG_REGISTRY_EPOCHS], -1);
+}
+
+// ============================================================================
+// ESCRITORES
+// ============================================================================
+
+// Avanza la época si ningún lector sigue en la anterior (con el lock)
+static inline gboolean registry_try_advance(PugRegistry* registry) {
+    gint epoch = g_atomic_int_get(&registry->epoch);
+    gint previous = (epoch + PUG_REGISTRY_EPOCHS - 1) % PUG_REGISTRY_EPOCHS;
+    for (guint i = 0; i < PUG_REGISTRY_SLOTS; i++) {
+        if (g_atomic_int_get(&registry->readers[i].count[previous]) != 0) return FALSE;
+    }
+    g_atomic_int_set(&registry->epoch, epoch + 1);
+    return TRUE;
+}
+
+// Libera lo retirado que ya ningún lector puede ver (con el lock). Nunca
+// espera: lo que siga en uso queda para la próxima escritura.
+static inline void registry_collect_locked(PugRegistry* registry) {
+    if (g_queue_is_empty(&registry->retired)) return;
+    if (registry_try_advance(registry)) registry_try_advance(registry);
+    gint epoch = g_atomic_int_get(&registry->epoch);
+    PugRegistryRetired* retired;
+    while ((retired = (PugRegistryRetired*)g_queue_peek_head(&registry->retired)) != NULL &&
+           retired->epoch + 2 <= epoch) {
+        g_queue_pop_head(&registry->retired);
+        registry_retired_free(retired);
+        registry->reclaimed++;
+    }
+}
+
+static inline void registry_retire_locked(PugRegistry* registry, PugRegistryRetiredType type, gpointer data) {
+    PugRegistryRetired* retired = g_new(PugRegistryRetired, 1);
+    retired->type = type;
+    retired->data = data;
+    retired->epoch = g_atomic_int_get(&registry->epoch);
+    g_queue_push_tail(&registry->retired, retired);
+}
+
+// Publica tpl (se queda con la referencia) en entry y retira la versión
+// anterior (con el lock)
+static inline void registry_swap_locked(PugRegistry* registry, PugRegistryEntry* entry, PugTemplate* tpl) {
+    // Sólo los escritores cambian el puntero, y van de uno en uno
+    PugTemplate* old = entry->tpl;
+    g_atomic_pointer_set(&entry->tpl, tpl);
+    if (old) registry_retire_locked(registry, PUG_REGISTRY_RETIRED_TEMPLATE, old);
+    registry->publishes++;
+}
+
+// Añade path con tpl (se queda con la referencia) y devuelve la entrada. Si
+// otro hilo la añadió antes, suelta tpl y devuelve la suya.
+static inline PugRegistryEntry* registry_insert(PugRegistry* registry, const char* path, PugTemplate* tpl) {
+    g_mutex_lock(&registry->lock);
+    GHashTable* table = registry->table;
+    PugRegistryEntry* entry = (PugRegistryEntry*)g_hash_table_lookup(table, path);
+    if (entry) {
+        g_mutex_unlock(&registry->lock);
+        pug_template_free(tpl);
+        return entry;
+    }
+    entry = g_new0(PugRegistryEntry, 1);
+    entry->path = g_strdup(path);
+    entry->resolved = g_strdup(tpl->name);
+    entry->tpl = tpl;
+    g_ptr_array_add(registry->entries, entry);
+    registry->publishes++;
+
+    // La tabla publicada no se toca: se copia con la entrada nueva
+    GHashTable* copy = g_hash_table_new(g_str_hash, g_str_equal);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, &key, &value)) g_hash_table_insert(copy, key, value);
+    g_hash_table_insert(copy, entry->path, entry);
+    g_atomic_pointer_set(&registry->table, copy);
+    registry_retire_locked(registry, PUG_REGISTRY_RETIRED_TABLE, table);
+    registry_collect_locked(registry);
+    g_mutex_unlock(&registry->lock);
+    return entry;
+}
+
+// Tarea del hilo de recargas: recompila la versión caducada de entry y la
+// publica
+static inline void registry_refresh_worker(gpointer data, gpointer user_data) {
+    PugRegistryEntry* entry = (PugRegistryEntry*)data;
+    PugRegistry* registry = (PugRegistry*)user_data;
+    PugTemplate* fresh = loader_load(registry->loader, entry->resolved);
+    g_mutex_lock(&registry->lock);
+    if (fresh && fresh != entry->tpl) {
+        registry_swap_locked(registry, entry, fresh);
+    } else {
+        pug_template_free(fresh);
+    }
+    registry_collect_locked(registry);
+    g_mutex_unlock(&registry->lock);
+    g_atomic_int_set(&entry->refreshing, 0);
+}
+
+// Encarga al hilo de recargas la versión caducada de entry, una vez por
+// entrada hasta que se publique. Quien la detecta sigue con la publicada.
+static inline void registry_refresh(PugRegistry* registry, PugRegistryEntry* entry) {
+    if (!g_atomic_int_compare_and_exchange(&entry->refreshing, 0, 1)) return;
+    g_thread_pool_push(registry->refresher, entry, NULL);
+}
+
+// Plantilla publicada de path (relativa a la raíz del loader), cargándola la
+// primera vez (sólo entonces compila). Una versión caducada se sigue
+// devolviendo hasta que el hilo de recargas publique la nueva. Sólo se puede
+// llamar dentro de una sección de lectura y el puntero vale hasta
+// pug_registry_leave(); no es una referencia.
+static inline const PugTemplate* pug_registry_get(PugRegistry* registry, const char* path) {
+    if (!registry || !path) return NULL;
+    GHashTable* table = (GHashTable*)g_atomic_pointer_get(&registry->table);
+    PugRegistryEntry* entry = (PugRegistryEntry*)g_hash_table_lookup(table, path);
+    if (!entry) {
+        PugTemplate* tpl = pug_loader_get(registry->loader, path);
+        if (!tpl) return NULL;
+        entry = registry_insert(registry, path, tpl);
+    } else if (registry->loader->check != PUG_CHECK_NONE &&
+               !loader_fresh(registry->loader, (const PugTemplate*)g_atomic_pointer_get(&entry->tpl))) {
+        registry_refresh(registry, entry);
+    }
+    return (const PugTemplate*)g_atomic_pointer_get(&entry->tpl);
+}
+
+// Recompila en el loader las plantillas de changed (rutas canónicas) y las
+// que dependen de ellas (pug_loader_reload()) y publica las versiones nuevas
+// de las que están en el registro. Los lectores siguen con las anteriores
+// hasta el cambio de puntero. Devuelve las rutas recompiladas
+// (g_ptr_array_unref).
+static inline GPtrArray* pug_registry_reload(PugRegistry* registry, const GPtrArray* changed) {
+    if (!registry) return g_ptr_array_new_with_free_func(g_free);
+
+    GHashTable* affected = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (guint i = 0; changed && i < changed->len; i++) {
+        const char* path = (const char*)g_ptr_array_index(changed, i);
+        GPtrArray* dependents = loader_dependents(registry->loader, path);
+        for (guint j = 0; j < dependents->len; j++) {
+            g_hash_table_add(affected, g_strdup((const char*)g_ptr_array_index(dependents, j)));
+        }
+        g_ptr_array_unref(dependents);
+        g_hash_table_add(affected, g_strdup(path));
+    }
+    GPtrArray* reloaded = pug_loader_reload(registry->loader, changed);
+
+    // Lo que el loader no tenía guardado (expulsado por LRU) se compila aquí
+    g_mutex_lock(&registry->lock);
+    for (guint i = 0; i < registry->entries->len; i++) {
+        PugRegistryEntry* entry = (PugRegistryEntry*)g_ptr_array_index(registry->entries, i);
+        if (!g_hash_table_contains(affected, entry->resolved)) continue;
+        PugTemplate* fresh = loader_load(registry->loader, entry->resolved);
+        if (fresh && fresh != entry->tpl) {
+            registry_swap_locked(registry, entry, fresh);
+        } else {
+            pug_template_free(fresh);
+        }
+    }
+    registry_collect_locked(registry);
+    g_mutex_unlock(&registry->lock);
+
+    g_hash_table_destroy(affected);
+    return reloaded;
+}
+
+// Libera lo retirado que ya no se usa (lo hacen también las escrituras)
+static inline void pug_registry_collect(PugRegistry* registry) {
+    if (!registry) return;
+    g_mutex_lock(&registry->lock);
+    registry_collect_locked(registry);
+    g_mutex_unlock(&registry->lock);
+}
+
+static inline void pug_registry_print_stats(PugRegistry* registry) {
+    if (!registry) return;
+    g_mutex_lock(&registry->lock);
+    printf("=== Template registry ===\n");
+    printf("Plantillas: %u | Publicaciones: %llu | Liberadas: %llu | Pendientes: %u | Época: %d\n",
+           registry->entries->len, (unsigned long long)registry->publishes,
+           (unsigned long long)registry->reclaimed, g_queue_get_length(&registry->retired),
+           g_atomic_int_get(&registry->epoch));
+    g_mutex_unlock(&registry->lock);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_REGISTRY_H
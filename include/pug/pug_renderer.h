@@ -3,7 +3,11 @@
 
 #include "pug_tokens.h"
 #include "pug_ast.h"
+#include "pug_bug.h"
 #include "pug_attribute_list.h"
+#include "pug_fragment_cache.h"
+#include "pug_value.h"
+#include "pug_expr.h"
 #include <glib.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,133 +17,1331 @@
 extern "C" {
 #endif
 
-// Lista de tags HTML void (no requieren cierre)
-static const char* void_tags[] = {
-    "area", "base", "br", "col", "embed", "hr", "img", "input",
-    "link", "meta", "param", "source", "track", "wbr", NULL
+// Modos de salida (parámetro minify de render_node/render_ast)
+typedef enum {
+    PUG_MINIFY_NONE = 0,     // Salida indentada con saltos de línea
+    PUG_MINIFY_COMPACT = 1,  // Sin saltos de línea, indentación ni comentarios
+    PUG_MINIFY_FULL = 2      // Compacto + minificado HTML5 (ver render_node)
+} PugMinifyMode;
+
+// ============================================================================
+// TABLA DE ETIQUETAS
+// ============================================================================
+// Propiedades de las etiquetas HTML que el renderer consulta en cada cierre
+// (void, espacios, reglas de cierre opcional de HTML5). La plantilla apunta
+// cada nodo a su entrada al compilar, así el render no compara cadenas. Es
+// de sólo lectura y se comparte entre hilos.
+
+// Etiquetas con regla propia de cierre opcional
+typedef enum {
+    PUG_TAG_OTHER = 0,
+    PUG_TAG_LI, PUG_TAG_DT, PUG_TAG_DD, PUG_TAG_RT, PUG_TAG_RP,
+    PUG_TAG_OPTION, PUG_TAG_OPTGROUP, PUG_TAG_THEAD, PUG_TAG_TBODY, PUG_TAG_TFOOT,
+    PUG_TAG_TR, PUG_TAG_TD, PUG_TAG_TH, PUG_TAG_HTML, PUG_TAG_BODY, PUG_TAG_HEAD, PUG_TAG_P
+} PugTagRule;
+
+#define PUG_TAG_VOID          0x01  // Sin contenido ni cierre
+#define PUG_TAG_PRESERVE      0x02  // Conserva los espacios (pre, textarea...)
+#define PUG_TAG_CLOSES_P      0x04  // Su apertura cierra un <p> abierto
+#define PUG_TAG_TRANSPARENT   0x08  // Un <p> al final de su contenido no se puede cerrar solo
+
+typedef struct PugTagInfo {
+    const char* name;
+    PugTagRule rule;
+    unsigned int flags;
+} PugTagInfo;
+
+// Ordenada por nombre (búsqueda binaria)
+static const PugTagInfo pug_tag_table[] = {
+    { "a", PUG_TAG_OTHER, PUG_TAG_TRANSPARENT },
+    { "address", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "area", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "article", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "aside", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "audio", PUG_TAG_OTHER, PUG_TAG_TRANSPARENT },
+    { "base", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "blockquote", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "body", PUG_TAG_BODY, 0 },
+    { "br", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "col", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "dd", PUG_TAG_DD, 0 },
+    { "del", PUG_TAG_OTHER, PUG_TAG_TRANSPARENT },
+    { "details", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "div", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "dl", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "dt", PUG_TAG_DT, 0 },
+    { "embed", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "fieldset", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "figcaption", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "figure", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "footer", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "form", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "h1", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "h2", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "h3", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "h4", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "h5", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "h6", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "head", PUG_TAG_HEAD, 0 },
+    { "header", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "hgroup", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "hr", PUG_TAG_OTHER, PUG_TAG_VOID | PUG_TAG_CLOSES_P },
+    { "html", PUG_TAG_HTML, 0 },
+    { "img", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "input", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "ins", PUG_TAG_OTHER, PUG_TAG_TRANSPARENT },
+    { "li", PUG_TAG_LI, 0 },
+    { "link", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "main", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "map", PUG_TAG_OTHER, PUG_TAG_TRANSPARENT },
+    { "menu", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "meta", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "nav", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "noscript", PUG_TAG_OTHER, PUG_TAG_TRANSPARENT },
+    { "ol", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "optgroup", PUG_TAG_OPTGROUP, 0 },
+    { "option", PUG_TAG_OPTION, 0 },
+    { "p", PUG_TAG_P, PUG_TAG_CLOSES_P },
+    { "param", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "pre", PUG_TAG_OTHER, PUG_TAG_PRESERVE | PUG_TAG_CLOSES_P },
+    { "rp", PUG_TAG_RP, 0 },
+    { "rt", PUG_TAG_RT, 0 },
+    { "script", PUG_TAG_OTHER, PUG_TAG_PRESERVE },
+    { "section", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "source", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "style", PUG_TAG_OTHER, PUG_TAG_PRESERVE },
+    { "table", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "tbody", PUG_TAG_TBODY, 0 },
+    { "td", PUG_TAG_TD, 0 },
+    { "textarea", PUG_TAG_OTHER, PUG_TAG_PRESERVE },
+    { "tfoot", PUG_TAG_TFOOT, 0 },
+    { "th", PUG_TAG_TH, 0 },
+    { "thead", PUG_TAG_THEAD, 0 },
+    { "tr", PUG_TAG_TR, 0 },
+    { "track", PUG_TAG_OTHER, PUG_TAG_VOID },
+    { "ul", PUG_TAG_OTHER, PUG_TAG_CLOSES_P },
+    { "video", PUG_TAG_OTHER, PUG_TAG_TRANSPARENT },
+    { "wbr", PUG_TAG_OTHER, PUG_TAG_VOID }
 };
 
+// Entrada para las etiquetas que no están en la tabla
+static const PugTagInfo pug_tag_other = { "", PUG_TAG_OTHER, 0 };
+
+// Entrada de tag (NULL si tag es NULL)
+static inline const PugTagInfo* pug_tag_lookup(const char* tag) {
+    if (!tag) return NULL;
+    gsize lo = 0, hi = G_N_ELEMENTS(pug_tag_table);
+    while (lo < hi) {
+        gsize mid = (lo + hi) / 2;
+        int cmp = strcmp(tag, pug_tag_table[mid].name);
+        if (cmp == 0) return &pug_tag_table[mid];
+        if (cmp < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return &pug_tag_other;
+}
+
+// Entrada de un nodo: la que le dejó la plantilla o, en árboles sin
+// compilar, la búsqueda
+static inline const PugTagInfo* node_tag_info(const ASTNode* node) {
+    return node->tag_info ? node->tag_info : pug_tag_lookup(node->tag);
+}
+
 // Verifica si un tag es void
 static inline int is_void_tag(const char* tag) {
-    if (!tag) return 0;
-    for (int i = 0; void_tags[i]; i++) {
-        if (g_strcmp0(tag, void_tags[i]) == 0) return 1;
+    const PugTagInfo* info = pug_tag_lookup(tag);
+    return info && (info->flags & PUG_TAG_VOID);
+}
+
+// ============================================================================
+// TABLAS DE ESCAPE HTML
+// ============================================================================
+// Compartidas por escape_html(), el sink de escritura y render_measure(): la
+// longitud medida y los bytes escritos salen siempre de la misma tabla.
+
+// Secuencia de reemplazo por byte (NULL = el byte se copia tal cual)
+static const char* const html_escape_seq[256] = {
+    ['&'] = "&amp;", ['<'] = "&lt;", ['>'] = "&gt;", ['"'] = "&quot;", ['\''] = "&#39;"
+};
+
+// Bytes extra que añade el escape de cada byte (0 = sin escape)
+static const unsigned char html_escape_extra[256] = {
+    ['&'] = 4, ['<'] = 3, ['>'] = 3, ['"'] = 5, ['\''] = 4
+};
+
+// Longitud en bytes de los n primeros bytes de un texto una vez escapados
+static inline gsize escape_html_len_n(const char* input, gsize n) {
+    gsize len = n;
+    const unsigned char* p = (const unsigned char*)input;
+    for (gsize i = 0; i < n; i++) {
+        len += html_escape_extra[p[i]];
     }
-    return 0;
+    return len;
+}
+
+// Longitud en bytes de un texto una vez escapado (sin escribir nada)
+static inline gsize escape_html_len(const char* input) {
+    if (!input) return 0;
+    return escape_html_len_n(input, strlen(input));
 }
 
 // Escapa caracteres especiales para HTML
 static inline char* escape_html(const char* input) {
     if (!input) return g_strdup("");
-    GString* escaped = g_string_new("");
+    GString* escaped = g_string_sized_new(escape_html_len(input) + 1);
     if (!escaped) return NULL;
-    for (const char* p = input; *p; p++) {
-        switch (*p) {
-            case '&': g_string_append(escaped, "&amp;"); break;
-            case '<': g_string_append(escaped, "&lt;"); break;
-            case '>': g_string_append(escaped, "&gt;"); break;
-            case '"': g_string_append(escaped, "&quot;"); break;
-            case '\'': g_string_append(escaped, "&#39;"); break;
-            default: g_string_append_c(escaped, *p); break;
+    for (const unsigned char* p = (const unsigned char*)input; *p; p++) {
+        if (html_escape_seq[*p]) {
+            g_string_append_len(escaped, html_escape_seq[*p], html_escape_extra[*p] + 1);
+        } else {
+            g_string_append_c(escaped, (char)*p);
         }
     }
     char* result = g_string_free(escaped, FALSE);
     return result;
 }
 
-// Genera la indentación para una línea
-static inline void append_indent(GString* output, unsigned int depth, unsigned int use_tabs, unsigned int tab_size) {
-    if (!output) return;
-    for (unsigned int i = 0; i < depth; i++) {
-        if (use_tabs) {
-            g_string_append_c(output, '\t');
+// ============================================================================
+// SINK DE SALIDA
+// ============================================================================
+// render_node() escribe siempre a través de un PugSink. Según qué campos estén
+// inicializados el mismo recorrido sirve para tres cosas:
+//   - gstr != NULL : añade a un GString (render_ast)
+//   - buf  != NULL : copia en un buffer fijo de cap bytes (render_into)
+//   - ninguno      : sólo suma longitudes, sin escribir (render_measure)
+// En todos los casos len acumula los bytes que ocupa la salida completa, de modo
+// que medir y escribir nunca pueden discrepar.
+//
+// El sink también guarda el estado del minificador (PUG_MINIFY_FULL), que se
+// aplica en el mismo recorrido en lugar de post-procesar la salida.
+typedef struct PugSink PugSink;
+
+// Llamada a mixin en curso. `block` dentro del cuerpo renderiza los hijos de
+// call con el marco anterior, que es el de quien escribió ese contenido.
+typedef struct PugMixinFrame {
+    ASTNode* call;
+    unsigned int level;
+    struct PugMixinFrame* parent;
+} PugMixinFrame;
+
+// Anidamiento máximo de llamadas (corta la recursión sin fin)
+#define PUG_MIXIN_MAX_DEPTH 128
+// Parámetros que caben en la pila en una llamada
+#define PUG_MIXIN_STACK_ARGS 16
+// Contextos de salida distintos que guarda una llamada constante
+#define PUG_CALL_MAX_VARIANTS 8
+
+// Tabla de bloques de una plantilla con `extends`: el layout se renderiza tal
+// cual y cada `block` con nombre emite las partes que le tocan en esta
+// plantilla (las suyas, las heredadas y el contenido por defecto si se
+// añade con append/prepend). Las partes apuntan a los árboles compartidos.
+typedef struct {
+    ASTNode* node;              // Bloque cuyos hijos se emiten
+    unsigned int level;         // Plantilla de la cadena (0 = layout raíz)
+} PugBlockPart;
+
+typedef struct {
+    unsigned int n_slots;
+    const char** names;         // slot -> nombre (de los nodos de la cadena)
+    unsigned int* first;        // slot -> primera parte; first[n_slots] = total
+    PugBlockPart* parts;        // Sin partes = el slot no se sobrescribe
+    unsigned int n_levels;
+    char** scopes;              // level -> ámbito de la caché de fragmentos
+    ASTNode** prelude;          // Código suelto de la cadena, se ejecuta antes
+    unsigned int n_prelude;
+} PugBlockTable;
+
+static inline void pug_block_table_free(PugBlockTable* table) {
+    if (!table) return;
+    for (unsigned int i = 0; i < table->n_levels; i++) g_free(table->scopes[i]);
+    g_free(table->scopes);
+    g_free(table->names);
+    g_free(table->first);
+    g_free(table->parts);
+    g_free(table->prelude);
+    g_free(table);
+}
+
+// Enganche del renderizado paralelo (ver pug_parallel.h). Si el hijo index de
+// parent inicia un rango renderizado en otro hilo, lo empalma en la salida y
+// devuelve el índice siguiente al rango; si no, devuelve index sin escribir.
+typedef unsigned int (*PugSpliceFunc)(PugSink* output, ASTNode* parent, unsigned int index);
+
+struct PugSink {
+    GString* gstr;
+    char* buf;
+    gsize cap;
+    gsize len;
+    unsigned int preserve_ws;   // > 0 dentro de pre/textarea/script/style
+    ASTNode* next_sibling;      // Siguiente hermano renderizado (cierres opcionales)
+    PugSpliceFunc splice;       // NULL salvo en renderizado paralelo
+    void* splice_data;
+    int depth_offset;           // Ajuste de indentación dentro de bloques transparentes
+
+    // Caché de fragmentos (bloques `cache`); opcional
+    PugFragmentCache* fragments;
+    const char* scope;          // Nombre de la plantilla, parte de la clave
+    PugVaryFunc vary;           // Valor de las locales de las que depende un bloque
+    gpointer vary_data;
+
+    // Locales enlazadas, indexadas por el slot resuelto al compilar. Las
+    // líneas `- var x = ...` escriben en el frame, que es propio del render.
+    PugValue* frame;
+    unsigned int frame_size;
+    PugArena* arena;            // Cadenas creadas por las expresiones
+    PugMixinFrame* mixin_frame; // Llamada a mixin en curso (NULL fuera de mixins)
+    PugFragmentCache* memo;     // Salidas de mixins puros por argumentos; opcional
+    unsigned int sealed;        // Plantillas selladas: no se publican variantes de llamadas
+    const PugBlockTable* blocks; // Bloques de la plantilla hija (NULL sin extends)
+};
+
+static inline void sink_append_len(PugSink* sink, const char* data, gsize n) {
+    if (sink->gstr) {
+        g_string_append_len(sink->gstr, data, n);
+    } else if (sink->buf && sink->len < sink->cap) {
+        // Lo que cabe: el buffer se queda con el prefijo exacto de la salida
+        gsize room = sink->cap - sink->len;
+        memcpy(sink->buf + sink->len, data, n < room ? n : room);
+    }
+    sink->len += n;
+}
+
+static inline void sink_append(PugSink* sink, const char* data) {
+    if (data) sink_append_len(sink, data, strlen(data));
+}
+
+static inline void sink_append_c(PugSink* sink, char c) {
+    if (sink->gstr) {
+        g_string_append_c(sink->gstr, c);
+    } else if (sink->buf && sink->len < sink->cap) {
+        sink->buf[sink->len] = c;
+    }
+    sink->len++;
+}
+
+// Escribe los n primeros bytes de un texto escapados con las tablas de escape
+static inline void sink_append_escaped_len(PugSink* sink, const char* input, gsize n) {
+    if (!sink->gstr && !sink->buf) {
+        sink->len += escape_html_len_n(input, n);
+        return;
+    }
+    const unsigned char* run = (const unsigned char*)input;
+    const unsigned char* p = run;
+    const unsigned char* end = run + n;
+    for (; p < end; p++) {
+        if (html_escape_seq[*p]) {
+            if (p > run) sink_append_len(sink, (const char*)run, p - run);
+            sink_append_len(sink, html_escape_seq[*p], html_escape_extra[*p] + 1);
+            run = p + 1;
+        }
+    }
+    if (p > run) sink_append_len(sink, (const char*)run, p - run);
+}
+
+// Escribe un texto escapado usando las tablas de escape
+static inline void sink_append_escaped(PugSink* sink, const char* input) {
+    if (input) sink_append_escaped_len(sink, input, strlen(input));
+}
+
+// Escribe los n primeros bytes de un texto escapados, colapsando cada secuencia
+// de espacios en blanco (espacios, tabs, saltos de línea) en un único espacio
+static inline void sink_append_collapsed_len(PugSink* sink, const char* input, gsize n) {
+    const unsigned char* run = (const unsigned char*)input;
+    const unsigned char* p = run;
+    const unsigned char* end = run + n;
+    while (p < end) {
+        if (g_ascii_isspace(*p)) {
+            const unsigned char* ws = p;
+            while (p < end && g_ascii_isspace(*p)) p++;
+            if (ws > run) sink_append_len(sink, (const char*)run, ws - run);
+            sink_append_c(sink, ' ');
+            run = p;
+        } else if (html_escape_seq[*p]) {
+            if (p > run) sink_append_len(sink, (const char*)run, p - run);
+            sink_append_len(sink, html_escape_seq[*p], html_escape_extra[*p] + 1);
+            run = ++p;
         } else {
-            for (unsigned int j = 0; j < tab_size; j++) {
-                g_string_append_c(output, ' ');
-            }
+            p++;
         }
     }
+    if (p > run) sink_append_len(sink, (const char*)run, p - run);
+}
+
+// Escribe contenido de texto según el modo de salida
+static inline void sink_append_text_len(PugSink* sink, const char* input, gsize n, int minify) {
+    if (minify == PUG_MINIFY_FULL && sink->preserve_ws == 0) {
+        sink_append_collapsed_len(sink, input, n);
+    } else {
+        sink_append_escaped_len(sink, input, n);
+    }
+}
+
+static inline void sink_append_text(PugSink* sink, const char* input, int minify) {
+    if (input) sink_append_text_len(sink, input, strlen(input), minify);
+}
+
+// Valor de una local del frame (NULL si el slot no está enlazado)
+static inline const PugValue* sink_local(PugSink* sink, unsigned int slot) {
+    return (sink->frame && slot < sink->frame_size) ? &sink->frame[slot] : NULL;
+}
+
+// Evalúa una expresión compilada con el frame y la arena del render
+static inline PugValue sink_eval(PugSink* sink, const PugExpr* expr) {
+    return pug_expr_eval(expr, sink->frame, sink->frame_size, sink->arena);
+}
+
+// Escribe un valor; raw != 0 lo escribe sin escapar. Los arrays se unen con
+// comas, como al convertirlos a cadena en JavaScript.
+static inline void sink_append_value(PugSink* sink, const PugValue* value, int raw, int minify) {
+    if (value && value->type == PUG_VALUE_ARRAY) {
+        for (gsize i = 0; i < value->as.array.count; i++) {
+            if (i > 0) sink_append_c(sink, ',');
+            sink_append_value(sink, &value->as.array.items[i], raw, minify);
+        }
+        return;
+    }
+    char buf[PUG_NUMBER_BUF_SIZE];
+    gsize len = 0;
+    const char* text = pug_value_to_text(value, buf, &len);
+    if (raw) sink_append_len(sink, text, len);
+    else sink_append_text_len(sink, text, len, minify);
+}
+
+// Escribe el contenido de texto de un nodo. Si la plantilla está compilada se
+// recorren sus segmentos: los literales se copian y cada interpolación lee su
+// local directamente del frame por slot o ejecuta su expresión.
+static inline void render_text(PugSink* output, ASTNode* node, int minify) {
+    if (!node->text) {
+        sink_append_text(output, node->text_content, minify);
+        return;
+    }
+    for (unsigned int i = 0; i < node->text->count; i++) {
+        const PugSegment* seg = &node->text->segments[i];
+        if (seg->type == SEGMENT_LITERAL) {
+            // Escapado al compilar: sólo se copia
+            int collapsed = (minify == PUG_MINIFY_FULL && output->preserve_ws == 0);
+            sink_append_len(output, seg->html[collapsed], seg->html_len[collapsed]);
+            continue;
+        }
+        if (seg->expr) {
+            PugValue value = sink_eval(output, seg->expr);
+            sink_append_value(output, &value, seg->type == SEGMENT_RAW, minify);
+        } else {
+            sink_append_value(output, sink_local(output, seg->slot), seg->type == SEGMENT_RAW, minify);
+        }
+    }
+}
+
+// Genera la indentación para una línea
+static inline void sink_append_indent(PugSink* sink, unsigned int depth, unsigned int use_tabs, unsigned int tab_size) {
+    int level = (int)depth + sink->depth_offset;
+    if (level <= 0) return;
+    gsize n = use_tabs ? (gsize)level : (gsize)level * tab_size;
+    if (n == 0) return;
+    if (!sink->gstr && !sink->buf) {
+        sink->len += n;
+        return;
+    }
+    char fill = use_tabs ? '\t' : ' ';
+    for (gsize i = 0; i < n; i++) {
+        sink_append_c(sink, fill);
+    }
+}
+
+// Indica si un valor de atributo puede escribirse sin comillas en HTML5
+// (no vacío y sin espacios, comillas, =, <, > ni `)
+static inline int attr_value_can_be_unquoted_len(const char* value, gsize len) {
+    if (!value || len == 0) return 0;
+    for (const char* p = value; p < value + len; p++) {
+        switch (*p) {
+            case ' ': case '\t': case '\n': case '\r': case '\f':
+            case '"': case '\'': case '=': case '<': case '>': case '`':
+                return 0;
+            default: break;
+        }
+    }
+    return 1;
+}
+
+static inline int attr_value_can_be_unquoted(const char* value) {
+    return value ? attr_value_can_be_unquoted_len(value, strlen(value)) : 0;
+}
+
+// Escribe ="valor" (o el equivalente minificado). En PUG_MINIFY_FULL un valor
+// vacío se omite (attr="" equivale a attr) y las comillas se quitan cuando
+// HTML5 lo permite.
+static inline void render_attribute_value_len(PugSink* output, const char* value, gsize len, int escape, int minify) {
+    if (minify == PUG_MINIFY_FULL) {
+        if (len == 0) return;
+        if (attr_value_can_be_unquoted_len(value, len)) {
+            sink_append_c(output, '=');
+            if (escape) sink_append_escaped_len(output, value, len);
+            else sink_append_len(output, value, len);
+            return;
+        }
+    }
+    sink_append_len(output, "=\"", 2);
+    if (escape) sink_append_escaped_len(output, value, len);
+    else sink_append_len(output, value, len);
+    sink_append_c(output, '"');
+}
+
+static inline void render_attribute_value(PugSink* output, const char* value, int escape, int minify) {
+    render_attribute_value_len(output, value, strlen(value), escape, minify);
+}
+
+// Atributo cuyo valor es una expresión: false, null y undefined lo omiten,
+// true lo deja como atributo booleano y el resto se escapa
+static inline void render_attribute_computed(PugSink* output, const char* name, const PugValue* value, int minify) {
+    if (value->type == PUG_VALUE_NULL || (value->type == PUG_VALUE_BOOL && !value->as.boolean)) return;
+
+    sink_append_c(output, ' ');
+    sink_append(output, name);
+    if (value->type == PUG_VALUE_BOOL) return;
+
+    if (value->type == PUG_VALUE_ARRAY) {
+        // Poco habitual: se une con comas en un buffer temporal
+        GString* joined = g_string_new("");
+        pug_value_append(joined, value);
+        render_attribute_value_len(output, joined->str, joined->len, 1, minify);
+        g_string_free(joined, TRUE);
+        return;
+    }
+    char buf[PUG_NUMBER_BUF_SIZE];
+    gsize len = 0;
+    const char* text = pug_value_to_text(value, buf, &len);
+    render_attribute_value_len(output, text, len, 1, minify);
+}
+
+static inline void render_attribute_expr(PugSink* output, Attribute* attr, int minify) {
+    PugValue value = sink_eval(output, attr->expr);
+    render_attribute_computed(output, attr->name, &value, minify);
+}
+
+// &attributes(objeto): un atributo por propiedad
+static inline void render_attribute_spread(PugSink* output, Attribute* attr, int minify) {
+    PugValue value = sink_eval(output, attr->expr);
+    if (value.type != PUG_VALUE_OBJECT) return;
+    for (gsize i = 0; i < value.as.object.count; i++) {
+        if (!value.as.object.keys[i]) continue;
+        render_attribute_computed(output, value.as.object.keys[i], &value.as.object.values[i], minify);
+    }
 }
 
 // Renderiza los atributos de un nodo
-static inline void render_attributes(GString* output, AttributeList* attrs) {
+static inline void render_attributes(PugSink* output, AttributeList* attrs, int minify) {
     if (!output || !attrs) return;
     for (unsigned int i = 0; i < attrs->count; i++) {
         Attribute* attr = attrs->attributes[i];
         if (!attr || !attr->name) continue;
-        g_string_append_c(output, ' ');
-        g_string_append(output, attr->name);
+        if (attr->expr) {
+            if (attr->name[0] == '&') render_attribute_spread(output, attr, minify);
+            else render_attribute_expr(output, attr, minify);
+            continue;
+        }
+        sink_append_c(output, ' ');
+        sink_append(output, attr->name);
         if (attr->type != ATTR_BOOLEAN && attr->value) {
-            g_string_append_printf(output, "=\"%s\"", attr->value);
+            render_attribute_value(output, attr->value, 0, minify);
         }
     }
 }
 
 // Renderiza las clases de un nodo
-static inline void render_classes(GString* output, char** classes, unsigned int class_count) {
+static inline void render_classes(PugSink* output, char** classes, unsigned int class_count, int minify) {
     if (!output || class_count == 0) return;
-    g_string_append(output, " class=\"");
+    if (minify == PUG_MINIFY_FULL && class_count == 1) {
+        sink_append(output, " class");
+        render_attribute_value(output, classes[0], 1, minify);
+        return;
+    }
+    sink_append(output, " class=\"");
     for (unsigned int i = 0; i < class_count; i++) {
-        if (i > 0) g_string_append_c(output, ' ');
-        char* escaped_class = escape_html(classes[i]);
-        g_string_append(output, escaped_class ? escaped_class : "");
-        g_free(escaped_class);
+        if (i > 0) sink_append_c(output, ' ');
+        sink_append_escaped(output, classes[i]);
     }
-    g_string_append_c(output, '"');
+    sink_append_c(output, '"');
+}
+
+// ============================================================================
+// MINIFICADO HTML5
+// ============================================================================
+
+// Elementos cuyo contenido conserva los espacios en blanco tal cual
+static inline int is_whitespace_preserving_tag(const char* tag) {
+    const PugTagInfo* info = pug_tag_lookup(tag);
+    return info && (info->flags & PUG_TAG_PRESERVE);
+}
+
+// Indica si un nodo produce salida cuando el modo es minificado (comentarios,
+// código y directivas no emiten nada)
+static inline int node_renders_when_minified(ASTNode* node) {
+    switch (node->node_type) {
+        case TOKEN_TAG:
+        case TOKEN_TEXT:
+        case TOKEN_PIPE:
+        case TOKEN_DOT:
+        case TOKEN_INTERPOLATION:
+        case TOKEN_DOCTYPE:
+        case TOKEN_CACHE:
+        case TOKEN_EACH:
+        case TOKEN_IF:
+        case TOKEN_UNLESS:
+        case TOKEN_ELSE:
+        case TOKEN_CASE:
+        case TOKEN_CALL:
+        case TOKEN_BLOCK:
+        case TOKEN_INCLUDE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Siguiente hermano que produce salida minificada, o NULL si no hay más
+static inline ASTNode* next_rendered_sibling(ASTNode* parent, unsigned int index) {
+    for (unsigned int i = index + 1; i < parent->children_count; i++) {
+        if (node_renders_when_minified(parent->children[i])) return parent->children[i];
+    }
+    return NULL;
+}
+
+// Elemento en el que acaba el contenido de node en la salida. Las
+// condiciones, los bucles y los bloques `cache` se renderizan en su sitio,
+// así que se atraviesan; el cuerpo de un mixin, un include o un bloque de
+// layout se renderiza donde se usa, que no es su padre en el árbol, y ahí se
+// devuelve NULL. También es NULL para la raíz y los elementos que no están en
+// pug_tag_table (custom elements, canvas...), de los que no se conocen las
+// reglas.
+static inline const PugTagInfo* rendered_parent_info(const ASTNode* node) {
+    for (const ASTNode* parent = node->parent; parent; parent = parent->parent) {
+        switch (parent->node_type) {
+            case TOKEN_IF:
+            case TOKEN_UNLESS:
+            case TOKEN_ELSE:
+            case TOKEN_EACH:
+            case TOKEN_CASE:
+            case TOKEN_WHEN:
+            case TOKEN_DEFAULT:
+            case TOKEN_CACHE:
+                continue;
+            case TOKEN_TAG: {
+                const PugTagInfo* info = node_tag_info(parent);
+                return (info && info->name[0]) ? info : NULL;
+            }
+            default:
+                return NULL;
+        }
+    }
+    return NULL;
+}
+
+// Reglas de HTML5 para omitir la etiqueta de cierre de node cuando le sigue
+// next (NULL = no hay más contenido en el padre). Sólo se aplican las reglas
+// que no dependen de comentarios ni de espacios, que el modo minificado ya
+// ha eliminado.
+static inline int can_omit_end_tag(ASTNode* node, ASTNode* next) {
+    const PugTagInfo* info = node_tag_info(node);
+    const PugTagInfo* next_info = (next && next->node_type == TOKEN_TAG) ? node_tag_info(next) : NULL;
+    PugTagRule next_rule = next_info ? next_info->rule : PUG_TAG_OTHER;
+    int at_end = (next == NULL);
+
+    if (!info) return 0;
+    switch (info->rule) {
+        case PUG_TAG_LI:
+            return at_end || next_rule == PUG_TAG_LI;
+        case PUG_TAG_DT:
+            return next_rule == PUG_TAG_DT || next_rule == PUG_TAG_DD;
+        case PUG_TAG_DD:
+            return at_end || next_rule == PUG_TAG_DT || next_rule == PUG_TAG_DD;
+        case PUG_TAG_RT:
+        case PUG_TAG_RP:
+            return at_end || next_rule == PUG_TAG_RT || next_rule == PUG_TAG_RP;
+        case PUG_TAG_OPTION:
+            return at_end || next_rule == PUG_TAG_OPTION || next_rule == PUG_TAG_OPTGROUP;
+        case PUG_TAG_OPTGROUP:
+            return at_end || next_rule == PUG_TAG_OPTGROUP;
+        case PUG_TAG_THEAD:
+            return next_rule == PUG_TAG_TBODY || next_rule == PUG_TAG_TFOOT;
+        case PUG_TAG_TBODY:
+            return at_end || next_rule == PUG_TAG_TBODY || next_rule == PUG_TAG_TFOOT;
+        case PUG_TAG_TFOOT:
+            return at_end;
+        case PUG_TAG_TR:
+            return at_end || next_rule == PUG_TAG_TR;
+        case PUG_TAG_TD:
+        case PUG_TAG_TH:
+            return at_end || next_rule == PUG_TAG_TD || next_rule == PUG_TAG_TH;
+        case PUG_TAG_HTML:
+        case PUG_TAG_BODY:
+            return at_end;
+        case PUG_TAG_HEAD:
+            return next_info != NULL;
+        case PUG_TAG_P: {
+            if (next_info) return (next_info->flags & PUG_TAG_CLOSES_P) != 0;
+            if (!at_end) return 0;
+            const PugTagInfo* parent_info = rendered_parent_info(node);
+            return parent_info && !(parent_info->flags & PUG_TAG_TRANSPARENT);
+        }
+        default:
+            return 0;
+    }
+}
+
+static inline void render_node(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify);
+static inline unsigned int render_branch(PugSink* output, ASTNode* parent, unsigned int index,
+                                         unsigned int use_tabs, unsigned int tab_size, int minify);
+
+// Renderiza los hijos [from, to) de un nodo
+static inline void render_children(PugSink* output, ASTNode* node, unsigned int from, unsigned int to,
+                                   unsigned int use_tabs, unsigned int tab_size, int minify) {
+    // En nodos transparentes (raíz, cache) el último hijo va seguido de lo que
+    // siga al propio nodo
+    ASTNode* after = (node->node_type == TOKEN_TAG && g_strcmp0(node->tag, "root") != 0) ? NULL : output->next_sibling;
+    unsigned int i = from;
+    while (i < to) {
+        if (output->splice) {
+            unsigned int next = output->splice(output, node, i);
+            if (next != i) {
+                i = next;
+                continue;
+            }
+        }
+        ASTNode* child = node->children[i];
+        // if/unless/each con sus else: se renderiza una rama y se salta al final de la cadena
+        int chain = child->branch && child->node_type != TOKEN_CASE;
+        unsigned int end = chain ? child->branch->end : i + 1;
+        if (end > node->children_count) end = node->children_count;
+        if (minify == PUG_MINIFY_FULL) {
+            output->next_sibling = next_rendered_sibling(node, end - 1);
+            if (!output->next_sibling) output->next_sibling = after;
+        }
+        if (chain) {
+            i = render_branch(output, node, i, use_tabs, tab_size, minify);
+            continue;
+        }
+        render_node(output, child, use_tabs, tab_size, minify);
+        i++;
+    }
+}
+
+static inline void sink_emit_fragment(gpointer target, const char* data, gsize len) {
+    sink_append_len((PugSink*)target, data, len);
+}
+
+// Añade a la clave de un fragmento el valor de una dependencia: tipo y
+// longitud delante de cada valor y, en arrays y objetos, de cada elemento y
+// cada nombre de propiedad, de modo que dos valores distintos nunca dan la
+// misma clave (el texto que se muestra no sirve: todos los objetos se ven
+// como "[object Object]"). Devuelve 0 si no puede formar parte de la clave
+// (la clave es una cadena C: un byte nulo la cortaría).
+static inline int render_fragment_key_value(GString* key, const PugValue* value) {
+    PugValueType type = value ? value->type : PUG_VALUE_NULL;
+    g_string_append_printf(key, "\x1e%d", (int)type);
+    if (type == PUG_VALUE_ARRAY) {
+        g_string_append_printf(key, "[%" G_GSIZE_FORMAT, value->as.array.count);
+        for (gsize i = 0; i < value->as.array.count; i++) {
+            if (!render_fragment_key_value(key, &value->as.array.items[i])) return 0;
+        }
+        g_string_append_c(key, ']');
+        return 1;
+    }
+    if (type == PUG_VALUE_OBJECT) {
+        g_string_append_printf(key, "{%" G_GSIZE_FORMAT, value->as.object.count);
+        for (gsize i = 0; i < value->as.object.count; i++) {
+            const char* name = value->as.object.keys[i];
+            g_string_append_printf(key, "\x1e%" G_GSIZE_FORMAT ":%s", strlen(name), name);
+            if (!render_fragment_key_value(key, &value->as.object.values[i])) return 0;
+        }
+        g_string_append_c(key, '}');
+        return 1;
+    }
+    char buf[PUG_NUMBER_BUF_SIZE];
+    gsize len = 0;
+    const char* text = pug_value_to_text(value, buf, &len);
+    if (memchr(text, '\0', len)) return 0;
+    g_string_append_printf(key, ":%" G_GSIZE_FORMAT ":", len);
+    g_string_append_len(key, text, (gssize)len);
+    return 1;
+}
+
+// Renderiza un bloque `cache`: sus hijos se emiten a la profundidad del propio
+// bloque y, si hay caché de fragmentos, se copian de ella cuando la clave ya
+// está guardada. En modo medición un acierto sólo suma la longitud guardada.
+static inline void render_fragment(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    output->depth_offset--;
+
+    if (!output->fragments) {
+        render_children(output, node, 0, node->children_count, use_tabs, tab_size, minify);
+        output->depth_offset++;
+        return;
+    }
+
+    char* key = fragment_build_key(node, output->scope, output->depth_offset, use_tabs, tab_size, minify,
+                                   output->preserve_ws, minify == PUG_MINIFY_FULL ? output->next_sibling : NULL,
+                                   node->text ? NULL : output->vary, output->vary_data);
+    // Sin dependencias conocidas no hay clave correcta: se renderiza sin caché
+    int cacheable = node->cache_deps != PUG_CACHE_DEPS_UNKNOWN;
+    if (cacheable && node->text) {
+        // Dependencias resueltas a slots: el valor sale del frame
+        GString* full = g_string_new(key);
+        for (unsigned int i = 0; cacheable && i < node->text->count; i++) {
+            if (node->text->segments[i].type == SEGMENT_LITERAL) continue;
+            cacheable = render_fragment_key_value(full, sink_local(output, node->text->segments[i].slot));
+        }
+        g_free(key);
+        key = g_string_free(full, FALSE);
+    }
+    if (!cacheable) {
+        render_children(output, node, 0, node->children_count, use_tabs, tab_size, minify);
+    } else if (!pug_fragment_cache_fetch(output->fragments, key, sink_emit_fragment, output)) {
+        // Renderizar en un buffer aparte para poder guardar los bytes
+        GString* fragment = g_string_new("");
+        PugSink sub = *output;
+        sub.gstr = fragment;
+        sub.buf = NULL;
+        sub.cap = 0;
+        sub.len = 0;
+        render_children(&sub, node, 0, node->children_count, use_tabs, tab_size, minify);
+        pug_fragment_cache_store(output->fragments, key, fragment->str, fragment->len);
+        sink_append_len(output, fragment->str, fragment->len);
+        g_string_free(fragment, TRUE);
+    }
+    g_free(key);
+    output->depth_offset++;
+}
+
+// Escribe la apertura de una etiqueta sin el '>' final: <tag id class attrs
+static inline void render_open_tag(PugSink* output, ASTNode* node, int minify) {
+    if (node->open_tag && minify >= 0 && minify <= PUG_MINIFY_FULL) {
+        sink_append_len(output, node->open_tag->html[minify], node->open_tag->len[minify]);
+        return;
+    }
+
+    sink_append_c(output, '<');
+    sink_append(output, node->tag ? node->tag : "div");
+
+    // Renderizar ID
+    if (node->id) {
+        sink_append(output, " id");
+        render_attribute_value(output, node->id, 1, minify);
+    }
+
+    // Renderizar clases
+    render_classes(output, node->classes, node->class_count, minify);
+
+    // Renderizar atributos
+    render_attributes(output, node->attributes, minify);
+}
+
+// Precalcula la apertura de una etiqueta cuyos atributos no dependen de las
+// locales. En bucles cada fila copia así un único bloque de bytes en lugar
+// de recomponer tag, id, clases y atributos.
+static inline void render_prepare_static_tag(ASTNode* node) {
+    if (!node || node->node_type != TOKEN_TAG || node->open_tag) return;
+    if (node->attributes) {
+        for (unsigned int i = 0; i < node->attributes->count; i++) {
+            Attribute* attr = node->attributes->attributes[i];
+            if (attr && attr->expr) return;
+        }
+    }
+    PugStaticTag* tag = g_new0(PugStaticTag, 1);
+    for (int mode = PUG_MINIFY_NONE; mode <= PUG_MINIFY_FULL; mode++) {
+        GString* html = g_string_new("");
+        PugSink sink = { .gstr = html };
+        render_open_tag(&sink, node, mode);
+        tag->len[mode] = (unsigned int)html->len;
+        tag->html[mode] = g_string_free(html, FALSE);
+    }
+    node->open_tag = tag;
+    if (is_void_tag(node->tag)) node->is_void = 1;
+}
+
+// Primer hijo que produce salida minificada
+static inline ASTNode* first_rendered_child(ASTNode* node) {
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        if (node_renders_when_minified(node->children[i])) return node->children[i];
+    }
+    return NULL;
+}
+
+// Asigna las variables de la iteración index de un bucle
+static inline void render_each_bind(PugSink* output, PugLoop* loop, const PugValue* collection, gsize index) {
+    if (collection->type == PUG_VALUE_ARRAY) {
+        output->frame[loop->value_slot] = collection->as.array.items[index];
+        if (loop->has_key) output->frame[loop->key_slot] = pug_value_number((double)index);
+    } else {
+        output->frame[loop->value_slot] = collection->as.object.values[index];
+        if (loop->has_key) output->frame[loop->key_slot] = pug_value_string(collection->as.object.keys[index]);
+    }
+}
+
+// Renderiza un bucle `each`: el cuerpo se emite a la profundidad del propio
+// bucle una vez por elemento. Las variables del bucle se escriben en su slot
+// del frame (sin reservar nada por iteración) y recuperan su valor al salir.
+// Devuelve el número de iteraciones.
+static inline gsize render_each(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    PugLoop* loop = node->loop;
+    PugValue collection = sink_eval(output, node->expr);
+    gsize count = 0;
+
+    if (collection.type == PUG_VALUE_ARRAY) count = collection.as.array.count;
+    else if (collection.type == PUG_VALUE_OBJECT) count = collection.as.object.count;
+    if (count == 0 || !output->frame) return 0;
+
+    PugValue saved_value = output->frame[loop->value_slot];
+    PugValue saved_key = output->frame[loop->key_slot];
+    ASTNode* after = output->next_sibling;
+    ASTNode* first = minify == PUG_MINIFY_FULL ? first_rendered_child(node) : NULL;
+
+    output->depth_offset--;
+    for (gsize i = 0; i < count; i++) {
+        render_each_bind(output, loop, &collection, i);
+        // Tras el último hijo de una fila viene la primera etiqueta de la siguiente
+        output->next_sibling = (i + 1 < count && first) ? first : after;
+        render_children(output, node, 0, node->children_count, use_tabs, tab_size, minify);
+    }
+    output->depth_offset++;
+
+    output->frame[loop->value_slot] = saved_value;
+    if (loop->has_key) output->frame[loop->key_slot] = saved_key;
+    output->next_sibling = after;
+    return count;
+}
+
+// Cuerpo de una rama (if, else, when...): sin etiqueta propia, sus hijos se
+// emiten levels niveles más arriba
+static inline void render_branch_body(PugSink* output, ASTNode* node, int levels,
+                                      unsigned int use_tabs, unsigned int tab_size, int minify) {
+    output->depth_offset -= levels;
+    render_children(output, node, 0, node->children_count, use_tabs, tab_size, minify);
+    output->depth_offset += levels;
+}
+
+// Condición de un if / unless / else if (un else sin condición siempre se cumple)
+static inline int render_branch_taken(PugSink* output, ASTNode* node) {
+    if (!node->expr) return node->node_type == TOKEN_ELSE;
+    PugValue value = sink_eval(output, node->expr);
+    int taken = pug_value_truthy(&value) ? 1 : 0;
+    return node->node_type == TOKEN_UNLESS ? !taken : taken;
+}
+
+// Renderiza la cadena que empieza en parent->children[index] (if/unless o
+// each seguidos de sus else) y devuelve el índice del primer hermano tras
+// ella. Cada eslabón es un salto condicional: la primera condición que se
+// cumple renderiza su cuerpo y salta al final sin evaluar el resto.
+static inline unsigned int render_branch(PugSink* output, ASTNode* parent, unsigned int index,
+                                         unsigned int use_tabs, unsigned int tab_size, int minify) {
+    ASTNode* head = parent->children[index];
+    unsigned int end = head->branch ? head->branch->end : index + 1;
+    if (end > parent->children_count) end = parent->children_count;
+
+    if (head->node_type == TOKEN_EACH) {
+        // each ... else: la rama else sólo si la colección está vacía
+        gsize count = head->loop ? render_each(output, head, use_tabs, tab_size, minify) : 0;
+        if (count == 0 && index + 1 < end) {
+            render_branch_body(output, parent->children[index + 1], 1, use_tabs, tab_size, minify);
+        }
+        return end;
+    }
+
+    for (unsigned int k = index; k < end; k++) {
+        ASTNode* link = parent->children[k];
+        if (render_branch_taken(output, link)) {
+            render_branch_body(output, link, 1, use_tabs, tab_size, minify);
+            break;
+        }
+    }
+    return end;
+}
+
+// Renderiza un `case`. Con tabla de saltos el valor se busca por hash; si no,
+// se compara en cascada con cada when (===). Un when sin cuerpo cae en el
+// siguiente que lo tenga.
+static inline void render_case(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    PugBranch* branch = node->branch;
+    PugValue subject = sink_eval(output, node->expr);
+    unsigned int hit = 0;
+
+    if (branch->table) {
+        hit = GPOINTER_TO_UINT(g_hash_table_lookup(branch->table, &subject));
+    } else {
+        for (unsigned int i = 0; i < node->children_count && !hit; i++) {
+            ASTNode* when = node->children[i];
+            if (when->node_type != TOKEN_WHEN || !when->expr) continue;
+            PugValue value = sink_eval(output, when->expr);
+            if (pug_expr_strict_equals(&subject, &value)) hit = i + 1;
+        }
+    }
+    if (!hit) hit = branch->fallback;
+    if (!hit) return;
+
+    unsigned int target = branch->targets[hit - 1];
+    if (target < node->children_count) {
+        // Dos niveles transparentes: el propio case y el when
+        render_branch_body(output, node->children[target], 2, use_tabs, tab_size, minify);
+    }
+}
+
+// Renderiza una llamada a mixin: los argumentos se evalúan en el ámbito de
+// quien llama y se escriben en los slots de los parámetros (recuperando su
+// valor al salir); el cuerpo es el de la definición, sin copiarlo, emitido a
+// la profundidad de la llamada.
+static inline void render_call_body(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    PugCall* call = node->call;
+    PugMixin* mixin = call->mixin;
+    unsigned int level = output->mixin_frame ? output->mixin_frame->level + 1 : 0;
+    if (level >= PUG_MIXIN_MAX_DEPTH) return;
+
+    unsigned int n = mixin->n_params;
+    PugValue stack_args[PUG_MIXIN_STACK_ARGS], stack_saved[PUG_MIXIN_STACK_ARGS];
+    PugValue* args = n <= PUG_MIXIN_STACK_ARGS ? stack_args : g_new(PugValue, n);
+    PugValue* saved = n <= PUG_MIXIN_STACK_ARGS ? stack_saved : g_new(PugValue, n);
+
+    // Argumentos, ...resto y atributos, aún con las locales de quien llama
+    for (unsigned int i = 0; i < n; i++) {
+        args[i] = i < call->n_args ? sink_eval(output, call->args[i]) : pug_value_null();
+    }
+    PugValue rest = pug_value_null();
+    if (mixin->rest_slot >= 0) {
+        gsize extra = call->n_args > n ? call->n_args - n : 0;
+        PugValue* items = pug_arena_alloc_values(output->arena, extra);
+        for (gsize i = 0; i < extra; i++) items[i] = sink_eval(output, call->args[n + i]);
+        rest = pug_value_array(items, extra);
+    }
+    PugValue* attr_values = pug_arena_alloc_values(output->arena, call->n_attrs);
+    for (unsigned int i = 0; i < call->n_attrs; i++) attr_values[i] = sink_eval(output, call->attr_values[i]);
+    PugValue attributes = pug_value_object((const char* const*)call->attr_names, attr_values, call->n_attrs);
+
+    // Enlazar: los valores por defecto ya ven los parámetros anteriores
+    for (unsigned int i = 0; i < n; i++) {
+        saved[i] = output->frame[mixin->param_slots[i]];
+        PugValue value = args[i];
+        if (value.type == PUG_VALUE_NULL && mixin->defaults[i]) value = sink_eval(output, mixin->defaults[i]);
+        output->frame[mixin->param_slots[i]] = value;
+    }
+    PugValue saved_rest = mixin->rest_slot >= 0 ? output->frame[mixin->rest_slot] : pug_value_null();
+    if (mixin->rest_slot >= 0) output->frame[mixin->rest_slot] = rest;
+    PugValue saved_attributes = output->frame[mixin->attributes_slot];
+    output->frame[mixin->attributes_slot] = attributes;
+
+    PugMixinFrame frame = { node, level, output->mixin_frame };
+    int depth_offset = output->depth_offset;
+    output->mixin_frame = &frame;
+    output->depth_offset += (int)node->depth - (int)mixin->node->depth - 1;
+    render_children(output, mixin->node, 0, mixin->node->children_count, use_tabs, tab_size, minify);
+    output->depth_offset = depth_offset;
+    output->mixin_frame = frame.parent;
+
+    // Recuperar en orden inverso (un parámetro puede repetir slot)
+    output->frame[mixin->attributes_slot] = saved_attributes;
+    if (mixin->rest_slot >= 0) output->frame[mixin->rest_slot] = saved_rest;
+    for (unsigned int i = n; i-- > 0;) output->frame[mixin->param_slots[i]] = saved[i];
+    if (args != stack_args) g_free(args);
+    if (saved != stack_saved) g_free(saved);
+}
+
+// Renderiza la llamada en un buffer aparte para guardar sus bytes
+static inline GString* render_call_capture(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    GString* html = g_string_new("");
+    PugSink sub = *output;
+    sub.gstr = html;
+    sub.buf = NULL;
+    sub.cap = 0;
+    sub.len = 0;
+    render_call_body(&sub, node, use_tabs, tab_size, minify);
+    return html;
+}
+
+// Llamada constante: la primera vez en cada contexto de salida se renderiza
+// y se publica (sin cerrojos: la lista sólo crece); después es una copia de
+// bytes. Las variantes repetidas por una carrera entre hilos son iguales.
+// Con la plantilla sellada sólo se usan las variantes que ya hay.
+static inline void render_call_constant(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    PugCall* call = node->call;
+    ASTNode* next = minify == PUG_MINIFY_FULL ? output->next_sibling : NULL;
+    PugCallVariant* head = (PugCallVariant*)g_atomic_pointer_get(&call->variants);
+    for (PugCallVariant* v = head; v; v = v->next) {
+        if (v->minify == minify && v->use_tabs == use_tabs && v->tab_size == tab_size &&
+            v->depth_offset == output->depth_offset && v->preserve_ws == output->preserve_ws &&
+            v->next_sibling == next) {
+            sink_append_len(output, v->html, v->len);
+            return;
+        }
+    }
+    if (output->sealed) {
+        render_call_body(output, node, use_tabs, tab_size, minify);
+        return;
+    }
+
+    GString* html = render_call_capture(output, node, use_tabs, tab_size, minify);
+    sink_append_len(output, html->str, html->len);
+    if (g_atomic_int_add(&call->n_variants, 1) >= PUG_CALL_MAX_VARIANTS) {
+        g_string_free(html, TRUE);
+        return;
+    }
+    PugCallVariant* variant = g_new0(PugCallVariant, 1);
+    variant->minify = minify;
+    variant->use_tabs = use_tabs;
+    variant->tab_size = tab_size;
+    variant->depth_offset = output->depth_offset;
+    variant->preserve_ws = output->preserve_ws;
+    variant->next_sibling = next;
+    variant->len = html->len;
+    variant->html = g_string_free(html, FALSE);
+    do {
+        variant->next = (PugCallVariant*)g_atomic_pointer_get(&call->variants);
+    } while (!g_atomic_pointer_compare_and_exchange(&call->variants, variant->next, variant));
+}
+
+// Añade a la clave de memo un valor escalar; 0 si no lo es (arrays y
+// objetos no se comparan por contenido)
+static inline int render_memo_key_value(GString* key, const PugValue* value) {
+    if (value->type >= PUG_VALUE_ARRAY) return 0;
+    g_string_append_c(key, '\x1e');
+    g_string_append_c(key, (char)('0' + value->type));
+    if (value->type == PUG_VALUE_STRING) {
+        // Con la longitud delante ningún contenido se confunde con un separador
+        if (memchr(value->as.string.str, '\0', value->as.string.len)) return 0;
+        g_string_append_printf(key, "%" G_GSIZE_FORMAT ":", value->as.string.len);
+    }
+    pug_value_append(key, value);
+    return 1;
+}
+
+// Llamada a un mixin puro con memo activo: la salida se guarda con una clave
+// formada por el mixin, el contexto de salida y el valor de los argumentos
+static inline void render_call_memo(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    PugCall* call = node->call;
+    GString* key = g_string_sized_new(64);
+    g_string_append_printf(key, "%p\x1f%d:%u:%u:%d:%u:%p", (void*)call->mixin, minify, use_tabs, tab_size,
+                           (int)node->depth + output->depth_offset, output->preserve_ws,
+                           minify == PUG_MINIFY_FULL ? (void*)output->next_sibling : NULL);
+    int ok = 1;
+    for (unsigned int i = 0; ok && i < call->n_args; i++) {
+        PugValue value = sink_eval(output, call->args[i]);
+        ok = render_memo_key_value(key, &value);
+    }
+    g_string_append_c(key, '\x1f');
+    for (unsigned int i = 0; ok && i < call->n_attrs; i++) {
+        PugValue value = sink_eval(output, call->attr_values[i]);
+        g_string_append_c(key, '\x1e');
+        g_string_append(key, call->attr_names[i]);
+        ok = render_memo_key_value(key, &value);
+    }
+
+    if (!ok) {
+        render_call_body(output, node, use_tabs, tab_size, minify);
+    } else if (!pug_fragment_cache_fetch(output->memo, key->str, sink_emit_fragment, output)) {
+        GString* html = render_call_capture(output, node, use_tabs, tab_size, minify);
+        pug_fragment_cache_store(output->memo, key->str, html->str, html->len);
+        sink_append_len(output, html->str, html->len);
+        g_string_free(html, TRUE);
+    }
+    g_string_free(key, TRUE);
+}
+
+static inline void render_call(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    PugCall* call = node->call;
+    if (!call->mixin) return;
+    if (!output->frame || !output->arena) {
+        // Todas las entradas de render dan frame a los árboles compilados
+        g_print("Error: llamada a '%s' sin frame de render (línea %u)\n", call->name, node->line);
+        return;
+    }
+    if (call->constant) {
+        render_call_constant(output, node, use_tabs, tab_size, minify);
+    } else if (output->memo && call->mixin->pure && node->children_count == 0) {
+        render_call_memo(output, node, use_tabs, tab_size, minify);
+    } else {
+        render_call_body(output, node, use_tabs, tab_size, minify);
+    }
+}
+
+// `block` dentro de un mixin: el contenido indentado bajo la llamada
+static inline void render_mixin_block(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    PugMixinFrame* frame = output->mixin_frame;
+    if (!frame || frame->call->children_count == 0) return;
+
+    int depth_offset = output->depth_offset;
+    output->mixin_frame = frame->parent;
+    output->depth_offset += (int)node->depth - (int)frame->call->depth - 1;
+    render_children(output, frame->call, 0, frame->call->children_count, use_tabs, tab_size, minify);
+    output->depth_offset = depth_offset;
+    output->mixin_frame = frame;
+}
+
+// Renderiza una plantilla incluida en el sitio del include: su nivel
+// superior queda a la profundidad del nodo y sus bloques `cache` usan su
+// propio ámbito
+static inline void render_include(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    ASTNode* root = node->include->root;
+    const char* scope = output->scope;
+    output->scope = node->include->name;
+    output->depth_offset += (int)node->depth;
+    render_children(output, root, 0, root->children_count, use_tabs, tab_size, minify);
+    output->depth_offset -= (int)node->depth;
+    output->scope = scope;
+}
+
+// Partes que emite el bloque node en el render en curso (0 = las suyas)
+static inline unsigned int render_block_parts(const PugSink* output, ASTNode* node, const PugBlockPart** parts) {
+    const PugBlockTable* table = output->blocks;
+    if (!table || !node->block) return 0;
+    unsigned int slot = node->block->slot;
+    // Los bloques de una plantilla incluida se numeran en la suya: se buscan
+    // por nombre
+    if (slot >= table->n_slots || strcmp(table->names[slot], node->block->name) != 0) {
+        for (slot = 0; slot < table->n_slots; slot++) {
+            if (strcmp(table->names[slot], node->block->name) == 0) break;
+        }
+        if (slot == table->n_slots) return 0;
+    }
+    *parts = table->parts + table->first[slot];
+    return table->first[slot + 1] - table->first[slot];
+}
+
+// Renderiza un `block` con nombre. Sin sobrescribir emite sus hijos; si no,
+// cada parte a la profundidad del bloque y con el ámbito de su plantilla.
+static inline void render_named_block(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+    const PugBlockPart* parts = NULL;
+    unsigned int n = render_block_parts(output, node, &parts);
+    if (n == 0) {
+        render_branch_body(output, node, 1, use_tabs, tab_size, minify);
+        return;
+    }
+
+    const char* scope = output->scope;
+    ASTNode* after = output->next_sibling;
+    for (unsigned int i = 0; i < n; i++) {
+        ASTNode* part = parts[i].node;
+        // El último hijo de una parte va seguido del primero de la siguiente
+        if (minify == PUG_MINIFY_FULL) {
+            output->next_sibling = after;
+            for (unsigned int j = i + 1; j < n; j++) {
+                ASTNode* first = parts[j].node->children_count ? parts[j].node->children[0] : NULL;
+                if (first && !node_renders_when_minified(first)) first = next_rendered_sibling(parts[j].node, 0);
+                if (first) {
+                    output->next_sibling = first;
+                    break;
+                }
+            }
+        }
+        int shift = (int)node->depth - (int)part->depth;
+        output->scope = output->blocks->scopes[parts[i].level];
+        output->depth_offset += shift;
+        render_branch_body(output, part, 1, use_tabs, tab_size, minify);
+        output->depth_offset -= shift;
+    }
+    output->scope = scope;
+    output->next_sibling = after;
 }
 
 // Renderiza un nodo AST recursivamente
-static inline void render_node(GString* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
+static inline void render_node(PugSink* output, ASTNode* node, unsigned int use_tabs, unsigned int tab_size, int minify) {
     if (!node || !output) return;
 
+    // Hermano siguiente fijado por el padre (sólo se usa en PUG_MINIFY_FULL)
+    ASTNode* next_sibling = output->next_sibling;
+
     // Ignorar nodos raíz artificiales
     if (node->tag && g_strcmp0(node->tag, "root") == 0) {
-        for (unsigned int i = 0; i < node->children_count; i++) {
-            render_node(output, node->children[i], use_tabs, tab_size, minify);
-        }
+        render_children(output, node, 0, node->children_count, use_tabs, tab_size, minify);
+        return;
+    }
+
+    // Los bloques `cache` no generan etiqueta propia
+    if (node->node_type == TOKEN_CACHE) {
+        render_fragment(output, node, use_tabs, tab_size, minify);
+        return;
+    }
+
+    // Los bucles tampoco generan etiqueta propia
+    if (node->node_type == TOKEN_EACH && node->loop) {
+        render_each(output, node, use_tabs, tab_size, minify);
+        return;
+    }
+
+    if (node->node_type == TOKEN_INCLUDE && node->include) {
+        render_include(output, node, use_tabs, tab_size, minify);
+        return;
+    }
+
+    // Mixins compilados: la definición no escribe nada y la llamada emite su cuerpo
+    if (node->node_type == TOKEN_MIXIN && node->mixin) return;
+    if (node->node_type == TOKEN_CALL && node->call) {
+        render_call(output, node, use_tabs, tab_size, minify);
+        return;
+    }
+
+    // `block` sin nombre es el contenido de la llamada al mixin en curso; con
+    // nombre, sus hijos (o las partes de la plantilla hija) a la profundidad
+    // del bloque
+    if (node->node_type == TOKEN_BLOCK) {
+        if (node->text_content && *node->text_content) render_named_block(output, node, use_tabs, tab_size, minify);
+        else render_mixin_block(output, node, use_tabs, tab_size, minify);
+        return;
+    }
+
+    // Condicionales compilados. Un if suelto (sin pasar por render_children)
+    // no ve sus else: sólo se evalúa su propia condición.
+    if (node->node_type == TOKEN_CASE && node->branch) {
+        render_case(output, node, use_tabs, tab_size, minify);
+        return;
+    }
+    if ((node->node_type == TOKEN_IF || node->node_type == TOKEN_UNLESS) && node->branch) {
+        if (render_branch_taken(output, node)) render_branch_body(output, node, 1, use_tabs, tab_size, minify);
+        return;
+    }
+
+    // Código compilado: se ejecuta y no escribe nada
+    if (node->node_type == TOKEN_CODE && node->expr) {
+        sink_eval(output, node->expr);
         return;
     }
 
     // Añadir indentación solo si NO está minificado
     if (!minify) {
-        append_indent(output, node->depth, use_tabs, tab_size);
+        sink_append_indent(output, node->depth, use_tabs, tab_size);
     }
 
     // Manejar nodos según su tipo
     switch (node->node_type) {
         case TOKEN_DOCTYPE:
-            g_string_append_printf(output, "<!DOCTYPE %s>", node->text_content ? node->text_content : "html");
-            if (!minify) g_string_append_c(output, '\n');
+            sink_append(output, "<!DOCTYPE ");
+            sink_append(output, node->text_content ? node->text_content : "html");
+            sink_append_c(output, '>');
+            if (!minify) sink_append_c(output, '\n');
             break;
 
         case TOKEN_TEXT:
         case TOKEN_PIPE:
         case TOKEN_DOT:
             if (node->text_content) {
-                char* escaped_text = escape_html(node->text_content);
-                g_string_append(output, escaped_text);
-                g_free(escaped_text);
+                render_text(output, node, minify);
             }
-            if (!minify) g_string_append_c(output, '\n');
+            if (!minify) sink_append_c(output, '\n');
             break;
 
         case TOKEN_INTERPOLATION:
-            if (node->text_content) {
-                g_string_append_printf(output, "#{ %s }", node->text_content);
+            if (node->text) {
+                render_text(output, node, minify);
+            } else if (node->text_content) {
+                sink_append(output, "#{ ");
+                sink_append(output, node->text_content);
+                sink_append(output, " }");
             }
-            if (!minify) g_string_append_c(output, '\n');
+            if (!minify) sink_append_c(output, '\n');
             break;
 
         case TOKEN_COMMENT:
             // Los comentarios solo se renderizan si NO está minificado
             if (minify == 0) {
-                g_string_append(output, "<!-- ");
+                sink_append(output, "<!-- ");
                 if (node->text_content) {
-                    char* escaped_comment = escape_html(node->text_content);
-                    g_string_append(output, escaped_comment);
-                    g_free(escaped_comment);
+                    sink_append_escaped(output, node->text_content);
                 }
-                g_string_append(output, " -->\n");
+                sink_append(output, " -->\n");
             }
             break;
 
@@ -148,80 +1350,80 @@ static inline void render_node(GString* output, ASTNode* node, unsigned int use_
             break;
 
         case TOKEN_CODE:
+        case TOKEN_EACH:
+        case TOKEN_IF:
+        case TOKEN_UNLESS:
+        case TOKEN_ELSE:
+        case TOKEN_CASE:
+        case TOKEN_WHEN:
+        case TOKEN_DEFAULT:
         case TOKEN_INCLUDE:
         case TOKEN_EXTENDS:
         case TOKEN_MIXIN:
         case TOKEN_CALL:
             // Renderizar como comentario para debugging solo si NO está minificado
             if (minify == 0) {
-                g_string_append_printf(output, "<!-- %s: %s -->\n",
-                                      token_type_to_string(node->node_type),
-                                      node->text_content ? node->text_content : "");
+                sink_append(output, "<!-- ");
+                sink_append(output, token_type_to_string(node->node_type));
+                sink_append(output, ": ");
+                sink_append(output, node->text_content ? node->text_content : "");
+                sink_append(output, " -->\n");
             }
             break;
 
         case TOKEN_TAG:
             // Abrir tag
-            g_string_append_printf(output, "<%s", node->tag ? node->tag : "div");
+            render_open_tag(output, node, minify);
 
-            // Renderizar ID
-            if (node->id) {
-                char* escaped_id = escape_html(node->id);
-                g_string_append_printf(output, " id=\"%s\"", escaped_id);
-                g_free(escaped_id);
-            }
-
-            // Renderizar clases
-            render_classes(output, node->classes, node->class_count);
-
-            // Renderizar atributos
-            render_attributes(output, node->attributes);
-
-            // Cerrar tag de apertura
-            if (node->is_void || is_void_tag(node->tag)) {
-                g_string_append(output, " />");
-                if (!minify) g_string_append_c(output, '\n');
+            // Cerrar tag de apertura (sintaxis void de HTML5 al minificar). Con
+            // la apertura precalculada is_void ya viene resuelto.
+            const PugTagInfo* info = node_tag_info(node);
+            if (node->is_void || (!node->open_tag && info && (info->flags & PUG_TAG_VOID))) {
+                sink_append(output, minify == PUG_MINIFY_FULL ? ">" : " />");
+                if (!minify) sink_append_c(output, '\n');
                 return; // Tags void no tienen hijos ni cierre
             } else {
-                g_string_append_c(output, '>');
+                sink_append_c(output, '>');
             }
 
+            int preserve = (minify == PUG_MINIFY_FULL && info && (info->flags & PUG_TAG_PRESERVE));
+            if (preserve) output->preserve_ws++;
+
             // Renderizar contenido de texto inline
             if (node->text_content && node->is_inline) {
-                char* escaped_text = escape_html(node->text_content);
-                g_string_append(output, escaped_text);
-                g_free(escaped_text);
+                render_text(output, node, minify);
             } else if (node->text_content) {
                 // Texto en bloque
                 if (!minify) {
-                    g_string_append_c(output, '\n');
-                    append_indent(output, node->depth + 1, use_tabs, tab_size);
+                    sink_append_c(output, '\n');
+                    sink_append_indent(output, node->depth + 1, use_tabs, tab_size);
                 }
-                char* escaped_text = escape_html(node->text_content);
-                g_string_append(output, escaped_text);
-                g_free(escaped_text);
+                render_text(output, node, minify);
             }
 
             // Renderizar hijos
             if (node->children_count > 0) {
                 if (!minify && (!node->text_content || node->is_block)) {
-                    g_string_append_c(output, '\n');
-                }
-                for (unsigned int i = 0; i < node->children_count; i++) {
-                    render_node(output, node->children[i], use_tabs, tab_size, minify);
+                    sink_append_c(output, '\n');
                 }
+                render_children(output, node, 0, node->children_count, use_tabs, tab_size, minify);
                 // Añadir indentación para tag de cierre
                 if (!minify && !node->is_inline) {
-                    append_indent(output, node->depth, use_tabs, tab_size);
+                    sink_append_indent(output, node->depth, use_tabs, tab_size);
                 }
             } else if (!minify && node->text_content && node->is_block) {
-                g_string_append_c(output, '\n');
-                append_indent(output, node->depth, use_tabs, tab_size);
+                sink_append_c(output, '\n');
+                sink_append_indent(output, node->depth, use_tabs, tab_size);
             }
 
-            // Cerrar tag
-            g_string_append_printf(output, "</%s>", node->tag ? node->tag : "div");
-            if (!minify) g_string_append_c(output, '\n');
+            if (preserve) output->preserve_ws--;
+
+            // Cerrar tag (HTML5 permite omitir algunos cierres)
+            if (minify == PUG_MINIFY_FULL && can_omit_end_tag(node, next_sibling)) break;
+            sink_append(output, "</");
+            sink_append(output, node->tag ? node->tag : "div");
+            sink_append_c(output, '>');
+            if (!minify) sink_append_c(output, '\n');
             break;
 
         default:
@@ -230,6 +1432,138 @@ static inline void render_node(GString* output, ASTNode* node, unsigned int use_
     }
 }
 
+// ============================================================================
+// FRAME DE LOS RENDERS SIN LOCALES
+// ============================================================================
+// render_ast() y el resto de entradas que sólo reciben un árbol no enlazan
+// locales, pero en un árbol compilado los bucles, las líneas `- código` y
+// las llamadas a mixins escriben en el frame. Estas entradas renderizan con
+// un frame vacío de usar y tirar, del tamaño del mayor slot que usa el árbol
+// (siguiendo mixins e includes), y su propia arena.
+
+typedef struct {
+    PugValue* frame;
+    PugArena arena;
+} PugScratchFrame;
+
+static inline void render_slots_expr(const PugExpr* expr, unsigned int* size) {
+    if (!expr) return;
+    if (expr->slot >= 0 && (unsigned int)expr->slot + 1 > *size) *size = (unsigned int)expr->slot + 1;
+    for (unsigned int i = 0; i < expr->code_len; i++) {
+        PugInstr instr = expr->code[i];
+        if ((instr.op == PUG_OP_LOADL || instr.op == PUG_OP_STOREL) && PUG_INSTR_BX(instr) + 1 > *size) {
+            *size = PUG_INSTR_BX(instr) + 1;
+        }
+    }
+}
+
+static inline void render_slots_max(unsigned int slot, unsigned int* size) {
+    if (slot + 1 > *size) *size = slot + 1;
+}
+
+// Número de slots que usa el árbol. visited evita recorrer dos veces el
+// mismo include.
+static inline void render_slots_node(const ASTNode* node, unsigned int* size, GHashTable* visited) {
+    render_slots_expr(node->expr, size);
+    if (node->text) {
+        for (unsigned int i = 0; i < node->text->count; i++) {
+            const PugSegment* seg = &node->text->segments[i];
+            if (seg->type == SEGMENT_LITERAL) continue;
+            if (seg->expr) render_slots_expr(seg->expr, size);
+            else render_slots_max(seg->slot, size);
+        }
+    }
+    if (node->attributes) {
+        for (unsigned int i = 0; i < node->attributes->count; i++) {
+            if (node->attributes->attributes[i]) render_slots_expr(node->attributes->attributes[i]->expr, size);
+        }
+    }
+    if (node->loop) {
+        render_slots_max(node->loop->value_slot, size);
+        if (node->loop->has_key) render_slots_max(node->loop->key_slot, size);
+    }
+    if (node->mixin) {
+        const PugMixin* mixin = node->mixin;
+        for (unsigned int i = 0; i < mixin->n_params; i++) {
+            render_slots_max(mixin->param_slots[i], size);
+            render_slots_expr(mixin->defaults[i], size);
+        }
+        if (mixin->rest_slot >= 0) render_slots_max((unsigned int)mixin->rest_slot, size);
+        render_slots_max(mixin->attributes_slot, size);
+    }
+    if (node->call) {
+        for (unsigned int i = 0; i < node->call->n_args; i++) render_slots_expr(node->call->args[i], size);
+        for (unsigned int i = 0; i < node->call->n_attrs; i++) render_slots_expr(node->call->attr_values[i], size);
+        // Mixin de una plantilla incluida: su definición no está en este árbol
+        const ASTNode* body = node->call->mixin ? node->call->mixin->node : NULL;
+        if (body && !g_hash_table_contains(visited, body)) {
+            g_hash_table_add(visited, (gpointer)body);
+            render_slots_node(body, size, visited);
+        }
+    }
+    if (node->include && !g_hash_table_contains(visited, node->include->root)) {
+        g_hash_table_add(visited, node->include->root);
+        render_slots_node(node->include->root, size, visited);
+    }
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        render_slots_node(node->children[i], size, visited);
+    }
+}
+
+// Da a sink un frame vacío para root (sólo si el árbol usa slots)
+static inline void render_scratch_begin(PugSink* sink, const ASTNode* root, PugScratchFrame* scratch) {
+    unsigned int size = 0;
+    GHashTable* visited = g_hash_table_new(g_direct_hash, g_direct_equal);
+    render_slots_node(root, &size, visited);
+    g_hash_table_destroy(visited);
+
+    memset(scratch, 0, sizeof(*scratch));
+    if (size > 0) scratch->frame = g_new0(PugValue, size);
+    sink->frame = scratch->frame;
+    sink->frame_size = size;
+    sink->arena = &scratch->arena;
+}
+
+static inline void render_scratch_end(PugSink* sink, PugScratchFrame* scratch) {
+    pug_arena_clear(&scratch->arena);
+    g_free(scratch->frame);
+    sink->frame = NULL;
+    sink->frame_size = 0;
+    sink->arena = NULL;
+}
+
+// Renderiza añadiendo la salida a un GString existente (p. ej. uno del pool)
+static inline void render_ast_to(GString* output, ASTNode* root, unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!root || !output) return;
+    PugSink sink = { .gstr = output };
+    PugScratchFrame scratch;
+    render_scratch_begin(&sink, root, &scratch);
+    render_node(&sink, root, use_tabs, tab_size, minify);
+    render_scratch_end(&sink, &scratch);
+}
+
+// Renderiza usando una caché de fragmentos para los bloques `cache`. scope
+// identifica la plantilla y vary devuelve el valor actual de cada local de
+// la que dependen los bloques.
+static inline char* render_ast_cached(ASTNode* root, unsigned int use_tabs, unsigned int tab_size, unsigned int minify,
+                                      PugFragmentCache* fragments, const char* scope, PugVaryFunc vary, gpointer vary_data) {
+    if (!root) return NULL;
+    GString* output = g_string_new("");
+    if (!output) return NULL;
+
+    PugSink sink = { .gstr = output };
+    sink.fragments = fragments;
+    sink.scope = scope;
+    sink.vary = vary;
+    sink.vary_data = vary_data;
+    PugScratchFrame scratch;
+    render_scratch_begin(&sink, root, &scratch);
+    render_node(&sink, root, use_tabs, tab_size, minify);
+    render_scratch_end(&sink, &scratch);
+
+    return g_string_free(output, FALSE);
+}
+
 // Función principal de renderizado
 static inline char* render_ast(ASTNode* root, unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
     if (!root) return NULL;
@@ -237,13 +1571,65 @@ static inline char* render_ast(ASTNode* root, unsigned int use_tabs, unsigned in
     GString* output = g_string_new("");
     if (!output) return NULL;
 
-    render_node(output, root, use_tabs, tab_size , minify );
+    render_ast_to(output, root, use_tabs, tab_size , minify );
 
     char* result = g_string_free(output, FALSE);
     return result;
 }
 
+// ============================================================================
+// RENDERIZADO EN DOS PASADAS (tamaño exacto)
+// ============================================================================
 
+// Primera pasada: recorre el mismo árbol que render_ast() pero sólo suma la
+// longitud de la salida (incluida la expansión de escapes), sin escribir nada.
+// Sirve para conocer Content-Length antes de generar el cuerpo.
+//
+// Como render_ast(), trabaja sólo con el árbol: no hay locales enlazadas, así
+// que las interpolaciones de locales salen vacías. Para una plantilla
+// compilada con locales se usan pug_template_measure() y
+// pug_template_render_into().
+static inline gsize render_measure(ASTNode* root, unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!root) return 0;
+    PugSink sink = { .gstr = NULL };
+    PugScratchFrame scratch;
+    render_scratch_begin(&sink, root, &scratch);
+    render_node(&sink, root, use_tabs, tab_size, minify);
+    render_scratch_end(&sink, &scratch);
+    return sink.len;
+}
+
+// Segunda pasada: escribe la salida en buf, que debe tener len bytes
+// (normalmente el valor devuelto por render_measure). No añade '\0'.
+// Devuelve los bytes que ocupa la salida completa; si es mayor que len el
+// buffer se quedó corto y sólo se escribieron los primeros len bytes.
+static inline gsize render_into(ASTNode* root, char* buf, gsize len, unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!root || !buf) return 0;
+    PugSink sink = { .buf = buf, .cap = len };
+    PugScratchFrame scratch;
+    render_scratch_begin(&sink, root, &scratch);
+    render_node(&sink, root, use_tabs, tab_size, minify);
+    render_scratch_end(&sink, &scratch);
+    return sink.len;
+}
+
+// Renderiza con una única reserva de memoria del tamaño exacto (más el '\0').
+// Si out_len no es NULL recibe la longitud de la salida.
+static inline char* render_ast_exact(ASTNode* root, unsigned int use_tabs, unsigned int tab_size, unsigned int minify, gsize* out_len) {
+    if (!root) return NULL;
+
+    gsize len = render_measure(root, use_tabs, tab_size, minify);
+    char* result = (char*)g_malloc(len + 1);
+    if (!result) return NULL;
+
+    if (render_into(root, result, len, use_tabs, tab_size, minify) != len) {
+        g_free(result);
+        return NULL;
+    }
+    result[len] = '\0';
+    if (out_len) *out_len = len;
+    return result;
+}
 
 #ifdef __cplusplus
 }
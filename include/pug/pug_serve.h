@@ -0,0 +1,858 @@
+#ifndef PUG_SERVE_H
+#define PUG_SERVE_H
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#include "pug/pug_value.h"
+#include "pug/pug_template.h"
+#include "pug/pug_engine.h"
+#include "pug/pug_preload.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// SERVIDOR DE RENDER (socket Unix)
+// ============================================================================
+// Proceso de larga duración que renderiza plantillas para otros programas
+// sin que paguen arranque ni compilación en cada página. Las plantillas se
+// compilan una vez en el loader del motor y se quedan en memoria; cada
+// petición las lee del registro del motor, así que una recarga no frena a
+// las que están en curso ni a las que llegan mientras compila. Un hilo
+// espera con epoll a que haya peticiones en las conexiones y un pool de
+// hilos las atiende: cada conexión se arma en modo EPOLLONESHOT, así que
+// sólo un hilo la lee a la vez, y vuelve a armarse tras responder. Las
+// conexiones no bloquean: el hilo lee lo que haya llegado, responde a las
+// tramas completas y guarda el resto en el buffer de la conexión hasta el
+// siguiente aviso, así que un cliente que se para a mitad de una trama no
+// retiene ningún hilo. Con las respuestas pasa lo mismo: lo que el socket no
+// admite se guarda en la conexión, que se arma con EPOLLOUT y no lee más
+// peticiones hasta que el cliente lo haya recibido. El render usa el
+// PugRenderContext del hilo: las locales se decodifican en su arena, las
+// cadenas apuntan al buffer de la petición y la respuesta sale del buffer
+// del contexto sin copiarse (sólo se copia lo que no cabe en el socket).
+//
+// Protocolo (enteros little-endian; la longitud de cada trama cuenta los
+// bytes que la siguen):
+//
+//   petición:  u32 longitud | u16 n + ruta | local*
+//              local = u16 n + nombre | valor
+//              valor = u8 tipo (PugValueType) | datos
+//                      NULL: nada          BOOL: u8
+//                      NUMBER: f64         STRING: u32 n + bytes
+//                      ARRAY: u32 n + n valores
+//                      OBJECT: u32 n + n × (u16 n + clave | valor)
+//   respuesta: u32 longitud | u8 estado (PugServeStatus) | HTML o mensaje
+//
+// Las locales que la plantilla no usa se ignoran. Una conexión puede enviar
+// tantas peticiones como quiera, una detrás de otra.
+
+#define PUG_SERVE_MAX_REQUEST (16 * 1024 * 1024)
+#define PUG_SERVE_MAX_DEPTH 32          // Anidamiento máximo de arrays/objetos
+#define PUG_SERVE_BACKLOG 128
+#define PUG_SERVE_READ_CHUNK (64 * 1024)        // Bytes leídos por llamada como máximo
+#define PUG_SERVE_KEEP_BUFFER (64 * 1024)       // Más que esto no se retiene entre peticiones
+
+typedef enum {
+    PUG_SERVE_OK = 0,
+    PUG_SERVE_NOT_FOUND,                // La plantilla no existe o no compila
+    PUG_SERVE_BAD_REQUEST               // Trama mal formada
+} PugServeStatus;
+
+// ============================================================================
+// PROTOCOLO
+// ============================================================================
+
+static inline void serve_put_u8(GByteArray* out, guint8 v) {
+    g_byte_array_append(out, &v, 1);
+}
+
+static inline void serve_put_u16(GByteArray* out, guint16 v) {
+    v = GUINT16_TO_LE(v);
+    g_byte_array_append(out, (const guint8*)&v, 2);
+}
+
+static inline void serve_put_u32(GByteArray* out, guint32 v) {
+    v = GUINT32_TO_LE(v);
+    g_byte_array_append(out, (const guint8*)&v, 4);
+}
+
+static inline void serve_put_f64(GByteArray* out, double d) {
+    guint64 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    bits = GUINT64_TO_LE(bits);
+    g_byte_array_append(out, (const guint8*)&bits, 8);
+}
+
+static inline void serve_put_name(GByteArray* out, const char* name) {
+    gsize len = name ? strlen(name) : 0;
+    if (len > G_MAXUINT16) len = G_MAXUINT16;
+    serve_put_u16(out, (guint16)len);
+    g_byte_array_append(out, (const guint8*)name, (guint)len);
+}
+
+// Codifica value (con sus elementos) al final de out
+static inline void pug_serve_put_value(GByteArray* out, const PugValue* value) {
+    PugValueType type = value ? value->type : PUG_VALUE_NULL;
+    serve_put_u8(out, (guint8)type);
+    switch (type) {
+        case PUG_VALUE_BOOL:
+            serve_put_u8(out, value->as.boolean ? 1 : 0);
+            break;
+        case PUG_VALUE_NUMBER:
+            serve_put_f64(out, value->as.number);
+            break;
+        case PUG_VALUE_STRING:
+            serve_put_u32(out, (guint32)value->as.string.len);
+            g_byte_array_append(out, (const guint8*)value->as.string.str, (guint)value->as.string.len);
+            break;
+        case PUG_VALUE_ARRAY:
+            serve_put_u32(out, (guint32)value->as.array.count);
+            for (gsize i = 0; i < value->as.array.count; i++) {
+                pug_serve_put_value(out, &value->as.array.items[i]);
+            }
+            break;
+        case PUG_VALUE_OBJECT:
+            serve_put_u32(out, (guint32)value->as.object.count);
+            for (gsize i = 0; i < value->as.object.count; i++) {
+                serve_put_name(out, value->as.object.keys[i]);
+                pug_serve_put_value(out, &value->as.object.values[i]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Empieza en out (vaciado antes) una petición de la plantilla path
+static inline void pug_serve_request_begin(GByteArray* out, const char* path) {
+    g_byte_array_set_size(out, 0);
+    serve_put_u32(out, 0);
+    serve_put_name(out, path);
+}
+
+static inline void pug_serve_request_add(GByteArray* out, const char* name, const PugValue* value) {
+    serve_put_name(out, name);
+    pug_serve_put_value(out, value);
+}
+
+// Cierra la petición escribiendo su longitud
+static inline void pug_serve_request_end(GByteArray* out) {
+    guint32 len = GUINT32_TO_LE((guint32)(out->len - 4));
+    memcpy(out->data, &len, 4);
+}
+
+typedef struct {
+    const guint8* p;
+    const guint8* end;
+} PugServeReader;
+
+static inline gboolean serve_get(PugServeReader* reader, void* dst, gsize n) {
+    if ((gsize)(reader->end - reader->p) < n) return FALSE;
+    memcpy(dst, reader->p, n);
+    reader->p += n;
+    return TRUE;
+}
+
+// Nombre u16 copiado a la arena con su '\0' (NULL si la trama se corta)
+static inline const char* serve_get_name(PugServeReader* reader, PugArena* arena) {
+    guint16 len;
+    if (!serve_get(reader, &len, 2)) return NULL;
+    len = GUINT16_FROM_LE(len);
+    if ((gsize)(reader->end - reader->p) < len) return NULL;
+    char* name = pug_arena_alloc(arena, (gsize)len + 1);
+    memcpy(name, reader->p, len);
+    name[len] = '\0';
+    reader->p += len;
+    return name;
+}
+
+// Decodifica un valor. Las cadenas apuntan a la trama; arrays, objetos y
+// claves van a la arena.
+static inline gboolean serve_get_value(PugServeReader* reader, PugArena* arena, PugValue* value, int depth) {
+    guint8 type;
+    guint32 count;
+    *value = pug_value_null();
+    if (depth > PUG_SERVE_MAX_DEPTH || !serve_get(reader, &type, 1)) return FALSE;
+    switch (type) {
+        case PUG_VALUE_NULL:
+            return TRUE;
+        case PUG_VALUE_BOOL: {
+            guint8 b;
+            if (!serve_get(reader, &b, 1)) return FALSE;
+            *value = pug_value_bool(b != 0);
+            return TRUE;
+        }
+        case PUG_VALUE_NUMBER: {
+            guint64 bits;
+            double n;
+            if (!serve_get(reader, &bits, 8)) return FALSE;
+            bits = GUINT64_FROM_LE(bits);
+            memcpy(&n, &bits, sizeof(n));
+            *value = pug_value_number(n);
+            return TRUE;
+        }
+        case PUG_VALUE_STRING:
+            if (!serve_get(reader, &count, 4)) return FALSE;
+            count = GUINT32_FROM_LE(count);
+            if ((gsize)(reader->end - reader->p) < count) return FALSE;
+            *value = pug_value_string_len((const char*)reader->p, count);
+            reader->p += count;
+            return TRUE;
+        case PUG_VALUE_ARRAY: {
+            if (!serve_get(reader, &count, 4)) return FALSE;
+            count = GUINT32_FROM_LE(count);
+            // Cada elemento ocupa al menos un byte
+            if ((gsize)(reader->end - reader->p) < count) return FALSE;
+            PugValue* items = pug_arena_alloc_values(arena, count ? count : 1);
+            for (guint32 i = 0; i < count; i++) {
+                if (!serve_get_value(reader, arena, &items[i], depth + 1)) return FALSE;
+            }
+            *value = pug_value_array(items, count);
+            return TRUE;
+        }
+        case PUG_VALUE_OBJECT: {
+            if (!serve_get(reader, &count, 4)) return FALSE;
+            count = GUINT32_FROM_LE(count);
+            if ((gsize)(reader->end - reader->p) < (gsize)count * 3) return FALSE;
+            PugValue* values = pug_arena_alloc_values(arena, count ? count : 1);
+            // Las claves van en un bloque alineado como el de los valores
+            const char** keys = (const char**)pug_arena_alloc_values(arena, count * sizeof(char*) / sizeof(PugValue) + 1);
+            for (guint32 i = 0; i < count; i++) {
+                keys[i] = serve_get_name(reader, arena);
+                if (!keys[i] || !serve_get_value(reader, arena, &values[i], depth + 1)) return FALSE;
+            }
+            *value = pug_value_object(keys, values, count);
+            return TRUE;
+        }
+        default:
+            return FALSE;
+    }
+}
+
+// Lee exactamente n bytes de un socket bloqueante (el del cliente). FALSE si
+// la conexión se cierra o falla.
+static inline gboolean serve_read_full(int fd, void* buf, gsize n) {
+    guint8* p = (guint8*)buf;
+    while (n > 0) {
+        ssize_t got = read(fd, p, n);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return FALSE;
+        p += got;
+        n -= (gsize)got;
+    }
+    return TRUE;
+}
+
+// ============================================================================
+// SERVIDOR
+// ============================================================================
+
+typedef struct {
+    PugEngine* engine;
+    PugPreload* preload;        // Plantillas precargadas (opcional, pug_server_set_preload())
+    char* path;                 // Socket que se borra al terminar (NULL si no es suyo)
+    int fd;                     // Socket de escucha
+    int epoll;
+    unsigned int n_threads;
+    GThreadPool* pool;
+    GHashTable* connections;    // PugServeConn abiertas (con lock)
+    GMutex lock;
+
+    // Estadísticas (atómicas)
+    gsize requests;
+    gsize errors;
+    gsize bytes;
+    gsize accepted;
+} PugServer;
+
+typedef struct {
+    int fd;
+    GByteArray* buffer;         // Bytes recibidos que aún no forman una trama completa
+    gsize peak;                 // Mayor tamaño del buffer desde que se reservó
+    GByteArray* out;            // Respuesta que el socket no admitió (NULL si no hay)
+    gsize out_sent;             // Bytes de out ya enviados
+    gboolean closing;           // Cerrar en cuanto out se haya enviado
+} PugServeConn;
+
+static inline void serve_conn_free(PugServeConn* conn) {
+    close(conn->fd);
+    g_byte_array_free(conn->buffer, TRUE);
+    if (conn->out) g_byte_array_free(conn->out, TRUE);
+    g_free(conn);
+}
+
+static inline void serve_conn_close(PugServer* server, PugServeConn* conn) {
+    g_mutex_lock(&server->lock);
+    g_hash_table_remove(server->connections, conn);
+    g_mutex_unlock(&server->lock);
+    serve_conn_free(conn);
+}
+
+// Escribe una trama de respuesta sin copiar el cuerpo (sin SIGPIPE si el
+// otro extremo ya cerró). Lo que el socket no admite se copia a conn->out y
+// sale con serve_flush() cuando epoll avise: un cliente que no lee no
+// retiene ningún hilo. FALSE si la conexión falló.
+static inline gboolean serve_write_frame(PugServeConn* conn, guint8 status, const char* body, gsize len) {
+    guint8 header[5];
+    guint32 frame_len = GUINT32_TO_LE((guint32)(len + 1));
+    memcpy(header, &frame_len, 4);
+    header[4] = status;
+
+    struct iovec iov[2] = { { header, sizeof(header) }, { (void*)body, len } };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    while (!conn->out && iov[0].iov_len + iov[1].iov_len > 0) {
+        ssize_t sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (sent <= 0) return FALSE;
+        for (int i = 0; i < 2; i++) {
+            gsize n = MIN((gsize)sent, iov[i].iov_len);
+            iov[i].iov_base = (guint8*)iov[i].iov_base + n;
+            iov[i].iov_len -= n;
+            sent -= (ssize_t)n;
+        }
+    }
+    if (iov[0].iov_len + iov[1].iov_len == 0) return TRUE;
+    if (!conn->out) {
+        conn->out = g_byte_array_sized_new((guint)(iov[0].iov_len + iov[1].iov_len));
+        conn->out_sent = 0;
+    }
+    for (int i = 0; i < 2; i++) g_byte_array_append(conn->out, (const guint8*)iov[i].iov_base, (guint)iov[i].iov_len);
+    return TRUE;
+}
+
+// Envía lo que quede de conn->out y lo suelta si ha salido todo. FALSE si la
+// conexión falló.
+static inline gboolean serve_flush(PugServeConn* conn) {
+    while (conn->out) {
+        ssize_t sent = send(conn->fd, conn->out->data + conn->out_sent, conn->out->len - conn->out_sent, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return TRUE;
+        if (sent <= 0) return FALSE;
+        conn->out_sent += (gsize)sent;
+        if (conn->out_sent == conn->out->len) {
+            g_byte_array_free(conn->out, TRUE);
+            conn->out = NULL;
+        }
+    }
+    return TRUE;
+}
+
+static inline gboolean serve_fail(PugServer* server, PugServeConn* conn, PugServeStatus status, const char* message) {
+    g_atomic_pointer_add(&server->errors, 1);
+    return serve_write_frame(conn, (guint8)status, message, strlen(message));
+}
+
+// Renderiza la petición de data y responde. FALSE si hay que cerrar.
+static inline gboolean serve_render(PugServer* server, PugServeConn* conn, const guint8* data, gsize len) {
+    PugRenderContext* ctx = pug_render_context_get();
+    PugServeReader reader = { data, data + len };
+    const char* path = serve_get_name(&reader, &ctx->arena);
+    if (!path) {
+        pug_arena_reset(&ctx->arena);
+        return serve_fail(server, conn, PUG_SERVE_BAD_REQUEST, "Error: Petición mal formada");
+    }
+    // La plantilla publicada vale hasta salir de la sección de lectura: ni
+    // lock del loader ni referencia por petición. Una precargada ni siquiera
+    // entra en el registro (no escribe nada compartido después de fork()).
+    PugRegistry* registry = server->engine->registry;
+    int preloaded = pug_preload_find(server->preload, path);
+    guint guard = preloaded < 0 ? pug_registry_enter(registry) : 0;
+    const PugTemplate* tpl = preloaded >= 0 ? pug_preload_template(server->preload, preloaded)
+                                            : pug_registry_get(registry, path);
+    if (!tpl) {
+        if (preloaded < 0) pug_registry_leave(registry, guard);
+        pug_arena_reset(&ctx->arena);
+        return serve_fail(server, conn, PUG_SERVE_NOT_FOUND, "Error: Plantilla no encontrada");
+    }
+
+    // Locales en la arena del hilo: no se reserva memoria por petición
+    PugLocals locals;
+    locals.tpl = tpl;
+    locals.count = pug_template_slot_count(tpl);
+    locals.values = pug_arena_alloc_values(&ctx->arena, locals.count ? locals.count : 1);
+    memset(locals.values, 0, sizeof(PugValue) * (locals.count ? locals.count : 1));
+    while (reader.p < reader.end) {
+        PugValue value;
+        const char* name = serve_get_name(&reader, &ctx->arena);
+        if (!name || !serve_get_value(&reader, &ctx->arena, &value, 0)) {
+            if (preloaded < 0) pug_registry_leave(registry, guard);
+            pug_arena_reset(&ctx->arena);
+            return serve_fail(server, conn, PUG_SERVE_BAD_REQUEST, "Error: Locales mal formadas");
+        }
+        pug_locals_set_by_name(&locals, name, value);
+    }
+
+    const PugEngineConfig* config = &server->engine->config;
+    pug_template_render_context(tpl, &locals, ctx, NULL, config->use_tabs, config->tab_size, config->minify);
+    if (preloaded < 0) pug_registry_leave(registry, guard);
+    else pug_preload_count(server->preload, preloaded, ctx->output->len);
+    g_atomic_pointer_add(&server->requests, 1);
+    g_atomic_pointer_add(&server->bytes, ctx->output->len);
+    return serve_write_frame(conn, PUG_SERVE_OK, ctx->output->str, ctx->output->len);
+}
+
+// Tras una petición grande el buffer vuelve a un tamaño pequeño: una
+// conexión larga no retiene la memoria de su mayor petición
+static inline void serve_conn_shrink(PugServeConn* conn) {
+    if (conn->peak <= PUG_SERVE_KEEP_BUFFER || conn->buffer->len > PUG_SERVE_KEEP_BUFFER) return;
+    GByteArray* buffer = g_byte_array_sized_new(4096);
+    g_byte_array_append(buffer, conn->buffer->data, conn->buffer->len);
+    g_byte_array_free(conn->buffer, TRUE);
+    conn->buffer = buffer;
+    conn->peak = buffer->len;
+}
+
+// Atiende las tramas completas del buffer y las quita. Para en cuanto una
+// respuesta queda pendiente: las siguientes esperan a que el cliente la lea.
+// FALSE si hay que cerrar la conexión.
+static inline gboolean serve_handle_frames(PugServer* server, PugServeConn* conn) {
+    gsize done = 0;
+    gboolean ok = TRUE;
+    while (ok && !conn->out && conn->buffer->len - done >= 4) {
+        guint32 len;
+        memcpy(&len, conn->buffer->data + done, 4);
+        len = GUINT32_FROM_LE(len);
+        if (len > PUG_SERVE_MAX_REQUEST) {
+            // Se cierra después de enviar el error
+            conn->closing = TRUE;
+            return serve_fail(server, conn, PUG_SERVE_BAD_REQUEST, "Error: Petición demasiado grande");
+        }
+        if (conn->buffer->len - done - 4 < len) break;
+        ok = serve_render(server, conn, conn->buffer->data + done + 4, len);
+        done += 4 + (gsize)len;
+    }
+    if (done > 0) g_byte_array_remove_range(conn->buffer, 0, (guint)done);
+    serve_conn_shrink(conn);
+    return ok;
+}
+
+// Envía lo pendiente, lee lo que haya llegado a conn y responde a las
+// peticiones completas. Una trama a medias se queda en el buffer y una
+// respuesta a medias en conn->out hasta el siguiente aviso de epoll. FALSE
+// si la conexión terminó.
+static inline gboolean serve_handle(PugServer* server, PugServeConn* conn) {
+    for (;;) {
+        if (!serve_flush(conn)) return FALSE;
+        if (conn->out) return TRUE;
+        if (conn->closing) return FALSE;
+        if (!serve_handle_frames(server, conn)) return FALSE;
+        if (conn->out || conn->closing) continue;
+
+        // Lo que falta de la trama en curso, sin reservar de una vez lo que
+        // anuncia la cabecera
+        gsize old = conn->buffer->len;
+        gsize want = 4096;
+        if (old >= 4) {
+            guint32 len;
+            memcpy(&len, conn->buffer->data, 4);
+            want = MAX(want, 4 + (gsize)GUINT32_FROM_LE(len) - old);
+        }
+        want = MIN(want, (gsize)PUG_SERVE_READ_CHUNK);
+        g_byte_array_set_size(conn->buffer, (guint)(old + want));
+        conn->peak = MAX(conn->peak, conn->buffer->len);
+        ssize_t got = read(conn->fd, conn->buffer->data + old, want);
+        g_byte_array_set_size(conn->buffer, (guint)(old + (got > 0 ? (gsize)got : 0)));
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return TRUE;
+        if (got <= 0) return FALSE;
+    }
+}
+
+#ifdef __linux__
+
+// Tarea del pool: atiende la conexión y la vuelve a armar, para escribir si
+// quedó una respuesta pendiente o para leer si no
+static inline void serve_worker(gpointer data, gpointer user_data) {
+    PugServeConn* conn = (PugServeConn*)data;
+    PugServer* server = (PugServer*)user_data;
+    if (serve_handle(server, conn)) {
+        struct epoll_event event;
+        event.events = (conn->out ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+        event.data.ptr = conn;
+        if (epoll_ctl(server->epoll, EPOLL_CTL_MOD, conn->fd, &event) == 0) return;
+    }
+    serve_conn_close(server, conn);
+}
+
+// Socket de escucha en socket_path (lo sustituye si ya hay un socket) o -1.
+// Se puede crear antes de fork() y compartir entre procesos con
+// pug_server_new_fd().
+static inline int pug_serve_listen(const char* socket_path) {
+    if (!socket_path) return -1;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        g_print("Error: Ruta de socket demasiado larga: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    // Un socket que quedó de una ejecución anterior se reemplaza; otro
+    // archivo no se toca
+    struct stat st;
+    if (lstat(socket_path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            g_print("Error: %s existe y no es un socket\n", socket_path);
+            return -1;
+        }
+        unlink(socket_path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, PUG_SERVE_BACKLOG) < 0) {
+        g_print("Error: No se pudo escuchar en %s: %s\n", socket_path, g_strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Servidor sobre el socket de escucha fd, del que pasa a ser dueño. Si
+// socket_path no es NULL, lo borra al terminar. n_threads == 0 usa un hilo
+// por procesador.
+static inline PugServer* pug_server_new_fd(PugEngine* engine, const char* socket_path, int fd, unsigned int n_threads) {
+    if (!engine || fd < 0) return NULL;
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;      // NULL = socket de escucha
+    if (epoll < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+        g_print("Error: epoll no disponible: %s\n", g_strerror(errno));
+        if (epoll >= 0) close(epoll);
+        close(fd);
+        if (socket_path) unlink(socket_path);
+        return NULL;
+    }
+
+    PugServer* server = g_new0(PugServer, 1);
+    server->engine = engine;
+    server->path = g_strdup(socket_path);
+    server->fd = fd;
+    server->epoll = epoll;
+    server->n_threads = n_threads ? n_threads : g_get_num_processors();
+    server->connections = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_mutex_init(&server->lock);
+    server->pool = g_thread_pool_new(serve_worker, server, (gint)server->n_threads, FALSE, NULL);
+    return server;
+}
+
+// Escucha en socket_path (lo sustituye si ya hay un socket)
+static inline PugServer* pug_server_new(PugEngine* engine, const char* socket_path, unsigned int n_threads) {
+    if (!engine || !socket_path) return NULL;
+    return pug_server_new_fd(engine, socket_path, pug_serve_listen(socket_path), n_threads);
+}
+
+// Acepta todas las conexiones pendientes, sin bloqueo, y las arma en epoll
+static inline void serve_accept(PugServer* server) {
+    for (;;) {
+#ifdef _GNU_SOURCE
+        int fd = accept4(server->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        // Sin accept4() (necesita _GNU_SOURCE): los mismos flags después
+        int fd = accept(server->fd, NULL, NULL);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+#endif
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                g_print("Error: accept: %s\n", g_strerror(errno));
+            }
+            return;
+        }
+        PugServeConn* conn = g_new0(PugServeConn, 1);
+        conn->fd = fd;
+        conn->buffer = g_byte_array_sized_new(4096);
+        g_mutex_lock(&server->lock);
+        g_hash_table_add(server->connections, conn);
+        g_mutex_unlock(&server->lock);
+        g_atomic_pointer_add(&server->accepted, 1);
+
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = conn;
+        if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+            serve_conn_close(server, conn);
+        }
+    }
+}
+
+// Atiende peticiones hasta que *stop deje de ser 0 (comprobado al menos
+// cada 200 ms)
+static inline void pug_server_run(PugServer* server, volatile gint* stop) {
+    if (!server) return;
+    struct epoll_event events[64];
+    while (!g_atomic_int_get(stop)) {
+        int n = epoll_wait(server->epoll, events, G_N_ELEMENTS(events), 200);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            g_print("Error: epoll_wait: %s\n", g_strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) serve_accept(server);
+            else g_thread_pool_push(server->pool, events[i].data.ptr, NULL);
+        }
+    }
+}
+
+#else
+
+static inline int pug_serve_listen(const char* socket_path) {
+    (void)socket_path;
+    g_print("Error: El servidor de render necesita epoll (Linux)\n");
+    return -1;
+}
+
+static inline PugServer* pug_server_new_fd(PugEngine* engine, const char* socket_path, int fd, unsigned int n_threads) {
+    (void)engine;
+    (void)socket_path;
+    (void)fd;
+    (void)n_threads;
+    g_print("Error: El servidor de render necesita epoll (Linux)\n");
+    return NULL;
+}
+
+static inline PugServer* pug_server_new(PugEngine* engine, const char* socket_path, unsigned int n_threads) {
+    (void)engine;
+    (void)socket_path;
+    (void)n_threads;
+    g_print("Error: El servidor de render necesita epoll (Linux)\n");
+    return NULL;
+}
+
+static inline void pug_server_run(PugServer* server, volatile gint* stop) {
+    (void)server;
+    (void)stop;
+}
+
+#endif
+
+// Espera a las peticiones en curso, cierra las conexiones y borra el socket
+static inline void pug_server_free(PugServer* server) {
+    if (!server) return;
+    g_thread_pool_free(server->pool, FALSE, TRUE);
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, server->connections);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        serve_conn_free((PugServeConn*)key);
+    }
+    g_hash_table_destroy(server->connections);
+    g_mutex_clear(&server->lock);
+    close(server->epoll);
+    close(server->fd);
+    if (server->path) unlink(server->path);
+    g_free(server->path);
+    g_free(server);
+}
+
+// Sirve las plantillas de preload (sellada) sin pasar por el registro. Antes
+// de pug_server_run().
+static inline void pug_server_set_preload(PugServer* server, PugPreload* preload) {
+    if (server) server->preload = preload;
+}
+
+static inline void pug_server_print_stats(const PugServer* server) {
+    if (!server) return;
+    printf("=== Serve ===\n");
+    printf("Conexiones: %lu | Peticiones: %lu | Errores: %lu | Bytes: %lu\n",
+           (unsigned long)server->accepted, (unsigned long)server->requests,
+           (unsigned long)server->errors, (unsigned long)server->bytes);
+}
+
+// ============================================================================
+// CLIENTE Y GENERADOR DE CARGA
+// ============================================================================
+
+// Conecta con un servidor; devuelve el descriptor o -1
+static inline int pug_serve_connect(const char* socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (!socket_path || strlen(socket_path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        g_print("Error: No se pudo conectar con %s: %s\n", socket_path, g_strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Envía una petición ya cerrada con pug_serve_request_end() y deja el
+// cuerpo de la respuesta en body. Devuelve el PugServeStatus o -1 si la
+// conexión se cortó.
+static inline int pug_serve_call(int fd, const GByteArray* request, GByteArray* body) {
+    const guint8* p = request->data;
+    gsize left = request->len;
+    while (left > 0) {
+        ssize_t sent = send(fd, p, left, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return -1;
+        p += sent;
+        left -= (gsize)sent;
+    }
+    guint8 header[5];
+    if (!serve_read_full(fd, header, sizeof(header))) return -1;
+    guint32 len;
+    memcpy(&len, header, 4);
+    len = GUINT32_FROM_LE(len);
+    if (len == 0) return -1;
+    g_byte_array_set_size(body, len - 1);
+    if (!serve_read_full(fd, body->data, len - 1)) return -1;
+    return header[4];
+}
+
+typedef struct {
+    guint64 requests;           // Respuestas con PUG_SERVE_OK
+    guint64 failed;             // Errores y conexiones cortadas
+    guint64 bytes;
+    double seconds;
+    double p50_us;
+    double p90_us;
+    double p99_us;
+    double p999_us;
+    double max_us;
+} PugServeLoadStats;
+
+typedef struct {
+    const char* socket_path;
+    const GByteArray* request;
+    gsize n;
+    gsize next;                 // Siguiente petición sin repartir (atómico)
+    gint64* latencies;          // Microsegundos por petición (-1 = fallida)
+    GMutex lock;
+    PugServeLoadStats stats;
+} PugServeLoad;
+
+static inline gpointer serve_load_worker(gpointer data) {
+    PugServeLoad* load = (PugServeLoad*)data;
+    GByteArray* body = g_byte_array_new();
+    guint64 ok = 0, failed = 0, bytes = 0;
+    int fd = pug_serve_connect(load->socket_path);
+
+    for (;;) {
+        gsize i = (gsize)g_atomic_pointer_add(&load->next, 1);
+        if (i >= load->n) break;
+        if (fd < 0) {
+            load->latencies[i] = -1;
+            failed++;
+            continue;
+        }
+        gint64 start = g_get_monotonic_time();
+        int status = pug_serve_call(fd, load->request, body);
+        load->latencies[i] = status == PUG_SERVE_OK ? g_get_monotonic_time() - start : -1;
+        if (status == PUG_SERVE_OK) {
+            ok++;
+            bytes += body->len;
+        } else {
+            failed++;
+            if (status < 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+
+    if (fd >= 0) close(fd);
+    g_byte_array_free(body, TRUE);
+    g_mutex_lock(&load->lock);
+    load->stats.requests += ok;
+    load->stats.failed += failed;
+    load->stats.bytes += bytes;
+    g_mutex_unlock(&load->lock);
+    return NULL;
+}
+
+static inline int serve_compare_latency(const void* a, const void* b) {
+    gint64 x = *(const gint64*)a, y = *(const gint64*)b;
+    return (x > y) - (x < y);
+}
+
+// Envía request n veces repartidas entre n_connections conexiones (cada una
+// en su hilo, una petición tras otra) y mide latencias
+static inline void pug_serve_load(const char* socket_path, const GByteArray* request, gsize n,
+                                  unsigned int n_connections, PugServeLoadStats* stats) {
+    PugServeLoad load;
+    memset(&load, 0, sizeof(load));
+    load.socket_path = socket_path;
+    load.request = request;
+    load.n = n;
+    load.latencies = g_new(gint64, n ? n : 1);
+    g_mutex_init(&load.lock);
+    if (n_connections == 0) n_connections = 1;
+
+    gint64 start = g_get_monotonic_time();
+    GPtrArray* threads = g_ptr_array_new();
+    for (unsigned int i = 1; i < n_connections; i++) {
+        g_ptr_array_add(threads, g_thread_new("pug-load", serve_load_worker, &load));
+    }
+    serve_load_worker(&load);
+    for (guint i = 0; i < threads->len; i++) {
+        g_thread_join((GThread*)g_ptr_array_index(threads, i));
+    }
+    g_ptr_array_free(threads, TRUE);
+    load.stats.seconds = (double)(g_get_monotonic_time() - start) / G_USEC_PER_SEC;
+
+    // Percentiles de las peticiones que salieron bien
+    qsort(load.latencies, n, sizeof(gint64), serve_compare_latency);
+    gsize first = 0;
+    while (first < n && load.latencies[first] < 0) first++;
+    gsize count = n - first;
+    if (count > 0) {
+        const gint64* sorted = load.latencies + first;
+        load.stats.p50_us = (double)sorted[(count - 1) * 50 / 100];
+        load.stats.p90_us = (double)sorted[(count - 1) * 90 / 100];
+        load.stats.p99_us = (double)sorted[(count - 1) * 99 / 100];
+        load.stats.p999_us = (double)sorted[(count - 1) * 999 / 1000];
+        load.stats.max_us = (double)sorted[count - 1];
+    }
+
+    g_free(load.latencies);
+    g_mutex_clear(&load.lock);
+    if (stats) *stats = load.stats;
+}
+
+static inline void pug_serve_print_load_stats(const PugServeLoadStats* stats) {
+    if (!stats) return;
+    double seconds = stats->seconds > 0 ? stats->seconds : 1e-9;
+    printf("=== Load ===\n");
+    printf("Peticiones: %llu | Fallidas: %llu | Bytes: %llu\n",
+           (unsigned long long)stats->requests, (unsigned long long)stats->failed,
+           (unsigned long long)stats->bytes);
+    printf("Tiempo: %.3f s | %.0f peticiones/s | %.1f MB/s\n", stats->seconds,
+           (double)stats->requests / seconds, (double)stats->bytes / seconds / (1024.0 * 1024.0));
+    printf("Latencia (us): p50 %.0f | p90 %.0f | p99 %.0f | p99.9 %.0f | max %.0f\n",
+           stats->p50_us, stats->p90_us, stats->p99_us, stats->p999_us, stats->max_us);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_SERVE_H
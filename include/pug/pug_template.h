@@ -0,0 +1,1368 @@
+#ifndef PUG_TEMPLATE_H
+#define PUG_TEMPLATE_H
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pug/pug_tokens.h"
+#include "pug/pug_ast.h"
+#include "pug/pug_parser.h"
+#include "pug/pug_tokenizer.h"
+#include "pug/pug_renderer.h"
+#include "pug/pug_parallel.h"
+#include "pug/pug_value.h"
+#include "pug/pug_expr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// PLANTILLA COMPILADA
+// ============================================================================
+typedef struct PugTemplate PugTemplate;
+
+// Resuelve un include/extends durante la compilación: devuelve una referencia
+// nueva a la plantilla de path (relativa a from) ya compilada, o NULL. Quien
+// la incluye se queda con la referencia (ver pug_loader.h).
+typedef PugTemplate* (*PugResolveFunc)(const char* from, const char* path, gpointer data);
+
+static inline void pug_template_free(PugTemplate* tpl);
+
+struct PugTemplate {
+    char* name;             // Nombre o ruta
+    char* scope;            // Ámbito en la caché de fragmentos: nombre y número de compilación
+    ASTNode* root;
+    gint ref_count;         // pug_template_ref() / pug_template_free()
+    gsize bytes;            // Memoria aproximada de lo compilado
+    GPtrArray* uses;        // Plantillas incluidas o extendidas (una referencia cada una)
+    unsigned int unresolved; // include/extends que no se pudieron cargar (con los de las usadas)
+    gint64 source_stamp;    // Versión del archivo al compilar (la rellena el loader)
+    guint64 source_hash;    // Hash del contenido compilado
+    PugSymbols* symbols;    // Propia o compartida con las plantillas del mismo loader
+    PugSymbols own_symbols;
+    unsigned int slot_count; // Slots que usa, fijados al terminar de compilar
+    GPtrArray* exprs;       // Expresiones compiladas; los nodos sólo las apuntan
+    GPtrArray* mixins;      // Tabla de mixins (PugMixin*); las llamadas la apuntan
+    GHashTable* mixin_names; // Nombre -> PugMixin (la última definición gana)
+    PugFragmentCache* memo; // Salidas de mixins puros (NULL = sin memo)
+    unsigned int sealed;    // Compartida entre procesos (pug_preload.h): el render no escribe en ella
+
+    // Herencia de bloques (extends)
+    PugTemplate* extends;   // Plantilla que extiende (del loader; NULL sin extends)
+    PugTemplate* layout;    // Raíz de la cadena: su árbol es el que se renderiza
+    unsigned int level;     // Posición en la cadena (0 = sin extends)
+    GHashTable* block_slots; // Nombre -> slot + 1 (claves de los nodos de la cadena)
+    GArray* block_defaults; // slot -> PugBlockPart con el contenido por defecto
+    PugBlockTable* blocks;  // Partes de cada slot (NULL sin extends)
+
+    // Sólo durante la compilación
+    PugResolveFunc resolve;
+    gpointer resolve_data;
+};
+
+static inline void pug_mixin_free(PugMixin* mixin) {
+    if (!mixin) return;
+    g_free(mixin->name);
+    g_free(mixin->param_slots);
+    g_free(mixin->defaults);
+    g_free(mixin);
+}
+
+// Compila una expresión de la plantilla (NULL si no es válida)
+static inline PugExpr* template_compile_expr(PugTemplate* tpl, const char* src, gsize len, int statements) {
+    PugExpr* expr = pug_expr_compile(src, len, tpl->symbols, statements);
+    if (expr) g_ptr_array_add(tpl->exprs, expr);
+    return expr;
+}
+
+// Longitud del identificador que empieza en p (0 si no empieza uno)
+static inline gsize template_ident_len(const char* p, const char* end) {
+    if (p >= end || !(g_ascii_isalpha(*p) || *p == '_' || *p == '$')) return 0;
+    const char* q = p + 1;
+    while (q < end && (g_ascii_isalnum(*q) || *q == '_' || *q == '$')) q++;
+    return (gsize)(q - p);
+}
+
+static inline void template_text_add(GArray* segments, SegmentType type, unsigned int slot,
+                                     PugExpr* expr, const char* text, gsize len) {
+    if (type == SEGMENT_LITERAL) {
+        if (len == 0) return;
+        // Unir literales consecutivos
+        if (segments->len > 0) {
+            PugSegment* last = &g_array_index(segments, PugSegment, segments->len - 1);
+            if (last->type == SEGMENT_LITERAL && last->text + last->len == text) {
+                last->len += (unsigned int)len;
+                return;
+            }
+        }
+    }
+    PugSegment seg;
+    memset(&seg, 0, sizeof(seg));
+    seg.type = type;
+    seg.slot = slot;
+    seg.expr = expr;
+    seg.text = text;
+    seg.len = (unsigned int)len;
+    g_array_append_val(segments, seg);
+}
+
+// Escapa los segmentos literales una sola vez, en las dos variantes que usa
+// render_text() (normal y con espacios colapsados para PUG_MINIFY_FULL)
+static inline void template_escape_literals(PugText* text) {
+    GString* escaped = g_string_new("");
+    PugSink sink = { .gstr = escaped };
+    for (unsigned int i = 0; i < text->count; i++) {
+        PugSegment* seg = &text->segments[i];
+        if (seg->type != SEGMENT_LITERAL) continue;
+        seg->html[0] = (const char*)(gsize)escaped->len;
+        sink_append_escaped_len(&sink, seg->text, seg->len);
+        seg->html_len[0] = (unsigned int)(escaped->len - (gsize)seg->html[0]);
+        seg->html[1] = (const char*)(gsize)escaped->len;
+        sink_append_collapsed_len(&sink, seg->text, seg->len);
+        seg->html_len[1] = (unsigned int)(escaped->len - (gsize)seg->html[1]);
+    }
+    // Con el buffer ya definitivo, los desplazamientos pasan a punteros
+    text->escaped = g_string_free(escaped, FALSE);
+    for (unsigned int i = 0; i < text->count; i++) {
+        PugSegment* seg = &text->segments[i];
+        if (seg->type != SEGMENT_LITERAL) continue;
+        seg->html[0] = text->escaped + (gsize)seg->html[0];
+        seg->html[1] = text->escaped + (gsize)seg->html[1];
+    }
+}
+
+// Compila un texto con interpolaciones #{expr} / !{expr} a segmentos. Una
+// local sola se lee por slot; el resto se compila a bytecode. \#{ se emite
+// literal y las expresiones no válidas se dejan como texto. Un texto sin
+// interpolaciones queda como un único segmento ya escapado; con dynamic_only
+// se devuelve NULL en ese caso.
+static inline PugText* template_compile_text(PugTemplate* tpl, const char* source, int dynamic_only) {
+    if (!source || !*source) return NULL;
+    if (dynamic_only && !strstr(source, "#{") && !strstr(source, "!{")) return NULL;
+
+    PugText* text = g_new0(PugText, 1);
+    text->literals = g_strdup(source);
+    GArray* segments = g_array_new(FALSE, FALSE, sizeof(PugSegment));
+
+    const char* p = text->literals;
+    const char* run = p;
+    int changed = 0;
+    while (*p) {
+        if (p[0] == '\\' && (p[1] == '#' || p[1] == '!') && p[2] == '{') {
+            template_text_add(segments, SEGMENT_LITERAL, 0, NULL, run, p - run);
+            run = p + 1;
+            p += 3;
+            changed = 1;
+            continue;
+        }
+        if ((p[0] == '#' || p[0] == '!') && p[1] == '{') {
+            const char* close = strchr(p + 2, '}');
+            if (!close) break;
+            const char* start = p + 2;
+            const char* end = close;
+            while (start < end && *start == ' ') start++;
+            while (end > start && end[-1] == ' ') end--;
+            SegmentType type = p[0] == '#' ? SEGMENT_ESCAPED : SEGMENT_RAW;
+            gsize len = template_ident_len(start, end);
+            if (len > 0 && start + len == end) {
+                template_text_add(segments, SEGMENT_LITERAL, 0, NULL, run, p - run);
+                unsigned int slot = pug_symbols_intern(tpl->symbols, start, len);
+                template_text_add(segments, type, slot, NULL, NULL, 0);
+                run = close + 1;
+                changed = 1;
+            } else {
+                PugExpr* expr = template_compile_expr(tpl, start, (gsize)(end - start), 0);
+                if (expr) {
+                    template_text_add(segments, SEGMENT_LITERAL, 0, NULL, run, p - run);
+                    template_text_add(segments, type, 0, expr, NULL, 0);
+                    run = close + 1;
+                    changed = 1;
+                }
+            }
+            p = close + 1;
+            continue;
+        }
+        p++;
+    }
+    template_text_add(segments, SEGMENT_LITERAL, 0, NULL, run, strlen(run));
+
+    if (!changed && dynamic_only) {
+        g_array_free(segments, TRUE);
+        g_free(text->literals);
+        g_free(text);
+        return NULL;
+    }
+
+    text->count = segments->len;
+    text->segments = (PugSegment*)g_array_free(segments, FALSE);
+    template_escape_literals(text);
+    return text;
+}
+
+// Compila las dependencias de un bloque `cache` a slots
+static inline PugText* template_compile_cache_deps(PugTemplate* tpl, const char* names) {
+    if (!names || !*names) return NULL;
+    PugText* text = g_new0(PugText, 1);
+    GArray* segments = g_array_new(FALSE, FALSE, sizeof(PugSegment));
+    gchar** parts = g_strsplit_set(names, " ,", -1);
+    for (gchar** name = parts; *name; name++) {
+        if (!**name) continue;
+        unsigned int slot = pug_symbols_intern(tpl->symbols, *name, strlen(*name));
+        template_text_add(segments, SEGMENT_ESCAPED, slot, NULL, NULL, 0);
+    }
+    g_strfreev(parts);
+    text->count = segments->len;
+    text->segments = (PugSegment*)g_array_free(segments, FALSE);
+    return text;
+}
+
+// Compila los valores de atributo sin comillas. Los que no son expresiones
+// válidas se quedan como texto.
+static inline void template_compile_attributes(PugTemplate* tpl, ASTNode* node) {
+    if (!node->attributes) return;
+    for (unsigned int i = 0; i < node->attributes->count; i++) {
+        Attribute* attr = node->attributes->attributes[i];
+        if (!attr || attr->type != ATTR_EXPRESSION || !attr->value) continue;
+        attr->expr = template_compile_expr(tpl, attr->value, strlen(attr->value), 0);
+    }
+}
+
+// Compila la cabecera de un bucle: `valor[, clave] in colección`
+static inline void template_compile_each(PugTemplate* tpl, ASTNode* node) {
+    const char* src = node->text_content;
+    const char* in = src ? strstr(src, " in ") : NULL;
+    if (!in) return;
+
+    const char* p = src;
+    gsize value_len = template_ident_len(p, in);
+    if (value_len == 0) return;
+    const char* q = p + value_len;
+    while (q < in && *q == ' ') q++;
+
+    gsize key_len = 0;
+    const char* key = NULL;
+    if (q < in && *q == ',') {
+        q++;
+        while (q < in && *q == ' ') q++;
+        key = q;
+        key_len = template_ident_len(key, in);
+        if (key_len == 0) return;
+        q = key + key_len;
+        while (q < in && *q == ' ') q++;
+    }
+    if (q != in) return;
+
+    PugExpr* collection = template_compile_expr(tpl, in + 4, strlen(in + 4), 0);
+    if (!collection) return;
+
+    PugLoop* loop = g_new0(PugLoop, 1);
+    loop->value_slot = pug_symbols_intern(tpl->symbols, p, value_len);
+    if (key) {
+        loop->key_slot = pug_symbols_intern(tpl->symbols, key, key_len);
+        loop->has_key = 1;
+    }
+    node->loop = loop;
+    node->expr = collection;
+}
+
+// ============================================================================
+// MIXINS
+// ============================================================================
+
+// Longitud del nombre de mixin que empieza en p (letras, dígitos, - y _)
+static inline gsize template_name_len(const char* p) {
+    gsize len = 0;
+    while (g_ascii_isalnum(p[len]) || p[len] == '-' || p[len] == '_') len++;
+    return len;
+}
+
+// Paréntesis que cierra el abierto en open (NULL si no se cierra). Las
+// cadenas entre comillas no cuentan.
+static inline const char* template_match_paren(const char* open) {
+    int level = 0;
+    char quote = 0;
+    for (const char* p = open; *p; p++) {
+        if (quote) {
+            if (*p == '\\' && p[1]) p++;
+            else if (*p == quote) quote = 0;
+        } else if (*p == '\'' || *p == '"') {
+            quote = *p;
+        } else if (*p == '(' || *p == '[' || *p == '{') {
+            level++;
+        } else if (*p == ')' || *p == ']' || *p == '}') {
+            if (--level == 0) return *p == ')' ? p : NULL;
+        }
+    }
+    return NULL;
+}
+
+// Divide una lista de argumentos por las comas de primer nivel (fuera de
+// cadenas, paréntesis, corchetes y llaves)
+static inline GPtrArray* template_split_args(const char* begin, const char* end) {
+    GPtrArray* parts = g_ptr_array_new_with_free_func(g_free);
+    int level = 0;
+    char quote = 0;
+    const char* start = begin;
+    for (const char* p = begin; p <= end; p++) {
+        if (p < end && quote) {
+            if (*p == '\\' && p + 1 < end) p++;
+            else if (*p == quote) quote = 0;
+            continue;
+        }
+        if (p < end && (*p == '\'' || *p == '"')) quote = *p;
+        else if (p < end && (*p == '(' || *p == '[' || *p == '{')) level++;
+        else if (p < end && (*p == ')' || *p == ']' || *p == '}')) level--;
+        else if (p == end || (*p == ',' && level == 0)) {
+            char* part = g_strstrip(g_strndup(start, (gsize)(p - start)));
+            if (*part || p < end) g_ptr_array_add(parts, part);
+            else g_free(part);
+            start = p + 1;
+        }
+    }
+    return parts;
+}
+
+// Compila una definición `mixin nombre(a, b='x', ...resto)` y la añade a la
+// tabla. Si la cabecera no es válida se sigue mostrando como comentario.
+static inline void template_compile_mixin(PugTemplate* tpl, ASTNode* node) {
+    const char* src = node->text_content;
+    gsize name_len = src ? template_name_len(src) : 0;
+    if (name_len == 0) return;
+
+    GPtrArray* params = NULL;
+    const char* open = src + name_len;
+    while (*open == ' ') open++;
+    if (*open == '(') {
+        const char* close = template_match_paren(open);
+        if (!close) return;
+        params = template_split_args(open + 1, close);
+    } else if (*open) {
+        return;
+    }
+
+    PugMixin* mixin = g_new0(PugMixin, 1);
+    mixin->name = g_strndup(src, name_len);
+    mixin->node = node;
+    mixin->rest_slot = -1;
+    unsigned int capacity = params ? params->len : 0;
+    mixin->param_slots = g_new0(unsigned int, capacity ? capacity : 1);
+    mixin->defaults = g_new0(PugExpr*, capacity ? capacity : 1);
+
+    int ok = 1;
+    for (unsigned int i = 0; ok && i < capacity; i++) {
+        const char* param = (const char*)g_ptr_array_index(params, i);
+        const char* end = param + strlen(param);
+        if (strncmp(param, "...", 3) == 0 && i + 1 == capacity) {
+            gsize len = template_ident_len(param + 3, end);
+            ok = len > 0 && param[3 + len] == '\0';
+            if (ok) mixin->rest_slot = (int)pug_symbols_intern(tpl->symbols, param + 3, len);
+            continue;
+        }
+        gsize len = template_ident_len(param, end);
+        const char* q = param + len;
+        while (*q == ' ') q++;
+        ok = len > 0 && (*q == '\0' || *q == '=');
+        if (ok && *q == '=') {
+            mixin->defaults[mixin->n_params] = template_compile_expr(tpl, q + 1, strlen(q + 1), 0);
+            ok = mixin->defaults[mixin->n_params] != NULL;
+        }
+        if (ok) mixin->param_slots[mixin->n_params++] = pug_symbols_intern(tpl->symbols, param, len);
+    }
+    if (params) g_ptr_array_free(params, TRUE);
+    if (!ok) {
+        pug_mixin_free(mixin);
+        return;
+    }
+
+    mixin->attributes_slot = pug_symbols_intern(tpl->symbols, "attributes", 10);
+    g_ptr_array_add(tpl->mixins, mixin);
+    g_hash_table_replace(tpl->mixin_names, mixin->name, mixin);
+    node->mixin = mixin;
+}
+
+// Compila una llamada `+nombre(args)(atributos)`. El mixin se busca en la
+// tabla al terminar de compilar (puede estar definido más abajo).
+static inline void template_compile_call(PugTemplate* tpl, ASTNode* node) {
+    const char* src = node->text_content;
+    gsize name_len = src ? template_name_len(src) : 0;
+    if (name_len == 0) return;
+
+    GPtrArray* args = NULL;
+    GPtrArray* attrs = NULL;
+    const char* p = src + name_len;
+    for (int group = 0; group < 2 && *p == '('; group++) {
+        const char* close = template_match_paren(p);
+        if (!close) break;
+        if (group == 0) args = template_split_args(p + 1, close);
+        else attrs = template_split_args(p + 1, close);
+        p = close + 1;
+    }
+
+    PugCall* call = g_new0(PugCall, 1);
+    call->name = g_strndup(src, name_len);
+    int ok = (*p == '\0');
+    if (ok && args) {
+        call->args = g_new0(PugExpr*, args->len ? args->len : 1);
+        for (unsigned int i = 0; ok && i < args->len; i++) {
+            const char* arg = (const char*)g_ptr_array_index(args, i);
+            call->args[call->n_args++] = template_compile_expr(tpl, arg, strlen(arg), 0);
+            ok = call->args[i] != NULL;
+        }
+    }
+    if (ok && attrs) {
+        // name=valor o name a secas (true); las comillas del nombre se quitan
+        call->attr_names = g_new0(char*, attrs->len + 1);
+        call->attr_values = g_new0(PugExpr*, attrs->len ? attrs->len : 1);
+        for (unsigned int i = 0; ok && i < attrs->len; i++) {
+            char* attr = (char*)g_ptr_array_index(attrs, i);
+            char* eq = strchr(attr, '=');
+            const char* value = eq ? eq + 1 : "true";
+            if (eq) *eq = '\0';
+            char* name = g_strstrip(attr);
+            gsize len = strlen(name);
+            if (len >= 2 && (name[0] == '\'' || name[0] == '"') && name[len - 1] == name[0]) {
+                name[len - 1] = '\0';
+                name++;
+            }
+            call->attr_names[call->n_attrs] = g_strdup(name);
+            call->attr_values[call->n_attrs++] = template_compile_expr(tpl, value, strlen(value), 0);
+            ok = *name && call->attr_values[i] != NULL;
+        }
+    }
+    if (args) g_ptr_array_free(args, TRUE);
+    if (attrs) g_ptr_array_free(attrs, TRUE);
+
+    if (!ok) {
+        pug_call_free(call);
+        return;
+    }
+    node->call = call;
+}
+
+// Enlaza cada llamada con su entrada de la tabla de mixins
+static inline void template_link_calls(PugTemplate* tpl, ASTNode* node) {
+    if (node->call && !node->call->mixin) {
+        node->call->mixin = (PugMixin*)g_hash_table_lookup(tpl->mixin_names, node->call->name);
+        if (!node->call->mixin) {
+            g_print("Error: mixin '%s' no definido (línea %u)\n", node->call->name, node->line);
+        }
+    }
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        template_link_calls(tpl, node->children[i]);
+    }
+}
+
+// ============================================================================
+// INCLUDE / EXTENDS
+// ============================================================================
+
+// Resuelve un include/extends con el loader de la compilación. Sin loader (o
+// con filtros `include:...`) el nodo se sigue mostrando como comentario.
+static inline void template_compile_include(PugTemplate* tpl, ASTNode* node) {
+    if (!tpl->resolve || !node->text_content || node->text_content[0] == ':') return;
+    char* path = g_strstrip(g_strdup(node->text_content));
+    gsize len = strlen(path);
+    if (len >= 2 && (path[0] == '\'' || path[0] == '"') && path[len - 1] == path[0]) {
+        memmove(path, path + 1, len - 2);
+        path[len - 2] = '\0';
+    }
+    PugTemplate* child = *path ? tpl->resolve(tpl->name, path, tpl->resolve_data) : NULL;
+    g_free(path);
+    if (!child) {
+        tpl->unresolved++;
+        return;
+    }
+
+    node->include = g_new0(PugInclude, 1);
+    node->include->root = child->root;
+    node->include->name = g_strdup(child->scope);
+    g_ptr_array_add(tpl->uses, child);
+    tpl->unresolved += child->unresolved;
+    if (node->node_type == TOKEN_EXTENDS && !tpl->extends) tpl->extends = child;
+
+    // Sus mixins se pueden llamar desde aquí; los definidos antes aquí mandan
+    GHashTableIter iter;
+    gpointer name, mixin;
+    g_hash_table_iter_init(&iter, child->mixin_names);
+    while (g_hash_table_iter_next(&iter, &name, &mixin)) {
+        if (!g_hash_table_contains(tpl->mixin_names, name)) g_hash_table_insert(tpl->mixin_names, name, mixin);
+    }
+}
+
+// ============================================================================
+// BLOQUES Y HERENCIA
+// ============================================================================
+// Cada plantilla numera sus bloques con nombre partiendo de la numeración de
+// la que extiende, así un nodo de un árbol compartido tiene el mismo slot en
+// todas las cadenas en que aparece. Una plantilla con `extends` no copia el
+// layout: guarda por slot la lista de partes (nodos `block` de los árboles
+// de la cadena) y el render recorre el árbol del layout despachando cada
+// bloque a sus partes. Compilar y renderizar una hija cuesta lo que su
+// propio contenido más una entrada por bloque del layout.
+
+static inline int template_block_keyword(const char* text, const char* kw) {
+    gsize len = strlen(kw);
+    return strncmp(text, kw, len) == 0 && (text[len] == ' ' || text[len] == '\t');
+}
+
+// `block [append|prepend] nombre` (el parser deja "append nombre" en text_content)
+static inline void template_compile_block(ASTNode* node) {
+    const char* text = node->text_content;
+    if (!text || !*text) return;
+    PugBlockMode mode = PUG_BLOCK_REPLACE;
+    if (template_block_keyword(text, "append")) {
+        mode = PUG_BLOCK_APPEND;
+        text += 6;
+    } else if (template_block_keyword(text, "prepend")) {
+        mode = PUG_BLOCK_PREPEND;
+        text += 7;
+    }
+    while (*text == ' ' || *text == '\t') text++;
+    if (!*text) return;
+    node->block = g_new0(PugBlock, 1);
+    node->block->name = g_strdup(text);
+    node->block->mode = mode;
+}
+
+// Slot del bloque de node; si el nombre es nuevo, node es su contenido por defecto
+static inline unsigned int template_block_slot(PugTemplate* tpl, ASTNode* node) {
+    gpointer slot = g_hash_table_lookup(tpl->block_slots, node->block->name);
+    if (slot) return GPOINTER_TO_UINT(slot) - 1;
+    PugBlockPart def = { node, tpl->level };
+    g_array_append_val(tpl->block_defaults, def);
+    g_hash_table_insert(tpl->block_slots, node->block->name, GUINT_TO_POINTER(tpl->block_defaults->len));
+    return tpl->block_defaults->len - 1;
+}
+
+// Numera los bloques con nombre de un subárbol. Los de las plantillas
+// incluidas ya están numerados en la suya.
+static inline void template_number_blocks(PugTemplate* tpl, ASTNode* node) {
+    if (node->block) node->block->slot = template_block_slot(tpl, node);
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        template_number_blocks(tpl, node->children[i]);
+    }
+}
+
+// Partes de slot en tpl: las heredadas, cambiadas por los bloques del nivel
+// superior de tpl en orden
+static inline void template_block_slot_parts(PugTemplate* tpl, unsigned int slot, GArray* out) {
+    const PugBlockTable* inherited = tpl->extends->blocks;
+    g_array_set_size(out, 0);
+    if (inherited && slot < inherited->n_slots) {
+        unsigned int first = inherited->first[slot];
+        g_array_append_vals(out, inherited->parts + first, inherited->first[slot + 1] - first);
+    }
+
+    PugBlockPart def = g_array_index(tpl->block_defaults, PugBlockPart, slot);
+    for (unsigned int i = 0; i < tpl->root->children_count; i++) {
+        ASTNode* child = tpl->root->children[i];
+        if (!child->block || child->block->slot != slot) continue;
+        PugBlockPart own = { child, tpl->level };
+        // append/prepend sin partes previas parten del contenido por defecto
+        // (salvo que el bloque sólo exista en esta plantilla)
+        if (out->len == 0 && child->block->mode != PUG_BLOCK_REPLACE && def.node != child) {
+            g_array_append_val(out, def);
+        }
+        switch (child->block->mode) {
+            case PUG_BLOCK_APPEND:
+                g_array_append_val(out, own);
+                break;
+            case PUG_BLOCK_PREPEND:
+                g_array_prepend_val(out, own);
+                break;
+            default:
+                g_array_set_size(out, 0);
+                g_array_append_val(out, own);
+                break;
+        }
+    }
+}
+
+// Construye la tabla de bloques de una plantilla con extends
+static inline PugBlockTable* template_build_blocks(PugTemplate* tpl) {
+    PugBlockTable* table = g_new0(PugBlockTable, 1);
+    unsigned int n_slots = tpl->block_defaults->len;
+    table->n_slots = n_slots;
+    table->names = g_new(const char*, n_slots ? n_slots : 1);
+    table->first = g_new(unsigned int, n_slots + 1);
+
+    GArray* parts = g_array_new(FALSE, FALSE, sizeof(PugBlockPart));
+    GArray* slot_parts = g_array_new(FALSE, FALSE, sizeof(PugBlockPart));
+    for (unsigned int s = 0; s < n_slots; s++) {
+        table->names[s] = g_array_index(tpl->block_defaults, PugBlockPart, s).node->block->name;
+        template_block_slot_parts(tpl, s, slot_parts);
+        table->first[s] = parts->len;
+        g_array_append_vals(parts, slot_parts->data, slot_parts->len);
+    }
+    table->first[n_slots] = parts->len;
+    g_array_free(slot_parts, TRUE);
+    table->parts = (PugBlockPart*)g_array_free(parts, FALSE);
+
+    // Ámbitos de la caché de fragmentos: el contenido del layout depende de
+    // la hija, así que cada nivel lleva también el nombre de la hija
+    table->n_levels = tpl->level + 1;
+    table->scopes = g_new0(char*, table->n_levels);
+    for (PugTemplate* t = tpl; t; t = t->extends) {
+        table->scopes[t->level] = t == tpl ? g_strdup(tpl->scope) : g_strconcat(tpl->scope, "\x1e", t->scope, NULL);
+    }
+
+    // Código suelto de las hijas (`- var titulo = ...`): se ejecuta antes del
+    // layout, de la más cercana al layout a la más lejana
+    const PugBlockTable* inherited = tpl->extends->blocks;
+    unsigned int n_inherited = inherited ? inherited->n_prelude : 0;
+    table->prelude = g_new(ASTNode*, n_inherited + tpl->root->children_count + 1);
+    if (n_inherited) memcpy(table->prelude, inherited->prelude, sizeof(ASTNode*) * n_inherited);
+    table->n_prelude = n_inherited;
+    for (unsigned int i = 0; i < tpl->root->children_count; i++) {
+        ASTNode* child = tpl->root->children[i];
+        if (child->node_type == TOKEN_CODE && child->expr) table->prelude[table->n_prelude++] = child;
+    }
+    return table;
+}
+
+static inline void template_link_blocks(PugTemplate* tpl) {
+    PugTemplate* parent = tpl->extends;
+    tpl->block_slots = g_hash_table_new(g_str_hash, g_str_equal);
+    tpl->block_defaults = g_array_new(FALSE, FALSE, sizeof(PugBlockPart));
+    if (parent) {
+        GHashTableIter iter;
+        gpointer name, slot;
+        g_hash_table_iter_init(&iter, parent->block_slots);
+        while (g_hash_table_iter_next(&iter, &name, &slot)) g_hash_table_insert(tpl->block_slots, name, slot);
+        g_array_append_vals(tpl->block_defaults, parent->block_defaults->data, parent->block_defaults->len);
+        tpl->level = parent->level + 1;
+        tpl->layout = parent->layout ? parent->layout : parent;
+    }
+    template_number_blocks(tpl, tpl->root);
+    if (parent) tpl->blocks = template_build_blocks(tpl);
+}
+
+// ============================================================================
+// DEPENDENCIAS DE LOS BLOQUES `cache`
+// ============================================================================
+// El parser deduce las dependencias de un `cache` sin declarar a partir de su
+// subárbol literal. Con las llamadas ya enlazadas se añaden las locales que
+// leen los cuerpos de los mixins llamados y las plantillas incluidas. Un
+// bloque con nombre lo puede sobrescribir una plantilla hija que aún no se
+// conoce: con uno dentro el `cache` no se puede cachear sin declarar nada.
+
+// Recoge en names las locales de node y de lo que renderiza a través de
+// llamadas e includes. visited evita recorrer dos veces el mismo cuerpo (y
+// los mixins recursivos). Devuelve 0 si el subárbol tiene un bloque con nombre.
+static inline int template_collect_cache_deps(ASTNode* node, GPtrArray* names, GHashTable* visited) {
+    if (node->node_type == TOKEN_BLOCK && node->block) return 0;
+    fragment_collect_node_deps(node, names);
+
+    ASTNode* linked = NULL;
+    if (node->node_type == TOKEN_CALL && node->call && node->call->mixin) linked = node->call->mixin->node;
+    if (node->node_type == TOKEN_INCLUDE && node->include) linked = node->include->root;
+    if (linked && !g_hash_table_contains(visited, linked)) {
+        g_hash_table_add(visited, linked);
+        for (unsigned int i = 0; i < linked->children_count; i++) {
+            if (!template_collect_cache_deps(linked->children[i], names, visited)) return 0;
+        }
+    }
+
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        if (!template_collect_cache_deps(node->children[i], names, visited)) return 0;
+    }
+    return 1;
+}
+
+static inline void template_link_cache_deps(PugTemplate* tpl, ASTNode* node) {
+    if (node->node_type == TOKEN_CACHE && node->cache_deps == PUG_CACHE_DEPS_INFERRED) {
+        GPtrArray* names = g_ptr_array_new_with_free_func(g_free);
+        GHashTable* visited = g_hash_table_new(g_direct_hash, g_direct_equal);
+        int known = 1;
+        for (unsigned int i = 0; known && i < node->children_count; i++) {
+            known = template_collect_cache_deps(node->children[i], names, visited);
+        }
+        g_hash_table_destroy(visited);
+
+        pug_text_free(node->text);
+        node->text = NULL;
+        if (known) {
+            g_ptr_array_add(names, NULL);
+            g_free(node->text_content);
+            node->text_content = g_strjoinv(" ", (gchar**)names->pdata);
+            node->text = template_compile_cache_deps(tpl, node->text_content);
+        } else {
+            node->cache_deps = PUG_CACHE_DEPS_UNKNOWN;
+        }
+        g_ptr_array_free(names, TRUE);
+    }
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        template_link_cache_deps(tpl, node->children[i]);
+    }
+}
+
+// ============================================================================
+// OPTIMIZACIÓN DE LLAMADAS
+// ============================================================================
+// Un mixin es puro si su salida sólo depende de sus argumentos: lee
+// únicamente sus parámetros, `attributes`, el resto y las variables de sus
+// propios bucles, no escribe locales, no usa `block` ni `cache` y sólo llama
+// a mixins puros. Las llamadas a mixins puros con argumentos constantes y sin
+// contenido se renderizan una vez por contexto de salida y después se copian
+// como bytes (render_call_constant); con memo activo, el resto de llamadas a
+// mixins puros se guardan por el valor de sus argumentos (render_call_memo).
+enum {
+    PUG_MIXIN_PURITY_UNKNOWN = 0,
+    PUG_MIXIN_PURITY_PENDING,   // Analizándose (una llamada recursiva no es pura)
+    PUG_MIXIN_PURITY_PURE,
+    PUG_MIXIN_PURITY_IMPURE
+};
+
+// La expresión sólo lee slots permitidos y no escribe ninguno
+static inline int template_expr_pure(const PugExpr* expr, const guint8* allowed) {
+    if (!expr) return 1;
+    if (expr->slot >= 0 && !allowed[expr->slot]) return 0;
+    for (unsigned int i = 0; i < expr->code_len; i++) {
+        if (expr->code[i].op == PUG_OP_STOREL) return 0;
+        if (expr->code[i].op == PUG_OP_LOADL && !allowed[PUG_INSTR_BX(expr->code[i])]) return 0;
+    }
+    return 1;
+}
+
+static inline int template_mixin_pure(PugTemplate* tpl, PugMixin* mixin, unsigned int* purity);
+
+static inline int template_node_pure(PugTemplate* tpl, ASTNode* node, guint8* allowed, unsigned int* purity) {
+    switch (node->node_type) {
+        case TOKEN_CACHE:
+            return 0;
+        case TOKEN_BLOCK:
+            // Con nombre, una plantilla hija lo puede sobrescribir
+            return 0;
+        case TOKEN_INCLUDE:
+            if (node->include && !template_node_pure(tpl, node->include->root, allowed, purity)) return 0;
+            break;
+        case TOKEN_CALL:
+            if (!node->call || !node->call->mixin) break;
+            if (!template_mixin_pure(tpl, node->call->mixin, purity)) return 0;
+            for (unsigned int i = 0; i < node->call->n_args; i++) {
+                if (!template_expr_pure(node->call->args[i], allowed)) return 0;
+            }
+            for (unsigned int i = 0; i < node->call->n_attrs; i++) {
+                if (!template_expr_pure(node->call->attr_values[i], allowed)) return 0;
+            }
+            break;
+        default:
+            break;
+    }
+    if (!template_expr_pure(node->expr, allowed)) return 0;
+    if (node->text) {
+        for (unsigned int i = 0; i < node->text->count; i++) {
+            PugSegment* seg = &node->text->segments[i];
+            if (seg->type == SEGMENT_LITERAL) continue;
+            if (seg->expr ? !template_expr_pure(seg->expr, allowed) : !allowed[seg->slot]) return 0;
+        }
+    }
+    if (node->attributes) {
+        for (unsigned int i = 0; i < node->attributes->count; i++) {
+            Attribute* attr = node->attributes->attributes[i];
+            if (attr && !template_expr_pure(attr->expr, allowed)) return 0;
+        }
+    }
+
+    // Las variables de un bucle sólo son propias dentro de su cuerpo
+    guint8 saved_value = 0, saved_key = 0;
+    if (node->loop) {
+        saved_value = allowed[node->loop->value_slot];
+        saved_key = allowed[node->loop->key_slot];
+        allowed[node->loop->value_slot] = 1;
+        if (node->loop->has_key) allowed[node->loop->key_slot] = 1;
+    }
+    int pure = 1;
+    for (unsigned int i = 0; pure && i < node->children_count; i++) {
+        pure = template_node_pure(tpl, node->children[i], allowed, purity);
+    }
+    if (node->loop) {
+        allowed[node->loop->key_slot] = saved_key;
+        allowed[node->loop->value_slot] = saved_value;
+    }
+    return pure;
+}
+
+// purity: estado de cada mixin, indexado como tpl->mixins
+static inline int template_mixin_pure(PugTemplate* tpl, PugMixin* mixin, unsigned int* purity) {
+    guint index = 0;
+    // Mixin de una plantilla incluida: ya se analizó al compilarla
+    if (!g_ptr_array_find(tpl->mixins, mixin, &index)) return mixin->pure;
+    if (purity[index] != PUG_MIXIN_PURITY_UNKNOWN) return purity[index] == PUG_MIXIN_PURITY_PURE;
+
+    purity[index] = PUG_MIXIN_PURITY_PENDING;
+    guint8* allowed = g_new0(guint8, tpl->symbols->names->len + 1);
+    for (unsigned int i = 0; i < mixin->n_params; i++) allowed[mixin->param_slots[i]] = 1;
+    if (mixin->rest_slot >= 0) allowed[mixin->rest_slot] = 1;
+    allowed[mixin->attributes_slot] = 1;
+    int pure = 1;
+    for (unsigned int i = 0; i < mixin->node->children_count && pure; i++) {
+        pure = template_node_pure(tpl, mixin->node->children[i], allowed, purity);
+    }
+    g_free(allowed);
+    purity[index] = pure ? PUG_MIXIN_PURITY_PURE : PUG_MIXIN_PURITY_IMPURE;
+    return pure;
+}
+
+// Marca las llamadas constantes: mixin puro, sin contenido para `block` y
+// con todos los argumentos y atributos constantes
+static inline void template_mark_constant_calls(ASTNode* node) {
+    PugCall* call = node->call;
+    if (call && call->mixin && call->mixin->pure && node->children_count == 0) {
+        int constant = 1;
+        for (unsigned int i = 0; constant && i < call->n_args; i++) {
+            constant = pug_expr_is_constant(call->args[i], NULL);
+        }
+        for (unsigned int i = 0; constant && i < call->n_attrs; i++) {
+            constant = pug_expr_is_constant(call->attr_values[i], NULL);
+        }
+        call->constant = constant;
+    }
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        template_mark_constant_calls(node->children[i]);
+    }
+}
+
+static inline void template_optimize_calls(PugTemplate* tpl) {
+    if (tpl->mixins->len == 0) return;
+    unsigned int* purity = g_new0(unsigned int, tpl->mixins->len);
+    for (guint i = 0; i < tpl->mixins->len; i++) {
+        PugMixin* mixin = (PugMixin*)g_ptr_array_index(tpl->mixins, i);
+        mixin->pure = template_mixin_pure(tpl, mixin, purity);
+    }
+    g_free(purity);
+    template_mark_constant_calls(tpl->root);
+}
+
+// Mínimo de `when` constantes para resolver un case con tabla hash en lugar
+// de comparar en cascada
+#define PUG_CASE_TABLE_MIN 4
+
+// Compila la condición de un if / unless / else if / when. Devuelve 0 si la
+// tiene pero no compila.
+static inline int template_compile_condition(PugTemplate* tpl, ASTNode* node) {
+    if (!node->text_content || !*node->text_content) return 1;
+    node->expr = template_compile_expr(tpl, node->text_content, strlen(node->text_content), 0);
+    return node->expr != NULL;
+}
+
+// Enlaza cada if / unless / each con los else que le siguen: el primer
+// eslabón guarda dónde termina la cadena para saltar allí tras renderizar
+// una rama. Si alguna condición no compila la cadena entera se queda sin
+// saltos y se muestra como comentario de depuración.
+static inline void template_link_branches(ASTNode* parent) {
+    for (unsigned int i = 0; i < parent->children_count; i++) {
+        ASTNode* head = parent->children[i];
+        int ok;
+        if (head->node_type == TOKEN_IF || head->node_type == TOKEN_UNLESS) ok = head->expr != NULL;
+        else if (head->node_type == TOKEN_EACH) ok = head->loop != NULL;
+        else continue;
+
+        unsigned int end = i + 1;
+        while (end < parent->children_count && parent->children[end]->node_type == TOKEN_ELSE) {
+            ASTNode* link = parent->children[end++];
+            int conditional = link->text_content && *link->text_content;
+            if (conditional && (!link->expr || head->node_type == TOKEN_EACH)) ok = 0;
+            if (!conditional) break;
+        }
+        if (head->node_type == TOKEN_EACH && end == i + 1) continue;
+        if (ok) {
+            head->branch = g_new0(PugBranch, 1);
+            head->branch->end = end;
+            head->branch->negate = head->node_type == TOKEN_UNLESS;
+        }
+        i = end - 1;
+    }
+}
+
+// Enlaza un `case` con su sujeto ya compilado: resuelve a qué cuerpo cae
+// cada when y, si todos los valores son constantes y hay suficientes, los
+// indexa en una tabla hash para elegir la rama con una sola búsqueda.
+static inline void template_link_case(ASTNode* node) {
+    if (!node->expr) return;
+
+    unsigned int whens = 0, constant = 0;
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        ASTNode* child = node->children[i];
+        if (child->node_type == TOKEN_DEFAULT) continue;
+        if (child->node_type != TOKEN_WHEN || !child->expr) return;
+        whens++;
+        if (pug_expr_is_constant(child->expr, NULL)) constant++;
+    }
+
+    PugBranch* branch = g_new0(PugBranch, 1);
+    branch->targets = g_new(unsigned int, node->children_count ? node->children_count : 1);
+    unsigned int target = node->children_count;
+    for (unsigned int i = node->children_count; i-- > 0;) {
+        ASTNode* child = node->children[i];
+        if (child->children_count > 0 || child->node_type == TOKEN_DEFAULT) target = i;
+        branch->targets[i] = target;
+        if (child->node_type == TOKEN_DEFAULT) branch->fallback = i + 1;
+    }
+
+    if (whens >= PUG_CASE_TABLE_MIN && constant == whens) {
+        // Las claves apuntan a las constantes de cada when (de la plantilla)
+        branch->table = g_hash_table_new(pug_expr_value_hash, pug_expr_value_equal);
+        for (unsigned int i = 0; i < node->children_count; i++) {
+            PugExpr* expr = node->children[i]->expr;
+            if (node->children[i]->node_type != TOKEN_WHEN) continue;
+            PugValue* key = &expr->constants[PUG_INSTR_BX(expr->code[0])];
+            if (!g_hash_table_contains(branch->table, key)) {
+                g_hash_table_insert(branch->table, key, GUINT_TO_POINTER(i + 1));
+            }
+        }
+    }
+    node->branch = branch;
+}
+
+static inline void template_compile_case(PugTemplate* tpl, ASTNode* node) {
+    if (template_compile_condition(tpl, node)) template_link_case(node);
+}
+
+// Recorre el árbol resolviendo locales a slots y compilando expresiones
+static inline void template_compile_node(PugTemplate* tpl, ASTNode* node) {
+    if (!node) return;
+    switch (node->node_type) {
+        case TOKEN_TAG:
+            node->tag_info = pug_tag_lookup(node->tag);
+            template_compile_attributes(tpl, node);
+            render_prepare_static_tag(node);
+            node->text = template_compile_text(tpl, node->text_content, 0);
+            break;
+        case TOKEN_TEXT:
+        case TOKEN_PIPE:
+        case TOKEN_DOT:
+            node->text = template_compile_text(tpl, node->text_content, 0);
+            break;
+        case TOKEN_INTERPOLATION: {
+            // Nodo suelto: su contenido es el nombre de la local
+            char* wrapped = g_strconcat("#{", node->text_content ? node->text_content : "", "}", NULL);
+            node->text = template_compile_text(tpl, wrapped, 1);
+            g_free(wrapped);
+            break;
+        }
+        case TOKEN_CACHE:
+            node->text = template_compile_cache_deps(tpl, node->text_content);
+            break;
+        case TOKEN_EACH:
+            // Si no compila se muestra como comentario, igual que el código
+            template_compile_each(tpl, node);
+            break;
+        case TOKEN_CODE:
+            // Si no compila se sigue mostrando como comentario de depuración
+            if (node->text_content) {
+                node->expr = template_compile_expr(tpl, node->text_content, strlen(node->text_content), 1);
+            }
+            break;
+        case TOKEN_IF:
+        case TOKEN_UNLESS:
+        case TOKEN_ELSE:
+        case TOKEN_WHEN:
+            template_compile_condition(tpl, node);
+            break;
+        case TOKEN_MIXIN:
+            template_compile_mixin(tpl, node);
+            break;
+        case TOKEN_CALL:
+            template_compile_call(tpl, node);
+            break;
+        case TOKEN_INCLUDE:
+        case TOKEN_EXTENDS:
+            template_compile_include(tpl, node);
+            break;
+        case TOKEN_BLOCK:
+            template_compile_block(node);
+            break;
+        default:
+            break;
+    }
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        template_compile_node(tpl, node->children[i]);
+    }
+    // Los saltos se resuelven con los hijos ya compilados
+    if (node->node_type == TOKEN_CASE) template_compile_case(tpl, node);
+    template_link_branches(node);
+}
+
+// Memoria aproximada de un subárbol compilado (para el presupuesto del loader)
+static inline gsize template_node_bytes(const ASTNode* node) {
+    gsize bytes = sizeof(ASTNode) + sizeof(ASTNode*);
+    if (node->tag) bytes += strlen(node->tag) + 1;
+    if (node->text_content) bytes += strlen(node->text_content) + 1;
+    if (node->attributes) bytes += node->attributes->count * (sizeof(Attribute) + sizeof(Attribute*));
+    if (node->open_tag) bytes += sizeof(PugStaticTag) + node->open_tag->len[0] * 3;
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        bytes += template_node_bytes(node->children[i]);
+    }
+    return bytes;
+}
+
+// Plantilla vacía, sin árbol todavía
+static inline PugTemplate* template_new(const char* name, PugSymbols* symbols,
+                                        PugResolveFunc resolve, gpointer resolve_data) {
+    PugTemplate* tpl = g_new0(PugTemplate, 1);
+    // Una recompilación no comparte fragmentos con la versión anterior
+    static gint serial = 0;
+    tpl->name = g_strdup(name ? name : "");
+    tpl->scope = g_strdup_printf("%s\x1f%u", tpl->name, (guint)g_atomic_int_add(&serial, 1));
+    tpl->ref_count = 1;
+    tpl->uses = g_ptr_array_new_with_free_func((GDestroyNotify)pug_template_free);
+    if (symbols) {
+        tpl->symbols = symbols;
+    } else {
+        pug_symbols_init(&tpl->own_symbols);
+        tpl->symbols = &tpl->own_symbols;
+    }
+    tpl->resolve = resolve;
+    tpl->resolve_data = resolve_data;
+    tpl->exprs = g_ptr_array_new_with_free_func((GDestroyNotify)pug_expr_free);
+    tpl->mixins = g_ptr_array_new_with_free_func((GDestroyNotify)pug_mixin_free);
+    tpl->mixin_names = g_hash_table_new(g_str_hash, g_str_equal);
+    return tpl;
+}
+
+// Enlaces que sólo dependen del árbol ya compilado: llamadas con su mixin,
+// bloques de la cadena extends, dependencias de los `cache` y llamadas
+// constantes
+static inline void template_finish(PugTemplate* tpl) {
+    template_link_calls(tpl, tpl->root);
+    template_link_blocks(tpl);
+    template_link_cache_deps(tpl, tpl->root);
+    tpl->slot_count = tpl->symbols->names->len;
+    template_optimize_calls(tpl);
+    tpl->bytes = sizeof(PugTemplate) + template_node_bytes(tpl->root) + tpl->exprs->len * sizeof(PugExpr) +
+                 tpl->mixins->len * sizeof(PugMixin);
+    tpl->resolve = NULL;
+    tpl->resolve_data = NULL;
+}
+
+// Compila una plantilla: tokeniza, parsea y resuelve las locales a slots.
+// Con symbols != NULL los slots se comparten con otras plantillas (así una
+// plantilla incluida se renderiza con el frame de quien la incluye) y
+// resolve carga los include/extends.
+static inline PugTemplate* pug_template_compile_with(const char* content, const char* name, PugSymbols* symbols,
+                                                     PugResolveFunc resolve, gpointer resolve_data) {
+    if (!content) return NULL;
+
+    TokenList* tokens = tokenize_file(content);
+    if (!tokens) {
+        g_print("Error: Fallo en tokenización\n");
+        return NULL;
+    }
+
+    ParserContext* ctx = parser_context_create();
+    if (!ctx) {
+        token_list_free(tokens);
+        g_print("Error: Fallo en creación de ParserContext\n");
+        return NULL;
+    }
+    ctx->tokens = tokens;
+
+    ASTNode* root = parse_pug(ctx);
+    if (!root) {
+        parser_context_free(ctx);
+        g_print("Error: Fallo en parsing\n");
+        return NULL;
+    }
+
+    // La plantilla se queda con el árbol; los tokens ya no hacen falta
+    ctx->root_node = NULL;
+    parser_context_free(ctx);
+
+    PugTemplate* tpl = template_new(name, symbols, resolve, resolve_data);
+    tpl->root = root;
+    template_compile_node(tpl, root);
+    template_finish(tpl);
+    return tpl;
+}
+
+static inline PugTemplate* pug_template_compile(const char* content, const char* name) {
+    return pug_template_compile_with(content, name, NULL, NULL, NULL);
+}
+
+// Toma una referencia más a la plantilla (para usarla desde otro hilo
+// mientras el loader puede recompilarla o expulsarla)
+static inline PugTemplate* pug_template_ref(PugTemplate* tpl) {
+    if (tpl) g_atomic_int_inc(&tpl->ref_count);
+    return tpl;
+}
+
+// Suelta una referencia; la última libera la plantilla y las que usa
+static inline void pug_template_free(PugTemplate* tpl) {
+    if (!tpl || !g_atomic_int_dec_and_test(&tpl->ref_count)) return;
+    ast_node_free(tpl->root);
+    if (tpl->memo) pug_fragment_cache_free(tpl->memo);
+    g_hash_table_destroy(tpl->mixin_names);
+    if (tpl->block_slots) g_hash_table_destroy(tpl->block_slots);
+    if (tpl->block_defaults) g_array_free(tpl->block_defaults, TRUE);
+    pug_block_table_free(tpl->blocks);
+    g_ptr_array_free(tpl->mixins, TRUE);
+    g_ptr_array_free(tpl->uses, TRUE);
+    g_ptr_array_free(tpl->exprs, TRUE);
+    if (tpl->symbols == &tpl->own_symbols) pug_symbols_clear(&tpl->own_symbols);
+    g_free(tpl->name);
+    g_free(tpl->scope);
+    g_free(tpl);
+}
+
+// Número de locales distintas que usa la plantilla
+static inline unsigned int pug_template_slot_count(const PugTemplate* tpl) {
+    return tpl ? tpl->slot_count : 0;
+}
+
+// Activa la memoización de llamadas a mixins puros con argumentos variables,
+// con hasta max_bytes de salidas guardadas (0 la desactiva). Se configura
+// antes de renderizar; las llamadas constantes no la necesitan.
+static inline void pug_template_set_mixin_memo(PugTemplate* tpl, gsize max_bytes) {
+    if (!tpl) return;
+    if (tpl->memo) pug_fragment_cache_free(tpl->memo);
+    tpl->memo = max_bytes ? pug_fragment_cache_new(max_bytes) : NULL;
+}
+
+// Slot de una local o -1 si la plantilla no la usa
+static inline int pug_template_slot(const PugTemplate* tpl, const char* name) {
+    return tpl ? pug_symbols_lookup(tpl->symbols, name) : -1;
+}
+
+// ============================================================================
+// LOCALES
+// ============================================================================
+// Frame de valores de una plantilla, indexado por slot. Se enlaza una vez
+// (por slot o por nombre) y se puede reutilizar en tantos renders como haga
+// falta, también con otras plantillas del mismo loader.
+typedef struct {
+    const PugTemplate* tpl;
+    PugValue* values;
+    unsigned int count;
+} PugLocals;
+
+static inline PugLocals* pug_locals_new(const PugTemplate* tpl) {
+    if (!tpl) return NULL;
+    PugLocals* locals = g_new0(PugLocals, 1);
+    locals->tpl = tpl;
+    locals->count = pug_template_slot_count(tpl);
+    locals->values = g_new0(PugValue, locals->count ? locals->count : 1);
+    return locals;
+}
+
+static inline void pug_locals_free(PugLocals* locals) {
+    if (!locals) return;
+    g_free(locals->values);
+    g_free(locals);
+}
+
+// Deja todas las locales sin valor
+static inline void pug_locals_reset(PugLocals* locals) {
+    if (locals) memset(locals->values, 0, sizeof(PugValue) * locals->count);
+}
+
+static inline void pug_locals_set(PugLocals* locals, unsigned int slot, PugValue value) {
+    if (locals && slot < locals->count) locals->values[slot] = value;
+}
+
+// Enlaza por nombre. Devuelve 0 si la plantilla no usa esa local.
+static inline int pug_locals_set_by_name(PugLocals* locals, const char* name, PugValue value) {
+    if (!locals) return 0;
+    int slot = pug_template_slot(locals->tpl, name);
+    if (slot < 0 || (unsigned int)slot >= locals->count) return 0;
+    locals->values[slot] = value;
+    return 1;
+}
+
+static inline int pug_locals_set_string(PugLocals* locals, const char* name, const char* str) {
+    return pug_locals_set_by_name(locals, name, pug_value_string(str));
+}
+
+static inline int pug_locals_set_number(PugLocals* locals, const char* name, double n) {
+    return pug_locals_set_by_name(locals, name, pug_value_number(n));
+}
+
+static inline int pug_locals_set_bool(PugLocals* locals, const char* name, gboolean b) {
+    return pug_locals_set_by_name(locals, name, pug_value_bool(b));
+}
+
+// ============================================================================
+// RENDER DE PLANTILLAS
+// ============================================================================
+
+// Slots que caben en el frame de la pila; más allá se reserva en el heap
+#define PUG_TEMPLATE_STACK_FRAME 32
+
+// Renderiza tpl sobre un frame y una arena del llamador. frame tiene sitio
+// para al menos pug_template_slot_count(tpl) valores; se sobrescribe entero.
+static inline void template_render_frame(const PugTemplate* tpl, const PugLocals* locals, PugSink* sink,
+                                         PugParallelRenderer* renderer, PugValue* frame, PugArena* arena,
+                                         unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    unsigned int count = pug_template_slot_count(tpl);
+
+    // Las locales valen para cualquier plantilla con los mismos slots; las
+    // creadas antes de compilar otras plantillas del loader son más cortas
+    unsigned int bound = 0;
+    if (locals && locals->tpl->symbols == tpl->symbols) {
+        bound = locals->count < count ? locals->count : count;
+        memcpy(frame, locals->values, sizeof(PugValue) * bound);
+    }
+    memset(frame + bound, 0, sizeof(PugValue) * (count - bound));
+
+    // Con extends se renderiza el árbol del layout con los bloques de tpl
+    const PugBlockTable* blocks = tpl->blocks;
+    sink->scope = blocks ? blocks->scopes[0] : tpl->scope;
+    sink->blocks = blocks;
+    // Una plantilla sellada no cachea nada en sus propias páginas
+    sink->sealed = tpl->sealed;
+    if (!sink->memo && !tpl->sealed) sink->memo = tpl->memo;
+    sink->frame = frame;
+    sink->frame_size = count;
+    sink->arena = arena;
+    for (unsigned int i = 0; blocks && i < blocks->n_prelude; i++) {
+        sink_eval(sink, blocks->prelude[i]->expr);
+    }
+    render_sink_parallel(renderer, sink, tpl->layout ? tpl->layout->root : tpl->root, use_tabs, tab_size, minify);
+    sink->blocks = NULL;
+    sink->frame = NULL;
+    sink->frame_size = 0;
+    sink->arena = NULL;
+}
+
+// Renderiza la plantilla en un sink ya preparado. Cada render trabaja sobre
+// su propia copia del frame (las líneas `- var` escriben en ella) y su propia
+// arena de cadenas, así una misma plantilla y unas mismas locales se pueden
+// renderizar a la vez desde varios hilos. Con renderer != NULL los subárboles
+// grandes se reparten entre sus hilos.
+static inline void pug_template_render_sink(const PugTemplate* tpl, const PugLocals* locals, PugSink* sink,
+                                            PugParallelRenderer* renderer,
+                                            unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    PugValue stack_frame[PUG_TEMPLATE_STACK_FRAME];
+    unsigned int count = pug_template_slot_count(tpl);
+    PugValue* frame = count <= PUG_TEMPLATE_STACK_FRAME ? stack_frame : g_new(PugValue, count);
+    PugArena arena = { NULL, NULL, 0, 0 };
+
+    template_render_frame(tpl, locals, sink, renderer, frame, &arena, use_tabs, tab_size, minify);
+
+    pug_arena_clear(&arena);
+    if (frame != stack_frame) g_free(frame);
+}
+
+static inline void pug_template_render_to(const PugTemplate* tpl, const PugLocals* locals, GString* output,
+                                          unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!tpl || !output) return;
+    PugSink sink = { .gstr = output };
+    pug_template_render_sink(tpl, locals, &sink, NULL, use_tabs, tab_size, minify);
+}
+
+static inline char* pug_template_render(const PugTemplate* tpl, const PugLocals* locals,
+                                        unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!tpl) return NULL;
+    GString* output = g_string_new("");
+    pug_template_render_to(tpl, locals, output, use_tabs, tab_size, minify);
+    return g_string_free(output, FALSE);
+}
+
+// Como pug_template_render_to() pero repartiendo los subárboles grandes
+// entre los hilos de renderer (ver pug_parallel.h)
+static inline void pug_template_render_parallel_to(PugParallelRenderer* renderer, const PugTemplate* tpl,
+                                                   const PugLocals* locals, GString* output,
+                                                   unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!tpl || !output) return;
+    PugSink sink = { .gstr = output };
+    pug_template_render_sink(tpl, locals, &sink, renderer, use_tabs, tab_size, minify);
+}
+
+// Equivalentes de render_measure()/render_into() con locales
+static inline gsize pug_template_measure(const PugTemplate* tpl, const PugLocals* locals,
+                                         unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!tpl) return 0;
+    PugSink sink = { .gstr = NULL };
+    pug_template_render_sink(tpl, locals, &sink, NULL, use_tabs, tab_size, minify);
+    return sink.len;
+}
+
+static inline gsize pug_template_render_into(const PugTemplate* tpl, const PugLocals* locals, char* buf, gsize len,
+                                             unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!tpl || !buf) return 0;
+    PugSink sink = { .buf = buf, .cap = len };
+    pug_template_render_sink(tpl, locals, &sink, NULL, use_tabs, tab_size, minify);
+    return sink.len;
+}
+
+// ============================================================================
+// CONTEXTO DE RENDER POR HILO
+// ============================================================================
+// Las plantillas compiladas no cambian después de compilarse, así que varios
+// hilos pueden renderizar la misma sin locks. Lo que sí se escribe durante un
+// render (frame de locales, arena de cadenas, buffer de salida) vive en un
+// contexto propio de cada hilo que se reutiliza de un render al siguiente:
+// en régimen estable un render no reserva memoria.
+
+typedef struct {
+    PugArena arena;
+    PugValue* frame;
+    unsigned int frame_cap;
+    GString* output;
+} PugRenderContext;
+
+static inline PugRenderContext* pug_render_context_new(void) {
+    PugRenderContext* ctx = g_new0(PugRenderContext, 1);
+    if (!ctx) return NULL;
+    ctx->output = g_string_sized_new(4096);
+    return ctx;
+}
+
+static inline void pug_render_context_free(gpointer data) {
+    PugRenderContext* ctx = (PugRenderContext*)data;
+    if (!ctx) return;
+    pug_arena_clear(&ctx->arena);
+    g_free(ctx->frame);
+    g_string_free(ctx->output, TRUE);
+    g_free(ctx);
+}
+
+// Contexto del hilo actual; se libera al terminar el hilo
+static inline PugRenderContext* pug_render_context_get(void) {
+    static GPrivate context_key = G_PRIVATE_INIT(pug_render_context_free);
+    PugRenderContext* ctx = (PugRenderContext*)g_private_get(&context_key);
+    if (!ctx) {
+        ctx = pug_render_context_new();
+        g_private_set(&context_key, ctx);
+    }
+    return ctx;
+}
+
+// Renderiza tpl usando el frame y la arena de ctx, con los bloques `cache`
+// servidos desde fragments (NULL = sin caché). La salida se añade a output,
+// o a ctx->output (vaciado antes) si output es NULL.
+static inline void template_render_context_cached(const PugTemplate* tpl, const PugLocals* locals,
+                                                  PugRenderContext* ctx, GString* output, PugFragmentCache* fragments,
+                                                  unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    if (!tpl || !ctx) return;
+    unsigned int count = pug_template_slot_count(tpl);
+    if (count > ctx->frame_cap) {
+        g_free(ctx->frame);
+        ctx->frame_cap = count;
+        ctx->frame = g_new(PugValue, count);
+    }
+    if (!output) {
+        output = ctx->output;
+        g_string_truncate(output, 0);
+    }
+
+    PugSink sink = { .gstr = output };
+    sink.fragments = fragments;
+    template_render_frame(tpl, locals, &sink, NULL, ctx->frame, &ctx->arena, use_tabs, tab_size, minify);
+    pug_arena_reset(&ctx->arena);
+}
+
+// Renderiza tpl usando el frame y la arena de ctx. La salida se añade a
+// output, o a ctx->output (vaciado antes) si output es NULL.
+static inline void pug_template_render_context(const PugTemplate* tpl, const PugLocals* locals,
+                                               PugRenderContext* ctx, GString* output,
+                                               unsigned int use_tabs, unsigned int tab_size, unsigned int minify) {
+    template_render_context_cached(tpl, locals, ctx, output, NULL, use_tabs, tab_size, minify);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_TEMPLATE_H
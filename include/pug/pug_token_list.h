@@ -3,6 +3,7 @@
 
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
 #include "pug/pug_tokens.h"
 
 #ifdef __cplusplus
@@ -42,19 +43,48 @@ static inline void token_list_add(TokenList* list, Token* token) {
 
 
 
+static inline void token_free(Token* token) {
+    if (!token) return;
+    if (token->value) {
+        free(token->value);
+    }
+    if (token->attributes) {
+        attribute_list_free(token->attributes);
+    }
+    free(token);
+}
+
+// Sustituye remove tokens desde index por los n de insert (la lista se queda
+// con ellos y libera los quitados)
+static inline void token_list_splice(TokenList* list, unsigned int index, unsigned int remove,
+                                     Token** insert, unsigned int n) {
+    if (!list || index > list->count) return;
+    if (remove > list->count - index) remove = list->count - index;
+
+    unsigned int count = list->count - remove + n;
+    if (count > list->capacity) {
+        unsigned int new_capacity = list->capacity * 2;
+        if (new_capacity < count) new_capacity = count;
+        Token** new_tokens = (Token**)realloc(list->tokens, sizeof(Token*) * new_capacity);
+        if (!new_tokens) return;
+        list->tokens = new_tokens;
+        list->capacity = new_capacity;
+    }
+
+    for (unsigned int i = 0; i < remove; i++) {
+        token_free(list->tokens[index + i]);
+    }
+    memmove(list->tokens + index + n, list->tokens + index + remove,
+            sizeof(Token*) * (list->count - index - remove));
+    if (n) memcpy(list->tokens + index, insert, sizeof(Token*) * n);
+    list->count = count;
+}
+
 static inline void token_list_free(TokenList* list) {
     if (!list) return;
     
     for (unsigned int i = 0; i < list->count; i++) {
-        if (list->tokens[i]) {
-            if (list->tokens[i]->value) {
-                free(list->tokens[i]->value);
-            }
-            if (list->tokens[i]->attributes) {
-                attribute_list_free(list->tokens[i]->attributes);
-            }
-            free(list->tokens[i]);
-        }
+        token_free(list->tokens[i]);
     }
     
     free(list->tokens);
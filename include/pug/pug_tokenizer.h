@@ -3,6 +3,7 @@
 
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,6 +37,23 @@ static inline int count_indent_level(const gchar *line) {
     return level;
 }
 
+// Indica si en pos empieza la palabra clave kw seguida de espacio o fin de línea
+static inline int keyword_at(const gchar *line, unsigned int pos, const gchar *kw) {
+    size_t len = strlen(kw);
+    if (strncmp(&line[pos], kw, len) != 0) return 0;
+    return line[pos + len] == '\0' || line[pos + len] == ' ' || line[pos + len] == '\t';
+}
+
+// Indica si la línea con sangría indent_level cuelga de un `case`: su padre
+// es la última línea ya tokenizada con menos sangría
+static inline int parent_is_case(const TokenList *token_list, unsigned int indent_level) {
+    for (unsigned int i = token_list->count; i > 0; i--) {
+        const Token *token = token_list->tokens[i - 1];
+        if (token->depth < indent_level) return token->type == TOKEN_CASE;
+    }
+    return 0;
+}
+
 // Salta espacios y tabs al inicio
 static inline unsigned int skip_whitespace(const gchar *line, unsigned int pos) {
     while (line[pos] == ' ' || line[pos] == '\t') {
@@ -148,6 +166,62 @@ static inline void tokenize_line(TokenList *token_list, const gchar *line, unsig
         return;
     }
     
+    // Detectar CACHE (bloque cuyo renderizado se guarda en la caché de fragmentos)
+    if (keyword_at(line, pos, "cache")) {
+        pos += 5; // longitud de "cache"
+        pos = skip_whitespace(line, pos);
+        Token *token = create_token(TOKEN_CACHE, &line[pos], indent_level, line_number, column);
+        token_list_add(token_list, token);
+        return;
+    }
+    
+    // Detectar EACH / FOR (bucles sobre arrays u objetos)
+    if (keyword_at(line, pos, "each") || keyword_at(line, pos, "for")) {
+        pos += (line[pos] == 'e') ? 4 : 3;
+        pos = skip_whitespace(line, pos);
+        Token *token = create_token(TOKEN_EACH, &line[pos], indent_level, line_number, column);
+        token_list_add(token_list, token);
+        return;
+    }
+    
+    // Detectar append / prepend (abreviaturas de `block append|prepend`)
+    if (keyword_at(line, pos, "append") || keyword_at(line, pos, "prepend")) {
+        unsigned int start = pos;
+        pos += (line[pos] == 'a') ? 6 : 7;
+        gchar *mode = g_strndup(&line[start], pos - start);
+        pos = skip_whitespace(line, pos);
+        gchar *value = g_strconcat(mode, " ", &line[pos], NULL);
+        Token *token = create_token(TOKEN_BLOCK, value, indent_level, line_number, column);
+        token_list_add(token_list, token);
+        g_free(value);
+        g_free(mode);
+        return;
+    }
+
+    // Detectar condicionales (if / unless / else [if] / case / when / default)
+    // y block. when y default sólo son palabras clave dentro de un case; en
+    // otro sitio son etiquetas
+    {
+        static const struct { const gchar *kw; TokenType type; } conditionals[] = {
+            { "if", TOKEN_IF }, { "unless", TOKEN_UNLESS }, { "else", TOKEN_ELSE },
+            { "case", TOKEN_CASE }, { "when", TOKEN_WHEN }, { "default", TOKEN_DEFAULT },
+            { "block", TOKEN_BLOCK }
+        };
+        for (unsigned int k = 0; k < G_N_ELEMENTS(conditionals); k++) {
+            if (keyword_at(line, pos, conditionals[k].kw)) {
+                if ((conditionals[k].type == TOKEN_WHEN || conditionals[k].type == TOKEN_DEFAULT) &&
+                    !parent_is_case(token_list, indent_level)) {
+                    break;
+                }
+                pos += strlen(conditionals[k].kw);
+                pos = skip_whitespace(line, pos);
+                Token *token = create_token(conditionals[k].type, &line[pos], indent_level, line_number, column);
+                token_list_add(token_list, token);
+                return;
+            }
+        }
+    }
+    
     // Detectar CALL (para mixins, inicia con +)
     if (line[pos] == '+') {
         pos++;
@@ -202,7 +276,9 @@ static inline void tokenize_line(TokenList *token_list, const gchar *line, unsig
     // Procesar resto de la línea (tags, clases, ids, atributos, texto con interpolaciones)
     GString *buffer = g_string_new("");
         
-    printf("linea::%s\n",line);    
+    #ifdef DEBUG
+    printf("linea::%s\n",line);
+    #endif
 
     while (line[pos] != '\0') {
         gchar c = line[pos];        
@@ -237,6 +313,25 @@ static inline void tokenize_line(TokenList *token_list, const gchar *line, unsig
             Token *token = create_token(type, buffer->str, indent_level, line_number, column);
             token_list_add(token_list, token);
         }
+        // Detectar &attributes(expr): se añade como atributo "&attributes"
+        else if (c == '&' && strncmp(&line[pos], "&attributes(", 12) == 0) {
+            pos += 12;
+            g_string_assign(buffer, "&attributes=");
+            
+            int paren_level = 1;
+            while (line[pos] != '\0' && paren_level > 0) {
+                if (line[pos] == '(') paren_level++;
+                if (line[pos] == ')') paren_level--;
+                
+                if (paren_level > 0) {
+                    g_string_append_c(buffer, line[pos]);
+                }
+                pos++;
+            }
+            
+            Token *token = create_token(TOKEN_ATTRIBUTE, buffer->str, indent_level, line_number, column);
+            token_list_add(token_list, token);
+        }
         // Detectar ATRIBUTOS (paréntesis)
         else if (c == '(') {
             pos++;
@@ -274,7 +369,8 @@ static inline void tokenize_line(TokenList *token_list, const gchar *line, unsig
             pos = skip_whitespace(line, pos);
             
             // Si hay contenido después del espacio y no es un símbolo especial
-            if (line[pos] != '\0' && line[pos] != '#' && line[pos] != '.') {
+            // (#{ al principio del texto es una interpolación, no un id)
+            if (line[pos] != '\0' && (line[pos] != '#' || line[pos + 1] == '{') && line[pos] != '.') {
                 column = pos;
                 
                 // Procesar texto con posible interpolación
@@ -313,7 +409,8 @@ static inline void tokenize_line(TokenList *token_list, const gchar *line, unsig
                         token_list_add(token_list, token);
                     } else if (line[pos] == '#') {
                         // # solo, tratar como texto
-                        g_string_append_c(buffer, '#');
+                        Token *token = create_token(TOKEN_TEXT, "#", indent_level, line_number, pos);
+                        token_list_add(token_list, token);
                         pos++;
                     }
                 }
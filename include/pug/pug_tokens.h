@@ -29,6 +29,15 @@ typedef enum{
     TOKEN_EXTENDS,        // extends layout.pug
     TOKEN_MIXIN,         // mixin nombre(args)
     TOKEN_CALL,          // +mixin(args)
+    TOKEN_CACHE,         // cache [locals...] (fragmento cacheable)
+    TOKEN_EACH,          // each item, i in lista / for item in lista
+    TOKEN_IF,            // if condición
+    TOKEN_UNLESS,        // unless condición
+    TOKEN_ELSE,          // else / else if condición
+    TOKEN_CASE,          // case expresión
+    TOKEN_WHEN,          // when valor
+    TOKEN_DEFAULT,       // default (rama por defecto de case)
+    TOKEN_BLOCK,         // block [nombre] (contenido de un mixin o bloque con nombre)
     TOKEN_EOF,           // Fin del archivo
     TOKEN_COUNT          // Contador total de tokens (no es un token real)
 } TokenType;
@@ -48,6 +57,7 @@ typedef struct {
     char* name;
     char* value;
     AttributeType type;
+    struct PugExpr* expr;   // value compilado (ATTR_EXPRESSION); de la plantilla
 } Attribute;
 
 typedef struct {
@@ -71,9 +81,136 @@ typedef struct {
     unsigned int capacity;
 } TokenList;
 
+typedef enum{
+    SEGMENT_LITERAL,    // Texto fijo
+    SEGMENT_ESCAPED,    // #{expresión} (se escapa)
+    SEGMENT_RAW         // !{expresión} (sin escapar)
+} SegmentType;
+
+// Trozo de un texto compilado
+typedef struct {
+    SegmentType type;
+    unsigned int slot;      // Local (SEGMENT_ESCAPED / SEGMENT_RAW)
+    struct PugExpr* expr;   // Expresión; NULL si basta con leer slot
+    const char* text;       // Texto fijo (apunta dentro de PugText.literals)
+    unsigned int len;
+    const char* html[2];    // Texto fijo ya escapado: [0] tal cual, [1] con espacios colapsados
+    unsigned int html_len[2];
+} PugSegment;
+
+// Texto con las interpolaciones ya resueltas a slots de locales
+typedef struct {
+    PugSegment* segments;
+    unsigned int count;
+    char* literals;
+    char* escaped;          // Buffer de PugSegment.html
+} PugText;
+
+// Variables de un bucle `each`, resueltas a slots al compilar
+typedef struct {
+    unsigned int value_slot;
+    unsigned int key_slot;
+    unsigned int has_key;
+} PugLoop;
+
+// Saltos de un condicional, resueltos al compilar. Los índices son
+// posiciones entre los hijos del padre (if/unless/each) o del propio case.
+typedef struct {
+    unsigned int end;       // if/unless/each: primer hermano tras su cadena de else
+    unsigned int negate;    // unless
+    GHashTable* table;      // case: valor constante de cada when -> índice + 1 (NULL = en cascada)
+    unsigned int fallback;  // case: índice + 1 del default (0 = no hay)
+    unsigned int* targets;  // case: rama cuyo cuerpo se renderiza al elegir cada hijo (caída)
+} PugBranch;
+
+// Mixin compilado: los parámetros se resuelven a slots y el cuerpo son los
+// hijos de la propia definición, que no se copian en cada llamada
+typedef struct PugMixin {
+    char* name;
+    struct ASTNode* node;        // Definición (TOKEN_MIXIN)
+    unsigned int n_params;
+    unsigned int* param_slots;
+    struct PugExpr** defaults;   // Valor por defecto de cada parámetro (o NULL)
+    int rest_slot;               // ...resto: array con los argumentos sobrantes (-1 = no hay)
+    unsigned int attributes_slot; // Local `attributes` del cuerpo
+    unsigned int pure;           // La salida sólo depende de los argumentos (ver template_mixin_pure)
+} PugMixin;
+
+// HTML de una llamada constante ya renderizado en un contexto de salida
+typedef struct PugCallVariant {
+    int minify;
+    unsigned int use_tabs;
+    unsigned int tab_size;
+    int depth_offset;
+    unsigned int preserve_ws;
+    struct ASTNode* next_sibling; // Sólo cuenta en PUG_MINIFY_FULL (cierres opcionales)
+    char* html;
+    gsize len;
+    struct PugCallVariant* next;
+} PugCallVariant;
+
+// Llamada +nombre(args)(atributos), resuelta al compilar
+typedef struct {
+    PugMixin* mixin;             // Entrada de la tabla de mixins (NULL = no definido)
+    char* name;
+    unsigned int n_args;
+    struct PugExpr** args;
+    unsigned int n_attrs;
+    char** attr_names;
+    struct PugExpr** attr_values;
+    unsigned int constant;       // Mixin puro, argumentos constantes y sin `block`
+    PugCallVariant* variants;    // Salidas ya renderizadas de una llamada constante
+    gint n_variants;
+} PugCall;
+
+// include/extends resuelto: el árbol es el de la plantilla compartida (del
+// loader), no una copia
+typedef struct {
+    struct ASTNode* root;
+    char* name;                  // Ámbito de la plantilla en la caché de fragmentos
+} PugInclude;
+
+// Bloque con nombre: `block x`, `block append x` / `append x`,
+// `block prepend x` / `prepend x`
+typedef enum {
+    PUG_BLOCK_REPLACE = 0,
+    PUG_BLOCK_APPEND,
+    PUG_BLOCK_PREPEND
+} PugBlockMode;
+
+typedef struct {
+    char* name;
+    PugBlockMode mode;
+    unsigned int slot;           // Índice en la tabla de bloques de la cadena extends
+} PugBlock;
+
+// Origen de las dependencias de un bloque `cache`
+typedef enum {
+    PUG_CACHE_DEPS_DECLARED = 0, // Escritas tras la palabra clave
+    PUG_CACHE_DEPS_INFERRED,     // Deducidas del subárbol
+    PUG_CACHE_DEPS_UNKNOWN       // No se pueden deducir: el bloque no se cachea
+} PugCacheDeps;
+
+// Apertura de etiqueta con atributos estáticos (<li class="fila" ...),
+// precalculada para cada modo de salida (índice = minify)
+typedef struct {
+    char* html[3];
+    unsigned int len[3];
+} PugStaticTag;
+
 typedef struct ASTNode {
     char* tag;
     char* text_content;
+    PugText* text;          // text_content compilado (NULL si no hay plantilla)
+    struct PugExpr* expr;   // Código, colección, condición o valor de when; de la plantilla
+    PugLoop* loop;          // Variables de TOKEN_EACH
+    PugBranch* branch;      // Saltos de if/unless/each...else y case
+    PugCall* call;          // Llamada a mixin de TOKEN_CALL
+    PugMixin* mixin;        // Mixin de TOKEN_MIXIN; de la plantilla
+    PugInclude* include;    // Plantilla de TOKEN_INCLUDE / TOKEN_EXTENDS
+    PugBlock* block;        // Bloque con nombre de TOKEN_BLOCK
+    PugStaticTag* open_tag; // Apertura precalculada de TOKEN_TAG (NULL si es dinámica)
+    const struct PugTagInfo* tag_info; // Entrada de la tabla de etiquetas (NULL = sin clasificar)
     TokenType node_type;
     AttributeList* attributes;
     char** classes;
@@ -89,6 +226,7 @@ typedef struct ASTNode {
     unsigned int is_void;
     unsigned int is_inline;
     unsigned int is_block;
+    PugCacheDeps cache_deps;    // TOKEN_CACHE: de dónde salen sus dependencias
 } ASTNode;
 
 typedef struct {
@@ -0,0 +1,304 @@
+#ifndef PUG_VALUE_H
+#define PUG_VALUE_H
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// VALORES DE LOCALES
+// ============================================================================
+// Valor que se enlaza a una local de la plantilla. Las cadenas, arrays y
+// objetos no se copian: quien enlaza el valor debe mantenerlos vivos mientras
+// dure el render. null y undefined no se distinguen.
+typedef enum {
+    PUG_VALUE_NULL = 0,     // Sin valor (se renderiza como cadena vacía)
+    PUG_VALUE_BOOL,
+    PUG_VALUE_NUMBER,
+    PUG_VALUE_STRING,
+    PUG_VALUE_ARRAY,
+    PUG_VALUE_OBJECT
+} PugValueType;
+
+typedef struct PugValue {
+    PugValueType type;
+    union {
+        gboolean boolean;
+        double number;
+        struct {
+            const char* str;
+            gsize len;
+        } string;
+        struct {
+            const struct PugValue* items;
+            gsize count;
+        } array;
+        struct {
+            const char* const* keys;
+            const struct PugValue* values;
+            gsize count;
+        } object;
+    } as;
+} PugValue;
+
+// Tamaño del buffer que necesita pug_value_format_number()
+#define PUG_NUMBER_BUF_SIZE 32
+
+static inline PugValue pug_value_null(void) {
+    PugValue value;
+    memset(&value, 0, sizeof(value));
+    return value;
+}
+
+static inline PugValue pug_value_bool(gboolean b) {
+    PugValue value = pug_value_null();
+    value.type = PUG_VALUE_BOOL;
+    value.as.boolean = b ? TRUE : FALSE;
+    return value;
+}
+
+static inline PugValue pug_value_number(double n) {
+    PugValue value = pug_value_null();
+    value.type = PUG_VALUE_NUMBER;
+    value.as.number = n;
+    return value;
+}
+
+static inline PugValue pug_value_string_len(const char* str, gsize len) {
+    PugValue value = pug_value_null();
+    if (!str) return value;
+    value.type = PUG_VALUE_STRING;
+    value.as.string.str = str;
+    value.as.string.len = len;
+    return value;
+}
+
+static inline PugValue pug_value_string(const char* str) {
+    return pug_value_string_len(str, str ? strlen(str) : 0);
+}
+
+static inline PugValue pug_value_array(const PugValue* items, gsize count) {
+    PugValue value = pug_value_null();
+    value.type = PUG_VALUE_ARRAY;
+    value.as.array.items = items;
+    value.as.array.count = items ? count : 0;
+    return value;
+}
+
+// Objeto como dos arrays paralelos de claves y valores
+static inline PugValue pug_value_object(const char* const* keys, const PugValue* values, gsize count) {
+    PugValue value = pug_value_null();
+    value.type = PUG_VALUE_OBJECT;
+    value.as.object.keys = keys;
+    value.as.object.values = values;
+    value.as.object.count = (keys && values) ? count : 0;
+    return value;
+}
+
+// Valor de la propiedad name de un objeto (NULL si no existe)
+static inline const PugValue* pug_value_lookup_len(const PugValue* value, const char* name, gsize len) {
+    if (!value || value->type != PUG_VALUE_OBJECT) return NULL;
+    for (gsize i = 0; i < value->as.object.count; i++) {
+        const char* key = value->as.object.keys[i];
+        if (key && strncmp(key, name, len) == 0 && key[len] == '\0') {
+            return &value->as.object.values[i];
+        }
+    }
+    return NULL;
+}
+
+static inline const PugValue* pug_value_lookup(const PugValue* value, const char* name) {
+    return name ? pug_value_lookup_len(value, name, strlen(name)) : NULL;
+}
+
+// Veracidad al estilo JavaScript
+static inline gboolean pug_value_truthy(const PugValue* value) {
+    switch (value ? value->type : PUG_VALUE_NULL) {
+        case PUG_VALUE_BOOL:
+            return value->as.boolean;
+        case PUG_VALUE_NUMBER:
+            return value->as.number != 0 && value->as.number == value->as.number;
+        case PUG_VALUE_STRING:
+            return value->as.string.len > 0;
+        case PUG_VALUE_ARRAY:
+        case PUG_VALUE_OBJECT:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+// Conversión a número al estilo JavaScript (cadena vacía = 0, no numérica = NaN)
+static inline double pug_value_to_number(const PugValue* value) {
+    switch (value ? value->type : PUG_VALUE_NULL) {
+        case PUG_VALUE_BOOL:
+            return value->as.boolean ? 1 : 0;
+        case PUG_VALUE_NUMBER:
+            return value->as.number;
+        case PUG_VALUE_STRING: {
+            char buf[64];
+            const char* s = value->as.string.str;
+            gsize len = value->as.string.len;
+            while (len > 0 && g_ascii_isspace(*s)) { s++; len--; }
+            while (len > 0 && g_ascii_isspace(s[len - 1])) len--;
+            if (len == 0) return 0;
+            if (len >= sizeof(buf)) break;
+            memcpy(buf, s, len);
+            buf[len] = '\0';
+            char* end = NULL;
+            double n = g_ascii_strtod(buf, &end);
+            if (end == buf + len) return n;
+            break;
+        }
+        case PUG_VALUE_NULL:
+            return 0;
+        default:
+            break;
+    }
+    return 0.0 / 0.0;
+}
+
+// Formatea un número como lo haría JavaScript en los casos habituales:
+// enteros sin decimales y el resto con hasta 15 cifras significativas.
+// Devuelve la longitud escrita en buf (PUG_NUMBER_BUF_SIZE bytes).
+static inline gsize pug_value_format_number(double n, char* buf) {
+    if (n != n) {
+        memcpy(buf, "NaN", 4);
+        return 3;
+    }
+    if (n > G_MAXDOUBLE || n < -G_MAXDOUBLE) {
+        const char* inf = n > 0 ? "Infinity" : "-Infinity";
+        gsize len = strlen(inf);
+        memcpy(buf, inf, len + 1);
+        return len;
+    }
+    if (n >= -9007199254740992.0 && n <= 9007199254740992.0 && n == (double)(gint64)n) {
+        // Enteros (índices, cantidades...): sin pasar por printf
+        char digits[24];
+        gsize count = 0, len = 0;
+        guint64 v = n < 0 ? (guint64)(-(gint64)n) : (guint64)n;
+        do {
+            digits[count++] = (char)('0' + v % 10);
+            v /= 10;
+        } while (v);
+        if (n < 0) buf[len++] = '-';
+        while (count) buf[len++] = digits[--count];
+        buf[len] = '\0';
+        return len;
+    }
+    g_ascii_formatd(buf, PUG_NUMBER_BUF_SIZE, "%.15g", n);
+    return strlen(buf);
+}
+
+// Representación textual de un valor. Para cadenas devuelve el puntero
+// original; para el resto escribe en buf (PUG_NUMBER_BUF_SIZE bytes). Los
+// arrays se unen con comas en pug_value_append() y en el renderer; aquí
+// devuelven la cadena vacía.
+static inline const char* pug_value_to_text(const PugValue* value, char* buf, gsize* len) {
+    switch (value ? value->type : PUG_VALUE_NULL) {
+        case PUG_VALUE_STRING:
+            *len = value->as.string.len;
+            return value->as.string.str;
+        case PUG_VALUE_NUMBER:
+            *len = pug_value_format_number(value->as.number, buf);
+            return buf;
+        case PUG_VALUE_BOOL:
+            *len = value->as.boolean ? 4 : 5;
+            return value->as.boolean ? "true" : "false";
+        case PUG_VALUE_OBJECT:
+            *len = 15;
+            return "[object Object]";
+        default:
+            *len = 0;
+            return "";
+    }
+}
+
+// Añade la representación textual de un valor a un GString
+static inline void pug_value_append(GString* out, const PugValue* value) {
+    if (value && value->type == PUG_VALUE_ARRAY) {
+        for (gsize i = 0; i < value->as.array.count; i++) {
+            if (i > 0) g_string_append_c(out, ',');
+            pug_value_append(out, &value->as.array.items[i]);
+        }
+        return;
+    }
+    char buf[PUG_NUMBER_BUF_SIZE];
+    gsize len = 0;
+    const char* text = pug_value_to_text(value, buf, &len);
+    g_string_append_len(out, text, (gssize)len);
+}
+
+// ============================================================================
+// ARENA DE CADENAS TEMPORALES
+// ============================================================================
+// Las cadenas que crea una expresión (concatenaciones) viven en una arena que
+// se libera entera al terminar el render. Sólo reserva memoria la primera vez
+// que hace falta: un render sin concatenaciones no toca el heap.
+#define PUG_ARENA_BLOCK_SIZE 4096
+
+typedef struct {
+    GSList* blocks;
+    char* ptr;
+    gsize left;
+    gsize first_size;       // Tamaño del primer bloque (el que conserva reset)
+} PugArena;
+
+static inline char* pug_arena_alloc(PugArena* arena, gsize n) {
+    if (n > arena->left) {
+        gsize size = n > PUG_ARENA_BLOCK_SIZE ? n : PUG_ARENA_BLOCK_SIZE;
+        char* block = (char*)g_malloc(size);
+        if (!arena->blocks) arena->first_size = size;
+        arena->blocks = g_slist_prepend(arena->blocks, block);
+        arena->ptr = block;
+        arena->left = size;
+    }
+    char* p = arena->ptr;
+    arena->ptr += n;
+    arena->left -= n;
+    return p;
+}
+
+// Reserva n valores en la arena (alineados: las cadenas dejan el puntero en
+// cualquier posición)
+static inline PugValue* pug_arena_alloc_values(PugArena* arena, gsize n) {
+    gsize misalign = (gsize)arena->ptr % G_MEM_ALIGN;
+    if (misalign && G_MEM_ALIGN - misalign <= arena->left) {
+        arena->ptr += G_MEM_ALIGN - misalign;
+        arena->left -= G_MEM_ALIGN - misalign;
+    } else if (misalign) {
+        arena->left = 0;
+    }
+    return (PugValue*)pug_arena_alloc(arena, n * sizeof(PugValue));
+}
+
+static inline void pug_arena_clear(PugArena* arena) {
+    if (!arena) return;
+    g_slist_free_full(arena->blocks, g_free);
+    arena->blocks = NULL;
+    arena->ptr = NULL;
+    arena->left = 0;
+    arena->first_size = 0;
+}
+
+// Vacía la arena conservando su primer bloque: un render que reutiliza la
+// arena no vuelve a reservar mientras sus cadenas quepan en él
+static inline void pug_arena_reset(PugArena* arena) {
+    if (!arena || !arena->blocks) return;
+    GSList* first = g_slist_last(arena->blocks);
+    arena->blocks = g_slist_remove_link(arena->blocks, first);
+    g_slist_free_full(arena->blocks, g_free);
+    arena->blocks = first;
+    arena->ptr = (char*)first->data;
+    arena->left = arena->first_size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_VALUE_H
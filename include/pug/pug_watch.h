@@ -0,0 +1,209 @@
+#ifndef PUG_WATCH_H
+#define PUG_WATCH_H
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "pug/pug_loader.h"
+#include "pug/pug_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// VIGILANCIA DE PLANTILLAS (inotify)
+// ============================================================================
+// Observa el directorio raíz de un motor (y sus subdirectorios, también los
+// que se creen después). Cuando llega un evento espera a que pase un rato
+// sin más eventos (un editor que guarda genera varios seguidos), junta las
+// rutas cambiadas y recompila en el motor sólo esas plantillas y las que
+// dependen de ellas por include/extends (pug_registry_reload()). Los hilos que
+// renderizan a la vez pasan de la versión vieja a la nueva sin parar.
+//
+// Sólo existe en Linux; en otros sistemas pug_watch_new() devuelve NULL.
+
+#define PUG_WATCH_DEFAULT_DEBOUNCE_MS 3
+#define PUG_WATCH_MAX_WAIT_MS 100       // Tope de la espera con eventos continuos
+
+// Se llama después de cada tanda: changed son las rutas canónicas que
+// cambiaron (también las borradas) y reloaded las plantillas recompiladas
+typedef void (*PugWatchFunc)(const GPtrArray* changed, const GPtrArray* reloaded, gpointer data);
+
+typedef struct {
+    PugEngine* engine;
+    int fd;
+    GHashTable* dirs;           // wd -> ruta del directorio
+    guint debounce_ms;
+
+    // Estadísticas
+    guint64 batches;
+    guint64 reloads;
+    double last_ms;             // Última recompilación (sin la espera)
+} PugWatch;
+
+#ifdef __linux__
+
+#define PUG_WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_DELETE_SELF)
+
+// Vigila dir y sus subdirectorios (sin ocultos ni enlaces simbólicos)
+static inline void watch_add_tree(PugWatch* watch, const char* dir) {
+    int wd = inotify_add_watch(watch->fd, dir, PUG_WATCH_MASK);
+    if (wd < 0) {
+        g_print("Error: No se pudo vigilar %s: %s\n", dir, g_strerror(errno));
+        return;
+    }
+    g_hash_table_replace(watch->dirs, GINT_TO_POINTER(wd), g_strdup(dir));
+
+    GDir* handle = g_dir_open(dir, 0, NULL);
+    if (!handle) return;
+    const char* name;
+    while ((name = g_dir_read_name(handle)) != NULL) {
+        if (name[0] == '.') continue;
+        char* child = g_build_filename(dir, name, NULL);
+        if (g_file_test(child, G_FILE_TEST_IS_DIR) && !g_file_test(child, G_FILE_TEST_IS_SYMLINK)) {
+            watch_add_tree(watch, child);
+        }
+        g_free(child);
+    }
+    g_dir_close(handle);
+}
+
+// Crea un vigilante sobre la raíz del motor. debounce_ms == 0 usa el valor
+// por defecto.
+static inline PugWatch* pug_watch_new(PugEngine* engine, guint debounce_ms) {
+    if (!engine) return NULL;
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        g_print("Error: inotify no disponible: %s\n", g_strerror(errno));
+        return NULL;
+    }
+    PugWatch* watch = g_new0(PugWatch, 1);
+    watch->engine = engine;
+    watch->fd = fd;
+    watch->dirs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    watch->debounce_ms = debounce_ms ? debounce_ms : PUG_WATCH_DEFAULT_DEBOUNCE_MS;
+    watch_add_tree(watch, engine->loader->root);
+    return watch;
+}
+
+static inline void pug_watch_free(PugWatch* watch) {
+    if (!watch) return;
+    close(watch->fd);
+    g_hash_table_destroy(watch->dirs);
+    g_free(watch);
+}
+
+// Lee los eventos pendientes y anota en changed las rutas *.pug tocadas
+static inline void watch_read_events(PugWatch* watch, GHashTable* changed) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t len = read(watch->fd, buffer, sizeof(buffer));
+        if (len <= 0) return;
+        for (char* p = buffer; p < buffer + len;) {
+            struct inotify_event* event = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            const char* dir = (const char*)g_hash_table_lookup(watch->dirs, GINT_TO_POINTER(event->wd));
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+                g_hash_table_remove(watch->dirs, GINT_TO_POINTER(event->wd));
+                continue;
+            }
+            if (!dir || event->len == 0 || event->name[0] == '.') continue;
+
+            char* path = g_build_filename(dir, event->name, NULL);
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                watch_add_tree(watch, path);
+                g_free(path);
+            } else if (!(event->mask & IN_ISDIR) && g_str_has_suffix(event->name, ".pug")) {
+                g_hash_table_add(changed, path);
+            } else {
+                g_free(path);
+            }
+        }
+    }
+}
+
+// Espera eventos hasta timeout_ms (-1 = sin límite). Si llegan, espera a que
+// se calmen, recompila lo afectado y llama a func. Devuelve el número de
+// plantillas recompiladas, 0 si no hubo cambios o -1 si falló la espera.
+static inline int pug_watch_poll(PugWatch* watch, int timeout_ms, PugWatchFunc func, gpointer data) {
+    if (!watch) return -1;
+    struct pollfd pfd = { watch->fd, POLLIN, 0 };
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready < 0) return errno == EINTR ? 0 : -1;
+    if (ready == 0) return 0;
+
+    GHashTable* changed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    gint64 start = g_get_monotonic_time();
+    watch_read_events(watch, changed);
+    while ((g_get_monotonic_time() - start) / 1000 < PUG_WATCH_MAX_WAIT_MS &&
+           poll(&pfd, 1, (int)watch->debounce_ms) > 0) {
+        watch_read_events(watch, changed);
+    }
+    if (g_hash_table_size(changed) == 0) {
+        g_hash_table_destroy(changed);
+        return 0;
+    }
+
+    // El tiempo de recarga se mide sin la espera
+    gint64 reload_start = g_get_monotonic_time();
+    GPtrArray* paths = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, changed);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) g_ptr_array_add(paths, key);
+    GPtrArray* reloaded = pug_registry_reload(watch->engine->registry, paths);
+    watch->last_ms = (double)(g_get_monotonic_time() - reload_start) / 1000.0;
+    watch->batches++;
+    watch->reloads += reloaded->len;
+
+    if (func) func(paths, reloaded, data);
+    int count = (int)reloaded->len;
+    g_ptr_array_unref(reloaded);
+    g_ptr_array_free(paths, TRUE);
+    g_hash_table_destroy(changed);
+    return count;
+}
+
+#else
+
+static inline PugWatch* pug_watch_new(PugEngine* engine, guint debounce_ms) {
+    (void)engine;
+    (void)debounce_ms;
+    g_print("Error: La vigilancia de plantillas necesita inotify (Linux)\n");
+    return NULL;
+}
+
+static inline void pug_watch_free(PugWatch* watch) {
+    g_free(watch);
+}
+
+static inline int pug_watch_poll(PugWatch* watch, int timeout_ms, PugWatchFunc func, gpointer data) {
+    (void)watch;
+    (void)timeout_ms;
+    (void)func;
+    (void)data;
+    return -1;
+}
+
+#endif
+
+// Vigila hasta que *stop deje de ser 0 (comprobado al menos cada 200 ms)
+static inline void pug_watch_run(PugWatch* watch, PugWatchFunc func, gpointer data, volatile gint* stop) {
+    while (!g_atomic_int_get(stop)) {
+        if (pug_watch_poll(watch, 200, func, data) < 0) break;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUG_WATCH_H
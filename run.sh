@@ -9,3 +9,51 @@ $(pkg-config --cflags glib-2.0) \
 $(pkg-config --libs glib-2.0) \
 $mainFile include/bellard/cutils.c include/bellard/libregexp.c include/bellard/libunicode.c -o ./bin/test && ./bin/test  \
 $testFile
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-fragment-cache.c -o ./bin/test-fragment-cache && ./bin/test-fragment-cache
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-locals.c -o ./bin/test-locals && ./bin/test-locals
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-expr.c -o ./bin/test-expr && ./bin/test-expr
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-each.c -o ./bin/test-each && ./bin/test-each
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-case.c -o ./bin/test-case && ./bin/test-case
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-mixins.c -o ./bin/test-mixins && ./bin/test-mixins
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-mixin-memo.c -o ./bin/test-mixin-memo && ./bin/test-mixin-memo
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-extends.c -o ./bin/test-extends && ./bin/test-extends
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-document-edit.c -o ./bin/test-document-edit && ./bin/test-document-edit
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-serve.c -o ./bin/test-serve && ./bin/test-serve
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-registry.c -o ./bin/test-registry && ./bin/test-registry
+tcc -I./include \
+$(pkg-config --cflags glib-2.0) \
+$(pkg-config --libs glib-2.0) \
+test/test-image.c -o ./bin/test-image && ./bin/test-image
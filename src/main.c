@@ -1,3 +1,4 @@
+#define _GNU_SOURCE  // accept4() en pug_serve.h
 #include <glib-2.0/glib.h>
 #include <stdio.h>
 #include <ctype.h>
@@ -6,6 +7,9 @@
 
 
 #include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "libregexp.h"
 
 
@@ -248,13 +252,398 @@ void ejemplo_pug_tags() {
 // bellard
 typedef enum{
     UNMINIFY = 0,
-    MINIFY = 1
+    MINIFY = 1,
+    MINIFY_HTML5 = 2
 } HTMLstyle;
 
+/* Estado del modo --watch */
+typedef struct {
+    PugEngine *engine;
+    const char *src;
+    const char *out;
+    const char *manifest;
+    unsigned int threads;
+    PugWatch *watch;
+} WatchState;
+
+/* Tras cada tanda de cambios vuelve a escribir las páginas afectadas */
+void on_templates_changed(const GPtrArray *changed, const GPtrArray *reloaded, gpointer data) {
+    WatchState *state = (WatchState *)data;
+    const char *root = state->engine->loader->root;
+    gsize root_len = strlen(root);
+    GPtrArray *pages = g_ptr_array_new_with_free_func(g_free);
+    const GPtrArray *lists[2] = { changed, reloaded };
+
+    for (int l = 0; l < 2; l++) {
+        for (guint i = 0; i < lists[l]->len; i++) {
+            const char *path = (const char *)g_ptr_array_index(lists[l], i);
+            if (strncmp(path, root, root_len) != 0 || path[root_len] != '/') continue;
+            if (!g_file_test(path, G_FILE_TEST_IS_REGULAR)) continue;
+            const char *rel = path + root_len + 1;
+            gboolean seen = FALSE;
+            for (guint j = 0; j < pages->len && !seen; j++) {
+                seen = strcmp((const char *)g_ptr_array_index(pages, j), rel) == 0;
+            }
+            if (!seen) g_ptr_array_add(pages, g_strdup(rel));
+        }
+    }
+
+    PugBuildReport report;
+    pug_build_pages(state->engine, state->src, state->out, state->threads, state->manifest, pages, &report);
+    printf("[watch] %u cambiados, %u recompiladas en %.2f ms, %u páginas (%.2f ms), %u fallos\n",
+            changed->len, reloaded->len, state->watch->last_ms, pages->len, report.seconds * 1000.0,
+            report.failed);
+    fflush(stdout);
+    pug_build_report_clear(&report);
+    g_ptr_array_free(pages, TRUE);
+}
+
+/* Modo build: compila un directorio entero en un solo proceso */
+int run_build(int argc, char *argv[]) {
+    const char *src = NULL, *out = NULL;
+    unsigned int threads = 0;
+    gboolean verbose = FALSE, incremental = FALSE, watch = FALSE;
+    HTMLstyle htmlStyle = UNMINIFY;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = (unsigned int)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--minify") == 0) {
+            htmlStyle = MINIFY;
+        } else if (strcmp(argv[i], "--html5") == 0) {
+            htmlStyle = MINIFY_HTML5;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = TRUE;
+        } else if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--incremental") == 0) {
+            incremental = TRUE;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watch = TRUE;
+        } else if (!src) {
+            src = argv[i];
+        } else if (!out) {
+            out = argv[i];
+        } else {
+            src = NULL;
+            break;
+        }
+    }
+    if (!src || !out) {
+        g_print("Uso: %s build <origen> <salida> [-j hilos] [--minify|--html5] [-i] [-v] [--watch]\n", argv[0]);
+        return 1;
+    }
+
+    PugEngineConfig config = pug_engine_config_default();
+    config.minify = htmlStyle;
+    PugEngine *engine = pug_engine_new(src, &config);
+    if (!engine) return 1;
+
+    /* Con -i sólo se reconstruye lo que cambió desde el último build */
+    char *manifest = incremental ? g_build_filename(out, ".pug-manifest", NULL) : NULL;
+    PugBuildReport report;
+    guint failed = pug_build_directory(engine, src, out, threads, manifest, &report);
+    pug_build_report_print(&report, verbose || failed > 0);
+    pug_build_report_clear(&report);
+
+    /* Con --watch se queda recompilando lo que cambie hasta que lo maten */
+    if (watch) {
+        WatchState state = { engine, src, out, manifest, threads, NULL };
+        state.watch = pug_watch_new(engine, 0);
+        if (!state.watch) failed = 1;
+        while (state.watch && pug_watch_poll(state.watch, -1, on_templates_changed, &state) >= 0) {
+        }
+        pug_watch_free(state.watch);
+    }
+
+    g_free(manifest);
+    pug_engine_free(engine);
+    return failed > 0 ? 1 : 0;
+}
+
+/* Modo serve: renderiza por un socket Unix hasta SIGINT/SIGTERM */
+static volatile gint serve_stop = 0;
+
+static void on_serve_signal(int sig) {
+    (void)sig;
+    serve_stop = 1;
+}
+
+/* Con --watch las recargas van en su hilo y se publican sin parar el servidor */
+static gpointer serve_watch_thread(gpointer data) {
+    pug_watch_run((PugWatch *)data, NULL, NULL, &serve_stop);
+    return NULL;
+}
+
+/* Con -p el maestro precarga, calienta y sella todas las plantillas y después
+   hace fork(): los hijos comparten las páginas compiladas sin copiarlas */
+static int serve_prefork(PugEngine *engine, const char *socket_path, PugImage *bundle,
+                         unsigned int threads, unsigned int processes) {
+    PugPreload *preload = pug_preload_new(engine);
+    guint count = bundle ? pug_preload_add_image(preload, bundle) : pug_preload_add_directory(preload);
+    int fd = preload && pug_preload_seal(preload) ? pug_serve_listen(socket_path) : -1;
+    if (fd < 0) {
+        pug_preload_free(preload);
+        return 1;
+    }
+
+    signal(SIGINT, on_serve_signal);
+    signal(SIGTERM, on_serve_signal);
+    printf("Escuchando en %s (%u procesos, %u plantillas precargadas)\n", socket_path, processes, count);
+    fflush(stdout);
+
+    GArray *children = g_array_new(FALSE, FALSE, sizeof(pid_t));
+    for (unsigned int i = 0; i < processes; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            g_print("Error: fork: %s\n", g_strerror(errno));
+            break;
+        }
+        if (pid == 0) {
+            /* Estadísticas en páginas propias y un epoll propio sobre el
+               socket compartido */
+            pug_preload_after_fork(preload);
+            PugServer *server = pug_server_new_fd(engine, NULL, fd, threads);
+            if (!server) _exit(1);
+            pug_server_set_preload(server, preload);
+            pug_server_run(server, &serve_stop);
+            printf("=== Proceso %d ===\n", (int)getpid());
+            pug_server_print_stats(server);
+            pug_preload_print_stats(preload);
+            fflush(stdout);
+            pug_server_free(server);
+            _exit(0);
+        }
+        g_array_append_val(children, pid);
+    }
+
+    /* El maestro sólo espera; al pararlo (o si muere un hijo) para a todos */
+    while (!g_atomic_int_get(&serve_stop) && children->len > 0 && waitpid(-1, NULL, WNOHANG) == 0) {
+        g_usleep(200000);
+    }
+    for (guint i = 0; i < children->len; i++) kill(g_array_index(children, pid_t, i), SIGTERM);
+    for (guint i = 0; i < children->len; i++) waitpid(g_array_index(children, pid_t, i), NULL, 0);
+
+    g_array_free(children, TRUE);
+    close(fd);
+    unlink(socket_path);
+    pug_preload_free(preload);
+    return 0;
+}
+
+int run_serve(int argc, char *argv[]) {
+    const char *root = NULL, *socket_path = NULL;
+    unsigned int threads = 0, processes = 0;
+    gboolean check = TRUE, watch = FALSE;
+    HTMLstyle htmlStyle = UNMINIFY;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = (unsigned int)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            processes = (unsigned int)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--minify") == 0) {
+            htmlStyle = MINIFY;
+        } else if (strcmp(argv[i], "--html5") == 0) {
+            htmlStyle = MINIFY_HTML5;
+        } else if (strcmp(argv[i], "--no-check") == 0) {
+            check = FALSE;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watch = TRUE;
+        } else if (!root) {
+            root = argv[i];
+        } else if (!socket_path) {
+            socket_path = argv[i];
+        } else {
+            root = NULL;
+            break;
+        }
+    }
+    if (!root || !socket_path) {
+        g_print("Uso: %s serve <raíz|paquete> <socket> [-j hilos] [-p procesos] [--minify|--html5] [--no-check] [--watch]\n", argv[0]);
+        return 1;
+    }
+
+    if (processes > 0 && watch) {
+        g_print("Error: --watch no se puede usar con -p\n");
+        return 1;
+    }
+
+    /* Con --no-check las plantillas compiladas no se vuelven a mirar en disco
+       (-p lo implica). Si la raíz es un paquete (c-pug bundle), se sirve
+       desde él sin compilar */
+    PugEngineConfig config = pug_engine_config_default();
+    config.minify = htmlStyle;
+    config.check = check && processes == 0 ? PUG_CHECK_STAMP : PUG_CHECK_NONE;
+    PugImage *bundle = NULL;
+    PugEngine *engine = NULL;
+    if (g_file_test(root, G_FILE_TEST_IS_REGULAR)) {
+        if (watch) {
+            g_print("Error: --watch no se puede usar con un paquete\n");
+            return 1;
+        }
+        bundle = pug_image_map(root);
+        engine = bundle ? pug_engine_new_from_image(bundle, &config) : NULL;
+    } else {
+        engine = pug_engine_new(root, &config);
+    }
+    if (!engine) {
+        pug_image_free(bundle);
+        return 1;
+    }
+    if (processes > 0) {
+        int status = serve_prefork(engine, socket_path, bundle, threads, processes);
+        pug_engine_free(engine);
+        pug_image_free(bundle);
+        return status;
+    }
+    PugServer *server = pug_server_new(engine, socket_path, threads);
+    if (!server) {
+        pug_engine_free(engine);
+        pug_image_free(bundle);
+        return 1;
+    }
+
+    PugWatch *watcher = watch ? pug_watch_new(engine, 0) : NULL;
+    GThread *watch_thread = watcher ? g_thread_new("pug-watch", serve_watch_thread, watcher) : NULL;
+
+    signal(SIGINT, on_serve_signal);
+    signal(SIGTERM, on_serve_signal);
+    printf("Escuchando en %s (%u hilos)\n", socket_path, server->n_threads);
+    fflush(stdout);
+    pug_server_run(server, &serve_stop);
+
+    if (watch_thread) {
+        g_atomic_int_set(&serve_stop, 1);
+        g_thread_join(watch_thread);
+    }
+    pug_watch_free(watcher);
+    pug_server_print_stats(server);
+    pug_registry_print_stats(engine->registry);
+    pug_server_free(server);
+    pug_engine_free(engine);
+    pug_image_free(bundle);
+    return 0;
+}
+
+/* Modo load: mide peticiones/s y latencias contra un servidor */
+int run_load(int argc, char *argv[]) {
+    const char *socket_path = NULL, *template_path = NULL;
+    unsigned int connections = 1;
+    gsize requests = 10000;
+    GPtrArray *locals = g_ptr_array_new();
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            connections = (unsigned int)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            requests = (gsize)g_ascii_strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc && strchr(argv[i + 1], '=')) {
+            g_ptr_array_add(locals, argv[++i]);
+        } else if (!socket_path) {
+            socket_path = argv[i];
+        } else if (!template_path) {
+            template_path = argv[i];
+        } else {
+            socket_path = NULL;
+            break;
+        }
+    }
+    if (!socket_path || !template_path) {
+        g_print("Uso: %s load <socket> <plantilla> [-c conexiones] [-n peticiones] [-l nombre=valor]...\n", argv[0]);
+        g_ptr_array_free(locals, TRUE);
+        return 1;
+    }
+
+    /* Cada -l es un número, true/false o una cadena */
+    GByteArray *request = g_byte_array_new();
+    pug_serve_request_begin(request, template_path);
+    for (guint i = 0; i < locals->len; i++) {
+        const char *arg = (const char *)g_ptr_array_index(locals, i);
+        const char *eq = strchr(arg, '=');
+        char *name = g_strndup(arg, (gsize)(eq - arg));
+        const char *text = eq + 1;
+        char *end = NULL;
+        double n = g_ascii_strtod(text, &end);
+        PugValue value;
+        if (*text && end && *end == '\0') {
+            value = pug_value_number(n);
+        } else if (strcmp(text, "true") == 0 || strcmp(text, "false") == 0) {
+            value = pug_value_bool(text[0] == 't');
+        } else {
+            value = pug_value_string(text);
+        }
+        pug_serve_request_add(request, name, &value);
+        g_free(name);
+    }
+    pug_serve_request_end(request);
+
+    PugServeLoadStats stats;
+    pug_serve_load(socket_path, request, requests, connections, &stats);
+    pug_serve_print_load_stats(&stats);
+
+    g_byte_array_free(request, TRUE);
+    g_ptr_array_free(locals, TRUE);
+    return stats.failed > 0 ? 1 : 0;
+}
+
+/* Modos embed y bundle: compilan un directorio y lo escriben como array de
+   C o como paquete para proyectar con mmap */
+int run_embed(int argc, char *argv[]) {
+    gboolean bundle = strcmp(argv[1], "bundle") == 0;
+    const char *src = NULL, *out = NULL, *symbol = "pug_templates";
+
+    for (int i = 2; i < argc; i++) {
+        if (!bundle && strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            symbol = argv[++i];
+        } else if (!src) {
+            src = argv[i];
+        } else if (!out) {
+            out = argv[i];
+        } else {
+            src = NULL;
+            break;
+        }
+    }
+    if (!src || !out) {
+        if (bundle) g_print("Uso: %s bundle <origen> <salida.pugi>\n", argv[0]);
+        else g_print("Uso: %s embed <origen> <salida.c> [-s símbolo]\n", argv[0]);
+        return 1;
+    }
+
+    guint count = 0;
+    GByteArray *image = pug_image_build_directory(src, &count);
+    if (!image) return 1;
+    gboolean ok = bundle ? pug_image_write_file(image, out) : pug_image_write_c(image, symbol, out);
+    if (ok && bundle) {
+        printf("%u plantillas, %u bytes en %s\n", count, image->len, out);
+    } else if (ok) {
+        printf("%u plantillas, %u bytes en %s (%s)\n", count, image->len, out, symbol);
+    }
+    g_byte_array_free(image, TRUE);
+    return ok ? 0 : 1;
+}
+
 int main(int argc, char *argv[]) {
     
+    if (argc >= 2 && strcmp(argv[1], "build") == 0) {
+        return run_build(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "serve") == 0) {
+        return run_serve(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "load") == 0) {
+        return run_load(argc, argv);
+    }
+    if (argc >= 2 && (strcmp(argv[1], "embed") == 0 || strcmp(argv[1], "bundle") == 0)) {
+        return run_embed(argc, argv);
+    }
+
     if (argc != 2) {
         g_print("Uso: %s <archivo.pug>\n", argv[0]);
+        g_print("     %s build <origen> <salida> [-j hilos] [--minify|--html5] [-i] [-v] [--watch]\n", argv[0]);
+        g_print("     %s serve <raíz|paquete> <socket> [-j hilos] [-p procesos] [--minify|--html5] [--no-check] [--watch]\n", argv[0]);
+        g_print("     %s load <socket> <plantilla> [-c conexiones] [-n peticiones] [-l nombre=valor]...\n", argv[0]);
+        g_print("     %s embed <origen> <salida.c> [-s símbolo]\n", argv[0]);
+        g_print("     %s bundle <origen> <salida.pugi>\n", argv[0]);
         return 1;
     }
     
@@ -275,7 +664,7 @@ int main(int argc, char *argv[]) {
             // Estadísticas
             int tag_count = 0, class_count = 0, id_count = 0, text_count = 0;
             
-            for (int i = 0; i < tokens->count; i++) {
+            for (unsigned int i = 0; i < tokens->count; i++) {
                 switch (tokens->tokens[i]->type) {
                     case TOKEN_TAG: tag_count++; break;
                     case TOKEN_CLASS: class_count++; break;
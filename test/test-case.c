@@ -0,0 +1,127 @@
+// Pruebas de los condicionales compilados: cadenas if / else if / else,
+// unless, y case/when con tabla de saltos (whens constantes), en cascada
+// (whens con expresiones), caída de un when vacío y default.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static const char* PAGE_SOURCE =
+    "if n > 10\n"
+    "  p grande\n"
+    "else if n > 5\n"
+    "  p mediano\n"
+    "else\n"
+    "  p pequeño\n"
+    "unless n\n"
+    "  p cero\n"
+    "case color\n"
+    "  when 'rojo'\n"
+    "  when 'granate'\n"
+    "    b cálido\n"
+    "  when 'azul'\n"
+    "    b frío\n"
+    "  when 1\n"
+    "    b uno\n"
+    "  default\n"
+    "    b otro\n"
+    "case true\n"
+    "  when n > 5\n"
+    "    i alto\n"
+    "  when n > 0\n"
+    "    i bajo\n"
+    "div\n"
+    "  when sigue siendo una etiqueta\n";
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static void expect_missing(const char* what, const char* html, const char* needle) {
+    if (html && !strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: sobra '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static char* render(PugTemplate* tpl, PugValue n, PugValue color) {
+    PugLocals* locals = pug_locals_new(tpl);
+    pug_locals_set_by_name(locals, "n", n);
+    pug_locals_set_by_name(locals, "color", color);
+    char* html = pug_template_render(tpl, locals, 0, 2, PUG_MINIFY_COMPACT);
+    pug_locals_free(locals);
+    return html;
+}
+
+// Busca el primer case del árbol
+static ASTNode* find_case(ASTNode* node) {
+    if (node->node_type == TOKEN_CASE) return node;
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        ASTNode* found = find_case(node->children[i]);
+        if (found) return found;
+    }
+    return NULL;
+}
+
+int main(void) {
+    PugTemplate* tpl = pug_template_compile(PAGE_SOURCE, "case");
+    if (!tpl) {
+        printf("FAIL no compila la plantilla\n");
+        return 1;
+    }
+
+    ASTNode* first_case = find_case(tpl->root);
+    if (first_case && first_case->branch && first_case->branch->table) {
+        printf("ok   whens constantes en tabla de saltos\n");
+    } else {
+        printf("FAIL el case con whens constantes no tiene tabla de saltos\n");
+        failures++;
+    }
+
+    char* html = render(tpl, pug_value_number(12), pug_value_string("azul"));
+    expect_contains("if", html, "<p>grande</p>");
+    expect_missing("sólo una rama de la cadena", html, "mediano");
+    expect_missing("unless con valor", html, "cero");
+    expect_contains("when por tabla", html, "<b>frío</b>");
+    expect_contains("case en cascada: primer when cierto", html, "<i>alto</i>");
+    expect_missing("case en cascada: una sola rama", html, "bajo");
+    expect_contains("when fuera de un case es una etiqueta", html, "<when>sigue siendo una etiqueta</when>");
+    g_free(html);
+
+    html = render(tpl, pug_value_number(7), pug_value_string("rojo"));
+    expect_contains("else if", html, "<p>mediano</p>");
+    expect_contains("when vacío cae en el siguiente", html, "<b>cálido</b>");
+    g_free(html);
+
+    html = render(tpl, pug_value_number(0), pug_value_number(1));
+    expect_contains("else", html, "<p>pequeño</p>");
+    expect_contains("unless sin valor", html, "<p>cero</p>");
+    expect_contains("when numérico", html, "<b>uno</b>");
+    expect_missing("case en cascada sin rama cierta ni default", html, "<i>");
+    g_free(html);
+
+    // '1' no es === 1: va al default
+    html = render(tpl, pug_value_number(3), pug_value_string("1"));
+    expect_contains("la tabla compara sin conversión", html, "<b>otro</b>");
+    expect_contains("segundo when de la cascada", html, "<i>bajo</i>");
+    g_free(html);
+
+    html = render(tpl, pug_value_number(3), pug_value_null());
+    expect_contains("default sin valor", html, "<b>otro</b>");
+    g_free(html);
+
+    pug_template_free(tpl);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,158 @@
+// Prueba diferencial del documento editable: aplica ediciones al azar con
+// pug_document_edit y compara cada vez el árbol con el que da parse_pug
+// sobre el texto nuevo. Comprueba también que el parseo completo sigue
+// siendo la excepción (full_parses) y que teclear dentro de una línea nunca
+// lo necesita.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static const char* PAGE_SOURCE =
+    "doctype html\n"
+    "html(lang='es')\n"
+    "  head\n"
+    "    title Título\n"
+    "  body\n"
+    "    - var saludo = 'hola'\n"
+    "    div#main.container\n"
+    "      // comentario\n"
+    "      h1.titulo Bienvenido\n"
+    "      p Un párrafo\n"
+    "      if saludo\n"
+    "        p #{saludo}\n"
+    "      else\n"
+    "        p adiós\n"
+    "      ul\n"
+    "        each i in items\n"
+    "          li #{i}\n"
+    "    footer#pie\n"
+    "      p Copyright\n";
+
+// Trozos que se insertan: texto suelto, líneas nuevas, indentación y
+// construcciones con bloque
+static const char* SNIPPETS[] = {
+    "", "\n", "  ", "    ", "x", "div", "p hola", "\n  span texto", "\n    a(href='x') link",
+    "\n.clase", "\n#id", "\n  | pipe", "\n- var a = 1", "\n// com", "\nif a\n  p si\nelse\n  p no",
+    "\n  cache\n    p #{x}", "\teach i in xs\n\t\tli #{i}", "\n\n", "ul\n  li uno\n  li dos",
+    "\n      deep", ".", "#", "(a=1)", " #{y}", "\n+m(1)", "\nmixin m(a)\n  p #{a}",
+};
+
+#define ROUNDS 2000
+
+static int failures = 0;
+
+static void expect_true(const char* what, int condition) {
+    if (condition) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Compara dos árboles nodo a nodo (incluidos los punteros a padre)
+static int same_tree(const ASTNode* a, const ASTNode* b, const ASTNode* parent_a, const ASTNode* parent_b) {
+    if (a->parent != parent_a || b->parent != parent_b) return 0;
+    if (a->node_type != b->node_type || a->depth != b->depth || a->line != b->line ||
+        a->column != b->column || a->is_inline != b->is_inline || a->is_block != b->is_block ||
+        g_strcmp0(a->tag, b->tag) != 0 || g_strcmp0(a->text_content, b->text_content) != 0 ||
+        g_strcmp0(a->id, b->id) != 0 || a->class_count != b->class_count ||
+        (a->attributes ? a->attributes->count : 0) != (b->attributes ? b->attributes->count : 0) ||
+        a->children_count != b->children_count) {
+        printf("     difiere en la línea %u: %s/%s '%s'/'%s'\n", a->line, a->tag, b->tag,
+               a->text_content ? a->text_content : "", b->text_content ? b->text_content : "");
+        return 0;
+    }
+    for (unsigned int i = 0; i < a->children_count; i++) {
+        if (!same_tree(a->children[i], b->children[i], a, b)) return 0;
+    }
+    return 1;
+}
+
+static ASTNode* parse_text(const char* text, ParserContext** ctx) {
+    *ctx = parser_context_create();
+    (*ctx)->tokens = tokenize_file(text);
+    return parse_pug(*ctx);
+}
+
+int main(void) {
+    GRand* rand = g_rand_new_with_seed(45);
+    PugDocument* doc = pug_document_new(PAGE_SOURCE);
+    GString* shadow = g_string_new(PAGE_SOURCE);
+    guint64 full_parses = 0;
+    int mismatches = 0, text_ok = 1;
+
+    for (int round = 0; round < ROUNDS && mismatches == 0; round++) {
+        gsize len = shadow->len;
+        gsize start = (gsize)g_rand_int_range(rand, 0, (gint32)len + 1);
+        gsize end = start;
+        if (g_rand_int_range(rand, 0, 3) == 0) {
+            end = start + (gsize)g_rand_int_range(rand, 0, 40);
+            if (end > len) end = len;
+        }
+        const char* snippet = SNIPPETS[g_rand_int_range(rand, 0, G_N_ELEMENTS(SNIPPETS))];
+
+        pug_document_edit(doc, start, end, snippet);
+        g_string_erase(shadow, (gssize)start, (gssize)(end - start));
+        g_string_insert(shadow, (gssize)start, snippet);
+        if (strcmp(doc->text->str, shadow->str) != 0) text_ok = 0;
+
+        ParserContext* ctx;
+        ASTNode* expected = parse_text(shadow->str, &ctx);
+        if (!same_tree(doc->root, expected, NULL, NULL)) {
+            printf("     ronda %d: edición %zu-%zu con '%s'\n", round, (size_t)start, (size_t)end, snippet);
+            mismatches++;
+        }
+        parser_context_free(ctx);
+
+        // Un documento que ha crecido demasiado vuelve al texto original
+        if (shadow->len > 20000) {
+            full_parses += doc->full_parses;
+            pug_document_free(doc);
+            doc = pug_document_new(PAGE_SOURCE);
+            g_string_assign(shadow, PAGE_SOURCE);
+        }
+    }
+    full_parses += doc->full_parses;
+    expect_true("el texto del documento sigue al editado", text_ok);
+    expect_true("el árbol incremental es el de parse_pug tras cada edición", mismatches == 0);
+    expect_true("pocas ediciones al azar acaban en parseo completo", full_parses < ROUNDS / 10);
+    pug_document_free(doc);
+
+    // Teclear al final de líneas al azar: siempre incremental y la vista
+    // previa coincide con la de un documento nuevo
+    doc = pug_document_new(PAGE_SOURCE);
+    const char* keys[] = { "a", " ", "\n        li nuevo", "x" };
+    guint64 nodes_parsed = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        guint line = (guint)g_rand_int_range(rand, 0, (gint32)doc->line_offsets->len - 1);
+        gsize end = g_array_index(doc->line_offsets, gsize, line + 1) - 1;
+        pug_document_edit(doc, end, end, keys[g_rand_int_range(rand, 0, G_N_ELEMENTS(keys))]);
+        nodes_parsed += doc->nodes_parsed;
+    }
+    PugDocument* fresh = pug_document_new(doc->text->str);
+    char* incremental = pug_document_render(doc, 0, 2, PUG_MINIFY_NONE);
+    char* full = pug_document_render(fresh, 0, 2, PUG_MINIFY_NONE);
+    expect_true("teclear no necesita parseo completo", doc->full_parses == 0);
+    expect_true("teclear re-parsea una parte pequeña del árbol",
+                nodes_parsed / ROUNDS < document_count_nodes(doc->root) / 10);
+    expect_true("vista previa igual a la de un documento nuevo", incremental && full && strcmp(incremental, full) == 0);
+    g_free(incremental);
+    g_free(full);
+    pug_document_free(fresh);
+    pug_document_free(doc);
+
+    // Rango no válido
+    doc = pug_document_new("p uno\n");
+    expect_true("edición fuera del documento", !pug_document_edit(doc, 3, 99, "x"));
+    expect_true("el texto no cambia", strcmp(doc->text->str, "p uno\n") == 0);
+    pug_document_free(doc);
+
+    g_string_free(shadow, TRUE);
+    g_rand_free(rand);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
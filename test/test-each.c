@@ -0,0 +1,86 @@
+// Pruebas de los bucles `each` / `for` compilados: arrays con índice,
+// objetos con clave, bucles anidados, `else` con colecciones vacías y
+// restauración de las variables del bucle al salir.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static const char* PAGE_SOURCE =
+    "- var item = 'fuera'\n"
+    "ul\n"
+    "  each item, i in items\n"
+    "    li #{i}:#{item}\n"
+    "dl\n"
+    "  for valor, clave in datos\n"
+    "    dt #{clave}\n"
+    "    dd #{clave}=#{valor}\n"
+    "table\n"
+    "  each fila in filas\n"
+    "    tr\n"
+    "      each celda in fila\n"
+    "        td #{celda}\n"
+    "p #{item}\n"
+    "ol\n"
+    "  each x in vacio\n"
+    "    li #{x}\n"
+    "  else\n"
+    "    li nada\n"
+    "  each x in texto\n"
+    "    li #{x}\n";
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+int main(void) {
+    PugTemplate* tpl = pug_template_compile(PAGE_SOURCE, "each");
+    if (!tpl) {
+        printf("FAIL no compila la plantilla\n");
+        return 1;
+    }
+
+    PugValue items[] = { pug_value_string("a"), pug_value_string("<b>"), pug_value_number(3) };
+    const char* keys[] = { "uno", "dos" };
+    PugValue values[] = { pug_value_number(1), pug_value_string("II") };
+    PugValue row_a[] = { pug_value_number(1), pug_value_number(2) };
+    PugValue row_b[] = { pug_value_number(3) };
+    PugValue rows[] = { pug_value_array(row_a, 2), pug_value_array(row_b, 1) };
+
+    PugLocals* locals = pug_locals_new(tpl);
+    pug_locals_set_by_name(locals, "items", pug_value_array(items, 3));
+    pug_locals_set_by_name(locals, "datos", pug_value_object(keys, values, 2));
+    pug_locals_set_by_name(locals, "filas", pug_value_array(rows, 2));
+    pug_locals_set_by_name(locals, "vacio", pug_value_array(NULL, 0));
+    pug_locals_set_string(locals, "texto", "no iterable");
+
+    char* html = pug_template_render(tpl, locals, 0, 2, PUG_MINIFY_COMPACT);
+    expect_contains("array con índice y escape", html, "<ul><li>0:a</li><li>1:&lt;b&gt;</li><li>2:3</li></ul>");
+    expect_contains("objeto con clave (for)", html, "<dd>uno=1</dd>");
+    expect_contains("objeto: orden de inserción", html, "<dd>uno=1</dd><dt>dos</dt><dd>dos=II</dd>");
+    expect_contains("bucles anidados", html, "<table><tr><td>1</td><td>2</td></tr><tr><td>3</td></tr></table>");
+    expect_contains("la variable del bucle se restaura", html, "<p>fuera</p>");
+    expect_contains("else con la colección vacía; un valor no iterable no repite",
+                    html, "<ol><li>nada</li></ol>");
+    g_free(html);
+
+    // Otro render con el mismo frame: nada de la iteración anterior se queda
+    pug_locals_set_by_name(locals, "items", pug_value_array(items, 1));
+    html = pug_template_render(tpl, locals, 0, 2, PUG_MINIFY_COMPACT);
+    expect_contains("segundo render con menos elementos", html, "<ul><li>0:a</li></ul>");
+    g_free(html);
+
+    pug_locals_free(locals);
+    pug_template_free(tpl);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+// Pruebas del compilador de expresiones y de la VM de registros: plegado de
+// constantes, cortocircuito, ternario, asignaciones compuestas,
+// concatenación con null y .length en UTF-8.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static void expect_true(const char* what, int condition) {
+    if (condition) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Compila src y la evalúa con frame; deja el texto del resultado en out
+static void eval_text(PugSymbols* symbols, const char* src, PugValue* frame, unsigned int frame_size,
+                      GString* out) {
+    g_string_truncate(out, 0);
+    PugExpr* expr = pug_expr_compile(src, strlen(src), symbols, 0);
+    if (!expr) {
+        g_string_append(out, "(no compila)");
+        return;
+    }
+    PugArena arena = { NULL, NULL, 0, 0 };
+    PugValue value = pug_expr_eval(expr, frame, frame_size, &arena);
+    pug_value_append(out, &value);
+    pug_arena_clear(&arena);
+    pug_expr_free(expr);
+}
+
+static void expect_eval(PugSymbols* symbols, const char* src, PugValue* frame, unsigned int frame_size,
+                        const char* expected) {
+    GString* out = g_string_new("");
+    eval_text(symbols, src, frame, frame_size, out);
+    if (strcmp(out->str, expected) == 0) {
+        printf("ok   %s => %s\n", src, expected);
+    } else {
+        printf("FAIL %s => '%s' (se esperaba '%s')\n", src, out->str, expected);
+        failures++;
+    }
+    g_string_free(out, TRUE);
+}
+
+// La expresión se reduce a una sola constante al compilar
+static void expect_folded(PugSymbols* symbols, const char* src, const char* expected) {
+    PugExpr* expr = pug_expr_compile(src, strlen(src), symbols, 0);
+    PugValue value;
+    int folded = pug_expr_is_constant(expr, &value);
+    GString* out = g_string_new("");
+    if (folded) pug_value_append(out, &value);
+    if (folded && strcmp(out->str, expected) == 0) {
+        printf("ok   plegada: %s => %s\n", src, expected);
+    } else {
+        printf("FAIL plegada: %s => '%s' (constante: %d)\n", src, out->str, folded);
+        failures++;
+    }
+    g_string_free(out, TRUE);
+    pug_expr_free(expr);
+}
+
+static int expr_has_op(const PugExpr* expr, PugOpcode op) {
+    for (unsigned int i = 0; expr && i < expr->code_len; i++) {
+        if (expr->code[i].op == op) return 1;
+    }
+    return 0;
+}
+
+int main(void) {
+    PugSymbols symbols;
+    pug_symbols_init(&symbols);
+
+    // Plegado de constantes
+    expect_folded(&symbols, "1 + 2 * 3", "7");
+    expect_folded(&symbols, "'a' + 'b' + 1", "ab1");
+    expect_folded(&symbols, "(10 - 4) / 4", "1.5");
+    expect_folded(&symbols, "7 % 3 === 1 ? 'si' : 'no'", "si");
+    expect_folded(&symbols, "'ñandú'.length", "5");
+
+    unsigned int a = pug_symbols_intern(&symbols, "a", 1);
+    unsigned int b = pug_symbols_intern(&symbols, "b", 1);
+    unsigned int s = pug_symbols_intern(&symbols, "s", 1);
+    unsigned int frame_size = symbols.names->len;
+    PugValue* frame = g_new0(PugValue, frame_size);
+    frame[a] = pug_value_number(0);
+    frame[b] = pug_value_string("be");
+    frame[s] = pug_value_string("añ€");
+
+    // Una local sola no ejecuta bytecode
+    PugExpr* local = pug_expr_compile("a", 1, &symbols, 0);
+    expect_true("local sin bytecode", local && local->slot == (int)a && local->code_len == 0);
+    pug_expr_free(local);
+
+    // Cortocircuito: el lado derecho sólo se evalúa si hace falta
+    PugExpr* logic = pug_expr_compile("a && b", 6, &symbols, 0);
+    expect_true("&& compila a un salto condicional", expr_has_op(logic, PUG_OP_JMPF));
+    pug_expr_free(logic);
+    expect_eval(&symbols, "a && b", frame, frame_size, "0");
+    expect_eval(&symbols, "a || b", frame, frame_size, "be");
+    expect_eval(&symbols, "b && a.x.y", frame, frame_size, "");
+    expect_eval(&symbols, "!a && b", frame, frame_size, "be");
+
+    // Ternario y comparaciones
+    expect_eval(&symbols, "a ? 'si' : 'no'", frame, frame_size, "no");
+    expect_eval(&symbols, "b == 'be' ? s : 'x'", frame, frame_size, "añ€");
+    expect_eval(&symbols, "a === '0'", frame, frame_size, "false");
+    expect_eval(&symbols, "a == '0'", frame, frame_size, "true");
+
+    // Concatenación: null y undefined se escriben vacíos
+    expect_eval(&symbols, "'x' + null + b", frame, frame_size, "xbe");
+    expect_eval(&symbols, "b + nada", frame, frame_size, "be");
+    expect_eval(&symbols, "b + 1 + 2", frame, frame_size, "be12");
+    expect_eval(&symbols, "1 + 2 + b", frame, frame_size, "3be");
+
+    // .length cuenta caracteres, no bytes
+    expect_eval(&symbols, "s.length", frame, frame_size, "3");
+    expect_eval(&symbols, "s.length + b.length", frame, frame_size, "5");
+
+    // Asignaciones en líneas de código: var, += y -=
+    PugTemplate* tpl = pug_template_compile("- var n = 1\n"
+                                            "- n += 2\n"
+                                            "- n -= 0.5\n"
+                                            "- var t = 'a'\n"
+                                            "- t += n\n"
+                                            "- t += vacio\n"
+                                            "p #{n} #{t} #{n * 2}\n",
+                                            "asignaciones");
+    char* html = tpl ? pug_template_render(tpl, NULL, 0, 2, 0) : NULL;
+    expect_contains("var, += y -= en el frame", html, "<p>2.5 a2.5 5</p>");
+    g_free(html);
+    pug_template_free(tpl);
+
+    // Expresiones que no compilan no rompen la plantilla
+    expect_true("expresión inválida", pug_expr_compile("1 +", 3, &symbols, 0) == NULL);
+    expect_true("paréntesis sin cerrar", pug_expr_compile("(a", 2, &symbols, 0) == NULL);
+
+    g_free(frame);
+    pug_symbols_clear(&symbols);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+// Pruebas de la herencia de plantillas: extends con block, append y
+// prepend, varios niveles, bloques por defecto y el layout compartido (sin
+// copiar su árbol) entre hijas.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static const char* LAYOUT_SOURCE =
+    "html\n"
+    "  head\n"
+    "    block scripts\n"
+    "      script(src='base.js')\n"
+    "  body\n"
+    "    block contenido\n"
+    "      p por defecto\n"
+    "    footer\n"
+    "      block pie\n"
+    "        p pie\n";
+
+static const char* PAGE_SOURCE =
+    "extends layout\n"
+    "append scripts\n"
+    "  script(src='pagina.js')\n"
+    "block contenido\n"
+    "  h1 Hola #{nombre}\n"
+    "  block interior\n"
+    "    p interior\n";
+
+static const char* SUB_SOURCE =
+    "extends page\n"
+    "block prepend scripts\n"
+    "  script(src='primero.js')\n"
+    "block interior\n"
+    "  p sub\n"
+    "block append pie\n"
+    "  p extra\n";
+
+// Proveedor en memoria: la plantilla sale del nombre del archivo
+static char* test_read(const char* path, gpointer data) {
+    (void)data;
+    if (g_str_has_suffix(path, "/layout.pug")) return g_strdup(LAYOUT_SOURCE);
+    if (g_str_has_suffix(path, "/page.pug")) return g_strdup(PAGE_SOURCE);
+    if (g_str_has_suffix(path, "/sub.pug")) return g_strdup(SUB_SOURCE);
+    return NULL;
+}
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static void expect_missing(const char* what, const char* html, const char* needle) {
+    if (html && !strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: sobra '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static char* render(PugEngine* engine, const char* path) {
+    PugTemplate* tpl = pug_engine_get(engine, path);
+    if (!tpl) return NULL;
+    PugLocals* locals = pug_locals_new(tpl);
+    pug_locals_set_string(locals, "nombre", "Ana");
+    char* html = g_strdup(pug_engine_render(engine, tpl, locals, NULL));
+    pug_locals_free(locals);
+    pug_template_free(tpl);
+    return html;
+}
+
+int main(void) {
+    PugFileProvider provider = { test_read, NULL, NULL, NULL };
+    PugEngineConfig config = pug_engine_config_default();
+    config.check = PUG_CHECK_NONE;
+    config.minify = PUG_MINIFY_COMPACT;
+    config.provider = &provider;
+    PugEngine* engine = pug_engine_new("/", &config);
+
+    char* layout = render(engine, "layout");
+    expect_contains("layout solo: bloques por defecto", layout,
+                    "<head><script src=\"base.js\"></script></head><body><p>por defecto</p>"
+                    "<footer><p>pie</p></footer></body>");
+    g_free(layout);
+
+    char* page = render(engine, "page");
+    expect_contains("append tras el contenido del layout", page,
+                    "<script src=\"base.js\"></script><script src=\"pagina.js\"></script></head>");
+    expect_contains("block sustituye al contenido por defecto", page, "<body><h1>Hola Ana</h1><p>interior</p>");
+    expect_missing("el contenido sustituido no aparece", page, "por defecto");
+    expect_contains("bloque sin sobrescribir", page, "<footer><p>pie</p></footer>");
+    g_free(page);
+
+    char* sub = render(engine, "sub");
+    expect_contains("prepend antes del layout y append de la hija intermedia", sub,
+                    "<head><script src=\"primero.js\"></script><script src=\"base.js\"></script>"
+                    "<script src=\"pagina.js\"></script></head>");
+    expect_contains("bloque definido en la hija intermedia sobrescrito", sub, "<h1>Hola Ana</h1><p>sub</p>");
+    expect_missing("el interior por defecto no aparece", sub, "<p>interior</p>");
+    expect_contains("append en un bloque del layout", sub, "<footer><p>pie</p><p>extra</p></footer>");
+    g_free(sub);
+
+    // El layout no cambia por haberse renderizado con bloques de las hijas
+    layout = render(engine, "layout");
+    expect_contains("el layout compartido sigue intacto", layout, "<body><p>por defecto</p>");
+    g_free(layout);
+
+    pug_engine_free(engine);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+// Pruebas de la caché de fragmentos (bloques `cache`) a través del motor.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static const char* PAGE_SOURCE =
+    "div\n"
+    "  cache\n"
+    "    p Hola #{user.name}\n"
+    "  cache\n"
+    "    each tag in tags\n"
+    "      span #{tag.label}\n";
+
+// Bloques sin dependencias declaradas cuyas locales sólo se leen en el
+// cuerpo de un mixin, en una plantilla incluida o en un bloque sobrescrito
+static const char* NAV_SOURCE =
+    "mixin nav\n"
+    "  p Menú de #{user.name}\n"
+    "div\n"
+    "  cache\n"
+    "    +nav\n"
+    "  cache\n"
+    "    include partial\n";
+
+static const char* PARTIAL_SOURCE = "span Pie de #{user.name}\n";
+
+static const char* LAYOUT_SOURCE =
+    "div\n"
+    "  cache\n"
+    "    block content\n";
+
+static const char* CHILD_SOURCE =
+    "extends layout\n"
+    "block content\n"
+    "  p Hijo de #{user.name}\n";
+
+// Proveedor en memoria: la plantilla sale del nombre del archivo
+static char* test_read(const char* path, gpointer data) {
+    (void)data;
+    if (g_str_has_suffix(path, "/nav.pug")) return g_strdup(NAV_SOURCE);
+    if (g_str_has_suffix(path, "/partial.pug")) return g_strdup(PARTIAL_SOURCE);
+    if (g_str_has_suffix(path, "/layout.pug")) return g_strdup(LAYOUT_SOURCE);
+    if (g_str_has_suffix(path, "/child.pug")) return g_strdup(CHILD_SOURCE);
+    return g_strdup(PAGE_SOURCE);
+}
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static const char* render_page(PugEngine* engine, const PugTemplate* tpl, PugValue user, PugValue tags) {
+    PugLocals* locals = pug_locals_new(tpl);
+    pug_locals_set_by_name(locals, "user", user);
+    if (tags.type != PUG_VALUE_NULL) pug_locals_set_by_name(locals, "tags", tags);
+    const char* html = pug_engine_render(engine, tpl, locals, NULL);
+    pug_locals_free(locals);
+    return html;
+}
+
+int main(void) {
+    PugFileProvider provider = { test_read, NULL, NULL, NULL };
+    PugEngineConfig config = pug_engine_config_default();
+    config.check = PUG_CHECK_NONE;
+    config.provider = &provider;
+    config.fragment_bytes = 1024 * 1024;
+    PugEngine* engine = pug_engine_new("/", &config);
+    PugTemplate* tpl = pug_engine_get(engine, "page");
+    if (!tpl) {
+        printf("FAIL no compila la plantilla\n");
+        return 1;
+    }
+
+    // Objetos con el mismo texto ("[object Object]") y distinto contenido
+    const char* keys[] = { "name" };
+    PugValue ana_name = pug_value_string("Ana");
+    PugValue bob_name = pug_value_string("Bob");
+    PugValue ana = pug_value_object(keys, &ana_name, 1);
+    PugValue bob = pug_value_object(keys, &bob_name, 1);
+
+    // Arrays con el mismo texto ("[object Object]") y distintos elementos
+    const char* tag_keys[] = { "label" };
+    PugValue red_label = pug_value_string("rojo");
+    PugValue blue_label = pug_value_string("azul");
+    PugValue red_item = pug_value_object(tag_keys, &red_label, 1);
+    PugValue blue_item = pug_value_object(tag_keys, &blue_label, 1);
+    PugValue red = pug_value_array(&red_item, 1);
+    PugValue blue = pug_value_array(&blue_item, 1);
+
+    expect_contains("objeto: primer render", render_page(engine, tpl, ana, red), "Hola Ana");
+    expect_contains("objeto: otro valor no reutiliza el fragmento", render_page(engine, tpl, bob, red), "Hola Bob");
+    expect_contains("array: primer render", render_page(engine, tpl, bob, red), "<span>rojo</span>");
+    expect_contains("array: otro valor no reutiliza el fragmento", render_page(engine, tpl, bob, blue),
+                    "<span>azul</span>");
+
+    // Con los mismos valores los dos bloques salen de la caché
+    guint64 hits = 0, hits_after = 0;
+    pug_fragment_cache_stats(engine->fragments, &hits, NULL, NULL, NULL);
+    expect_contains("mismo valor otra vez", render_page(engine, tpl, ana, red), "Hola Ana");
+    pug_fragment_cache_stats(engine->fragments, &hits_after, NULL, NULL, NULL);
+    if (hits_after != hits + 2) {
+        printf("FAIL los valores repetidos no aciertan en la caché (%lu aciertos)\n",
+               (unsigned long)(hits_after - hits));
+        failures++;
+    } else {
+        printf("ok   mismos valores, mismos fragmentos\n");
+    }
+
+    // Las locales que lee un mixin o un include forman parte de la clave
+    PugTemplate* nav = pug_engine_get(engine, "nav");
+    PugValue none = pug_value_null();
+    expect_contains("mixin: primer render", render_page(engine, nav, ana, none), "Menú de Ana");
+    expect_contains("mixin: otro usuario no reutiliza el fragmento", render_page(engine, nav, bob, none),
+                    "Menú de Bob");
+    expect_contains("include: otro usuario no reutiliza el fragmento", render_page(engine, nav, bob, none),
+                    "Pie de Bob");
+    expect_contains("mixin: vuelve el primer usuario", render_page(engine, nav, ana, none), "Menú de Ana");
+
+    // Un bloque que sobrescribe la hija no se puede deducir: no se cachea
+    PugTemplate* child = pug_engine_get(engine, "child");
+    expect_contains("block: primer render", render_page(engine, child, ana, none), "Hijo de Ana");
+    expect_contains("block: otro usuario no reutiliza el fragmento", render_page(engine, child, bob, none),
+                    "Hijo de Bob");
+
+    pug_template_free(child);
+    pug_template_free(nav);
+    pug_template_free(tpl);
+    pug_engine_free(engine);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
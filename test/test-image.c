@@ -0,0 +1,245 @@
+// Pruebas de la imagen de plantillas compiladas: construir, abrir y
+// renderizar igual que las plantillas compiladas desde las fuentes, y
+// rechazar imágenes corruptas (cabecera, bytecode no válido y bytes al azar)
+// sin ejecutar nada de ellas.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static const char* LAYOUT_SOURCE =
+    "html\n"
+    "  body\n"
+    "    include partial\n"
+    "    block contenido\n"
+    "      p por defecto\n";
+
+static const char* PARTIAL_SOURCE =
+    "mixin item(texto, clase = 'normal')\n"
+    "  li(class=clase) #{texto}\n"
+    "nav Hola #{user}\n";
+
+static const char* PAGE_SOURCE =
+    "extends layout\n"
+    "block contenido\n"
+    "  ul\n"
+    "    each i, n in items\n"
+    "      +item(i, n % 2 ? 'impar' : 'par')\n"
+    "    else\n"
+    "      li vacío\n"
+    "  case user\n"
+    "    when 'Ana'\n"
+    "      b Ana\n"
+    "    default\n"
+    "      b otro\n";
+
+static const char* EXPR_SOURCE =
+    "p #{a && b ? a + 1 : c}\n";
+
+static const char* NAMES[] = { "expr.pug", "layout.pug", "page.pug", "partial.pug" };
+
+static char* test_read(const char* path, gpointer data) {
+    (void)data;
+    if (g_str_has_suffix(path, "/layout.pug")) return g_strdup(LAYOUT_SOURCE);
+    if (g_str_has_suffix(path, "/partial.pug")) return g_strdup(PARTIAL_SOURCE);
+    if (g_str_has_suffix(path, "/page.pug")) return g_strdup(PAGE_SOURCE);
+    if (g_str_has_suffix(path, "/expr.pug")) return g_strdup(EXPR_SOURCE);
+    return NULL;
+}
+
+static int failures = 0;
+
+static void expect_true(const char* what, int condition) {
+    if (condition) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Render de name con unas locales fijas (variant cambia sus valores)
+static char* render(PugEngine* engine, const char* name, int variant, unsigned int minify) {
+    PugTemplate* tpl = pug_engine_get(engine, name);
+    if (!tpl) return NULL;
+    PugValue items[] = { pug_value_string("uno"), pug_value_string("<dos>"), pug_value_number(3) };
+    PugLocals* locals = pug_locals_new(tpl);
+    pug_locals_set_string(locals, "user", variant ? "Ana" : "Bob & co");
+    pug_locals_set_by_name(locals, "items", pug_value_array(items, variant ? 3 : 0));
+    pug_locals_set_number(locals, "a", variant ? 2 : 0);
+    pug_locals_set_by_name(locals, "b", pug_value_bool(variant));
+    pug_locals_set_string(locals, "c", "ce");
+    char* html = pug_template_render(tpl, locals, 0, 2, minify);
+    pug_locals_free(locals);
+    pug_template_free(tpl);
+    return html;
+}
+
+// Posición en data de la primera aparición de needle (o -1)
+static gssize find_bytes(const GByteArray* data, const guint8* needle, gsize len) {
+    for (gsize i = 0; i + len <= data->len; i++) {
+        if (memcmp(data->data + i, needle, len) == 0) return (gssize)i;
+    }
+    return -1;
+}
+
+// ¿Se rechaza la plantilla expr de la imagen data? Las demás tienen que
+// seguir cargándose: cada plantilla se valida por separado.
+static int expr_rejected(const GByteArray* data) {
+    PugImage* image = pug_image_open(data->data, data->len);
+    PugEngine* engine = pug_engine_new_from_image(image, NULL);
+    if (!engine) {
+        pug_image_free(image);
+        return 0;
+    }
+    PugTemplate* broken = pug_engine_get(engine, "expr");
+    PugTemplate* other = pug_engine_get(engine, "partial");
+    int rejected = broken == NULL && other != NULL;
+    pug_template_free(broken);
+    pug_template_free(other);
+    pug_engine_free(engine);
+    pug_image_free(image);
+    return rejected;
+}
+
+int main(void) {
+    PugFileProvider provider = { test_read, NULL, NULL, NULL };
+    PugEngineConfig config = pug_engine_config_default();
+    config.check = PUG_CHECK_NONE;
+    config.provider = &provider;
+    PugEngine* source = pug_engine_new("/", &config);
+
+    GPtrArray* names = g_ptr_array_new();
+    for (guint i = 0; i < G_N_ELEMENTS(NAMES); i++) g_ptr_array_add(names, (gpointer)NAMES[i]);
+    GByteArray* data = pug_image_build(source->loader, names);
+    expect_true("construir la imagen", data != NULL);
+    if (!data) return 1;
+
+    PugImage* image = pug_image_open(data->data, data->len);
+    expect_true("abrir la imagen", image != NULL && pug_image_count(image) == G_N_ELEMENTS(NAMES));
+    expect_true("índice por nombre", image && pug_image_find(image, "page.pug") >= 0 &&
+                                         pug_image_find(image, "otra.pug") < 0);
+    PugEngine* loaded = pug_engine_new_from_image(image, NULL);
+    expect_true("motor sobre la imagen", loaded != NULL);
+
+    // Mismo HTML desde la imagen que desde las fuentes
+    int same = 1;
+    for (guint i = 0; loaded && i < G_N_ELEMENTS(NAMES); i++) {
+        for (int variant = 0; variant < 2; variant++) {
+            for (unsigned int minify = PUG_MINIFY_NONE; minify <= PUG_MINIFY_COMPACT; minify++) {
+                char* expected = render(source, NAMES[i], variant, minify);
+                char* actual = render(loaded, NAMES[i], variant, minify);
+                if (!expected || !actual || strcmp(expected, actual) != 0) {
+                    printf("     %s (variante %d, modo %u):\n%s\n--\n%s\n", NAMES[i], variant, minify,
+                           expected ? expected : "(null)", actual ? actual : "(null)");
+                    same = 0;
+                }
+                g_free(expected);
+                g_free(actual);
+            }
+        }
+    }
+    expect_true("render igual que desde las fuentes", same);
+    expect_true("plantilla que no está en la imagen", loaded && pug_engine_get(loaded, "otra") == NULL);
+    pug_engine_free(loaded);
+    pug_image_free(image);
+
+    // Cabecera
+    GByteArray* copy = g_byte_array_new();
+    g_byte_array_append(copy, data->data, data->len);
+    copy->data[0] = 'X';
+    expect_true("firma incorrecta", pug_image_open(copy->data, copy->len) == NULL);
+    copy->data[0] = data->data[0];
+    copy->data[4]++;
+    expect_true("otra versión", pug_image_open(copy->data, copy->len) == NULL);
+    copy->data[4] = data->data[4];
+    expect_true("imagen cortada", pug_image_open(copy->data, copy->len - 1) == NULL);
+
+    // Bytecode: se localiza la expresión de expr en la imagen por sus bytes
+    PugTemplate* tpl = pug_engine_get(source, "expr");
+    const PugExpr* expr = NULL;
+    for (guint i = 0; tpl && i < tpl->exprs->len && !expr; i++) {
+        const PugExpr* candidate = (const PugExpr*)g_ptr_array_index(tpl->exprs, i);
+        if (candidate->code_len > 2) expr = candidate;
+    }
+    gssize code_at = -1;
+    if (expr) {
+        GByteArray* pattern = g_byte_array_new();
+        guint32 head[] = { GUINT32_TO_LE((guint32)expr->slot), GUINT32_TO_LE(expr->n_regs),
+                           GUINT32_TO_LE(expr->code_len) };
+        g_byte_array_append(pattern, (const guint8*)head, sizeof(head));
+        g_byte_array_append(pattern, (const guint8*)expr->code, expr->code_len * 4);
+        gssize at = find_bytes(data, pattern->data, pattern->len);
+        if (at >= 0) code_at = at + (gssize)sizeof(head);
+        g_byte_array_free(pattern, TRUE);
+    }
+    expect_true("expresión compilada en la imagen", code_at >= 0);
+    expect_true("la imagen sin tocar carga expr", code_at >= 0 && !expr_rejected(data));
+
+    int loads = 0, returns = 0, jumps = 0;
+    for (unsigned int pc = 0; code_at >= 0 && pc < expr->code_len; pc++) {
+        PugInstr instr = expr->code[pc];
+        guint8* at = copy->data + code_at + pc * 4;
+        if (instr.op == PUG_OP_LOADL) {
+            // Local fuera del frame
+            memcpy(copy->data, data->data, data->len);
+            at[2] = 0xff;
+            at[3] = 0xff;
+            loads += expr_rejected(copy);
+        } else if (instr.op == PUG_OP_JMPF || instr.op == PUG_OP_JMPT || instr.op == PUG_OP_JMP) {
+            // Salto hacia atrás (un bucle) y fuera del código
+            memcpy(copy->data, data->data, data->len);
+            at[2] = 0;
+            at[3] = 0;
+            jumps += expr_rejected(copy);
+            at[2] = 0xff;
+            jumps += expr_rejected(copy);
+        } else if (instr.op == PUG_OP_RET) {
+            // Registro fuera de rango y código sin RET al final
+            memcpy(copy->data, data->data, data->len);
+            at[1] = 0xff;
+            returns += expr_rejected(copy);
+            at[1] = instr.a;
+            at[0] = PUG_OP_MOVE;
+            returns += expr_rejected(copy);
+            at[0] = 0xff;
+            returns += expr_rejected(copy);
+        }
+    }
+    expect_true("LOADL fuera del frame", loads > 0);
+    expect_true("saltos hacia atrás o fuera del código", jumps >= 2);
+    expect_true("RET con registro no válido, sin RET u opcode desconocido", returns == 3);
+    pug_template_free(tpl);
+
+    // Bytes al azar: abrir y montar nunca falla de otra forma que con NULL
+    GRand* rand = g_rand_new_with_seed(48);
+    int rejected = 0;
+    for (int round = 0; round < 300; round++) {
+        memcpy(copy->data, data->data, data->len);
+        for (int flips = g_rand_int_range(rand, 1, 5); flips > 0; flips--) {
+            copy->data[g_rand_int_range(rand, 0, (gint32)copy->len)] = (guint8)g_rand_int_range(rand, 0, 256);
+        }
+        PugImage* fuzzed = pug_image_open(copy->data, copy->len);
+        PugEngine* engine = pug_engine_new_from_image(fuzzed, NULL);
+        int loaded_all = engine != NULL;
+        for (guint i = 0; engine && i < G_N_ELEMENTS(NAMES); i++) {
+            char* html = render(engine, NAMES[i], round & 1, PUG_MINIFY_NONE);
+            if (!html) loaded_all = 0;
+            g_free(html);
+        }
+        if (!loaded_all) rejected++;
+        pug_engine_free(engine);
+        pug_image_free(fuzzed);
+    }
+    expect_true("bytes cambiados al azar: se rechazan sin romper nada", rejected > 0);
+    g_rand_free(rand);
+
+    g_byte_array_free(copy, TRUE);
+    g_byte_array_free(data, TRUE);
+    g_ptr_array_free(names, TRUE);
+    pug_engine_free(source);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+// Pruebas del enlace de locales: cada nombre se resuelve a un slot al
+// compilar y las interpolaciones leen el frame por índice.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static const char* PAGE_SOURCE =
+    "div(title=titulo)\n"
+    "  h1 Hola #{nombre}\n"
+    "  p #{html} / !{html}\n"
+    "  p #{usuario.pais} #{vacio}\n";
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static void expect_true(const char* what, int condition) {
+    if (condition) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+int main(void) {
+    PugTemplate* tpl = pug_template_compile(PAGE_SOURCE, "page");
+    if (!tpl) {
+        printf("FAIL no compila la plantilla\n");
+        return 1;
+    }
+
+    // Un slot por nombre distinto
+    int nombre = pug_template_slot(tpl, "nombre");
+    expect_true("slot de una local", nombre >= 0);
+    expect_true("slot de una local de atributo", pug_template_slot(tpl, "titulo") >= 0);
+    expect_true("nombres distintos, slots distintos",
+                pug_template_slot(tpl, "titulo") != nombre && pug_template_slot(tpl, "usuario") != nombre);
+    expect_true("propiedad: sólo la raíz tiene slot", pug_template_slot(tpl, "pais") < 0);
+    expect_true("local que no usa la plantilla", pug_template_slot(tpl, "otra") < 0);
+
+    PugLocals* locals = pug_locals_new(tpl);
+    expect_true("enlazar una local desconocida devuelve 0", !pug_locals_set_string(locals, "otra", "x"));
+    pug_locals_set(locals, (unsigned int)nombre, pug_value_string("Ana"));
+    pug_locals_set_string(locals, "titulo", "t\"1");
+    pug_locals_set_string(locals, "html", "<b>");
+    const char* keys[] = { "pais" };
+    PugValue pais = pug_value_string("ES");
+    pug_locals_set_by_name(locals, "usuario", pug_value_object(keys, &pais, 1));
+
+    char* html = pug_template_render(tpl, locals, 0, 2, 0);
+    expect_contains("interpolación por slot", html, "<h1>Hola Ana</h1>");
+    expect_contains("atributo escapado", html, "title=\"t&quot;1\"");
+    expect_contains("#{} escapa y !{} no", html, "&lt;b&gt; / <b>");
+    expect_contains("propiedad de un objeto; local sin valor vacía", html, "<p>ES </p>");
+    g_free(html);
+
+    // El mismo frame se reutiliza: sólo cambia lo que se vuelve a enlazar
+    pug_locals_set_string(locals, "nombre", "Bob");
+    html = pug_template_render(tpl, locals, 0, 2, 0);
+    expect_contains("reenlazar una local", html, "<h1>Hola Bob</h1>");
+    expect_contains("el resto se conserva", html, "<p>ES </p>");
+    g_free(html);
+
+    pug_locals_reset(locals);
+    html = pug_template_render(tpl, locals, 0, 2, 0);
+    expect_contains("reset deja las locales vacías", html, "<h1>Hola </h1>");
+    g_free(html);
+
+    pug_locals_free(locals);
+    pug_template_free(tpl);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
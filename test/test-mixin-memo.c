@@ -0,0 +1,120 @@
+// Pruebas del optimizador de llamadas: mixins puros con argumentos
+// constantes (una salida por contexto, copiada después), memo de mixins
+// puros por el valor de sus argumentos y mixins impuros que siempre se
+// renderizan.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static const char* PAGE_SOURCE =
+    "mixin badge(texto)\n"
+    "  span.badge #{texto}\n"
+    "mixin saludo()\n"
+    "  b Hola #{usuario}\n"
+    "mixin marco()\n"
+    "  div\n"
+    "    block\n"
+    "div\n"
+    "  +badge('fijo')\n"
+    "  div\n"
+    "    +badge('fijo')\n"
+    "  each t in tags\n"
+    "    +badge(t)\n"
+    "  +saludo()\n"
+    "  +marco()\n"
+    "    +badge('dentro')\n";
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static void expect_true(const char* what, int condition) {
+    if (condition) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Primera llamada a name en el árbol
+static PugCall* find_call(ASTNode* node, const char* name) {
+    if (node->call && strcmp(node->call->name, name) == 0) return node->call;
+    for (unsigned int i = 0; i < node->children_count; i++) {
+        PugCall* found = find_call(node->children[i], name);
+        if (found) return found;
+    }
+    return NULL;
+}
+
+static unsigned int count_variants(const PugCall* call) {
+    unsigned int n = 0;
+    for (const PugCallVariant* v = call ? call->variants : NULL; v; v = v->next) n++;
+    return n;
+}
+
+static char* render(PugTemplate* tpl, const char* usuario, PugValue tags, unsigned int minify) {
+    PugLocals* locals = pug_locals_new(tpl);
+    pug_locals_set_string(locals, "usuario", usuario);
+    pug_locals_set_by_name(locals, "tags", tags);
+    char* html = pug_template_render(tpl, locals, 0, 2, minify);
+    pug_locals_free(locals);
+    return html;
+}
+
+int main(void) {
+    PugTemplate* tpl = pug_template_compile(PAGE_SOURCE, "memo");
+    if (!tpl) {
+        printf("FAIL no compila la plantilla\n");
+        return 1;
+    }
+    pug_template_set_mixin_memo(tpl, 1024 * 1024);
+
+    PugCall* fixed = find_call(tpl->root, "badge");
+    PugCall* greeting = find_call(tpl->root, "saludo");
+    PugCall* frame = find_call(tpl->root, "marco");
+    expect_true("mixin puro con argumentos constantes: llamada constante", fixed && fixed->constant);
+    expect_true("mixin que lee una local: no es puro", greeting && greeting->mixin && !greeting->mixin->pure);
+    expect_true("mixin con block: no es constante", frame && !frame->constant);
+
+    PugValue a[] = { pug_value_string("a"), pug_value_string("b") };
+    char* html = render(tpl, "Ana", pug_value_array(a, 2), PUG_MINIFY_NONE);
+    expect_contains("llamada constante", html, "  <span class=\"badge\">fijo</span>\n");
+    expect_contains("la misma llamada más anidada se indenta aparte", html,
+                    "    <span class=\"badge\">fijo</span>\n");
+    expect_contains("llamada memo", html, "<span class=\"badge\">b</span>");
+    expect_contains("mixin impuro", html, "<b>Hola Ana</b>");
+    expect_contains("block con una llamada constante dentro", html, "<span class=\"badge\">dentro</span>");
+    g_free(html);
+    expect_true("una variante por contexto de salida", count_variants(fixed) == 1);
+
+    // Segundo render: el memo acierta con los mismos argumentos y el mixin
+    // impuro ve la nueva local
+    guint64 hits = 0, hits_after = 0;
+    pug_fragment_cache_stats(tpl->memo, &hits, NULL, NULL, NULL);
+    html = render(tpl, "Bob", pug_value_array(a, 2), PUG_MINIFY_NONE);
+    pug_fragment_cache_stats(tpl->memo, &hits_after, NULL, NULL, NULL);
+    expect_true("memo: mismos argumentos, mismas salidas", hits_after == hits + 2);
+    expect_contains("mixin impuro con otra local", html, "<b>Hola Bob</b>");
+    g_free(html);
+
+    // Otro modo de salida es otro contexto: no reutiliza la variante indentada
+    html = render(tpl, "Ana", pug_value_array(a, 1), PUG_MINIFY_COMPACT);
+    expect_contains("variante compacta", html, "<div><span class=\"badge\">fijo</span><div>");
+    g_free(html);
+    expect_true("variantes por modo", count_variants(fixed) == 2);
+
+    pug_template_free(tpl);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+// Pruebas de los mixins compilados: argumentos, valores por defecto,
+// argumentos de resto, `block`, &attributes, llamadas anidadas y el render
+// de un árbol compilado sin locales (render_ast).
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static const char* PAGE_SOURCE =
+    "mixin item(texto, clase = 'normal')\n"
+    "  li(class=clase)&attributes(attributes) #{texto}\n"
+    "mixin caja(titulo)\n"
+    "  section\n"
+    "    h2 #{titulo}\n"
+    "    block\n"
+    "mixin lista(nombre, ...items)\n"
+    "  ul(id=nombre)\n"
+    "    each i in items\n"
+    "      +item(i)\n"
+    "ul\n"
+    "  +item('uno')\n"
+    "  +item('dos', 'extra')\n"
+    "  +item(quien)(id='tres', data-x=1)\n"
+    "+caja('Caja')\n"
+    "  p contenido de #{quien}\n"
+    "+caja('Vacía')\n"
+    "+lista('l', 'a', 'b')\n"
+    "p #{texto} tras las llamadas\n";
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+int main(void) {
+    PugTemplate* tpl = pug_template_compile(PAGE_SOURCE, "mixins");
+    if (!tpl) {
+        printf("FAIL no compila la plantilla\n");
+        return 1;
+    }
+
+    PugLocals* locals = pug_locals_new(tpl);
+    pug_locals_set_string(locals, "quien", "Ana");
+    pug_locals_set_string(locals, "texto", "fuera");
+    char* html = pug_template_render(tpl, locals, 0, 2, PUG_MINIFY_COMPACT);
+    expect_contains("argumento con valor por defecto", html, "<li class=\"normal\">uno</li>");
+    expect_contains("argumento explícito", html, "<li class=\"extra\">dos</li>");
+    expect_contains("argumento desde una local y &attributes", html,
+                    "<li class=\"normal\" id=\"tres\" data-x=\"1\">Ana</li>");
+    expect_contains("block con el contenido de la llamada", html,
+                    "<section><h2>Caja</h2><p>contenido de Ana</p></section>");
+    expect_contains("block sin contenido", html, "<section><h2>Vacía</h2></section>");
+    expect_contains("resto de argumentos y llamadas anidadas", html,
+                    "<ul id=\"l\"><li class=\"normal\">a</li><li class=\"normal\">b</li></ul>");
+    expect_contains("los parámetros no pisan las locales", html, "<p>fuera tras las llamadas</p>");
+    g_free(html);
+    pug_locals_free(locals);
+
+    // Sin locales enlazadas las llamadas se siguen renderizando
+    char* with_template = pug_template_render(tpl, NULL, 0, 2, PUG_MINIFY_COMPACT);
+    char* tree_only = render_ast(tpl->root, 0, 2, PUG_MINIFY_COMPACT);
+    expect_contains("render_ast renderiza las llamadas", tree_only, "<li class=\"normal\">uno</li>");
+    if (with_template && tree_only && strcmp(with_template, tree_only) == 0) {
+        printf("ok   render_ast igual que la plantilla sin locales\n");
+    } else {
+        printf("FAIL render_ast distinto:\n%s\n%s\n", with_template, tree_only);
+        failures++;
+    }
+    g_free(with_template);
+    g_free(tree_only);
+
+    pug_template_free(tpl);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+// Pruebas del registro de plantillas publicadas: un lector que ve una
+// versión caducada la sigue recibiendo sin esperar a la compilación, que
+// hace el hilo de recargas, y la nueva se publica después.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+// Proveedor en memoria con una versión por plantilla. Con el paso cerrado
+// las lecturas esperan (como un disco muy lento) hasta que se abra.
+static gint version = 1;
+static gint reads = 0;
+static gboolean gate_closed = FALSE;
+static GMutex gate_lock;
+static GCond gate_cond;
+
+static char* test_read(const char* path, gpointer data) {
+    (void)path;
+    (void)data;
+    g_atomic_int_inc(&reads);
+    g_mutex_lock(&gate_lock);
+    gint64 deadline = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+    while (gate_closed && g_cond_wait_until(&gate_cond, &gate_lock, deadline)) {
+    }
+    g_mutex_unlock(&gate_lock);
+    return g_strdup_printf("p versión %d\n", g_atomic_int_get(&version));
+}
+
+static gint64 test_stat(const char* path, gpointer data) {
+    (void)path;
+    (void)data;
+    return g_atomic_int_get(&version);
+}
+
+static void set_gate(gboolean closed) {
+    g_mutex_lock(&gate_lock);
+    gate_closed = closed;
+    g_cond_broadcast(&gate_cond);
+    g_mutex_unlock(&gate_lock);
+}
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static void expect_true(const char* what, int condition) {
+    if (condition) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Lee page del registro y devuelve la versión publicada (y su HTML en html)
+static const PugTemplate* get_page(PugEngine* engine, char** html) {
+    guint guard = pug_registry_enter(engine->registry);
+    const PugTemplate* tpl = pug_registry_get(engine->registry, "page");
+    if (html) *html = tpl ? g_strdup(pug_engine_render(engine, tpl, NULL, NULL)) : NULL;
+    pug_registry_leave(engine->registry, guard);
+    return tpl;
+}
+
+int main(void) {
+    PugFileProvider provider = { test_read, NULL, test_stat, NULL };
+    PugEngineConfig config = pug_engine_config_default();
+    config.check = PUG_CHECK_STAMP;
+    config.provider = &provider;
+    PugEngine* engine = pug_engine_new("/", &config);
+
+    char* html;
+    const PugTemplate* first = get_page(engine, &html);
+    expect_contains("primera lectura: compila", html, "<p>versión 1</p>");
+    g_free(html);
+    expect_true("sin cambios: la misma versión", get_page(engine, NULL) == first);
+
+    // Cambia la plantilla y su compilación se queda parada en la lectura
+    set_gate(TRUE);
+    g_atomic_int_set(&version, 2);
+    gint reads_before = g_atomic_int_get(&reads);
+    gint64 start = g_get_monotonic_time();
+    const PugTemplate* stale = get_page(engine, &html);
+    stale = get_page(engine, NULL);
+    stale = get_page(engine, NULL);
+    gint64 elapsed = g_get_monotonic_time() - start;
+    expect_true("el lector no espera a la compilación", elapsed < G_USEC_PER_SEC);
+    expect_true("recibe la versión publicada", stale == first);
+    expect_contains("que sigue siendo la anterior", html, "<p>versión 1</p>");
+    g_free(html);
+
+    // El hilo de recargas publica la nueva al terminar, una sola vez
+    set_gate(FALSE);
+    const PugTemplate* fresh = first;
+    for (int i = 0; i < 500 && fresh == first; i++) {
+        g_usleep(10000);
+        fresh = get_page(engine, &html);
+        if (fresh == first) g_free(html);
+    }
+    expect_true("la versión nueva se publica", fresh != first);
+    expect_contains("con el contenido nuevo", fresh != first ? html : NULL, "<p>versión 2</p>");
+    if (fresh != first) g_free(html);
+    expect_true("una recarga por versión caducada", g_atomic_int_get(&reads) - reads_before == 1);
+    expect_true("y ya no está caducada", get_page(engine, NULL) == fresh);
+
+    pug_engine_free(engine);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}
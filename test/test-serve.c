@@ -0,0 +1,301 @@
+// Pruebas del servidor de render: codificación y decodificación de las
+// locales, tramas mal formadas, peticiones por el socket, rutas que intentan
+// salir de la raíz de las plantillas y clientes que no leen su respuesta.
+//
+// Se compila y ejecuta desde run.sh; termina con 0 si todas pasan.
+
+#include <stdio.h>
+#include <string.h>
+#include <c-pug.h>
+
+static int failures = 0;
+
+static void expect_contains(const char* what, const char* html, const char* needle) {
+    if (html && strstr(html, needle)) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s: falta '%s' en:\n%s\n", what, needle, html ? html : "(null)");
+        failures++;
+    }
+}
+
+static void expect_true(const char* what, int condition) {
+    if (condition) {
+        printf("ok   %s\n", what);
+    } else {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Igualdad estructural (las cadenas por contenido)
+static int same_value(const PugValue* a, const PugValue* b) {
+    if (a->type != b->type) return 0;
+    switch (a->type) {
+        case PUG_VALUE_BOOL:
+            return a->as.boolean == b->as.boolean;
+        case PUG_VALUE_NUMBER:
+            return a->as.number == b->as.number;
+        case PUG_VALUE_STRING:
+            return a->as.string.len == b->as.string.len &&
+                   memcmp(a->as.string.str, b->as.string.str, a->as.string.len) == 0;
+        case PUG_VALUE_ARRAY:
+            if (a->as.array.count != b->as.array.count) return 0;
+            for (gsize i = 0; i < a->as.array.count; i++) {
+                if (!same_value(&a->as.array.items[i], &b->as.array.items[i])) return 0;
+            }
+            return 1;
+        case PUG_VALUE_OBJECT:
+            if (a->as.object.count != b->as.object.count) return 0;
+            for (gsize i = 0; i < a->as.object.count; i++) {
+                if (strcmp(a->as.object.keys[i], b->as.object.keys[i]) != 0 ||
+                    !same_value(&a->as.object.values[i], &b->as.object.values[i])) {
+                    return 0;
+                }
+            }
+            return 1;
+        default:
+            return 1;
+    }
+}
+
+// Decodifica data entero como un valor
+static gboolean decode(const guint8* data, gsize len, PugArena* arena, PugValue* value) {
+    PugServeReader reader = { data, data + len };
+    return serve_get_value(&reader, arena, value, 0) && reader.p == reader.end;
+}
+
+static void test_values(void) {
+    const char* keys[] = { "nombre", "", "lista" };
+    PugValue inner[] = { pug_value_number(-2.5), pug_value_null(), pug_value_string("") };
+    PugValue fields[] = { pug_value_string("Ana \xc3\xb1 <b>"), pug_value_bool(TRUE), pug_value_array(inner, 3) };
+    PugValue items[] = { pug_value_object(keys, fields, 3), pug_value_number(1e300), pug_value_bool(FALSE),
+                         pug_value_string_len("a\0b", 3), pug_value_array(NULL, 0) };
+    PugValue original = pug_value_array(items, G_N_ELEMENTS(items));
+
+    GByteArray* data = g_byte_array_new();
+    pug_serve_put_value(data, &original);
+    PugArena arena = { 0 };
+    PugValue decoded;
+    expect_true("ida y vuelta: decodifica", decode(data->data, data->len, &arena, &decoded));
+    expect_true("ida y vuelta: mismo valor", same_value(&original, &decoded));
+
+    // Cualquier trama cortada se rechaza
+    int truncated_ok = 1;
+    for (guint len = 0; len < data->len; len++) {
+        pug_arena_reset(&arena);
+        if (decode(data->data, len, &arena, &decoded)) truncated_ok = 0;
+    }
+    expect_true("valores cortados en cualquier byte", truncated_ok);
+
+    // Tipo desconocido
+    guint8 bad_type[] = { 99 };
+    expect_true("tipo desconocido", !decode(bad_type, sizeof(bad_type), &arena, &decoded));
+
+    // Un recuento enorme con pocos bytes no reserva nada
+    guint8 huge[] = { PUG_VALUE_ARRAY, 0xff, 0xff, 0xff, 0xff, PUG_VALUE_NULL };
+    expect_true("array con más elementos que bytes", !decode(huge, sizeof(huge), &arena, &decoded));
+    huge[0] = PUG_VALUE_OBJECT;
+    expect_true("objeto con más claves que bytes", !decode(huge, sizeof(huge), &arena, &decoded));
+
+    // Anidamiento por encima de PUG_SERVE_MAX_DEPTH
+    g_byte_array_set_size(data, 0);
+    for (int i = 0; i <= PUG_SERVE_MAX_DEPTH + 1; i++) {
+        guint8 head[] = { PUG_VALUE_ARRAY, 1, 0, 0, 0 };
+        g_byte_array_append(data, head, sizeof(head));
+    }
+    serve_put_u8(data, PUG_VALUE_NULL);
+    expect_true("anidamiento excesivo", !decode(data->data, data->len, &arena, &decoded));
+
+    pug_arena_clear(&arena);
+    g_byte_array_free(data, TRUE);
+}
+
+// Envía una trama con cuerpo body y devuelve el estado de la respuesta
+static int call_raw(int fd, const guint8* body, gsize len, GByteArray* reply) {
+    GByteArray* frame = g_byte_array_new();
+    serve_put_u32(frame, (guint32)len);
+    g_byte_array_append(frame, body, (guint)len);
+    int status = pug_serve_call(fd, frame, reply);
+    g_byte_array_free(frame, TRUE);
+    return status;
+}
+
+static volatile gint stop = 0;
+
+static gpointer run_server(gpointer data) {
+    pug_server_run((PugServer*)data, &stop);
+    return NULL;
+}
+
+// Pide path con la local msg; devuelve el estado y deja el cuerpo en body
+// (terminado en '\0')
+static int call(int fd, const char* path, const char* msg, GByteArray* body) {
+    GByteArray* request = g_byte_array_new();
+    pug_serve_request_begin(request, path);
+    PugValue value = pug_value_string(msg);
+    pug_serve_request_add(request, "msg", &value);
+    pug_serve_request_end(request);
+    int status = pug_serve_call(fd, request, body);
+    g_byte_array_free(request, TRUE);
+    if (status >= 0) g_byte_array_append(body, (const guint8*)"", 1);
+    return status;
+}
+
+// Petición de la plantilla lista con n elementos
+static GByteArray* list_request(guint n) {
+    PugValue* items = g_new(PugValue, n);
+    for (guint i = 0; i < n; i++) items[i] = pug_value_string("elemento");
+    PugValue value = pug_value_array(items, n);
+    GByteArray* request = g_byte_array_new();
+    pug_serve_request_begin(request, "lista");
+    pug_serve_request_add(request, "items", &value);
+    pug_serve_request_end(request);
+    g_free(items);
+    return request;
+}
+
+static gboolean send_all(int fd, const GByteArray* data) {
+    for (guint done = 0; done < data->len;) {
+        ssize_t sent = send(fd, data->data + done, data->len - done, MSG_NOSIGNAL);
+        if (sent <= 0) return FALSE;
+        done += (guint)sent;
+    }
+    return TRUE;
+}
+
+// Lee una respuesta (estado o -1) sin enviar nada
+static int read_response(int fd, GByteArray* body) {
+    guint8 header[5];
+    guint32 len;
+    if (!serve_read_full(fd, header, sizeof(header))) return -1;
+    memcpy(&len, header, 4);
+    len = GUINT32_FROM_LE(len);
+    g_byte_array_set_size(body, len - 1);
+    if (!serve_read_full(fd, body->data, len - 1)) return -1;
+    return header[4];
+}
+
+int main(void) {
+    test_values();
+
+    // tmp/secreto.pug queda fuera de la raíz tmp/raiz
+    char* tmp = g_dir_make_tmp("pug-serve-XXXXXX", NULL);
+    char* root = g_build_filename(tmp, "raiz", NULL);
+    char* pages = g_build_filename(root, "pages", NULL);
+    char* page = g_build_filename(root, "page.pug", NULL);
+    char* sub = g_build_filename(pages, "sub.pug", NULL);
+    char* escape = g_build_filename(root, "escape.pug", NULL);
+    char* list = g_build_filename(root, "lista.pug", NULL);
+    char* secret = g_build_filename(tmp, "secreto.pug", NULL);
+    char* socket_path = g_build_filename(tmp, "serve.sock", NULL);
+    g_mkdir_with_parents(pages, 0700);
+    g_file_set_contents(page, "p Hola #{msg}\n", -1, NULL);
+    g_file_set_contents(sub, "include ../page\n", -1, NULL);
+    g_file_set_contents(escape, "include ../secreto\n", -1, NULL);
+    g_file_set_contents(list, "each i in items\n  p #{i}\n", -1, NULL);
+    g_file_set_contents(secret, "p secreto\n", -1, NULL);
+
+    PugEngine* engine = pug_engine_new(root, NULL);
+
+    // El loader no resuelve nada fuera de la raíz
+    PugTemplate* tpl = pug_loader_get(engine->loader, "pages/../page");
+    expect_true("ruta con .. dentro de la raíz", tpl != NULL);
+    pug_template_free(tpl);
+    tpl = pug_loader_get(engine->loader, "../secreto");
+    expect_true("ruta que sale de la raíz", tpl == NULL);
+    pug_template_free(tpl);
+    tpl = pug_loader_get(engine->loader, "/../secreto");
+    expect_true("ruta absoluta que sale de la raíz", tpl == NULL);
+    pug_template_free(tpl);
+
+    // Un solo hilo: un cliente que lo retuviera pararía a todos los demás
+    PugServer* server = pug_server_new(engine, socket_path, 1);
+    if (!server) {
+        printf("FAIL no se pudo arrancar el servidor\n");
+        return 1;
+    }
+    GThread* thread = g_thread_new("serve", run_server, server);
+    int fd = pug_serve_connect(socket_path);
+    GByteArray* body = g_byte_array_new();
+
+    expect_true("petición", call(fd, "page", "Ana", body) == PUG_SERVE_OK);
+    expect_contains("render con la local", (const char*)body->data, "<p>Hola Ana</p>");
+    expect_true("include relativo dentro de la raíz", call(fd, "pages/sub", "Bob", body) == PUG_SERVE_OK);
+    expect_contains("render del include", (const char*)body->data, "<p>Hola Bob</p>");
+    expect_true("../ fuera de la raíz: no encontrada", call(fd, "../secreto", "", body) == PUG_SERVE_NOT_FOUND);
+    expect_true("otra profundidad", call(fd, "pages/../../secreto", "", body) == PUG_SERVE_NOT_FOUND);
+    expect_true("/../ fuera de la raíz", call(fd, "/../secreto", "", body) == PUG_SERVE_NOT_FOUND);
+    expect_true("archivo del sistema", call(fd, "../../../../../../etc/passwd", "", body) == PUG_SERVE_NOT_FOUND);
+    // Un include sin resolver se queda como comentario, como cualquier otro
+    call(fd, "escape", "", body);
+    expect_true("include que sale de la raíz: sin su contenido", !strstr((const char*)body->data, "<p>secreto</p>"));
+    expect_true("la conexión sigue abierta", call(fd, "page", "Eva", body) == PUG_SERVE_OK);
+
+    // Tramas mal formadas: se rechazan y la conexión sigue
+    guint8 short_name[] = { 9, 0, 'p' };
+    expect_true("ruta cortada", call_raw(fd, short_name, sizeof(short_name), body) == PUG_SERVE_BAD_REQUEST);
+    guint8 bad_local[] = { 4, 0, 'p', 'a', 'g', 'e', 3, 0, 'm', 's', 'g', 99 };
+    expect_true("local de tipo desconocido", call_raw(fd, bad_local, sizeof(bad_local), body) == PUG_SERVE_BAD_REQUEST);
+    guint8 cut_local[] = { 4, 0, 'p', 'a', 'g', 'e', 3, 0, 'm', 's', 'g', PUG_VALUE_STRING, 50, 0, 0, 0, 'x' };
+    expect_true("cadena más larga que la trama", call_raw(fd, cut_local, sizeof(cut_local), body) == PUG_SERVE_BAD_REQUEST);
+    expect_true("trama vacía", call_raw(fd, NULL, 0, body) == PUG_SERVE_BAD_REQUEST);
+    expect_true("la conexión sigue tras los errores", call(fd, "page", "Eva", body) == PUG_SERVE_OK);
+    expect_contains("render tras los errores", (const char*)body->data, "<p>Hola Eva</p>");
+
+    // Una trama que anuncia más de PUG_SERVE_MAX_REQUEST: error y cierre
+    int huge = pug_serve_connect(socket_path);
+    guint8 huge_header[] = { 0xff, 0xff, 0xff, 0x7f };
+    GByteArray* header = g_byte_array_new();
+    g_byte_array_append(header, huge_header, sizeof(huge_header));
+    expect_true("trama demasiado grande", send_all(huge, header) && read_response(huge, body) == PUG_SERVE_BAD_REQUEST);
+    expect_true("y después se cierra", read(huge, huge_header, 1) == 0);
+    g_byte_array_free(header, TRUE);
+    close(huge);
+
+    // Una respuesta mucho mayor que el buffer del socket que el cliente no
+    // lee: se queda en la conexión y el hilo atiende a los demás
+    guint n_items = 200000;
+    GByteArray* big = list_request(n_items);
+    int slow = pug_serve_connect(socket_path);
+    expect_true("petición con respuesta grande enviada", send_all(slow, big));
+    g_usleep(200000);
+    gint64 start = g_get_monotonic_time();
+    int status = call(fd, "page", "Luz", body);
+    gint64 elapsed = g_get_monotonic_time() - start;
+    expect_true("otro cliente no espera al que no lee", status == PUG_SERVE_OK && elapsed < 2 * G_USEC_PER_SEC);
+    gsize expected = n_items * strlen("<p>elemento</p>");
+    status = read_response(slow, body);
+    expect_true("la respuesta pendiente llega entera", status == PUG_SERVE_OK && body->len >= expected);
+    status = pug_serve_call(slow, big, body);
+    expect_true("y la conexión sigue atendiendo", status == PUG_SERVE_OK && body->len >= expected);
+    close(slow);
+    g_byte_array_free(big, TRUE);
+
+    close(fd);
+    g_byte_array_free(body, TRUE);
+    g_atomic_int_set(&stop, 1);
+    g_thread_join(thread);
+    pug_server_free(server);
+    pug_engine_free(engine);
+
+    remove(page);
+    remove(sub);
+    remove(escape);
+    remove(list);
+    remove(secret);
+    rmdir(pages);
+    rmdir(root);
+    rmdir(tmp);
+    g_free(page);
+    g_free(sub);
+    g_free(escape);
+    g_free(list);
+    g_free(secret);
+    g_free(socket_path);
+    g_free(pages);
+    g_free(root);
+    g_free(tmp);
+    printf(failures ? "%d fallos\n" : "Todas las pruebas pasan\n", failures);
+    return failures ? 1 : 0;
+}